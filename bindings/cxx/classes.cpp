@@ -1681,6 +1681,11 @@ string Output::receive(shared_ptr<Packet> packet)
 	}
 }
 
+void Output::finalize()
+{
+	check(sr_output_finalize(_structure));
+}
+
 #include <enums.cpp>
 
 }
@@ -1015,6 +1015,9 @@ public:
 	/** Update output with data from the given packet.
 	 * @param packet Packet to handle. */
 	std::string receive(std::shared_ptr<Packet> packet);
+	/** Update the output file in place, after all output was written
+	 * to it and it was closed. */
+	void finalize();
 	/** Output format in use for this output */
 	std::shared_ptr<OutputFormat> format();
 private:
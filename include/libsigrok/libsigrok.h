@@ -153,6 +153,7 @@ enum sr_datatype {
 	SR_T_DOUBLE_RANGE,
 	SR_T_INT32,
 	SR_T_MQ,
+	SR_T_UINT64_ARRAY,
 
 	/* Update sr_variant_type_get() (hwdriver.c) upon changes! */
 };
@@ -1077,6 +1078,40 @@ enum sr_configkey {
 	 */
 	SR_CONF_RESISTANCE_TARGET,
 
+	/**
+	 * USB bulk transfer size in bytes, 0 selects automatic sizing.
+	 * @arg type: uint64_t
+	 * @arg get: get configured transfer size
+	 * @arg set: change transfer size for the next acquisition
+	 */
+	SR_CONF_USB_TRANSFER_SIZE,
+
+	/**
+	 * Number of USB bulk transfers in flight, 0 selects automatic sizing.
+	 * @arg type: uint64_t
+	 * @arg get: get configured transfer count
+	 * @arg set: change transfer count for the next acquisition
+	 */
+	SR_CONF_USB_TRANSFER_COUNT,
+
+	/**
+	 * Interval in ms over which readings get collected into one analog
+	 * packet per channel, 0 sends every reading right away. Readings
+	 * keep the encoding in which the driver provided them.
+	 * @arg type: uint64_t
+	 * @arg get: get configured batch interval
+	 * @arg set: change batch interval
+	 */
+	SR_CONF_BATCH_INTERVAL,
+
+	/**
+	 * Host timestamps of the samples in the analog packet which follows,
+	 * in microseconds since the Unix epoch, taken upon data reception.
+	 * Only sent as meta packet.
+	 * @arg type: array of uint64_t
+	 */
+	SR_CONF_SAMPLE_TIMESTAMPS,
+
 	/* Update sr_key_info_config[] (hwdriver.c) upon changes! */
 
 	/*--- Special stuff -------------------------------------------------*/
@@ -156,6 +156,8 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 
 SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 		struct sr_datafeed_packet **copy);
+SR_API int sr_packet_copy_shared(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy);
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet);
 
 /*--- input/input.c ---------------------------------------------------------*/
@@ -198,6 +200,7 @@ SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_finalize(const struct sr_output *o);
 SR_API int sr_output_free(const struct sr_output *o);
 
 /*--- transform/transform.c -------------------------------------------------*/
@@ -292,6 +292,27 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		return SR_ERR;
 	}
 
+	/*
+	 * Convert longer runs of 8bit values by means of a lookup table.
+	 * Table entries are computed in the same way as the individual
+	 * conversions below, results are identical.
+	 */
+	if (input_unitsize == sizeof(uint8_t) && count >= 256) {
+		float table[256];
+		size_t idx;
+		for (idx = 0; idx < ARRAY_SIZE(table); idx++) {
+			if (input_signed)
+				value = (int8_t)idx;
+			else
+				value = idx;
+			value *= scale;
+			value += offset;
+			table[idx] = value;
+		}
+		while (count--)
+			*outbuf++ = table[*data8++];
+		return SR_OK;
+	}
 	if (input_unitsize == sizeof(uint8_t) && input_signed) {
 		int8_t (*reader)(const uint8_t **p);
 		reader = read_i8_inc;
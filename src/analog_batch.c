@@ -0,0 +1,429 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Batching of individual analog readings
+ *
+ * Meters which report one reading per serial packet would send one analog
+ * packet per reading. These helpers collect a channel's readings over a
+ * configurable interval (SR_CONF_BATCH_INTERVAL), and send them as one
+ * analog packet. Each such packet is preceded by an SR_CONF_SAMPLE_TIMESTAMPS
+ * meta packet which carries the host time of reception for every sample,
+ * which allows to correlate the readings of several devices. Drivers
+ * record when each chunk of serial data arrives, a packet's readings get
+ * the time of the chunk which held the packet's first byte. Readings are
+ * sent right away when no interval is configured.
+ *
+ * Batches keep the readings in their original encoding, e.g. double
+ * values of meters whose protocol is parsed to double.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "analog_batch"
+
+/* Upper limit for the interval, and for the samples per packet. */
+#define MAX_INTERVAL_MS		60000
+#define MAX_BATCH_SAMPLES	4096
+
+/* Pending readings of one channel, all with the same meaning and encoding. */
+struct batch_chan {
+	struct sr_channel *channel;
+	enum sr_mq mq;
+	enum sr_unit unit;
+	enum sr_mqflag mqflags;
+	struct sr_analog_encoding encoding;
+	int8_t spec_digits;
+	GByteArray *values;
+	GArray *timestamps;
+	int64_t first_us;
+};
+
+/**
+ * Initialize an analog batching instance.
+ *
+ * Must be called before any other operations are performed on a struct
+ * sr_analog_batch, typically when the device context gets allocated.
+ * Readings get sent right away.
+ *
+ * @param batch The analog batching instance to initialize.
+ */
+SR_PRIV void sr_analog_batch_init(struct sr_analog_batch *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * Get analog batching configuration.
+ *
+ * Should be called from the driver's config_get() callback.
+ *
+ * @param batch Analog batching instance.
+ * @param key Config item key.
+ * @param data Config item data.
+ *
+ * @return SR_ERR_NA if @p key is not supported, SR_OK otherwise.
+ */
+SR_PRIV int sr_analog_batch_config_get(const struct sr_analog_batch *batch,
+	uint32_t key, GVariant **data)
+{
+	if (key != SR_CONF_BATCH_INTERVAL)
+		return SR_ERR_NA;
+
+	*data = g_variant_new_uint64(batch->cfg_interval_ms);
+
+	return SR_OK;
+}
+
+/**
+ * Set analog batching configuration.
+ *
+ * Should be called from the driver's config_set() callback. Takes effect
+ * for subsequently added readings.
+ *
+ * @param batch Analog batching instance.
+ * @param key Config item key.
+ * @param data Config item data.
+ *
+ * @return SR_ERR_NA if @p key is not supported, SR_ERR_ARG for values
+ *         which are out of range, SR_OK otherwise.
+ */
+SR_PRIV int sr_analog_batch_config_set(struct sr_analog_batch *batch,
+	uint32_t key, GVariant *data)
+{
+	uint64_t value;
+
+	if (key != SR_CONF_BATCH_INTERVAL)
+		return SR_ERR_NA;
+
+	value = g_variant_get_uint64(data);
+	if (value > MAX_INTERVAL_MS)
+		return SR_ERR_ARG;
+	batch->cfg_interval_ms = value;
+
+	return SR_OK;
+}
+
+/**
+ * Record the reception of another chunk of data.
+ *
+ * Should be called by drivers whenever a serial read has appended data
+ * to their receive buffer. Tracks the host time of reception of every
+ * chunk which is still in the buffer, see sr_analog_batch_rx_time().
+ *
+ * @param batch Analog batching instance.
+ * @param len Number of bytes which were appended to the receive buffer.
+ */
+SR_PRIV void sr_analog_batch_rx_chunk(struct sr_analog_batch *batch,
+	size_t len)
+{
+	size_t count, end;
+
+	if (!len)
+		return;
+
+	count = batch->rx_chunk_count;
+	end = count ? batch->rx_chunks[count - 1].end : 0;
+	if (count == ARRAY_SIZE(batch->rx_chunks)) {
+		/* Merge the two oldest chunks, keep the earlier time. */
+		batch->rx_chunks[1].time_us = batch->rx_chunks[0].time_us;
+		memmove(&batch->rx_chunks[0], &batch->rx_chunks[1],
+			(count - 1) * sizeof(batch->rx_chunks[0]));
+		count--;
+	}
+	batch->rx_chunks[count].end = end + len;
+	batch->rx_chunks[count].time_us = g_get_real_time();
+	batch->rx_chunk_count = count + 1;
+}
+
+/**
+ * Get the host time of reception of a byte in the receive buffer.
+ *
+ * Drivers pass the position of a packet's first byte, and use the result
+ * as the timestamp of the packet's readings.
+ *
+ * @param batch Analog batching instance.
+ * @param pos Position of the byte in the driver's receive buffer.
+ *
+ * @return The time at which the chunk which contains the byte was
+ *         received, in microseconds since the Unix epoch. The current
+ *         time for bytes which were not recorded.
+ */
+SR_PRIV int64_t sr_analog_batch_rx_time(const struct sr_analog_batch *batch,
+	size_t pos)
+{
+	size_t i;
+
+	for (i = 0; i < batch->rx_chunk_count; i++) {
+		if (pos < batch->rx_chunks[i].end)
+			return batch->rx_chunks[i].time_us;
+	}
+
+	return g_get_real_time();
+}
+
+/**
+ * Account for data which was removed from the receive buffer.
+ *
+ * Should be called by drivers when they move the remaining data to the
+ * start of their receive buffer, or discard it.
+ *
+ * @param batch Analog batching instance.
+ * @param len Number of bytes which were removed from the buffer's start.
+ */
+SR_PRIV void sr_analog_batch_rx_consume(struct sr_analog_batch *batch,
+	size_t len)
+{
+	size_t i, count;
+
+	count = 0;
+	for (i = 0; i < batch->rx_chunk_count; i++) {
+		if (batch->rx_chunks[i].end <= len)
+			continue;
+		batch->rx_chunks[count].end = batch->rx_chunks[i].end - len;
+		batch->rx_chunks[count].time_us = batch->rx_chunks[i].time_us;
+		count++;
+	}
+	batch->rx_chunk_count = count;
+}
+
+static void chan_free(void *p)
+{
+	struct batch_chan *chan;
+
+	chan = p;
+	g_byte_array_free(chan->values, TRUE);
+	g_array_free(chan->timestamps, TRUE);
+	g_free(chan);
+}
+
+static struct batch_chan *chan_get(struct sr_analog_batch *batch,
+	struct sr_channel *channel)
+{
+	struct batch_chan *chan;
+	size_t i;
+
+	if (!batch->chans)
+		batch->chans = g_ptr_array_new_with_free_func(chan_free);
+	for (i = 0; i < batch->chans->len; i++) {
+		chan = g_ptr_array_index(batch->chans, i);
+		if (chan->channel == channel)
+			return chan;
+	}
+
+	chan = g_malloc0(sizeof(*chan));
+	chan->channel = channel;
+	chan->values = g_byte_array_new();
+	chan->timestamps = g_array_new(FALSE, FALSE, sizeof(guint64));
+	g_ptr_array_add(batch->chans, chan);
+
+	return chan;
+}
+
+static gboolean encoding_equal(const struct sr_analog_encoding *a,
+	const struct sr_analog_encoding *b)
+{
+	return a->unitsize == b->unitsize && a->is_signed == b->is_signed
+		&& a->is_float == b->is_float
+		&& a->is_bigendian == b->is_bigendian
+		&& a->digits == b->digits
+		&& a->is_digits_decimal == b->is_digits_decimal
+		&& a->scale.p == b->scale.p && a->scale.q == b->scale.q
+		&& a->offset.p == b->offset.p && a->offset.q == b->offset.q;
+}
+
+static int chan_send(const struct sr_dev_inst *sdi, struct batch_chan *chan)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GVariant *timestamps;
+	int ret;
+
+	if (!chan->timestamps->len)
+		return SR_OK;
+
+	timestamps = g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
+		chan->timestamps->data, chan->timestamps->len, sizeof(guint64));
+	ret = sr_session_send_meta(sdi, SR_CONF_SAMPLE_TIMESTAMPS, timestamps);
+	if (ret != SR_OK)
+		return ret;
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec,
+		chan->encoding.digits);
+	encoding = chan->encoding;
+	spec.spec_digits = chan->spec_digits;
+	meaning.mq = chan->mq;
+	meaning.unit = chan->unit;
+	meaning.mqflags = chan->mqflags;
+	meaning.channels = g_slist_append(NULL, chan->channel);
+	analog.num_samples = chan->timestamps->len;
+	analog.data = chan->values->data;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	ret = sr_session_send(sdi, &packet);
+	g_slist_free(meaning.channels);
+
+	g_byte_array_set_size(chan->values, 0);
+	g_array_set_size(chan->timestamps, 0);
+
+	return ret;
+}
+
+/**
+ * Add a reading to the batch.
+ *
+ * Readings which differ in their meaning, encoding or precision from the
+ * pending readings of the same channel cause those to get sent first.
+ * Without a configured interval the reading gets sent right away, as is.
+ *
+ * @param batch Analog batching instance.
+ * @param sdi The device instance which sends the readings.
+ * @param analog The reading(s), for a single channel.
+ * @param timestamp_us Host time of reception, in microseconds since the
+ *                     Unix epoch, see sr_analog_batch_rx_time().
+ *
+ * @return SR_OK upon success, a negative error code otherwise.
+ */
+SR_PRIV int sr_analog_batch_add(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi, const struct sr_datafeed_analog *analog,
+	int64_t timestamp_us)
+{
+	struct sr_datafeed_packet packet;
+	struct batch_chan *chan;
+	struct sr_channel *channel;
+	size_t i;
+	guint64 ts;
+	int ret;
+
+	if (!batch->cfg_interval_ms) {
+		packet.type = SR_DF_ANALOG;
+		packet.payload = analog;
+		return sr_session_send(sdi, &packet);
+	}
+
+	if (!analog->num_samples)
+		return SR_OK;
+	channel = analog->meaning->channels ? analog->meaning->channels->data : NULL;
+	chan = chan_get(batch, channel);
+
+	if (chan->timestamps->len && (chan->mq != analog->meaning->mq
+			|| chan->unit != analog->meaning->unit
+			|| chan->mqflags != analog->meaning->mqflags
+			|| !encoding_equal(&chan->encoding, analog->encoding)
+			|| chan->spec_digits != analog->spec->spec_digits)) {
+		ret = chan_send(sdi, chan);
+		if (ret != SR_OK)
+			return ret;
+	}
+	if (!chan->timestamps->len) {
+		chan->mq = analog->meaning->mq;
+		chan->unit = analog->meaning->unit;
+		chan->mqflags = analog->meaning->mqflags;
+		chan->encoding = *analog->encoding;
+		chan->spec_digits = analog->spec->spec_digits;
+		chan->first_us = g_get_monotonic_time();
+	}
+
+	g_byte_array_append(chan->values, analog->data,
+		analog->num_samples * analog->encoding->unitsize);
+	ts = timestamp_us;
+	for (i = 0; i < analog->num_samples; i++)
+		g_array_append_val(chan->timestamps, ts);
+
+	if (chan->timestamps->len >= MAX_BATCH_SAMPLES)
+		return chan_send(sdi, chan);
+
+	return SR_OK;
+}
+
+/**
+ * Send the pending readings of channels whose interval has elapsed.
+ *
+ * Should be called periodically during acquisition, typically from the
+ * driver's receive callback.
+ *
+ * @param batch Analog batching instance.
+ * @param sdi The device instance which sends the readings.
+ *
+ * @return SR_OK upon success, a negative error code otherwise.
+ */
+SR_PRIV int sr_analog_batch_check(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi)
+{
+	struct batch_chan *chan;
+	int64_t now_us, interval_us;
+	size_t i;
+	int ret;
+
+	if (!batch->chans)
+		return SR_OK;
+
+	now_us = g_get_monotonic_time();
+	interval_us = 1000 * (int64_t)batch->cfg_interval_ms;
+	for (i = 0; i < batch->chans->len; i++) {
+		chan = g_ptr_array_index(batch->chans, i);
+		if (!chan->timestamps->len || now_us - chan->first_us < interval_us)
+			continue;
+		ret = chan_send(sdi, chan);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Send all pending readings, and release the batch's resources.
+ *
+ * Must be called when the acquisition stops, before the SR_DF_END packet
+ * gets sent.
+ *
+ * @param batch Analog batching instance.
+ * @param sdi The device instance which sends the readings.
+ *
+ * @return SR_OK upon success, a negative error code otherwise.
+ */
+SR_PRIV int sr_analog_batch_flush(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi)
+{
+	size_t i;
+	int ret, rc;
+
+	if (!batch->chans)
+		return SR_OK;
+
+	ret = SR_OK;
+	for (i = 0; i < batch->chans->len; i++) {
+		rc = chan_send(sdi, g_ptr_array_index(batch->chans, i));
+		if (rc != SR_OK)
+			ret = rc;
+	}
+	g_ptr_array_free(batch->chans, TRUE);
+	batch->chans = NULL;
+
+	return ret;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <glib.h>
 #ifdef _WIN32
 #include <winsock2.h>
@@ -552,6 +553,9 @@ SR_API int sr_init(struct sr_context **ctx)
 #ifdef _WIN32
 	WSADATA wsadata;
 #endif
+#ifdef HAVE_LIBUSB_1_0
+	const char *env;
+#endif
 
 	print_versions();
 
@@ -601,6 +605,8 @@ SR_API int sr_init(struct sr_context **ctx)
 		ret = SR_ERR;
 		goto done;
 	}
+	env = g_getenv("SIGROK_USB_EVENT_THREAD");
+	context->usb_thread_wanted = env && *env && strcmp(env, "0") != 0;
 #endif
 #ifdef HAVE_LIBHIDAPI
 	/*
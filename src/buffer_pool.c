@@ -0,0 +1,314 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Reference counted sample buffer pool
+ *
+ * Drivers receive sample data into buffers of a pool (typically USB
+ * transfer buffers), and send them to the session by means of
+ * sr_session_send_loaned(). Consumers which keep the data around by
+ * means of sr_packet_copy_shared() take a reference on the buffer
+ * instead of copying its content. A buffer returns to the pool for
+ * reuse when the driver and all consumers have released it.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "buffer_pool"
+
+struct sr_buffer_pool {
+	GMutex mutex;
+	size_t size;
+	unsigned int allocated;
+	unsigned int max_count;
+	GSList *free_list;
+	gboolean released;
+};
+
+struct pool_buffer {
+	struct sr_buffer_pool *pool;
+	gint refcount;
+};
+
+/* Sample data follows the header, aligned for wide accesses. */
+#define HEADER_SIZE \
+	((sizeof(struct pool_buffer) + 15) & ~(size_t)15)
+
+static inline uint8_t *buffer_data(struct pool_buffer *buf)
+{
+	return (uint8_t *)buf + HEADER_SIZE;
+}
+
+static inline struct pool_buffer *buffer_header(const uint8_t *data)
+{
+	return (struct pool_buffer *)(data - HEADER_SIZE);
+}
+
+/* The buffer which currently gets sent to the session, per thread. */
+static GPrivate current_loan;
+
+/* Buffers which are referenced by packet copies, keyed by payload. */
+static GMutex loans_mutex;
+static GHashTable *loans;
+
+/**
+ * Create a buffer pool.
+ *
+ * @param size Size of each buffer in bytes.
+ * @param count Number of buffers to allocate upfront.
+ * @param max_count Upper limit for the number of buffers. The pool grows
+ *                  up to this limit while consumers hold references.
+ *
+ * @return The new pool, or NULL upon allocation failure.
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t size,
+	unsigned int count, unsigned int max_count)
+{
+	struct sr_buffer_pool *pool;
+	struct pool_buffer *buf;
+	unsigned int i;
+
+	if (!size)
+		return NULL;
+
+	pool = g_malloc0(sizeof(*pool));
+	g_mutex_init(&pool->mutex);
+	pool->size = size;
+	pool->max_count = MAX(count, max_count);
+	for (i = 0; i < count; i++) {
+		buf = g_try_malloc(HEADER_SIZE + size);
+		if (!buf) {
+			sr_buffer_pool_free(pool);
+			return NULL;
+		}
+		buf->pool = pool;
+		buf->refcount = 0;
+		pool->free_list = g_slist_prepend(pool->free_list, buf);
+		pool->allocated++;
+	}
+
+	return pool;
+}
+
+static void pool_destroy(struct sr_buffer_pool *pool)
+{
+	g_mutex_clear(&pool->mutex);
+	g_free(pool);
+}
+
+/**
+ * Release a buffer pool.
+ *
+ * Buffers which are still referenced by consumers get freed when their
+ * last reference is dropped, the pool goes away with the last of them.
+ *
+ * @param pool The buffer pool, may be NULL.
+ */
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	gboolean destroy;
+
+	if (!pool)
+		return;
+
+	g_mutex_lock(&pool->mutex);
+	pool->allocated -= g_slist_length(pool->free_list);
+	g_slist_free_full(pool->free_list, g_free);
+	pool->free_list = NULL;
+	pool->released = TRUE;
+	destroy = !pool->allocated;
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy)
+		pool_destroy(pool);
+}
+
+/**
+ * Get a buffer from the pool.
+ *
+ * May be called from any thread.
+ *
+ * @param pool The buffer pool.
+ *
+ * @return A buffer of the pool's size, owned by the caller, or NULL when
+ *         all buffers are in use and the pool cannot grow.
+ */
+SR_PRIV uint8_t *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct pool_buffer *buf;
+
+	if (!pool)
+		return NULL;
+
+	g_mutex_lock(&pool->mutex);
+	buf = NULL;
+	if (pool->free_list) {
+		buf = pool->free_list->data;
+		pool->free_list = g_slist_delete_link(pool->free_list,
+			pool->free_list);
+	} else if (pool->allocated < pool->max_count) {
+		buf = g_try_malloc(HEADER_SIZE + pool->size);
+		if (buf) {
+			buf->pool = pool;
+			pool->allocated++;
+			sr_dbg("Grew pool to %u buffers.", pool->allocated);
+		}
+	}
+	g_mutex_unlock(&pool->mutex);
+	if (!buf)
+		return NULL;
+
+	g_atomic_int_set(&buf->refcount, 1);
+
+	return buffer_data(buf);
+}
+
+static void buffer_ref(struct pool_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+}
+
+static void buffer_unref(struct pool_buffer *buf)
+{
+	struct sr_buffer_pool *pool;
+	gboolean destroy;
+
+	if (!g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	pool = buf->pool;
+	destroy = FALSE;
+	g_mutex_lock(&pool->mutex);
+	if (pool->released) {
+		g_free(buf);
+		destroy = !--pool->allocated;
+	} else {
+		pool->free_list = g_slist_prepend(pool->free_list, buf);
+	}
+	g_mutex_unlock(&pool->mutex);
+
+	if (destroy)
+		pool_destroy(pool);
+}
+
+/**
+ * Return a buffer to its pool.
+ *
+ * Drops the caller's reference. The buffer becomes available for reuse
+ * after consumers have released theirs, too. May be called from any
+ * thread.
+ *
+ * @param data The buffer as returned by sr_buffer_pool_get(), may be NULL.
+ */
+SR_PRIV void sr_buffer_pool_put(uint8_t *data)
+{
+	if (!data)
+		return;
+
+	buffer_unref(buffer_header(data));
+}
+
+/**
+ * Start loaning a buffer to the session.
+ *
+ * Packets which get sent from the calling thread until the loan ends,
+ * and whose payload is located in the buffer, can be retained by
+ * consumers without copying. See sr_session_send_loaned().
+ *
+ * @param data The buffer as returned by sr_buffer_pool_get().
+ */
+SR_PRIV void sr_buffer_pool_loan_begin(uint8_t *data)
+{
+	g_private_set(&current_loan, data ? buffer_header(data) : NULL);
+}
+
+/** End loaning a buffer to the session. */
+SR_PRIV void sr_buffer_pool_loan_end(void)
+{
+	g_private_set(&current_loan, NULL);
+}
+
+/**
+ * Take a reference on the loaned buffer which holds some data.
+ *
+ * @param key Identifies the reference, for sr_buffer_pool_loan_release().
+ * @param data Start of the data which the caller wants to retain.
+ * @param length Length of the data in bytes.
+ *
+ * @return TRUE when the data is located in the currently loaned buffer
+ *         and a reference was taken. FALSE when the caller needs to copy.
+ */
+SR_PRIV gboolean sr_buffer_pool_loan_retain(const void *key,
+	const void *data, size_t length)
+{
+	struct pool_buffer *buf;
+	const uint8_t *start, *end;
+
+	buf = g_private_get(&current_loan);
+	if (!buf || !key || !data)
+		return FALSE;
+	start = buffer_data(buf);
+	end = start + buf->pool->size;
+	if ((const uint8_t *)data < start || (const uint8_t *)data > end)
+		return FALSE;
+	if (length > (size_t)(end - (const uint8_t *)data))
+		return FALSE;
+
+	buffer_ref(buf);
+	g_mutex_lock(&loans_mutex);
+	if (!loans)
+		loans = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_insert(loans, (void *)key, buf);
+	g_mutex_unlock(&loans_mutex);
+
+	return TRUE;
+}
+
+/**
+ * Drop a reference which was taken by sr_buffer_pool_loan_retain().
+ *
+ * @param key Identifies the reference.
+ *
+ * @return TRUE when a reference was dropped, FALSE when @p key is not
+ *         known (the caller owns a private copy of the data).
+ */
+SR_PRIV gboolean sr_buffer_pool_loan_release(const void *key)
+{
+	struct pool_buffer *buf;
+
+	buf = NULL;
+	g_mutex_lock(&loans_mutex);
+	if (loans) {
+		buf = g_hash_table_lookup(loans, key);
+		if (buf)
+			g_hash_table_remove(loans, key);
+	}
+	g_mutex_unlock(&loans_mutex);
+	if (!buf)
+		return FALSE;
+
+	buffer_unref(buf);
+
+	return TRUE;
+}
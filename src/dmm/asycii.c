@@ -469,6 +469,9 @@ SR_PRIV int sr_asycii_packet_request(struct sr_serial_dev_inst *serial)
 }
 #endif
 
+/* Packets end in CR. */
+SR_PRIV const struct sr_packet_sync sr_asycii_packet_sync = { 15, 0xff, '\r' };
+
 /**
  * Check whether a received frame is valid.
  *
@@ -168,6 +168,11 @@ SR_PRIV int sr_brymen_bm82x_packet_request(struct sr_serial_dev_inst *serial)
  * and is handled in other code paths.
  */
 
+/* Bytes 16 to 19 carry the model number. */
+SR_PRIV const struct sr_packet_sync sr_brymen_bm52x_packet_sync = {
+	16, 0xff, 0x52,
+};
+
 SR_PRIV gboolean sr_brymen_bm52x_packet_valid(const uint8_t *buf)
 {
 	if (buf[16] != 0x52)
@@ -182,6 +187,10 @@ SR_PRIV gboolean sr_brymen_bm52x_packet_valid(const uint8_t *buf)
 	return TRUE;
 }
 
+SR_PRIV const struct sr_packet_sync sr_brymen_bm82x_packet_sync = {
+	16, 0xff, 0x82,
+};
+
 SR_PRIV gboolean sr_brymen_bm82x_packet_valid(const uint8_t *buf)
 {
 	if (buf[16] != 0x82)
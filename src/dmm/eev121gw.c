@@ -633,6 +633,11 @@ static const struct mode_range_item *mode_range_get_scale(
 	return NULL;
 }
 
+/* Packets start with a fixed command byte. */
+SR_PRIV const struct sr_packet_sync sr_eev121gw_packet_sync = {
+	OFF_START_CMD, 0xff, VAL_START_CMD,
+};
+
 SR_PRIV gboolean sr_eev121gw_packet_valid(const uint8_t *buf)
 {
 	uint8_t csum;
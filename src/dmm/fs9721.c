@@ -323,6 +323,9 @@ static void handle_flags(struct sr_datafeed_analog *analog, float *floatval,
 		sr_spew("User-defined LCD symbol 3 is active.");
 }
 
+/* The upper nibble of the first byte is 1. */
+SR_PRIV const struct sr_packet_sync sr_fs9721_packet_sync = { 0, 0xf0, 0x10 };
+
 SR_PRIV gboolean sr_fs9721_packet_valid(const uint8_t *buf)
 {
 	struct fs9721_info info;
@@ -320,6 +320,9 @@ static void handle_flags(struct sr_datafeed_analog *analog, float *floatval,
 
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync sr_fs9922_packet_sync = { 13, 0xff, '\n' };
+
 SR_PRIV gboolean sr_fs9922_packet_valid(const uint8_t *buf)
 {
 	struct fs9922_info info;
@@ -348,6 +348,9 @@ SR_PRIV int sr_metex14_packet_request(struct sr_serial_dev_inst *serial)
 }
 #endif
 
+/* Packets end in CR. */
+SR_PRIV const struct sr_packet_sync sr_metex14_packet_sync = { 13, 0xff, '\r' };
+
 SR_PRIV gboolean sr_metex14_packet_valid(const uint8_t *buf)
 {
 	struct metex14_info info;
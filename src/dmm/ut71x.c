@@ -316,6 +316,9 @@ static gboolean flags_valid(const struct ut71x_info *info)
 	return TRUE;
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync sr_ut71x_packet_sync = { 10, 0xff, '\n' };
+
 SR_PRIV gboolean sr_ut71x_packet_valid(const uint8_t *buf)
 {
 	struct ut71x_info info;
@@ -390,6 +390,9 @@ static gboolean flags_valid(const struct vc870_info *info)
 	return TRUE;
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync sr_vc870_packet_sync = { 22, 0xff, '\n' };
+
 SR_PRIV gboolean sr_vc870_packet_valid(const uint8_t *buf)
 {
 	struct vc870_info info;
@@ -229,6 +229,9 @@ static gboolean flags_valid(const struct vc96_info *info)
 	return TRUE;
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync sr_vc96_packet_sync = { 12, 0xff, '\n' };
+
 SR_PRIV gboolean sr_vc96_packet_valid(const uint8_t *buf)
 {
 	struct vc96_info info;
@@ -1260,34 +1260,113 @@ static int flush_submit_buffer(struct dev_context *devc)
 	return SR_OK;
 }
 
+/*
+ * Determine how many of the next samples may get submitted. Enforces
+ * the user specified sample count limit (which only applies when no
+ * trigger is involved, sample memory content is limited otherwise).
+ */
+static size_t clip_submit_count(struct dev_context *devc, size_t count)
+{
+	struct sr_sw_limits *limits;
+	uint64_t remain;
+
+	if (devc->use_triggers)
+		return count;
+	limits = &devc->limit.submit;
+	if (!limits->limit_samples)
+		return count;
+	remain = 0;
+	if (limits->samples_read < limits->limit_samples)
+		remain = limits->limit_samples - limits->samples_read;
+	if (count > remain)
+		count = remain;
+
+	return count;
+}
+
+/*
+ * Accumulate a run of identical samples. Which is the common case for
+ * "decoded RLE" (the samples between non-adjacent DRAM clusters), and
+ * can span many megabytes. Write runs in multiples of 64bit words,
+ * only flush when the local storage is exhausted.
+ */
 static int addto_submit_buffer(struct dev_context *devc,
 	uint16_t sample, size_t count)
 {
 	struct submit_buffer *buffer;
-	struct sr_sw_limits *limits;
+	uint8_t pattern[sizeof(uint64_t)];
+	uint8_t *wrptr;
+	size_t chunk, remain;
 	int ret;
 
 	buffer = devc->buffer;
-	limits = &devc->limit.submit;
-	if (!devc->use_triggers && sr_sw_limits_check(limits))
-		count = 0;
+	count = clip_submit_count(devc, count);
+
+	wrptr = pattern;
+	write_u16le_inc(&wrptr, sample);
+	write_u16le_inc(&wrptr, sample);
+	write_u16le_inc(&wrptr, sample);
+	write_u16le_inc(&wrptr, sample);
+
+	while (count) {
+		chunk = buffer->max_samples - buffer->curr_samples;
+		if (chunk > count)
+			chunk = count;
+		wrptr = buffer->write_pointer;
+		remain = chunk;
+		while (remain >= sizeof(pattern) / sizeof(sample)) {
+			memcpy(wrptr, pattern, sizeof(pattern));
+			wrptr += sizeof(pattern);
+			remain -= sizeof(pattern) / sizeof(sample);
+		}
+		while (remain--)
+			write_u16le_inc(&wrptr, sample);
+		buffer->write_pointer = wrptr;
+		buffer->curr_samples += chunk;
+		count -= chunk;
+		sr_sw_limits_update_samples_read(&devc->limit.submit, chunk);
+		if (buffer->curr_samples == buffer->max_samples) {
+			ret = flush_submit_buffer(devc);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
 
-	/*
-	 * Individually accumulate and check each sample, such that
-	 * accumulation between flushes won't exceed local storage, and
-	 * enforcement of user specified limits is exact.
-	 */
-	while (count--) {
-		write_u16le_inc(&buffer->write_pointer, sample);
-		buffer->curr_samples++;
+	return SR_OK;
+}
+
+/*
+ * Accumulate a sequence of samples which need not get checked for
+ * trigger matches.
+ */
+static int append_submit_buffer(struct dev_context *devc,
+	const uint16_t *samples, size_t count)
+{
+	struct submit_buffer *buffer;
+	uint8_t *wrptr;
+	size_t chunk, idx;
+	int ret;
+
+	buffer = devc->buffer;
+	count = clip_submit_count(devc, count);
+
+	while (count) {
+		chunk = buffer->max_samples - buffer->curr_samples;
+		if (chunk > count)
+			chunk = count;
+		wrptr = buffer->write_pointer;
+		for (idx = 0; idx < chunk; idx++)
+			write_u16le_inc(&wrptr, samples[idx]);
+		buffer->write_pointer = wrptr;
+		buffer->curr_samples += chunk;
+		samples += chunk;
+		count -= chunk;
+		sr_sw_limits_update_samples_read(&devc->limit.submit, chunk);
 		if (buffer->curr_samples == buffer->max_samples) {
 			ret = flush_submit_buffer(devc);
 			if (ret != SR_OK)
 				return ret;
 		}
-		sr_sw_limits_update_samples_read(limits, 1);
-		if (!devc->use_triggers && sr_sw_limits_check(limits))
-			break;
 	}
 
 	return SR_OK;
@@ -1808,6 +1887,37 @@ static uint16_t sigma_dram_cluster_data(struct sigma_dram_cluster *cl, int idx)
 	return read_u16le((const uint8_t *)&cl->samples[idx]);
 }
 
+/*
+ * Lookup tables for the deinterlacing of sample data. Bits of several
+ * samples are interleaved in a 16bit item, they are taken apart one
+ * byte at a time.
+ *
+ * The 2x8 table holds the even bits of a byte in the low nibble, and
+ * the odd bits in the high nibble. The 4x4 table holds two bits for
+ * each of the four sample positions (bits N and N + 4 of the input),
+ * in two bit fields at position 2 * N.
+ */
+#define DEINT_2X8_HALF(b) \
+	(((b) & 0x01) | (((b) >> 1) & 0x02) | (((b) >> 2) & 0x04) | (((b) >> 3) & 0x08))
+#define DEINT_2X8(b) \
+	(DEINT_2X8_HALF(b) | (DEINT_2X8_HALF((b) >> 1) << 4))
+#define DEINT_4X4_PAIR(b, n) \
+	((((b) >> (n)) & 0x01) | (((b) >> ((n) + 3)) & 0x02))
+#define DEINT_4X4(b) \
+	(DEINT_4X4_PAIR(b, 0) | (DEINT_4X4_PAIR(b, 1) << 2) | \
+	 (DEINT_4X4_PAIR(b, 2) << 4) | (DEINT_4X4_PAIR(b, 3) << 6))
+
+#define DEINT_R4(f, n)	f(n), f((n) + 1), f((n) + 2), f((n) + 3)
+#define DEINT_R16(f, n)	DEINT_R4(f, n), DEINT_R4(f, (n) + 4), \
+			DEINT_R4(f, (n) + 8), DEINT_R4(f, (n) + 12)
+#define DEINT_R64(f, n)	DEINT_R16(f, n), DEINT_R16(f, (n) + 16), \
+			DEINT_R16(f, (n) + 32), DEINT_R16(f, (n) + 48)
+#define DEINT_R256(f)	DEINT_R64(f, 0), DEINT_R64(f, 64), \
+			DEINT_R64(f, 128), DEINT_R64(f, 192)
+
+static const uint8_t deint_2x8[256] = { DEINT_R256(DEINT_2X8) };
+static const uint8_t deint_4x4[256] = { DEINT_R256(DEINT_4X4) };
+
 /*
  * Deinterlace sample data that was retrieved at 100MHz samplerate.
  * One 16bit item contains two samples of 8bits each. The bits of
@@ -1815,19 +1925,11 @@ static uint16_t sigma_dram_cluster_data(struct sigma_dram_cluster *cl, int idx)
  */
 static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx)
 {
-	uint16_t outdata;
-
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 2 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 2 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 2 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 2 - 3)) & (1 << 3);
-	outdata |= (indata >> (4 * 2 - 4)) & (1 << 4);
-	outdata |= (indata >> (5 * 2 - 5)) & (1 << 5);
-	outdata |= (indata >> (6 * 2 - 6)) & (1 << 6);
-	outdata |= (indata >> (7 * 2 - 7)) & (1 << 7);
-	return outdata;
+	uint8_t lo, hi;
+
+	lo = deint_2x8[indata & 0xff] >> (4 * idx);
+	hi = deint_2x8[indata >> 8] >> (4 * idx);
+	return (lo & 0x0f) | ((hi & 0x0f) << 4);
 }
 
 /*
@@ -1837,25 +1939,55 @@ static uint16_t sigma_deinterlace_data_2x8(uint16_t indata, int idx)
  */
 static uint16_t sigma_deinterlace_data_4x4(uint16_t indata, int idx)
 {
-	uint16_t outdata;
-
-	indata >>= idx;
-	outdata = 0;
-	outdata |= (indata >> (0 * 4 - 0)) & (1 << 0);
-	outdata |= (indata >> (1 * 4 - 1)) & (1 << 1);
-	outdata |= (indata >> (2 * 4 - 2)) & (1 << 2);
-	outdata |= (indata >> (3 * 4 - 3)) & (1 << 3);
-	return outdata;
+	uint8_t lo, hi;
+
+	lo = deint_4x4[indata & 0xff] >> (2 * idx);
+	hi = deint_4x4[indata >> 8] >> (2 * idx);
+	return (lo & 0x03) | ((hi & 0x03) << 2);
+}
+
+/*
+ * Deinterlace all samples of one 16bit item. Returns the number of
+ * samples which were written to the caller's buffer.
+ */
+static size_t sigma_deinterlace_event(uint16_t indata,
+	size_t samples_per_event, uint16_t *samples)
+{
+	uint8_t lo, hi;
+
+	if (samples_per_event == 4) {
+		lo = deint_4x4[indata & 0xff];
+		hi = deint_4x4[indata >> 8];
+		samples[0] = (lo & 0x03) | ((hi & 0x03) << 2);
+		samples[1] = ((lo >> 2) & 0x03) | (hi & 0x0c);
+		samples[2] = ((lo >> 4) & 0x03) | ((hi >> 2) & 0x0c);
+		samples[3] = (lo >> 6) | ((hi >> 4) & 0x0c);
+		return 4;
+	}
+	if (samples_per_event == 2) {
+		lo = deint_2x8[indata & 0xff];
+		hi = deint_2x8[indata >> 8];
+		samples[0] = (lo & 0x0f) | ((hi & 0x0f) << 4);
+		samples[1] = (lo >> 4) | (hi & 0xf0);
+		return 2;
+	}
+	samples[0] = indata;
+	return 1;
 }
 
 static void sigma_decode_dram_cluster(struct dev_context *devc,
 	struct sigma_dram_cluster *dram_cluster,
 	size_t events_in_cluster)
 {
+	struct sigma_sample_interp *interp;
+	uint16_t samples[EVENTS_PER_CLUSTER * 4];
 	uint16_t tsdiff, ts, sample, item16;
-	size_t count;
+	size_t count, spe, idx;
 	size_t evt;
 
+	interp = &devc->interp;
+	spe = interp->samples_per_event;
+
 	/*
 	 * If this cluster is not adjacent to the previously received
 	 * cluster, then send the appropriate number of samples with the
@@ -1867,13 +1999,15 @@ static void sigma_decode_dram_cluster(struct dev_context *devc,
 	 * counted conditions, which currently are not supported.)
 	 */
 	ts = sigma_dram_cluster_ts(dram_cluster);
-	tsdiff = ts - devc->interp.last.ts;
+	tsdiff = ts - interp->last.ts;
 	if (tsdiff > 0) {
-		sample = devc->interp.last.sample;
-		count = tsdiff * devc->interp.samples_per_event;
+		sample = interp->last.sample;
+		count = tsdiff * spe;
 		(void)check_and_submit_sample(devc, sample, count);
 	}
-	devc->interp.last.ts = ts + EVENTS_PER_CLUSTER;
+	interp->last.ts = ts + EVENTS_PER_CLUSTER;
+	if (!events_in_cluster)
+		return;
 
 	/*
 	 * Grab sample data from the current cluster and prepare their
@@ -1881,36 +2015,39 @@ static void sigma_decode_dram_cluster(struct dev_context *devc,
 	 * memory layout of sample data. Accumulation of data chunks
 	 * before submission is transparent to this code path, specific
 	 * buffer depth is neither assumed nor required here.
+	 *
+	 * Software trigger checks are not armed for most of the sample
+	 * memory. When they cannot get armed within this cluster either
+	 * (no trigger in use, or the match was found already), then the
+	 * whole cluster gets submitted in one call.
 	 */
-	sample = 0;
+	if (!interp->trig_chk.armed &&
+	    (!devc->use_triggers || interp->trig_chk.matched)) {
+		count = 0;
+		for (evt = 0; evt < events_in_cluster; evt++) {
+			item16 = sigma_dram_cluster_data(dram_cluster, evt);
+			count += sigma_deinterlace_event(item16, spe,
+				&samples[count]);
+			sigma_location_increment(&interp->iter);
+		}
+		(void)append_submit_buffer(devc, samples, count);
+		interp->last.sample = samples[count - 1];
+		return;
+	}
+
 	for (evt = 0; evt < events_in_cluster; evt++) {
 		item16 = sigma_dram_cluster_data(dram_cluster, evt);
-		if (devc->interp.samples_per_event == 4) {
-			sample = sigma_deinterlace_data_4x4(item16, 0);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 1);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 2);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_4x4(item16, 3);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-		} else if (devc->interp.samples_per_event == 2) {
-			sample = sigma_deinterlace_data_2x8(item16, 0);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
-			sample = sigma_deinterlace_data_2x8(item16, 1);
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
+		count = sigma_deinterlace_event(item16, spe, samples);
+		if (!interp->trig_chk.armed) {
+			(void)append_submit_buffer(devc, samples, count);
+			interp->last.sample = samples[count - 1];
 		} else {
-			sample = item16;
-			check_and_submit_sample(devc, sample, 1);
-			devc->interp.last.sample = sample;
+			for (idx = 0; idx < count; idx++) {
+				check_and_submit_sample(devc, samples[idx], 1);
+				interp->last.sample = samples[idx];
+			}
 		}
-		sigma_location_increment(&devc->interp.iter);
+		sigma_location_increment(&interp->iter);
 		sigma_location_check(devc);
 	}
 }
@@ -119,6 +119,9 @@ struct beaglelogic_ops {
 	int (*get_bufunitsize)(struct dev_context *devc);
 	int (*set_bufunitsize)(struct dev_context *devc);
 
+	/* Gets the index of the buffer unit which currently gets filled */
+	int (*get_cur_index)(struct dev_context *devc);
+
 	int (*mmap)(struct dev_context *devc);
 	int (*munmap)(struct dev_context *devc);
 };
@@ -119,6 +119,11 @@ static int beaglelogic_set_bufunitsize(struct dev_context *devc)
 	return ioctl(devc->fd, IOCTL_BL_SET_BUFUNIT_SIZE, devc->bufunitsize);
 }
 
+static int beaglelogic_get_cur_index(struct dev_context *devc)
+{
+	return ioctl(devc->fd, IOCTL_BL_GET_CUR_INDEX, &devc->cur_index);
+}
+
 static int beaglelogic_mmap(struct dev_context *devc)
 {
 	if (!devc->buffersize)
@@ -150,6 +155,7 @@ SR_PRIV const struct beaglelogic_ops beaglelogic_native_ops = {
 	.get_lasterror = beaglelogic_get_lasterror,
 	.get_bufunitsize = beaglelogic_get_bufunitsize,
 	.set_bufunitsize = beaglelogic_set_bufunitsize,
+	.get_cur_index = beaglelogic_get_cur_index,
 	.mmap = beaglelogic_mmap,
 	.munmap = beaglelogic_munmap,
 };
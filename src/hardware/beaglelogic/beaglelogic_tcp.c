@@ -46,7 +46,7 @@ static int beaglelogic_tcp_open(struct dev_context *devc)
 {
 	struct addrinfo hints;
 	struct addrinfo *results, *res;
-	int err;
+	int err, bufsize;
 
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_UNSPEC;
@@ -81,6 +81,12 @@ static int beaglelogic_tcp_open(struct dev_context *devc)
 		return SR_ERR;
 	}
 
+	/* Let the kernel buffer sample data while the session is busy. */
+	bufsize = TCP_BUFFER_SIZE;
+	if (setsockopt(devc->socket, SOL_SOCKET, SO_RCVBUF,
+			(const char *)&bufsize, sizeof(bufsize)) < 0)
+		sr_dbg("Cannot set receive buffer size: %s", g_strerror(errno));
+
 	return SR_OK;
 }
 
@@ -425,6 +431,7 @@ SR_PRIV const struct beaglelogic_ops beaglelogic_tcp_ops = {
 	.get_lasterror = beaglelogic_get_lasterror,
 	.get_bufunitsize = beaglelogic_get_bufunitsize,
 	.set_bufunitsize = beaglelogic_set_bufunitsize,
+	.get_cur_index = dummy,
 	.mmap = dummy,
 	.munmap = dummy,
 };
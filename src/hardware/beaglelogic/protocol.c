@@ -32,9 +32,28 @@
 #include "protocol.h"
 #include "beaglelogic.h"
 
-/* Define data packet size independent of packet (bufunitsize bytes) size
- * from the BeagleLogic kernel module */
-#define PACKET_SIZE	(512 * 1024)
+/*
+ * Determine how much contiguous sample data is ready at the current
+ * read position. poll() signals that the buffer unit at the read
+ * position is complete. All units before the one which currently gets
+ * filled are complete, too, and get sent in one go (up to the end of
+ * the ring buffer).
+ */
+static uint32_t native_ready_bytes(struct dev_context *devc)
+{
+	uint32_t size, filling;
+
+	size = devc->bufunitsize - devc->offset % devc->bufunitsize;
+	if (devc->beaglelogic->get_cur_index(devc) == SR_OK) {
+		filling = devc->cur_index * devc->bufunitsize;
+		if (filling > devc->offset)
+			size = MAX(size, filling - devc->offset);
+		else if (filling < devc->offset)
+			size = devc->buffersize - devc->offset;
+	}
+
+	return MIN(size, devc->buffersize - devc->offset);
+}
 
 /* This implementation is zero copy from the libsigrok side.
  * It does not copy any data, just passes a pointer from the mmap'ed
@@ -56,11 +75,13 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	if (!(sdi = cb_data) || !(devc = sdi->priv))
 		return TRUE;
 
-	packetsize = PACKET_SIZE;
+	packetsize = devc->bufunitsize;
 	logic.unitsize = SAMPLEUNIT_TO_BYTES(devc->sampleunit);
 
 	if (revents == G_IO_IN) {
-		sr_info("In callback G_IO_IN, offset=%d", devc->offset);
+		packetsize = native_ready_bytes(devc);
+		sr_info("In callback G_IO_IN, offset=%d, size=%d",
+			devc->offset, packetsize);
 
 		bytes_remaining = (devc->limit_samples * logic.unitsize) -
 				devc->bytes_read;
@@ -75,7 +96,7 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 			/* Send the incoming transfer to the session bus. */
 			sr_session_send(sdi, &packet);
 		} else {
-			/* Check for trigger */
+			/* Check for trigger, in place on the mapped memory */
 			trigger_offset = soft_trigger_logic_check(devc->stl,
 					logic.data, packetsize, &pre_trigger_samples);
 			if (trigger_offset > -1) {
@@ -91,7 +112,7 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 			}
 		}
 
-		/* Move the read pointer forward */
+		/* Move the read pointer forward, past all consumed units */
 		lseek(fd, packetsize, SEEK_CUR);
 
 		/* Update byte count and offset (roll over if needed) */
@@ -117,6 +138,31 @@ SR_PRIV int beaglelogic_native_receive_data(int fd, int revents, void *cb_data)
 	return TRUE;
 }
 
+/*
+ * Receive as much data as is available, up to the buffer size. The
+ * first call can block (poll() signalled data), subsequent calls only
+ * pick up what has arrived already. This batches many TCP segments
+ * into one packet at high data rates.
+ */
+static int tcp_recv_batch(int fd, uint8_t *buf, size_t size)
+{
+	int len;
+
+	len = recv(fd, (char *)buf, size, 0);
+	if (len <= 0)
+		return len;
+#ifdef MSG_DONTWAIT
+	while ((size_t)len < size) {
+		int ret = recv(fd, (char *)buf + len, size - len, MSG_DONTWAIT);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+#endif
+
+	return len;
+}
+
 SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 {
 	const struct sr_dev_inst *sdi;
@@ -139,7 +185,7 @@ SR_PRIV int beaglelogic_tcp_receive_data(int fd, int revents, void *cb_data)
 	if (revents == G_IO_IN) {
 		sr_info("In callback G_IO_IN");
 
-		len = recv(fd, devc->tcp_buffer, TCP_BUFFER_SIZE, 0);
+		len = tcp_recv_batch(fd, devc->tcp_buffer, TCP_BUFFER_SIZE);
 		if (len < 0) {
 			sr_err("Receive error: %s", g_strerror(errno));
 			return SR_ERR;
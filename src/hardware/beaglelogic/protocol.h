@@ -32,7 +32,7 @@
 
 #define SAMPLEUNIT_TO_BYTES(x)	((x) == 1 ? 1 : 2)
 
-#define TCP_BUFFER_SIZE         (128 * 1024)
+#define TCP_BUFFER_SIZE         (4 * 1024 * 1024)
 
 /** Private, per-device-instance driver context. */
 struct dev_context {
@@ -59,6 +59,7 @@ struct dev_context {
 	/* Buffers: size of each buffer block and the total buffer area */
 	uint32_t bufunitsize;
 	uint32_t buffersize;
+	uint32_t cur_index;
 
 	int fd;
 	GPollFD pollfd;
@@ -65,6 +65,8 @@ static const uint32_t devopts[] = {
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_EXTERNAL_CLOCK | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_CLOCK_EDGE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
+	SR_CONF_USB_TRANSFER_SIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_USB_TRANSFER_COUNT | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -445,6 +447,9 @@ static int config_get(uint32_t key, GVariant **data,
 			return SR_ERR_BUG;
 		*data = g_variant_new_string(signal_edges[0]);
 		break;
+	case SR_CONF_USB_TRANSFER_SIZE:
+	case SR_CONF_USB_TRANSFER_COUNT:
+		return sr_usb_stream_config_get(&devc->stream, key, data);
 	default:
 		return SR_ERR_NA;
 	}
@@ -500,6 +505,9 @@ static int config_set(uint32_t key, GVariant *data,
 			return SR_ERR_ARG;
 		devc->clock_edge = idx;
 		break;
+	case SR_CONF_USB_TRANSFER_SIZE:
+	case SR_CONF_USB_TRANSFER_COUNT:
+		return sr_usb_stream_config_set(&devc->stream, key, data);
 	default:
 		return SR_ERR_NA;
 	}
@@ -656,6 +656,7 @@ SR_PRIV struct dev_context *dslogic_dev_new(void)
 	devc->capture_ratio = 0;
 	devc->continuous_mode = FALSE;
 	devc->clock_edge = DS_EDGE_RISING;
+	sr_usb_stream_init(&devc->stream);
 
 	return devc;
 }
@@ -679,12 +680,15 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 
 	std_session_send_df_end(sdi);
+	sr_usb_stream_report(&devc->stream);
 
 	usb_source_remove(sdi->session, devc->ctx);
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
 	g_free(devc->deinterleave_buffer);
+	sr_bit_transpose_free(devc->transpose);
+	devc->transpose = NULL;
 }
 
 static void free_transfer(struct libusb_transfer *transfer)
@@ -724,30 +728,6 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void deinterleave_buffer(const uint8_t *src, size_t length,
-	uint16_t *dst_ptr, size_t channel_count, uint16_t channel_mask)
-{
-	uint16_t sample;
-
-	for (const uint64_t *src_ptr = (uint64_t*)src;
-		src_ptr < (uint64_t*)(src + length);
-		src_ptr += channel_count) {
-		for (int bit = 0; bit != 64; bit++) {
-			const uint64_t *word_ptr = src_ptr;
-			sample = 0;
-			for (unsigned int channel = 0; channel != 16;
-				channel++) {
-				const uint16_t m = channel_mask >> channel;
-				if (!m)
-					break;
-				if ((m & 1) && ((*word_ptr++ >> bit) & UINT64_C(1)))
-					sample |= 1 << channel;
-			}
-			*dst_ptr++ = sample;
-		}
-	}
-}
-
 static void send_data(struct sr_dev_inst *sdi,
 	uint16_t *data, size_t sample_count)
 {
@@ -770,7 +750,6 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
 	const size_t channel_count = enabled_channel_count(sdi);
-	const uint16_t channel_mask = enabled_channel_mask(sdi);
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
 		transfer->actual_length /
 		(DSLOGIC_ATOMIC_BYTES * channel_count);
@@ -836,14 +815,14 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 * channel.
 		 *
 		 * Because sigrok's internal representation is bit-interleaved channels
-		 * we must recast the data.
-		 *
-		 * Hopefully in future it will be possible to pass the data on as-is.
+		 * we must recast the data, which the core's bit transposition does
+		 * for all enabled channels of a block at once.
 		 */
 		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
-			devc->deinterleave_buffer, channel_count, channel_mask);
+		sr_bit_transpose_run(devc->transpose, transfer->buffer,
+			transfer->actual_length / (DSLOGIC_ATOMIC_BYTES * channel_count),
+			devc->deinterleave_buffer);
 
 		/* Send the incoming transfer to the session bus. */
 		if (devc->trigger_pos > devc->sent_samples
@@ -870,8 +849,10 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
 		abort_acquisition(devc);
 		free_transfer(transfer);
-	} else
+	} else {
+		sr_usb_stream_completed(&devc->stream, transfer);
 		resubmit_transfer(transfer);
+	}
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -905,41 +886,9 @@ static size_t to_bytes_per_ms(const struct sr_dev_inst *sdi)
 	return 35000000 / (1000 * 10);
 }
 
-static size_t get_buffer_size(const struct sr_dev_inst *sdi)
-{
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of the size of a data atom.
-	 */
-	const size_t block_size = enabled_channel_count(sdi) * 512;
-	const size_t s = 10 * to_bytes_per_ms(sdi);
-	if (!block_size)
-		return s;
-	return ((s + block_size - 1) / block_size) * block_size;
-}
-
-static unsigned int get_number_of_transfers(const struct sr_dev_inst *sdi)
-{
-	/* Total buffer size should be able to hold about 100ms of data. */
-	const unsigned int s = get_buffer_size(sdi);
-	const unsigned int n = (100 * to_bytes_per_ms(sdi) + s - 1) / s;
-	return (n > NUM_SIMUL_TRANSFERS) ? NUM_SIMUL_TRANSFERS : n;
-}
-
-static unsigned int get_timeout(const struct sr_dev_inst *sdi)
-{
-	const size_t total_size = get_buffer_size(sdi) *
-		get_number_of_transfers(sdi);
-	const unsigned int timeout = total_size / to_bytes_per_ms(sdi);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
-}
-
 static int start_transfers(const struct sr_dev_inst *sdi)
 {
 	const size_t channel_count = enabled_channel_count(sdi);
-	const size_t size = get_buffer_size(sdi);
-	const unsigned int num_transfers = get_number_of_transfers(sdi);
-	const unsigned int timeout = get_timeout(sdi);
 
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
@@ -947,6 +896,9 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	unsigned int i;
 	int ret;
 	unsigned char *buf;
+	unsigned int num_transfers, bit;
+	uint16_t channel_mask, row_masks[16];
+	size_t size;
 
 	devc = sdi->priv;
 	usb = sdi->conn;
@@ -956,6 +908,9 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	devc->empty_transfer_count = 0;
 	devc->submitted_transfers = 0;
 
+	num_transfers = devc->stream.count;
+	size = devc->stream.max_size;
+
 	g_free(devc->transfers);
 	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
 	if (!devc->transfers) {
@@ -971,6 +926,24 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
+	/* One 64bit word per enabled channel, in ascending order. */
+	channel_mask = enabled_channel_mask(sdi);
+	for (i = 0, bit = 0; bit < 16; bit++) {
+		if (channel_mask & (1 << bit))
+			row_masks[i++] = 1 << bit;
+	}
+	sr_bit_transpose_free(devc->transpose);
+	devc->transpose = sr_bit_transpose_new(64, channel_count, row_masks, FALSE);
+	if (!devc->transpose) {
+		sr_err("Unsupported channel configuration.");
+		g_free(devc->deinterleave_buffer);
+		devc->deinterleave_buffer = NULL;
+		g_free(devc->transfers);
+		devc->transfers = NULL;
+		devc->num_transfers = 0;
+		return SR_ERR;
+	}
+
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
 		if (!(buf = g_try_malloc(size))) {
@@ -979,8 +952,8 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		}
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				6 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
+				6 | LIBUSB_ENDPOINT_IN, buf, devc->stream.size,
+				receive_transfer, (void *)sdi, devc->stream.timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
@@ -1028,8 +1001,6 @@ static void LIBUSB_CALL trigger_receive(struct libusb_transfer *transfer)
 
 SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 {
-	const unsigned int timeout = get_timeout(sdi);
-
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
@@ -1048,7 +1019,15 @@ SR_PRIV int dslogic_acquisition_start(const struct sr_dev_inst *sdi)
 	devc->empty_transfer_count = 0;
 	devc->acq_aborted = FALSE;
 
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	/*
+	 * Transfers should initially hold about 10ms of data and a
+	 * multiple of the size of a data atom, all of them together
+	 * about 100ms. Their size adapts during acquisition.
+	 */
+	sr_usb_stream_setup(&devc->stream, to_bytes_per_ms(sdi),
+		enabled_channel_count(sdi) * 512, 100, NUM_SIMUL_TRANSFERS);
+	usb_source_add(sdi->session, devc->ctx, devc->stream.timeout,
+		receive_data, drvc);
 
 	if ((ret = command_stop_acquisition(sdi)) != SR_OK)
 		return ret;
@@ -130,9 +130,11 @@ struct dev_context {
 
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
+	struct sr_usb_stream stream;
 	struct sr_context *ctx;
 
 	uint16_t *deinterleave_buffer;
+	struct sr_bit_transpose *transpose;
 
 	uint16_t mode;
 	uint32_t trigger_pos;
@@ -131,6 +131,8 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
 	SR_CONF_CAPTURE_RATIO | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_USB_TRANSFER_SIZE | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_USB_TRANSFER_COUNT | SR_CONF_GET | SR_CONF_SET,
 };
 
 static const int32_t trigger_matches[] = {
@@ -504,6 +506,9 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_CAPTURE_RATIO:
 		*data = g_variant_new_uint64(devc->capture_ratio);
 		break;
+	case SR_CONF_USB_TRANSFER_SIZE:
+	case SR_CONF_USB_TRANSFER_COUNT:
+		return sr_usb_stream_config_get(&devc->stream, key, data);
 	default:
 		return SR_ERR_NA;
 	}
@@ -539,6 +544,9 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_CAPTURE_RATIO:
 		devc->capture_ratio = g_variant_get_uint64(data);
 		break;
+	case SR_CONF_USB_TRANSFER_SIZE:
+	case SR_CONF_USB_TRANSFER_COUNT:
+		return sr_usb_stream_config_set(&devc->stream, key, data);
 	default:
 		return SR_ERR_NA;
 	}
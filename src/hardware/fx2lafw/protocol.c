@@ -21,6 +21,9 @@
 #include <config.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "protocol.h"
 
 #pragma pack(push, 1)
@@ -263,6 +266,7 @@ SR_PRIV struct dev_context *fx2lafw_dev_new(void)
 	devc->sample_wide = FALSE;
 	devc->num_frames = 0;
 	devc->stl = NULL;
+	sr_usb_stream_init(&devc->stream);
 
 	return devc;
 }
@@ -271,7 +275,7 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 {
 	int i;
 
-	devc->acq_aborted = TRUE;
+	g_atomic_int_set(&devc->acq_aborted, TRUE);
 
 	for (i = devc->num_transfers - 1; i >= 0; i--) {
 		if (devc->transfers[i])
@@ -279,24 +283,49 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 	}
 }
 
-static void finish_acquisition(struct sr_dev_inst *sdi)
+static void release_completion_queues(struct dev_context *devc)
+{
+	struct sr_usb_completion item;
+
+	while (usb_completion_queue_pop(devc->done_queue, &item))
+		sr_buffer_pool_put(item.buffer);
+	usb_completion_queue_free(devc->done_queue);
+	devc->done_queue = NULL;
+}
+
+/*
+ * Release the acquisition's resources: the event source (and the event
+ * thread's reference), transfers, buffers and the soft trigger. Must
+ * only run when no transfers are in flight.
+ */
+static void release_acquisition(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 
 	devc = sdi->priv;
 
-	std_session_send_df_end(sdi);
-
-	usb_source_remove(sdi->session, devc->ctx);
+	if (devc->done_queue) {
+		/* No transfers are left, the event thread can terminate. */
+		usb_completion_source_remove(sdi->session, devc->done_queue);
+		usb_event_thread_stop(devc->ctx);
+		release_completion_queues(devc);
+	} else {
+		usb_source_remove(sdi->session, devc->ctx);
+	}
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	devc->transfers = NULL;
+
+	/* Buffers which consumers still reference are freed later. */
+	sr_buffer_pool_free(devc->pool);
+	devc->pool = NULL;
 
 	/* Free the deinterlace buffers if we had them. */
-	if (g_slist_length(devc->enabled_analog_channels) > 0) {
-		g_free(devc->logic_buffer);
-		g_free(devc->analog_buffer);
-	}
+	g_free(devc->logic_buffer);
+	devc->logic_buffer = NULL;
+	g_free(devc->analog_buffer);
+	devc->analog_buffer = NULL;
 
 	if (devc->stl) {
 		soft_trigger_logic_free(devc->stl);
@@ -304,6 +333,17 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 	}
 }
 
+static void finish_acquisition(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+
+	std_session_send_df_end(sdi);
+	sr_usb_stream_report(&devc->stream);
+	release_acquisition(sdi);
+}
+
 static void free_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *sdi;
@@ -313,7 +353,7 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
+	sr_buffer_pool_put(transfer->buffer);
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
@@ -341,10 +381,39 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
+/*
+ * Split interleaved (logic, analog) byte pairs into separate buffers.
+ * Takes 16 pairs per iteration where SSE2 is available: the low bytes
+ * of 16bit lanes are the logic data, the high bytes are analog data.
+ */
+static void mso_split_pairs(const uint8_t *data, size_t count,
+	uint8_t *logic, uint8_t *analog)
+{
+	size_t i;
+#ifdef __SSE2__
+	__m128i lo, hi, mask;
+
+	mask = _mm_set1_epi16(0x00ff);
+	for (i = 0; i + 16 <= count; i += 16) {
+		lo = _mm_loadu_si128((const __m128i *)&data[2 * i]);
+		hi = _mm_loadu_si128((const __m128i *)&data[2 * i + 16]);
+		_mm_storeu_si128((__m128i *)&logic[i], _mm_packus_epi16(
+			_mm_and_si128(lo, mask), _mm_and_si128(hi, mask)));
+		_mm_storeu_si128((__m128i *)&analog[i], _mm_packus_epi16(
+			_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+	}
+#else
+	i = 0;
+#endif
+	for (; i < count; i++) {
+		logic[i] = data[2 * i];
+		analog[i] = data[2 * i + 1];
+	}
+}
+
 static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	uint8_t *data, size_t length, size_t sample_width)
 {
-	size_t i;
 	struct dev_context *devc;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
@@ -358,11 +427,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	length /= 2;
 
 	/* Send the logic */
-	for (i = 0; i < length; i++) {
-		devc->logic_buffer[i] = data[i * 2];
-		/* Rescale to -10V - +10V from 0-255. */
-		devc->analog_buffer[i] = (data[i * 2 + 1] - 128.0f) / 12.8f;
-	};
+	mso_split_pairs(data, length, devc->logic_buffer, devc->analog_buffer);
 
 	const struct sr_datafeed_logic logic = {
 		.length = length,
@@ -377,7 +442,18 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 
 	sr_session_send(sdi, &logic_packet);
 
+	/*
+	 * Send the raw analog bytes. Values 0-255 map to -10V - +10V,
+	 * that is (value - 128) / 12.8, expressed as scale and offset.
+	 */
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+	encoding.unitsize = sizeof(uint8_t);
+	encoding.is_float = FALSE;
+	encoding.is_signed = FALSE;
+	encoding.scale.p = 10;
+	encoding.scale.q = 128;
+	encoding.offset.p = -10;
+	encoding.offset.q = 1;
 	analog.meaning->channels = devc->enabled_analog_channels;
 	analog.meaning->mq = SR_MQ_VOLTAGE;
 	analog.meaning->unit = SR_UNIT_VOLT;
@@ -396,6 +472,8 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 static void la_send_data_proc(struct sr_dev_inst *sdi,
 	uint8_t *data, size_t length, size_t sample_width)
 {
+	struct dev_context *devc;
+
 	const struct sr_datafeed_logic logic = {
 		.length = length,
 		.unitsize = sample_width,
@@ -407,68 +485,31 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	devc = sdi->priv;
+	if (devc->loan)
+		sr_session_send_loaned(sdi, &packet, devc->loan);
+	else
+		sr_session_send(sdi, &packet);
 }
 
-static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+/*
+ * Process received sample data: check for triggers, and send samples
+ * to the session. Returns TRUE when the acquisition is complete.
+ */
+static gboolean process_samples(struct sr_dev_inst *sdi,
+	uint8_t *buffer, size_t length)
 {
-	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	gboolean packet_has_error = FALSE;
 	unsigned int num_samples;
 	int trigger_offset, cur_sample_count, unitsize, processed_samples;
 	int pre_trigger_samples;
 
-	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	/*
-	 * If acquisition has already ended, just free any queued up
-	 * transfer that come in.
-	 */
-	if (devc->acq_aborted) {
-		free_transfer(transfer);
-		return;
-	}
-
-	sr_dbg("receive_transfer(): status %s received %d bytes.",
-		libusb_error_name(transfer->status), transfer->actual_length);
-
-	/* Save incoming transfer before reusing the transfer struct. */
 	unitsize = devc->sample_wide ? 2 : 1;
-	cur_sample_count = transfer->actual_length / unitsize;
+	cur_sample_count = length / unitsize;
 	processed_samples = 0;
 
-	switch (transfer->status) {
-	case LIBUSB_TRANSFER_NO_DEVICE:
-		fx2lafw_abort_acquisition(devc);
-		free_transfer(transfer);
-		return;
-	case LIBUSB_TRANSFER_COMPLETED:
-	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
-		break;
-	default:
-		packet_has_error = TRUE;
-		break;
-	}
-
-	if (transfer->actual_length == 0 || packet_has_error) {
-		devc->empty_transfer_count++;
-		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
-			/*
-			 * The FX2 gave up. End the acquisition, the frontend
-			 * will work out that the samplecount is short.
-			 */
-			fx2lafw_abort_acquisition(devc);
-			free_transfer(transfer);
-		} else {
-			resubmit_transfer(transfer);
-		}
-		return;
-	} else {
-		devc->empty_transfer_count = 0;
-	}
-
 check_trigger:
 	if (devc->trigger_fired) {
 		if (!devc->limit_samples || devc->sent_samples < devc->limit_samples) {
@@ -477,15 +518,15 @@ check_trigger:
 			if (devc->limit_samples && devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer + processed_samples * unitsize,
+			devc->send_data_proc(sdi, buffer + processed_samples * unitsize,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 			processed_samples += num_samples;
 		}
 	} else {
 		trigger_offset = soft_trigger_logic_check(devc->stl,
-			transfer->buffer + processed_samples * unitsize,
-			transfer->actual_length - processed_samples * unitsize,
+			buffer + processed_samples * unitsize,
+			length - processed_samples * unitsize,
 			&pre_trigger_samples);
 		if (trigger_offset > -1) {
 			std_session_send_df_frame_begin(sdi);
@@ -495,7 +536,7 @@ check_trigger:
 					devc->sent_samples + num_samples > devc->limit_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi, buffer
 					+ processed_samples * unitsize
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
@@ -528,11 +569,163 @@ check_trigger:
 				goto check_trigger;
 		}
 	}
-	if (frame_ended && final_frame) {
+
+	return frame_ended && final_frame;
+}
+
+static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	gboolean packet_has_error = FALSE;
+	uint8_t *data, *spare;
+	gboolean done;
+
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	/*
+	 * If acquisition has already ended, just free any queued up
+	 * transfer that come in.
+	 */
+	if (devc->acq_aborted) {
+		free_transfer(transfer);
+		return;
+	}
+
+	sr_dbg("receive_transfer(): status %s received %d bytes.",
+		libusb_error_name(transfer->status), transfer->actual_length);
+
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_NO_DEVICE:
 		fx2lafw_abort_acquisition(devc);
 		free_transfer(transfer);
-	} else
+		return;
+	case LIBUSB_TRANSFER_COMPLETED:
+	case LIBUSB_TRANSFER_TIMED_OUT: /* We may have received some data though. */
+		break;
+	default:
+		packet_has_error = TRUE;
+		break;
+	}
+
+	if (transfer->actual_length == 0 || packet_has_error) {
+		devc->empty_transfer_count++;
+		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
+			/*
+			 * The FX2 gave up. End the acquisition, the frontend
+			 * will work out that the samplecount is short.
+			 */
+			fx2lafw_abort_acquisition(devc);
+			free_transfer(transfer);
+		} else {
+			resubmit_transfer(transfer);
+		}
+		return;
+	} else {
+		devc->empty_transfer_count = 0;
+	}
+
+	/*
+	 * Detach the received data when a spare buffer is available, so
+	 * that it can be loaned to the session. Consumers must not see
+	 * the transfer's buffer otherwise, it gets resubmitted below.
+	 */
+	data = transfer->buffer;
+	spare = sr_buffer_pool_get(devc->pool);
+	if (spare) {
+		transfer->buffer = spare;
+		devc->loan = data;
+	}
+	done = process_samples(sdi, data, transfer->actual_length);
+	if (spare) {
+		devc->loan = NULL;
+		sr_buffer_pool_put(data);
+	}
+
+	if (done) {
+		fx2lafw_abort_acquisition(devc);
+		free_transfer(transfer);
+	} else {
+		/* The event thread accounts for its own completions. */
+		if (!devc->done_queue)
+			sr_usb_stream_completed(&devc->stream, transfer);
 		resubmit_transfer(transfer);
+	}
+}
+
+/*
+ * Transfer completion when the USB event thread is used. Runs on that
+ * thread. Received data gets detached, and the transfer is resubmitted
+ * with a spare buffer right away, so that the device's FIFO keeps being
+ * drained regardless of the session's latency. All other conditions
+ * are left to the session, which runs the regular receive_transfer().
+ */
+static void LIBUSB_CALL receive_transfer_threaded(struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_usb_completion item;
+	uint8_t *spare;
+
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	memset(&item, 0, sizeof(item));
+	if (!g_atomic_int_get(&devc->acq_aborted) &&
+			transfer->status == LIBUSB_TRANSFER_COMPLETED &&
+			transfer->actual_length > 0 &&
+			(spare = sr_buffer_pool_get(devc->pool))) {
+		item.buffer = transfer->buffer;
+		item.length = transfer->actual_length;
+		transfer->buffer = spare;
+		sr_usb_stream_completed(&devc->stream, transfer);
+		if (libusb_submit_transfer(transfer) == LIBUSB_SUCCESS) {
+			usb_completion_queue_push(devc->done_queue, &item);
+			return;
+		}
+		/* Pass on the data, and let the session handle the failure. */
+		usb_completion_queue_push(devc->done_queue, &item);
+		memset(&item, 0, sizeof(item));
+		transfer->status = LIBUSB_TRANSFER_ERROR;
+		transfer->actual_length = 0;
+	}
+	item.transfer = transfer;
+	usb_completion_queue_push(devc->done_queue, &item);
+}
+
+/* Consume completions from the USB event thread, in the session's context. */
+static int receive_completions(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_usb_completion item;
+
+	(void)fd;
+	(void)revents;
+
+	sdi = cb_data;
+	devc = sdi->priv;
+
+	/* The queues are gone when the last transfer was freed. */
+	while (devc->done_queue &&
+			usb_completion_queue_pop(devc->done_queue, &item)) {
+		if (item.transfer) {
+			receive_transfer(item.transfer);
+			continue;
+		}
+		if (!devc->acq_aborted) {
+			devc->empty_transfer_count = 0;
+			devc->loan = item.buffer;
+			if (process_samples(sdi, item.buffer, item.length))
+				fx2lafw_abort_acquisition(devc);
+			devc->loan = NULL;
+		}
+		/* Reusable when consumers have released it, too. */
+		sr_buffer_pool_put(item.buffer);
+	}
+
+	return TRUE;
 }
 
 static int configure_channels(const struct sr_dev_inst *sdi)
@@ -569,46 +762,9 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-static unsigned int to_bytes_per_ms(unsigned int samplerate)
+static size_t to_bytes_per_ms(struct dev_context *devc)
 {
-	return samplerate / 1000;
-}
-
-static size_t get_buffer_size(struct dev_context *devc)
-{
-	size_t s;
-
-	/*
-	 * The buffer should be large enough to hold 10ms of data and
-	 * a multiple of 512.
-	 */
-	s = 10 * to_bytes_per_ms(devc->cur_samplerate);
-	return (s + 511) & ~511;
-}
-
-static unsigned int get_number_of_transfers(struct dev_context *devc)
-{
-	unsigned int n;
-
-	/* Total buffer size should be able to hold about 500ms of data. */
-	n = (500 * to_bytes_per_ms(devc->cur_samplerate) /
-		get_buffer_size(devc));
-
-	if (n > NUM_SIMUL_TRANSFERS)
-		return NUM_SIMUL_TRANSFERS;
-
-	return n;
-}
-
-static unsigned int get_timeout(struct dev_context *devc)
-{
-	size_t total_size;
-	unsigned int timeout;
-
-	total_size = get_buffer_size(devc) *
-			get_number_of_transfers(devc);
-	timeout = total_size / to_bytes_per_ms(devc->cur_samplerate);
-	return timeout + timeout / 4; /* Leave a headroom of 25% percent. */
+	return devc->cur_samplerate / 1000 * (devc->sample_wide ? 2 : 1);
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -633,6 +789,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct sr_usb_dev_inst *usb;
 	struct sr_trigger *trigger;
 	struct libusb_transfer *transfer;
+	libusb_transfer_cb_fn callback;
 	unsigned int i, num_transfers;
 	int timeout, ret;
 	unsigned char *buf;
@@ -658,9 +815,8 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		devc->trigger_fired = TRUE;
 	}
 
-	num_transfers = get_number_of_transfers(devc);
-
-	size = get_buffer_size(devc);
+	num_transfers = devc->stream.count;
+	size = devc->stream.max_size;
 	devc->submitted_transfers = 0;
 
 	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
@@ -669,24 +825,41 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
-	timeout = get_timeout(devc);
+	timeout = devc->stream.timeout;
 	devc->num_transfers = num_transfers;
+	callback = receive_transfer;
+	if (devc->done_queue)
+		callback = receive_transfer_threaded;
+
+	/*
+	 * One spare buffer per transfer for immediate resubmission. The
+	 * pool grows while consumers keep received data around.
+	 */
+	devc->pool = sr_buffer_pool_new(size, 2 * num_transfers,
+		4 * num_transfers);
+	if (!devc->pool) {
+		sr_err("USB transfer buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->pool))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
-		transfer = libusb_alloc_transfer(0);
+		if (!(transfer = libusb_alloc_transfer(0))) {
+			sr_err("USB transfer malloc failed.");
+			sr_buffer_pool_put(buf);
+			return SR_ERR_MALLOC;
+		}
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
-				receive_transfer, (void *)sdi, timeout);
+				2 | LIBUSB_ENDPOINT_IN, buf, devc->stream.size,
+				callback, (void *)sdi, timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
-			fx2lafw_abort_acquisition(devc);
+			sr_buffer_pool_put(buf);
 			return SR_ERR;
 		}
 		devc->transfers[i] = transfer;
@@ -713,6 +886,7 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	struct sr_dev_driver *di;
 	struct drv_context *drvc;
 	struct dev_context *devc;
+	unsigned int num_transfers;
 	int timeout, ret;
 	size_t size;
 
@@ -724,6 +898,7 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 	devc->num_frames = 0;
 	devc->sent_samples = 0;
 	devc->empty_transfer_count = 0;
+	devc->submitted_transfers = 0;
 	devc->acq_aborted = FALSE;
 
 	if (configure_channels(sdi) != SR_OK) {
@@ -731,20 +906,50 @@ SR_PRIV int fx2lafw_start_acquisition(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	timeout = get_timeout(devc);
-	usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	/*
+	 * Transfers should initially hold about 10ms of data, and all of
+	 * them together about 500ms. Their size adapts to the observed
+	 * completion rate during acquisition.
+	 */
+	sr_usb_stream_setup(&devc->stream, to_bytes_per_ms(devc), 512,
+		500, NUM_SIMUL_TRANSFERS);
+	timeout = devc->stream.timeout;
+	if (usb_event_thread_start(devc->ctx) == SR_OK) {
+		/* Up to one data item per pool buffer, plus every transfer. */
+		num_transfers = devc->stream.count;
+		devc->done_queue = usb_completion_queue_new(5 * num_transfers);
+		usb_completion_source_add(sdi->session, devc->done_queue,
+			timeout, receive_completions, (void *)sdi);
+	} else {
+		usb_source_add(sdi->session, devc->ctx, timeout, receive_data, drvc);
+	}
 
-	size = get_buffer_size(devc);
+	size = devc->stream.max_size;
 	/* Prepare for analog sampling. */
+	ret = SR_OK;
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
 		/* We need a buffer half the size of a transfer. */
 		devc->logic_buffer = g_try_malloc(size / 2);
-		devc->analog_buffer = g_try_malloc(
-			sizeof(float) * size / 2);
+		devc->analog_buffer = g_try_malloc(size / 2);
+		if (!devc->logic_buffer || !devc->analog_buffer) {
+			sr_err("Analog buffer malloc failed.");
+			ret = SR_ERR_MALLOC;
+		}
 	}
-	start_transfers(sdi);
-	if ((ret = command_start_acquisition(sdi)) != SR_OK) {
-		fx2lafw_abort_acquisition(devc);
+	if (ret == SR_OK)
+		ret = start_transfers(sdi);
+	if (ret == SR_OK)
+		ret = command_start_acquisition(sdi);
+	if (ret != SR_OK) {
+		/*
+		 * Cancelled transfers complete later, and the last one
+		 * releases the acquisition's resources. Without any in
+		 * flight, release them right here.
+		 */
+		if (devc->submitted_transfers)
+			fx2lafw_abort_acquisition(devc);
+		else
+			release_acquisition(sdi);
 		return ret;
 	}
 
@@ -118,11 +118,19 @@ struct dev_context {
 
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
+	struct sr_usb_stream stream;
 	struct sr_context *ctx;
 	void (*send_data_proc)(struct sr_dev_inst *sdi,
 		uint8_t *data, size_t length, size_t sample_width);
 	uint8_t *logic_buffer;
-	float *analog_buffer;
+	uint8_t *analog_buffer;
+
+	/* Transfer buffers, and the one which currently gets processed. */
+	struct sr_buffer_pool *pool;
+	uint8_t *loan;
+
+	/* Completed data from the USB event thread. */
+	struct sr_usb_completion_queue *done_queue;
 };
 
 SR_PRIV int fx2lafw_dev_open(struct sr_dev_inst *sdi, struct sr_dev_driver *di);
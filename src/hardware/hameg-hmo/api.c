@@ -102,6 +102,7 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 static void clear_helper(struct dev_context *devc)
 {
 	hmo_scope_state_free(devc->model_state);
+	g_free(devc->pod_buffer);
 	g_free(devc->analog_groups);
 	g_free(devc->digital_groups);
 }
@@ -895,6 +896,8 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	devc->num_samples = 0;
 	devc->num_frames = 0;
+	g_free(devc->pod_buffer);
+	devc->pod_buffer = NULL;
 	g_slist_free(devc->enabled_channels);
 	devc->enabled_channels = NULL;
 	scpi = sdi->conn;
@@ -114,6 +114,18 @@ static const char *rohde_schwarz_log_not_pod_scpi_dialect[] = {
 	[SCPI_CMD_SET_DIG_POD_USER_THRESHOLD] = ":DIG%d:THR %s",
 };
 
+/* Analog waveform data, as requested by SCPI_CMD_GET_ANALOG_DATA. */
+static const struct sr_scpi_sample_format hmo_analog_format = {
+	.unitsize = sizeof(float),
+	.is_signed = TRUE,
+	.is_float = TRUE,
+#ifdef WORDS_BIGENDIAN
+	.is_bigendian = TRUE,
+#else
+	.is_bigendian = FALSE,
+#endif
+};
+
 static const uint32_t devopts[] = {
 	SR_CONF_OSCILLOSCOPE,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_SET,
@@ -1362,6 +1374,43 @@ SR_PRIV void hmo_cleanup_logic_data(struct dev_context *devc)
 	 */
 }
 
+/*
+ * Receive the data of a single pod when a sample limit applies. The
+ * samples go to a buffer which gets allocated once per acquisition,
+ * and samples in excess of the limit get discarded while reading.
+ * Returns SR_ERR_MALLOC before reading when there is no such buffer.
+ */
+static int hmo_receive_pod_limited(const struct sr_dev_inst *sdi,
+				   struct dev_context *devc)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	size_t length;
+	int ret;
+
+	if (!devc->pod_buffer) {
+		if (devc->samples_limit > G_MAXSIZE)
+			return SR_ERR_MALLOC;
+		devc->pod_buffer = g_try_malloc(devc->samples_limit);
+		if (!devc->pod_buffer)
+			return SR_ERR_MALLOC;
+	}
+	ret = sr_scpi_get_block_into(sdi->conn, NULL, devc->pod_buffer,
+				     devc->samples_limit, &length);
+	if (ret != SR_OK)
+		return ret;
+
+	logic.data = devc->pod_buffer;
+	logic.length = length;
+	logic.unitsize = 1;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	sr_session_send(sdi, &packet);
+	devc->num_samples = length;
+
+	return SR_OK;
+}
+
 SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 {
 	struct sr_channel *ch;
@@ -1375,7 +1424,8 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
-	size_t group;
+	size_t group, num_samples;
+	int ret;
 
 	(void)fd;
 	(void)revents;
@@ -1410,7 +1460,8 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	 */
 	switch (ch->type) {
 	case SR_CHANNEL_ANALOG:
-		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
+		if (sr_scpi_get_samples(sdi->conn, NULL, &hmo_analog_format,
+				&data, &num_samples) != SR_OK) {
 			if (data)
 				g_byte_array_free(data, TRUE);
 			return TRUE;
@@ -1419,13 +1470,13 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		packet.type = SR_DF_ANALOG;
 
 		analog.data = data->data;
-		analog.num_samples = data->len / sizeof(float);
+		analog.num_samples = num_samples;
 		/* Truncate acquisition if a smaller number of samples has been requested. */
 		if (devc->samples_limit > 0 && analog.num_samples > devc->samples_limit)
 			analog.num_samples = devc->samples_limit;
 		/* TODO: Use proper 'digits' value for this device (and its modes). */
 		sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-		encoding.is_signed = TRUE;
+		sr_scpi_sample_encoding(&hmo_analog_format, 1.0, 0.0, &encoding);
 		if (state->analog_channels[ch->index].probe_unit == 'V') {
 			meaning.mq = SR_MQ_VOLTAGE;
 			meaning.unit = SR_UNIT_VOLT;
@@ -1436,12 +1487,19 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 		meaning.channels = g_slist_append(NULL, ch);
 		packet.payload = &analog;
 		sr_session_send(sdi, &packet);
-		devc->num_samples = data->len / sizeof(float);
+		devc->num_samples = num_samples;
 		g_slist_free(meaning.channels);
 		g_byte_array_free(data, TRUE);
 		data = NULL;
 		break;
 	case SR_CHANNEL_LOGIC:
+		if (devc->pod_count == 1 && devc->samples_limit > 0) {
+			ret = hmo_receive_pod_limited(sdi, devc);
+			if (ret == SR_OK)
+				break;
+			if (ret != SR_ERR_MALLOC)
+				return TRUE;
+		}
 		if (sr_scpi_get_block(sdi->conn, NULL, &data) != SR_OK) {
 			if (data)
 				g_byte_array_free(data, TRUE);
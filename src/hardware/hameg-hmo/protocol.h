@@ -131,6 +131,8 @@ struct dev_context {
 
 	size_t pod_count;
 	GByteArray *logic_data;
+	/* Single pod data, when a sample limit applies. */
+	uint8_t *pod_buffer;
 };
 
 SR_PRIV int hmo_init_device(struct sr_dev_inst *sdi);
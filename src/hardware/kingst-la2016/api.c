@@ -507,92 +507,102 @@ static int config_list(uint32_t key, GVariant **data, const struct sr_dev_inst *
 	return SR_OK;
 }
 
-static void send_chunk(struct sr_dev_inst *sdi, transfer_packet_t *packets, unsigned int num_tfers)
+/* Expand a run of identical samples, with 64bit stores for longer runs. */
+static uint16_t *fill_samples(uint16_t *wp, uint16_t state, unsigned int count)
+{
+	uint64_t pattern;
+
+	if (count >= 8) {
+		pattern = state * UINT64_C(0x0001000100010001);
+		while (count >= 4) {
+			memcpy(wp, &pattern, sizeof(pattern));
+			wp += 4;
+			count -= 4;
+		}
+	}
+	while (count--)
+		*wp++ = state;
+
+	return wp;
+}
+
+static void flush_samples(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_logic logic;
-	struct sr_datafeed_packet sr_packet;
-	transfer_packet_t *packet;
-	acq_packet_t *p;
-	unsigned int max_samples, n_samples, total_samples, free_n_samples, ptotal;
-	unsigned int i, j, k;
-	int do_signal_trigger;
-	uint16_t *wp;
+	struct sr_datafeed_packet packet;
 
 	devc = sdi->priv;
+	if (!devc->conv_samples)
+		return;
 
-	logic.unitsize = 2;
+	logic.length = devc->conv_samples * sizeof(uint16_t);
+	logic.unitsize = sizeof(uint16_t);
 	logic.data = devc->convbuffer;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	sr_session_send(sdi, &packet);
+	devc->conv_samples = 0;
+}
+
+/*
+ * Expand the received (state, repetitions) pairs into the conversion
+ * buffer. Samples accumulate across transfers, the buffer only gets
+ * sent when it is full, at the trigger position, and at the end of the
+ * transfer (see handle_event()).
+ */
+static void send_chunk(struct sr_dev_inst *sdi, transfer_packet_t *packets, unsigned int num_tfers)
+{
+	struct dev_context *devc;
+	transfer_packet_t *packet;
+	acq_packet_t *p;
+	unsigned int max_samples, total_samples;
+	unsigned int i, k;
+	uint16_t *wp;
 
-	sr_packet.type = SR_DF_LOGIC;
-	sr_packet.payload = &logic;
+	devc = sdi->priv;
 
-	max_samples = devc->convbuffer_size / 2;
-	n_samples = 0;
-	wp = (uint16_t*)devc->convbuffer;
+	max_samples = devc->convbuffer_size / sizeof(uint16_t);
+	wp = (uint16_t *)devc->convbuffer + devc->conv_samples;
 	total_samples = 0;
-	do_signal_trigger = 0;
 
 	if (devc->had_triggers_configured && devc->reading_behind_trigger == 0 && devc->info.n_rep_packets_before_trigger == 0) {
-		sr_packet.type = SR_DF_TRIGGER;
-		sr_packet.payload = NULL;
-		sr_session_send(sdi, &sr_packet);
+		flush_samples(sdi);
+		wp = (uint16_t *)devc->convbuffer;
+		std_session_send_df_trigger(sdi);
 		devc->reading_behind_trigger = 1;
-
-		do_signal_trigger = 0;
-		sr_packet.type = SR_DF_LOGIC;
-		sr_packet.payload = &logic;
 	}
 
 	for (i = 0; i < num_tfers; i++) {
 		transfer_packet_host(packets[i]);
 		packet = packets + i;
-		ptotal = 0;
+
+		/* Make sure that a whole transfer packet fits. */
+		if (max_samples - devc->conv_samples < ARRAY_SIZE(packet->packet) * UINT8_MAX) {
+			flush_samples(sdi);
+			wp = (uint16_t *)devc->convbuffer;
+		}
+
 		for (k = 0; k < ARRAY_SIZE(packet->packet); k++) {
-			free_n_samples = max_samples - n_samples;
-			if (free_n_samples < 256 || do_signal_trigger) {
-				logic.length = n_samples * 2;
-				sr_session_send(sdi, &sr_packet);
-				n_samples = 0;
-				wp = (uint16_t*)devc->convbuffer;
-				if (do_signal_trigger) {
-					sr_packet.type = SR_DF_TRIGGER;
-					sr_packet.payload = NULL;
-					sr_session_send(sdi, &sr_packet);
-					
-					do_signal_trigger = 0;
-					sr_packet.type = SR_DF_LOGIC;
-					sr_packet.payload = &logic;
-				}
-			}
 			p = packet->packet + k;
-			for (j = 0; j < p->repetitions; j++)
-				*(wp++) = p->state;
-			n_samples += p->repetitions;
+			wp = fill_samples(wp, p->state, p->repetitions);
+			devc->conv_samples += p->repetitions;
 			total_samples += p->repetitions;
-			ptotal += p->repetitions;
 			devc->total_samples += p->repetitions;
-			if (!devc->reading_behind_trigger) {
-				devc->n_reps_until_trigger --;
-				if (devc->n_reps_until_trigger == 0) {
-					devc->reading_behind_trigger = 1;
-					do_signal_trigger = 1;
-					sr_dbg("  here is trigger position after %" PRIu64 " samples, %.6fms",
-					       devc->total_samples,
-					       (double)devc->total_samples / devc->cur_samplerate * 1e3);
-				}
+			if (devc->reading_behind_trigger)
+				continue;
+			devc->n_reps_until_trigger--;
+			if (devc->n_reps_until_trigger == 0) {
+				devc->reading_behind_trigger = 1;
+				sr_dbg("  here is trigger position after %" PRIu64 " samples, %.6fms",
+				       devc->total_samples,
+				       (double)devc->total_samples / devc->cur_samplerate * 1e3);
+				flush_samples(sdi);
+				wp = (uint16_t *)devc->convbuffer;
+				std_session_send_df_trigger(sdi);
 			}
 		}
 	}
-	if (n_samples) {
-		logic.length = n_samples * 2;
-		sr_session_send(sdi, &sr_packet);
-		if (do_signal_trigger) {
-			sr_packet.type = SR_DF_TRIGGER;
-			sr_packet.payload = NULL;
-			sr_session_send(sdi, &sr_packet);
-		}
-	}
 	sr_dbg("send_chunk done after %d samples", total_samples);
 }
 
@@ -677,6 +687,7 @@ static int handle_event(int fd, int revents, void *cb_data)
 
 	if (devc->transfer_finished) {
 		sr_dbg("transfer is finished!");
+		flush_samples(sdi);
 		packet.type = SR_DF_FRAME_END;
 		sr_session_send(sdi, &packet);
 
@@ -735,7 +746,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
-	devc->convbuffer_size = 4 * 1024 * 1024;
+	devc->convbuffer_size = CONV_BUFFER_SIZE;
+	devc->conv_samples = 0;
 	if (!(devc->convbuffer = g_try_malloc(devc->convbuffer_size))) {
 		sr_err("Conversion buffer malloc failed.");
 		return SR_ERR_MALLOC;
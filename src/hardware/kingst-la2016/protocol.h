@@ -38,6 +38,9 @@
 
 #define LA2016_BULK_MAX         8388608
 
+/* Conversion buffer for expanded samples, sent when full. */
+#define CONV_BUFFER_SIZE        (16 * 1024 * 1024)
+
 #define MAX_RENUM_DELAY_MS	3000
 #define DEFAULT_TIMEOUT_MS      200
 
@@ -121,6 +124,7 @@ struct dev_context {
 	uint32_t read_pos;
 
 	unsigned int convbuffer_size;
+	unsigned int conv_samples;
 	uint8_t *convbuffer;
 	struct libusb_transfer *transfer;
 };
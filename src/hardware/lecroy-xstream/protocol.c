@@ -548,33 +548,28 @@ static int lecroy_waveform_2_x_to_analog(GByteArray *data,
 	struct sr_analog_encoding *encoding = analog->encoding;
 	struct sr_analog_meaning *meaning = analog->meaning;
 	struct sr_analog_spec *spec = analog->spec;
-	float *data_float;
-	int16_t *waveform_data;
-	unsigned int i, num_samples;
-
-	data_float = g_malloc(desc->version_2_x.wave_array_count * sizeof(float));
-	num_samples = desc->version_2_x.wave_array_count;
-
-	waveform_data = (int16_t*)(data->data +
-		+ desc->version_2_x.wave_descriptor_length
-		+ desc->version_2_x.user_text_len);
-
-	for (i = 0; i < num_samples; i++)
-		data_float[i] = (float)waveform_data[i]
-			* desc->version_2_x.vertical_gain
-			+ desc->version_2_x.vertical_offset;
-
-	analog->data = data_float;
-	analog->num_samples = num_samples;
-
-	encoding->unitsize = sizeof(float);
-	encoding->is_signed = TRUE;
-	encoding->is_float = TRUE;
-	encoding->is_bigendian = FALSE;
-	encoding->scale.p = 1;
-	encoding->scale.q = 1;
-	encoding->offset.p = 0;
-	encoding->offset.q = 1;
+	struct sr_scpi_sample_format format;
+	size_t data_offset;
+
+	/* COMM_FORMAT DEF9,WORD,BIN yields 16bit samples, BYTE 8bit ones. */
+	format.unitsize = desc->version_2_x.comm_type ? 2 : 1;
+	format.is_signed = TRUE;
+	format.is_float = FALSE;
+	format.is_bigendian = FALSE;
+
+	data_offset = desc->version_2_x.wave_descriptor_length
+		+ desc->version_2_x.user_text_len;
+	if (data_offset > data->len || desc->version_2_x.wave_array_count >
+			(data->len - data_offset) / format.unitsize) {
+		sr_err("Truncated waveform data.");
+		return SR_ERR_DATA;
+	}
+
+	/* Pass the raw samples on, gain and offset apply to them. */
+	analog->data = data->data + data_offset;
+	analog->num_samples = desc->version_2_x.wave_array_count;
+	sr_scpi_sample_encoding(&format, desc->version_2_x.vertical_gain,
+		desc->version_2_x.vertical_offset, encoding);
 
 	encoding->digits = 6;
 	encoding->is_digits_decimal = FALSE;
@@ -654,11 +649,13 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 	analog.meaning = &meaning;
 	analog.spec = &spec;
 
-	if (lecroy_waveform_to_analog(data, &analog) != SR_OK)
+	if (lecroy_waveform_to_analog(data, &analog) != SR_OK) {
+		g_byte_array_free(data, TRUE);
 		return SR_ERR;
+	}
 
 	if (analog.num_samples == 0) {
-		g_free(analog.data);
+		g_byte_array_free(data, TRUE);
 
 		/* No data available, we have to acquire data first. */
 		g_snprintf(command, sizeof(command), "ARM;WAIT;*OPC;C%d:WAVEFORM?", ch->index + 1);
@@ -670,7 +667,7 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 		/* Update sample rate if needed. */
 		if (state->sample_rate == 0)
 			if (lecroy_xstream_update_sample_rate(sdi, analog.num_samples) != SR_OK) {
-				g_free(analog.data);
+				g_byte_array_free(data, TRUE);
 				return SR_ERR;
 			}
 	}
@@ -691,7 +688,6 @@ SR_PRIV int lecroy_xstream_receive_data(int fd, int revents, void *cb_data)
 	data = NULL;
 
 	g_slist_free(meaning.channels);
-	g_free(analog.data);
 
 	/*
 	 * Advance to the next enabled channel. When data for all enabled
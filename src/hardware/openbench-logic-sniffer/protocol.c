@@ -360,6 +360,113 @@ SR_PRIV void abort_acquisition(const struct sr_dev_inst *sdi)
 	std_session_send_df_end(sdi);
 }
 
+/* Store count copies of a 4 byte sample, 8 bytes per store where possible. */
+static void fill_samples(uint8_t *dst, const uint8_t *sample, size_t count)
+{
+	uint8_t pattern[8];
+
+	if (count >= 4) {
+		memcpy(&pattern[0], sample, 4);
+		memcpy(&pattern[4], sample, 4);
+		while (count >= 2) {
+			memcpy(dst, pattern, sizeof(pattern));
+			dst += sizeof(pattern);
+			count -= 2;
+		}
+	}
+	while (count--) {
+		memcpy(dst, sample, 4);
+		dst += 4;
+	}
+}
+
+/*
+ * Decode a block of received bytes into the sample buffer. Returns when
+ * the buffer is full, remaining bytes get ignored.
+ */
+static void decode_bytes(struct dev_context *devc, int num_changroups,
+	const uint8_t *buf, size_t len)
+{
+	uint32_t sample;
+	int i, j;
+
+	while (len-- && devc->num_samples < devc->limit_samples) {
+		devc->sample[devc->num_bytes++] = *buf++;
+		if (devc->num_bytes != num_changroups)
+			continue;
+
+		devc->cnt_samples++;
+		devc->cnt_samples_rle++;
+		/*
+		 * Got a full sample. Convert from the OLS's little-endian
+		 * sample to the local format.
+		 */
+		sample = devc->sample[0] | (devc->sample[1] << 8) \
+				| (devc->sample[2] << 16) | (devc->sample[3] << 24);
+		if (devc->capture_flags & CAPTURE_FLAG_RLE) {
+			/*
+			 * In RLE mode the high bit of the sample is the
+			 * "count" flag, meaning this sample is the number
+			 * of times the previous sample occurred.
+			 */
+			if (devc->sample[devc->num_bytes - 1] & 0x80) {
+				/* Clear the high bit. */
+				sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
+				devc->rle_count = sample;
+				devc->cnt_samples_rle += devc->rle_count;
+				devc->num_bytes = 0;
+				continue;
+			}
+		}
+		devc->num_samples += devc->rle_count + 1;
+		if (devc->num_samples > devc->limit_samples) {
+			/* Save us from overrunning the buffer. */
+			devc->rle_count -= devc->num_samples - devc->limit_samples;
+			devc->num_samples = devc->limit_samples;
+		}
+
+		if (num_changroups < 4) {
+			/*
+			 * Some channel groups may have been turned
+			 * off, to speed up transfer between the
+			 * hardware and the PC. Expand that here before
+			 * submitting it over the session bus --
+			 * whatever is listening on the bus will be
+			 * expecting a full 32-bit sample, based on
+			 * the number of channels.
+			 */
+			j = 0;
+			memset(devc->tmp_sample, 0, 4);
+			for (i = 0; i < 4; i++) {
+				if (((devc->capture_flags >> 2) & (1 << i)) == 0) {
+					/*
+					 * This channel group was
+					 * enabled, copy from received
+					 * sample.
+					 */
+					devc->tmp_sample[i] = devc->sample[j++];
+				} else if (devc->capture_flags & CAPTURE_FLAG_DEMUX && (i > 2)) {
+					/* group 2 & 3 get added to 0 & 1 */
+					devc->tmp_sample[i - 2] = devc->sample[j++];
+				}
+			}
+			memcpy(devc->sample, devc->tmp_sample, 4);
+		}
+
+		/*
+		 * the OLS sends its sample buffer backwards.
+		 * store it in reverse order here, so we can dump
+		 * this on the session bus later.
+		 */
+		fill_samples(devc->raw_sample_buf +
+			(devc->limit_samples - devc->num_samples) * 4,
+			devc->sample, devc->rle_count + 1);
+		memset(devc->sample, 0, 4);
+		devc->num_bytes = 0;
+		devc->rle_count = 0;
+	}
+}
+
 SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 {
 	struct dev_context *devc;
@@ -367,10 +474,9 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	struct sr_serial_dev_inst *serial;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	uint32_t sample;
-	int num_changroups, offset, j;
+	uint8_t buf[READ_CHUNK_SIZE];
+	int num_changroups, len;
 	unsigned int i;
-	unsigned char byte;
 
 	(void)fd;
 
@@ -401,139 +507,60 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	}
 
 	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
-		if (serial_read_nonblocking(serial, &byte, 1) != 1)
+		/* Consume everything that is available in one go. */
+		len = serial_read_nonblocking(serial, buf, sizeof(buf));
+		if (len < 1)
 			return FALSE;
-		devc->cnt_bytes++;
-
-		/* Ignore it if we've read enough. */
-		if (devc->num_samples >= devc->limit_samples)
+		devc->cnt_bytes += len;
+		decode_bytes(devc, num_changroups, buf, len);
+		if (devc->num_samples < devc->limit_samples)
 			return TRUE;
+	}
 
-		devc->sample[devc->num_bytes++] = byte;
-		sr_spew("Received byte 0x%.2x.", byte);
-		if (devc->num_bytes == num_changroups) {
-			devc->cnt_samples++;
-			devc->cnt_samples_rle++;
-			/*
-			 * Got a full sample. Convert from the OLS's little-endian
-			 * sample to the local format.
-			 */
-			sample = devc->sample[0] | (devc->sample[1] << 8) \
-					| (devc->sample[2] << 16) | (devc->sample[3] << 24);
-			sr_dbg("Received sample 0x%.*x.", devc->num_bytes * 2, sample);
-			if (devc->capture_flags & CAPTURE_FLAG_RLE) {
-				/*
-				 * In RLE mode the high bit of the sample is the
-				 * "count" flag, meaning this sample is the number
-				 * of times the previous sample occurred.
-				 */
-				if (devc->sample[devc->num_bytes - 1] & 0x80) {
-					/* Clear the high bit. */
-					sample &= ~(0x80 << (devc->num_bytes - 1) * 8);
-					devc->rle_count = sample;
-					devc->cnt_samples_rle += devc->rle_count;
-					sr_dbg("RLE count: %u.", devc->rle_count);
-					devc->num_bytes = 0;
-					return TRUE;
-				}
-			}
-			devc->num_samples += devc->rle_count + 1;
-			if (devc->num_samples > devc->limit_samples) {
-				/* Save us from overrunning the buffer. */
-				devc->rle_count -= devc->num_samples - devc->limit_samples;
-				devc->num_samples = devc->limit_samples;
-			}
-
-			if (num_changroups < 4) {
-				/*
-				 * Some channel groups may have been turned
-				 * off, to speed up transfer between the
-				 * hardware and the PC. Expand that here before
-				 * submitting it over the session bus --
-				 * whatever is listening on the bus will be
-				 * expecting a full 32-bit sample, based on
-				 * the number of channels.
-				 */
-				j = 0;
-				memset(devc->tmp_sample, 0, 4);
-				for (i = 0; i < 4; i++) {
-					if (((devc->capture_flags >> 2) & (1 << i)) == 0) {
-						/*
-						 * This channel group was
-						 * enabled, copy from received
-						 * sample.
-						 */
-						devc->tmp_sample[i] = devc->sample[j++];
-					} else if (devc->capture_flags & CAPTURE_FLAG_DEMUX && (i > 2)) {
-						/* group 2 & 3 get added to 0 & 1 */
-						devc->tmp_sample[i - 2] = devc->sample[j++];
-					}
-				}
-				memcpy(devc->sample, devc->tmp_sample, 4);
-				sr_spew("Expanded sample: 0x%.2hhx%.2hhx%.2hhx%.2hhx ",
-					devc->sample[3], devc->sample[2], devc->sample[1], devc->sample[0]);
-			}
-
-			/*
-			 * the OLS sends its sample buffer backwards.
-			 * store it in reverse order here, so we can dump
-			 * this on the session bus later.
-			 */
-			offset = (devc->limit_samples - devc->num_samples) * 4;
-			for (i = 0; i <= devc->rle_count; i++) {
-				memcpy(devc->raw_sample_buf + offset + (i * 4),
-				       devc->sample, 4);
-			}
-			memset(devc->sample, 0, 4);
-			devc->num_bytes = 0;
-			devc->rle_count = 0;
-		}
-	} else {
+	/*
+	 * This is the main loop telling us a timeout was reached, or
+	 * we've acquired all the samples we asked for -- we're done.
+	 * Send the (properly-ordered) buffer to the frontend.
+	 */
+	sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
+			devc->cnt_bytes, devc->cnt_samples,
+			devc->cnt_samples_rle);
+	if (devc->trigger_at_smpl != OLS_NO_TRIGGER) {
 		/*
-		 * This is the main loop telling us a timeout was reached, or
-		 * we've acquired all the samples we asked for -- we're done.
-		 * Send the (properly-ordered) buffer to the frontend.
+		 * A trigger was set up, so we need to tell the frontend
+		 * about it.
 		 */
-		sr_dbg("Received %d bytes, %d samples, %d decompressed samples.",
-				devc->cnt_bytes, devc->cnt_samples,
-				devc->cnt_samples_rle);
-		if (devc->trigger_at_smpl != OLS_NO_TRIGGER) {
-			/*
-			 * A trigger was set up, so we need to tell the frontend
-			 * about it.
-			 */
-			if (devc->trigger_at_smpl > 0) {
-				/* There are pre-trigger samples, send those first. */
-				packet.type = SR_DF_LOGIC;
-				packet.payload = &logic;
-				logic.length = devc->trigger_at_smpl * 4;
-				logic.unitsize = 4;
-				logic.data = devc->raw_sample_buf +
-					(devc->limit_samples - devc->num_samples) * 4;
-				sr_session_send(sdi, &packet);
-			}
-
-			/* Send the trigger. */
-			std_session_send_df_trigger(sdi);
+		if (devc->trigger_at_smpl > 0) {
+			/* There are pre-trigger samples, send those first. */
+			packet.type = SR_DF_LOGIC;
+			packet.payload = &logic;
+			logic.length = devc->trigger_at_smpl * 4;
+			logic.unitsize = 4;
+			logic.data = devc->raw_sample_buf +
+				(devc->limit_samples - devc->num_samples) * 4;
+			sr_session_send(sdi, &packet);
 		}
 
-		/* Send post-trigger / all captured samples. */
-		int num_pre_trigger_samples = devc->trigger_at_smpl == OLS_NO_TRIGGER
-			? 0 : devc->trigger_at_smpl;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = (devc->num_samples - num_pre_trigger_samples) * 4;
-		logic.unitsize = 4;
-		logic.data = devc->raw_sample_buf + (num_pre_trigger_samples +
-			devc->limit_samples - devc->num_samples) * 4;
-		sr_session_send(sdi, &packet);
-
-		g_free(devc->raw_sample_buf);
-
-		serial_flush(serial);
-		abort_acquisition(sdi);
+		/* Send the trigger. */
+		std_session_send_df_trigger(sdi);
 	}
 
+	/* Send post-trigger / all captured samples. */
+	int num_pre_trigger_samples = devc->trigger_at_smpl == OLS_NO_TRIGGER
+		? 0 : devc->trigger_at_smpl;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = (devc->num_samples - num_pre_trigger_samples) * 4;
+	logic.unitsize = 4;
+	logic.data = devc->raw_sample_buf + (num_pre_trigger_samples +
+		devc->limit_samples - devc->num_samples) * 4;
+	sr_session_send(sdi, &packet);
+
+	g_free(devc->raw_sample_buf);
+
+	serial_flush(serial);
+	abort_acquisition(sdi);
+
 	return TRUE;
 }
 
@@ -33,6 +33,9 @@
 #define MIN_NUM_SAMPLES            4
 #define DEFAULT_SAMPLERATE         SR_KHZ(200)
 
+/* Maximum number of bytes to read per receive callback. */
+#define READ_CHUNK_SIZE            4096
+
 /* Command opcodes */
 #define CMD_RESET                     0x00
 #define CMD_ARM_BASIC_TRIGGER         0x01
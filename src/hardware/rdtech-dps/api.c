@@ -94,6 +94,13 @@ static struct sr_dev_inst *probe_device(struct sr_modbus_dev_inst *modbus)
 	sr_channel_new(sdi, 0, SR_CHANNEL_ANALOG, TRUE, "I");
 	sr_channel_new(sdi, 0, SR_CHANNEL_ANALOG, TRUE, "P");
 
+	/*
+	 * The acquisition reads the output values and states, config_get()
+	 * requests for the setpoints get served from the same request.
+	 */
+	sr_modbus_poll_add(modbus, REG_USET, 2);
+	sr_modbus_poll_add(modbus, REG_UOUT, 8);
+
 	devc = g_malloc0(sizeof(struct dev_context));
 	sr_sw_limits_init(&devc->limits);
 	devc->model = model;
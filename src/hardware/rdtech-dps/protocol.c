@@ -21,6 +21,9 @@
 #include <config.h>
 #include "protocol.h"
 
+/* Values of the poll set serve config_get() requests for this long. */
+#define POLL_MAX_AGE_MS 500
+
 SR_PRIV int rdtech_dps_read_holding_registers(struct sr_modbus_dev_inst *modbus,
 		int address, int nb_registers, uint16_t *registers)
 {
@@ -48,7 +51,9 @@ SR_PRIV int rdtech_dps_get_reg(const struct sr_dev_inst *sdi,
 	modbus = sdi->conn;
 
 	g_mutex_lock(&devc->rw_mutex);
-	ret = rdtech_dps_read_holding_registers(modbus, address, 1, registers);
+	ret = sr_modbus_poll_get(modbus, address, 1, registers, POLL_MAX_AGE_MS);
+	if (ret != SR_OK)
+		ret = rdtech_dps_read_holding_registers(modbus, address, 1, registers);
 	g_mutex_unlock(&devc->rw_mutex);
 	*value = RB16(registers + 0);
 	return ret;
@@ -68,6 +73,9 @@ SR_PRIV int rdtech_dps_set_reg(const struct sr_dev_inst *sdi,
 	WB16(registers, value);
 	g_mutex_lock(&devc->rw_mutex);
 	ret = sr_modbus_write_multiple_registers(modbus, address, 1, registers);
+	/* Setpoints mirror preset 0, which also changes by loading presets. */
+	if (address == REG_PRESET || address == PRE_USET || address == PRE_ISET)
+		sr_modbus_poll_invalidate(modbus, REG_USET, 2);
 	g_mutex_unlock(&devc->rw_mutex);
 	return ret;
 }
@@ -137,7 +145,10 @@ SR_PRIV int rdtech_dps_receive_data(int fd, int revents, void *cb_data)
 	 * Using the libsigrok function here, because it doesn't matter if the
 	 * reading fails. It will be done again in the next acquision cycle anyways.
 	 */
-	ret = sr_modbus_read_holding_registers(modbus, REG_UOUT, 8, registers);
+	ret = sr_modbus_poll_read(modbus);
+	if (ret == SR_OK)
+		ret = sr_modbus_poll_get(modbus, REG_UOUT, 8, registers,
+			POLL_MAX_AGE_MS);
 	g_mutex_unlock(&devc->rw_mutex);
 
 	if (ret == SR_OK) {
@@ -66,6 +66,14 @@
  * Each data block has a trailing linefeed too.
  */
 
+/* Analog waveform data, as selected by ":WAV:FORM BYTE". */
+static const struct sr_scpi_sample_format rigol_ds_byte_format = {
+	.unitsize = 1,
+	.is_signed = FALSE,
+	.is_float = FALSE,
+	.is_bigendian = FALSE,
+};
+
 static int parse_int(const char *str, int *ret)
 {
 	char *e;
@@ -608,7 +616,7 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 	struct sr_analog_spec spec;
 	struct sr_datafeed_logic logic;
 	double vdiv, offset, origin;
-	int len, i, vref;
+	int len, vref;
 	struct sr_channel *ch;
 	gsize expected_data_bytes;
 
@@ -734,18 +742,19 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 		vdiv = devc->vert_inc[ch->index];
 		origin = devc->vert_origin[ch->index];
 		offset = devc->vert_offset[ch->index];
-		if (devc->model->series->protocol >= PROTOCOL_V3)
-			for (i = 0; i < len; i++)
-				devc->data[i] = ((int)devc->buffer[i] - vref - origin) * vdiv;
-		else
-			for (i = 0; i < len; i++)
-				devc->data[i] = (128 - devc->buffer[i]) * vdiv - offset;
 		float vdivlog = log10f(vdiv);
 		int digits = -(int)vdivlog + (vdivlog < 0.0);
 		sr_analog_init(&analog, &encoding, &meaning, &spec, digits);
+		/* Pass the raw bytes on, scale/offset describe the conversion. */
+		if (devc->model->series->protocol >= PROTOCOL_V3)
+			sr_scpi_sample_encoding(&rigol_ds_byte_format,
+				vdiv, -(vref + origin) * vdiv, &encoding);
+		else
+			sr_scpi_sample_encoding(&rigol_ds_byte_format,
+				-vdiv, 128 * vdiv - offset, &encoding);
 		analog.meaning->channels = g_slist_append(NULL, ch);
 		analog.num_samples = len;
-		analog.data = devc->data;
+		analog.data = devc->buffer;
 		analog.meaning->mq = SR_MQ_VOLTAGE;
 		analog.meaning->unit = SR_UNIT_VOLT;
 		analog.meaning->mqflags = 0;
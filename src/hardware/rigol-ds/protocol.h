@@ -160,9 +160,8 @@ struct dev_context {
 	enum wait_events wait_event;
 	/* Trigger/block copying/stop waiting status */
 	int wait_status;
-	/* Acq buffers used for reading from the scope and sending data to app */
+	/* Acq buffer used for reading from the scope and sending data to app */
 	unsigned char *buffer;
-	float *data;
 };
 
 SR_PRIV int rigol_ds_config_set(const struct sr_dev_inst *sdi, const char *format, ...);
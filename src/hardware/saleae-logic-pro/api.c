@@ -453,6 +453,8 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 	usb_source_remove(sdi->session, drvc->sr_ctx);
 
 	g_free(devc->conv_buffer);
+	sr_bit_transpose_free(devc->transpose);
+	devc->transpose = NULL;
 
 	return SR_OK;
 }
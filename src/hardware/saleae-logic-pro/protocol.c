@@ -585,6 +585,15 @@ static int configure_channels(const struct sr_dev_inst *sdi)
 	sr_dbg("%d channels enabled (0x%04x)",
 	       devc->dig_channel_cnt, devc->dig_channel_mask);
 
+	/* 32bit words per channel, the first sample in the MSB. */
+	sr_bit_transpose_free(devc->transpose);
+	devc->transpose = sr_bit_transpose_new(32, devc->dig_channel_cnt,
+		devc->dig_channel_masks, TRUE);
+	if (!devc->transpose) {
+		sr_err("Unsupported channel configuration.");
+		return SR_ERR;
+	}
+
 	return SR_OK;
 }
 
@@ -746,8 +755,10 @@ SR_PRIV int saleae_logic_pro_prepare(const struct sr_dev_inst *sdi)
 	};
 	uint8_t start_req[] = {0x00, 0x01};
 	uint8_t start_rsp[2] = {};
+	int ret;
 
-	configure_channels(sdi);
+	if ((ret = configure_channels(sdi)) != SR_OK)
+		return ret;
 
 	/* Digital channel mask and muxing */
 	regs_config[3][1] = devc->dig_channel_mask;
@@ -796,7 +807,6 @@ SR_PRIV int saleae_logic_pro_start(const struct sr_dev_inst *sdi)
 	struct dev_context *devc = sdi->priv;
 
 	devc->conv_size = 0;
-	devc->batch_index = 0;
 
 	write_reg(sdi, 0x00, 0x01);
 
@@ -844,45 +854,17 @@ static void saleae_logic_pro_send_data(const struct sr_dev_inst *sdi,
 /*
  * One batch from the device consists of 32 samples per active digital channel.
  * This stream of batches is packed into USB packets with 16384 bytes each.
+ * Batches may span packets, the bit transposition keeps the partial batch.
  */
 static void saleae_logic_pro_convert_data(const struct sr_dev_inst *sdi,
-					 const uint32_t *src, size_t srccnt)
+					 const uint8_t *src, size_t length)
 {
 	struct dev_context *devc = sdi->priv;
-	uint8_t *dst = devc->conv_buffer;
-	uint32_t samples;
-	uint16_t channel_mask;
-	unsigned int sample_index, batch_index;
-	uint16_t *dst_batch;
-
-	/* Copy partial batch to the beginning. */
-	memcpy(dst, dst + devc->conv_size, CONV_BATCH_SIZE);
-	/* Reset converted size. */
-	devc->conv_size = 0;
+	size_t count;
 
-	batch_index = devc->batch_index;
-	while (srccnt--) {
-		samples = *src++;
-		dst_batch = (uint16_t*)dst;
-
-		/* First index of the batch. */
-		if (batch_index == 0)
-			memset(dst, 0, CONV_BATCH_SIZE);
-
-		/* Convert one channel. */
-		channel_mask = devc->dig_channel_masks[batch_index];
-		for (sample_index = 0; sample_index <= 31; sample_index++)
-			if ((samples >> (31 - sample_index)) & 1)
-				dst_batch[sample_index] |= channel_mask;
-
-		/* Last index of the batch. */
-		if (++batch_index == devc->dig_channel_cnt) {
-			devc->conv_size += CONV_BATCH_SIZE;
-			batch_index = 0;
-			dst += CONV_BATCH_SIZE;
-		}
-	}
-	devc->batch_index = batch_index;
+	count = sr_bit_transpose_feed(devc->transpose, src, length,
+		(uint16_t *)devc->conv_buffer);
+	devc->conv_size = count * sizeof(uint16_t);
 }
 
 SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *transfer)
@@ -903,7 +885,7 @@ SR_PRIV void LIBUSB_CALL saleae_logic_pro_receive_data(struct libusb_transfer *t
 		return;
 	}
 
-	saleae_logic_pro_convert_data(sdi, (uint32_t*)transfer->buffer, 16 * 1024 / 4);
+	saleae_logic_pro_convert_data(sdi, transfer->buffer, transfer->actual_length);
 	saleae_logic_pro_send_data(sdi, devc->conv_buffer, devc->conv_size, 2);
 
 	if ((ret = libusb_submit_transfer(transfer)) != LIBUSB_SUCCESS)
@@ -48,9 +48,9 @@ struct dev_context {
 	unsigned int submitted_transfers;
 	struct libusb_transfer **transfers;
 
+	struct sr_bit_transpose *transpose;
 	uint8_t *conv_buffer;
 	unsigned int conv_size;
-	unsigned int batch_index;
 };
 
 SR_PRIV int saleae_logic_pro_init(const struct sr_dev_inst *sdi);
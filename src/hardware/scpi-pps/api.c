@@ -802,9 +802,6 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 	scpi = sdi->conn;
 
-	/* Prime the pipe with the first channel. */
-	devc->cur_acquisition_channel = sr_next_enabled_channel(sdi, NULL);
-
 	/* Device specific initialization before acquisition starts. */
 	if (devc->device->init_acquisition)
 		devc->device->init_acquisition(sdi);
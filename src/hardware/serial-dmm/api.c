@@ -42,62 +42,31 @@ static const uint32_t devopts[] = {
 	SR_CONF_CONTINUOUS,
 	SR_CONF_LIMIT_SAMPLES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_MSEC | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_BATCH_INTERVAL | SR_CONF_GET | SR_CONF_SET,
 };
 
-static GSList *scan(struct sr_dev_driver *di, GSList *options)
+static int probe_port(struct sr_serial_dev_inst *serial, void *cb_data)
 {
 	struct dmm_info *dmm;
-	struct sr_config *src;
-	GSList *l, *devices;
-	const char *conn, *serialcomm;
-	struct sr_dev_inst *sdi;
-	struct dev_context *devc;
-	struct sr_serial_dev_inst *serial;
 	int ret;
 	size_t dropped, len, packet_len;
 	uint8_t buf[128];
-	size_t ch_idx;
-	char ch_name[12];
-
-	dmm = (struct dmm_info *)di;
-
-	conn = dmm->conn;
-	serialcomm = dmm->serialcomm;
-	for (l = options; l; l = l->next) {
-		src = l->data;
-		switch (src->key) {
-		case SR_CONF_CONN:
-			conn = g_variant_get_string(src->data, NULL);
-			break;
-		case SR_CONF_SERIALCOMM:
-			serialcomm = g_variant_get_string(src->data, NULL);
-			break;
-		}
-	}
-	if (!conn)
-		return NULL;
 
-	serial = sr_serial_dev_inst_new(conn, serialcomm);
-
-	if (serial_open(serial, SERIAL_RDWR) != SR_OK)
-		return NULL;
-	sr_info("Probing serial port %s.", conn);
+	dmm = cb_data;
 
 	if (dmm->after_open) {
 		ret = dmm->after_open(serial);
 		if (ret != SR_OK) {
 			sr_err("Activity after port open failed: %d.", ret);
-			return NULL;
+			return ret;
 		}
 	}
 
-	devices = NULL;
-
 	/* Request a packet if the DMM requires this. */
 	if (dmm->packet_request) {
 		if ((ret = dmm->packet_request(serial)) < 0) {
 			sr_err("Failed to request packet: %d.", ret);
-			return NULL;
+			return ret;
 		}
 	}
 
@@ -116,76 +85,139 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	ret = serial_stream_detect(serial, buf, &len, dmm->packet_size,
 		dmm->packet_valid, dmm->packet_valid_len, &packet_len, 3000);
 	if (ret != SR_OK)
-		goto scan_cleanup;
+		return ret;
 	dropped = len - dmm->packet_size;
 	if (dropped > 2 * packet_len)
 		sr_warn("Packet search dropped a lot of data.");
-	sr_info("Found device on port %s.", conn);
+	sr_info("Found device on port %s.", serial->port);
 
-	/*
-	 * Setup optional additional callbacks when sub device drivers
-	 * happen to provide them. (This is a compromise to do it here,
-	 * and not extend the DMM_CONN() et al set of macros.)
-	 */
-	if (strcmp(dmm->di.name, "brymen-bm52x") == 0) {
-		/* Applicable to BM520s but not to BM820s. */
-		dmm->dmm_state_init = brymen_bm52x_state_init;
-		dmm->dmm_state_free = brymen_bm52x_state_free;
-		dmm->config_get = brymen_bm52x_config_get;
-		dmm->config_set = brymen_bm52x_config_set;
-		dmm->config_list = brymen_bm52x_config_list;
-		dmm->acquire_start = brymen_bm52x_acquire_start;
-	}
-	if (dmm->dmm_state_init)
-		dmm->dmm_state = dmm->dmm_state_init();
-
-	/* Setup the device instance. */
-	sdi = g_malloc0(sizeof(*sdi));
-	sdi->status = SR_ST_INACTIVE;
-	sdi->vendor = g_strdup(dmm->vendor);
-	sdi->model = g_strdup(dmm->device);
-	devc = g_malloc0(sizeof(*devc));
-	sr_sw_limits_init(&devc->limits);
-	sdi->inst_type = SR_INST_SERIAL;
-	sdi->conn = serial;
-	sdi->priv = devc;
-
-	/* Create (optionally device dependent) channel(s). */
-	dmm->channel_count = 1;
-	if (dmm->packet_parse == sr_brymen_bm52x_parse)
-		dmm->channel_count = BRYMEN_BM52X_DISPLAY_COUNT;
-	if (dmm->packet_parse == sr_brymen_bm86x_parse)
-		dmm->channel_count = BRYMEN_BM86X_DISPLAY_COUNT;
-	if (dmm->packet_parse == sr_eev121gw_3displays_parse) {
-		dmm->channel_count = EEV121GW_DISPLAY_COUNT;
-		dmm->channel_formats = eev121gw_channel_formats;
-	}
-	if (dmm->packet_parse == sr_metex14_4packets_parse)
-		dmm->channel_count = 4;
-	if (dmm->packet_parse == sr_ms2115b_parse) {
-		dmm->channel_count = MS2115B_DISPLAY_COUNT;
-		dmm->channel_formats = ms2115b_channel_formats;
-	}
-	for (ch_idx = 0; ch_idx < dmm->channel_count; ch_idx++) {
-		size_t ch_num;
-		const char *fmt;
-		fmt = "P%zu";
-		if (dmm->channel_formats && dmm->channel_formats[ch_idx])
-			fmt = dmm->channel_formats[ch_idx];
-		ch_num = ch_idx + 1;
-		snprintf(ch_name, sizeof(ch_name), fmt, ch_num);
-		sr_channel_new(sdi, ch_idx, SR_CHANNEL_ANALOG, TRUE, ch_name);
+	return SR_OK;
+}
+
+static GSList *scan(struct sr_dev_driver *di, GSList *options)
+{
+	struct dmm_info *dmm;
+	struct sr_config *src;
+	GSList *l, *ports, *devices;
+	const char *conn, *serialcomm;
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct sr_serial_dev_inst *serial;
+	size_t ch_idx;
+	char ch_name[12];
+
+	dmm = (struct dmm_info *)di;
+
+	conn = dmm->conn;
+	serialcomm = dmm->serialcomm;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		switch (src->key) {
+		case SR_CONF_CONN:
+			conn = g_variant_get_string(src->data, NULL);
+			break;
+		case SR_CONF_SERIALCOMM:
+			serialcomm = g_variant_get_string(src->data, NULL);
+			break;
+		}
 	}
+	if (!conn)
+		return NULL;
 
-	/* Add found device to result set. */
-	devices = g_slist_append(devices, sdi);
+	/* Probe all given ports, set up devices in the scan's thread. */
+	ports = serial_scan_ports(conn, serialcomm, probe_port, dmm);
+	devices = NULL;
+	for (l = ports; l; l = l->next) {
+		serial = l->data;
 
-scan_cleanup:
-	serial_close(serial);
+		/*
+		 * Setup optional additional callbacks when sub device drivers
+		 * happen to provide them. (This is a compromise to do it here,
+		 * and not extend the DMM_CONN() et al set of macros.)
+		 */
+		if (strcmp(dmm->di.name, "brymen-bm52x") == 0) {
+			/* Applicable to BM520s but not to BM820s. */
+			dmm->dmm_state_init = brymen_bm52x_state_init;
+			dmm->dmm_state_free = brymen_bm52x_state_free;
+			dmm->config_get = brymen_bm52x_config_get;
+			dmm->config_set = brymen_bm52x_config_set;
+			dmm->config_list = brymen_bm52x_config_list;
+			dmm->acquire_start = brymen_bm52x_acquire_start;
+		}
+
+		/* Setup the device instance. */
+		sdi = g_malloc0(sizeof(*sdi));
+		sdi->status = SR_ST_INACTIVE;
+		sdi->vendor = g_strdup(dmm->vendor);
+		sdi->model = g_strdup(dmm->device);
+		devc = g_malloc0(sizeof(*devc));
+		sr_sw_limits_init(&devc->limits);
+		sr_analog_batch_init(&devc->batch);
+		if (dmm->dmm_state_init)
+			devc->dmm_state = dmm->dmm_state_init();
+		sdi->inst_type = SR_INST_SERIAL;
+		sdi->conn = serial;
+		sdi->priv = devc;
+
+		/* Create (optionally device dependent) channel(s). */
+		dmm->channel_count = 1;
+		if (dmm->packet_parse == sr_brymen_bm52x_parse)
+			dmm->channel_count = BRYMEN_BM52X_DISPLAY_COUNT;
+		if (dmm->packet_parse == sr_brymen_bm86x_parse)
+			dmm->channel_count = BRYMEN_BM86X_DISPLAY_COUNT;
+		if (dmm->packet_parse == sr_eev121gw_3displays_parse) {
+			dmm->channel_count = EEV121GW_DISPLAY_COUNT;
+			dmm->channel_formats = eev121gw_channel_formats;
+		}
+		if (dmm->packet_parse == sr_metex14_4packets_parse)
+			dmm->channel_count = 4;
+		if (dmm->packet_parse == sr_ms2115b_parse) {
+			dmm->channel_count = MS2115B_DISPLAY_COUNT;
+			dmm->channel_formats = ms2115b_channel_formats;
+		}
+		for (ch_idx = 0; ch_idx < dmm->channel_count; ch_idx++) {
+			size_t ch_num;
+			const char *fmt;
+			fmt = "P%zu";
+			if (dmm->channel_formats && dmm->channel_formats[ch_idx])
+				fmt = dmm->channel_formats[ch_idx];
+			ch_num = ch_idx + 1;
+			snprintf(ch_name, sizeof(ch_name), fmt, ch_num);
+			sr_channel_new(sdi, ch_idx, SR_CHANNEL_ANALOG, TRUE, ch_name);
+		}
+
+		/* Add found device to result set. */
+		devices = g_slist_append(devices, sdi);
+	}
+	g_slist_free(ports);
 
 	return std_scan_complete(di, devices);
 }
 
+static int dev_clear(const struct sr_dev_driver *di)
+{
+	struct dmm_info *dmm;
+	struct drv_context *drvc;
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	GSList *l;
+
+	dmm = (struct dmm_info *)di;
+	drvc = di->context;
+	if (drvc && dmm->dmm_state_free) {
+		for (l = drvc->instances; l; l = l->next) {
+			sdi = l->data;
+			devc = sdi->priv;
+			if (!devc)
+				continue;
+			dmm->dmm_state_free(devc->dmm_state);
+			devc->dmm_state = NULL;
+		}
+	}
+
+	return std_dev_clear(di);
+}
+
 static int config_get(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
@@ -201,11 +233,13 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_get(&devc->limits, key, data);
+	case SR_CONF_BATCH_INTERVAL:
+		return sr_analog_batch_config_get(&devc->batch, key, data);
 	default:
 		dmm = (struct dmm_info *)sdi->driver;
 		if (!dmm || !dmm->config_get)
 			return SR_ERR_NA;
-		return dmm->config_get(dmm->dmm_state, key, data, sdi, cg);
+		return dmm->config_get(devc->dmm_state, key, data, sdi, cg);
 	}
 	/* UNREACH */
 }
@@ -226,17 +260,20 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_set(&devc->limits, key, data);
+	case SR_CONF_BATCH_INTERVAL:
+		return sr_analog_batch_config_set(&devc->batch, key, data);
 	default:
 		dmm = (struct dmm_info *)sdi->driver;
 		if (!dmm || !dmm->config_set)
 			return SR_ERR_NA;
-		return dmm->config_set(dmm->dmm_state, key, data, sdi, cg);
+		return dmm->config_set(devc->dmm_state, key, data, sdi, cg);
 	}
 }
 
 static int config_list(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg)
 {
+	struct dev_context *devc;
 	struct dmm_info *dmm;
 	int ret;
 
@@ -248,9 +285,10 @@ static int config_list(uint32_t key, GVariant **data,
 	 * Check for device specific config_list handler. ERR N/A from
 	 * that handler is non-fatal, just falls back to common logic.
 	 */
+	devc = sdi->priv;
 	dmm = (struct dmm_info *)sdi->driver;
 	if (dmm && dmm->config_list) {
-		ret = dmm->config_list(dmm->dmm_state, key, data, sdi, cg);
+		ret = dmm->config_list(devc->dmm_state, key, data, sdi, cg);
 		if (ret != SR_ERR_NA)
 			return ret;
 	}
@@ -276,7 +314,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	cb_data = (void *)sdi;
 	dmm = (struct dmm_info *)sdi->driver;
 	if (dmm && dmm->acquire_start) {
-		ret = dmm->acquire_start(dmm->dmm_state, sdi,
+		ret = dmm->acquire_start(devc->dmm_state, sdi,
 			&cb_func, &cb_data);
 		if (ret < 0)
 			return ret;
@@ -289,11 +327,21 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(&devc->batch, sdi);
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, VALID, PARSE, DETAILS, \
 		INIT_STATE, FREE_STATE, VALID_LEN, PARSE_LEN, \
-		CFG_GET, CFG_SET, CFG_LIST, ACQ_START) \
+		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, SYNC) \
 	&((struct dmm_info) { \
 		{ \
 			.name = ID, \
@@ -303,22 +351,22 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.cleanup = std_cleanup, \
 			.scan = scan, \
 			.dev_list = std_dev_list, \
-			.dev_clear = std_dev_clear, \
+			.dev_clear = dev_clear, \
 			.config_get = config_get, \
 			.config_set = config_set, \
 			.config_list = config_list, \
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		VENDOR, MODEL, CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		REQUEST, 1, NULL, VALID, PARSE, DETAILS, \
 		sizeof(struct CHIPSET##_info), \
-		NULL, INIT_STATE, FREE_STATE, \
+		INIT_STATE, FREE_STATE, \
 		OPEN, VALID_LEN, PARSE_LEN, \
-		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, \
+		CFG_GET, CFG_SET, CFG_LIST, ACQ_START, SYNC, \
 	}).di
 
 #define DMM_CONN(ID, CHIPSET, VENDOR, MODEL, \
@@ -327,7 +375,15 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		NULL, REQUEST, VALID, PARSE, DETAILS, \
-		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL)
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL)
+
+#define DMM_CONN_SYNC(ID, CHIPSET, VENDOR, MODEL, \
+		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
+		REQUEST, VALID, PARSE, DETAILS, SYNC) \
+	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
+		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
+		NULL, REQUEST, VALID, PARSE, DETAILS, \
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, SYNC)
 
 #define DMM(ID, CHIPSET, VENDOR, MODEL, SERIALCOMM, PACKETSIZE, TIMEOUT, \
 		DELAY, REQUEST, VALID, PARSE, DETAILS) \
@@ -335,13 +391,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		NULL, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		REQUEST, VALID, PARSE, DETAILS)
 
+#define DMM_SYNC(ID, CHIPSET, VENDOR, MODEL, SERIALCOMM, PACKETSIZE, \
+		TIMEOUT, DELAY, REQUEST, VALID, PARSE, DETAILS, SYNC) \
+	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
+		NULL, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
+		NULL, REQUEST, VALID, PARSE, DETAILS, \
+		NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, SYNC)
+
 #define DMM_LEN(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		INIT, FREE, OPEN, REQUEST, VALID, PARSE, DETAILS) \
 	DMM_ENTRY(ID, CHIPSET, VENDOR, MODEL, \
 		CONN, SERIALCOMM, PACKETSIZE, TIMEOUT, DELAY, \
 		OPEN, REQUEST, NULL, NULL, DETAILS, \
-		INIT, FREE, VALID, PARSE, NULL, NULL, NULL, NULL)
+		INIT, FREE, VALID, PARSE, NULL, NULL, NULL, NULL, NULL)
 
 SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	/*
@@ -357,10 +420,11 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	 * speed up navigation in the long list.
 	 */
 	/* asycii based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"metrix-mx56c", asycii, "Metrix", "MX56C",
 		"2400/8n1", ASYCII_PACKET_SIZE, 0, 0, NULL,
-		sr_asycii_packet_valid, sr_asycii_parse, NULL
+		sr_asycii_packet_valid, sr_asycii_parse, NULL,
+		&sr_asycii_packet_sync
 	),
 	/* }}} */
 	/* bm25x based meters {{{ */
@@ -373,19 +437,19 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	),
 	/* }}} */
 	/* bm52x based meters {{{ */
-	DMM_CONN(
+	DMM_CONN_SYNC(
 		"brymen-bm52x", brymen_bm52x, "Brymen", "BM52x",
 		"hid/bu86x", NULL, BRYMEN_BM52X_PACKET_SIZE, 4000, 500,
 		sr_brymen_bm52x_packet_request,
 		sr_brymen_bm52x_packet_valid, sr_brymen_bm52x_parse,
-		NULL
+		NULL, &sr_brymen_bm52x_packet_sync
 	),
-	DMM_CONN(
+	DMM_CONN_SYNC(
 		"brymen-bm82x", brymen_bm52x, "Brymen", "BM82x",
 		"hid/bu86x", NULL, BRYMEN_BM52X_PACKET_SIZE, 4000, 500,
 		sr_brymen_bm82x_packet_request,
 		sr_brymen_bm82x_packet_valid, sr_brymen_bm52x_parse,
-		NULL
+		NULL, &sr_brymen_bm82x_packet_sync
 	),
 	/* }}} */
 	/* bm85x based meters {{{ */
@@ -409,24 +473,27 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	),
 	/* }}} */
 	/* dtm0660 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"peaktech-3415", dtm0660,
 		"PeakTech", "3415", "2400/8n1/rts=0/dtr=1",
 		DTM0660_PACKET_SIZE, 0, 0, NULL,
-		sr_dtm0660_packet_valid, sr_dtm0660_parse, NULL
+		sr_dtm0660_packet_valid, sr_dtm0660_parse, NULL,
+		&sr_dtm0660_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"velleman-dvm4100", dtm0660,
 		"Velleman", "DVM4100", "2400/8n1/rts=0/dtr=1",
 		DTM0660_PACKET_SIZE, 0, 0, NULL,
-		sr_dtm0660_packet_valid, sr_dtm0660_parse, NULL
+		sr_dtm0660_packet_valid, sr_dtm0660_parse, NULL,
+		&sr_dtm0660_packet_sync
 	),
 	/* }}} */
 	/* eev121gw based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"eevblog-121gw", eev121gw, "EEVblog", "121GW",
 		"115200/8n1", EEV121GW_PACKET_SIZE, 0, 0, NULL,
-		sr_eev121gw_packet_valid, sr_eev121gw_3displays_parse, NULL
+		sr_eev121gw_packet_valid, sr_eev121gw_3displays_parse, NULL,
+		&sr_eev121gw_packet_sync
 	),
 	/* }}} */
 	/* es519xx based meters {{{ */
@@ -469,135 +536,153 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	),
 	/* }}} */
 	/* fs9721 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"digitek-dt4000zc", fs9721,
 		"Digitek", "DT4000ZC", "2400/8n1/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_10_temp_c
+		sr_fs9721_10_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"mastech-ms8250b", fs9721,
 		"MASTECH", "MS8250B", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		NULL
+		NULL,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"pce-pce-dm32", fs9721,
 		"PCE", "PCE-DM32", "2400/8n1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_01_10_temp_f_c
+		sr_fs9721_01_10_temp_f_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"peaktech-3330", fs9721,
 		"PeakTech", "3330", "2400/8n1/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_01_10_temp_f_c
+		sr_fs9721_01_10_temp_f_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"tecpel-dmm-8061-ser", fs9721,
 		"Tecpel", "DMM-8061 (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_00_temp_c
+		sr_fs9721_00_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"tekpower-tp4000ZC", fs9721,
 		"TekPower", "TP4000ZC", "2400/8n1/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_10_temp_c
+		sr_fs9721_10_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"tenma-72-7745-ser", fs9721,
 		"Tenma", "72-7745 (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_00_temp_c
+		sr_fs9721_00_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut60a-ser", fs9721,
 		"UNI-T", "UT60A (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		NULL
+		NULL,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut60e-ser", fs9721,
 		"UNI-T", "UT60E (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_00_temp_c
+		sr_fs9721_00_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"va-va18b", fs9721,
 		"V&A", "VA18B", "2400/8n1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_01_temp_c
+		sr_fs9721_01_temp_c,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"va-va40b", fs9721,
 		"V&A", "VA40B", "2400/8n1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_max_c_min
+		sr_fs9721_max_c_min,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc820-ser", fs9721,
 		"Voltcraft", "VC-820 (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		NULL
+		NULL,
+		&sr_fs9721_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc840-ser", fs9721,
 		"Voltcraft", "VC-840 (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9721_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
-		sr_fs9721_00_temp_c
+		sr_fs9721_00_temp_c,
+		&sr_fs9721_packet_sync
 	),
 	/* }}} */
 	/* fs9922 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"gwinstek-gdm-397", fs9922,
 		"GW Instek", "GDM-397", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
-		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
+		sr_fs9922_packet_valid, sr_fs9922_parse, NULL,
+		&sr_fs9922_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"sparkfun-70c", fs9922,
 		"SparkFun", "70C", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
-		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
+		sr_fs9922_packet_valid, sr_fs9922_parse, NULL,
+		&sr_fs9922_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut61b-ser", fs9922,
 		"UNI-T", "UT61B (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
-		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
+		sr_fs9922_packet_valid, sr_fs9922_parse, NULL,
+		&sr_fs9922_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut61c-ser", fs9922,
 		"UNI-T", "UT61C (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
-		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
+		sr_fs9922_packet_valid, sr_fs9922_parse, NULL,
+		&sr_fs9922_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut61d-ser", fs9922,
 		"UNI-T", "UT61D (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
-		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
+		sr_fs9922_packet_valid, sr_fs9922_parse, NULL,
+		&sr_fs9922_packet_sync
 	),
 	DMM_CONN(
 		"victor-dmm", fs9922, "Victor", "Victor DMMs",
 		"hid/victor", "2400/8n1", FS9922_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9922_packet_valid, sr_fs9922_parse, NULL
 	),
-	DMM(
+	DMM_SYNC(
 		/*
 		 * Note: The VC830 doesn't set the 'volt' and 'diode' bits of
 		 * the FS9922 protocol. Instead, it only sets the user-defined
@@ -607,7 +692,8 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 		"Voltcraft", "VC-830 (UT-D02 cable)", "2400/8n1/rts=0/dtr=1",
 		FS9922_PACKET_SIZE, 0, 0, NULL,
 		sr_fs9922_packet_valid, sr_fs9922_parse,
-		&sr_fs9922_z1_diode
+		&sr_fs9922_z1_diode,
+		&sr_fs9922_packet_sync
 	),
 	/* }}} */
 	/* m2110 based meters {{{ */
@@ -629,19 +715,21 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	),
 	/* }}} */
 	/* metex14 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"mastech-mas345", metex14,
 		"MASTECH", "MAS345", "600/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"metex-m3640d", metex14,
 		"Metex", "M-3640D", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
 	DMM(
 		"metex-m3860m", metex14,
@@ -650,40 +738,45 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 		sr_metex14_4packets_valid, sr_metex14_4packets_parse,
 		NULL
 	),
-	DMM(
+	DMM_SYNC(
 		"metex-m4650cr", metex14,
 		"Metex", "M-4650CR", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"metex-me21", metex14,
 		"Metex", "ME-21", "2400/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"metex-me31", metex14,
 		"Metex", "ME-31", "600/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"peaktech-3410", metex14,
 		"PeakTech", "3410", "600/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"peaktech-4370", metex14,
 		"PeakTech", "4370", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
 	DMM(
 		"peaktech-4390a", metex14,
@@ -692,47 +785,53 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 		sr_metex14_4packets_valid, sr_metex14_4packets_parse,
 		NULL
 	),
-	DMM(
+	DMM_SYNC(
 		"radioshack-22-168", metex14,
 		"RadioShack", "22-168", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"radioshack-22-805", metex14,
 		"RadioShack", "22-805", "600/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-m3650cr", metex14,
 		"Voltcraft", "M-3650CR", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 150, 20, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-m3650d", metex14,
 		"Voltcraft", "M-3650D", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-m4650cr", metex14,
 		"Voltcraft", "M-4650CR", "1200/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 0, 0, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-me42", metex14,
 		"Voltcraft", "ME-42", "600/7n2/rts=0/dtr=1",
 		METEX14_PACKET_SIZE, 250, 60, sr_metex14_packet_request,
 		sr_metex14_packet_valid, sr_metex14_parse,
-		NULL
+		NULL,
+		&sr_metex14_packet_sync
 	),
 	/* }}} */
 	/* ms2115b based meters {{{ */
@@ -763,94 +862,108 @@ SR_REGISTER_DEV_DRIVER_LIST(serial_dmm_drivers,
 	),
 	/* }}} */
 	/* ut71x based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"tenma-72-7730-ser", ut71x,
 		"Tenma", "72-7730 (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"tenma-72-7732-ser", ut71x,
 		"Tenma", "72-7732 (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"tenma-72-9380a-ser", ut71x,
 		"Tenma", "72-9380A (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut71a-ser", ut71x,
 		"UNI-T", "UT71A (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut71b-ser", ut71x,
 		"UNI-T", "UT71B (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut71c-ser", ut71x,
 		"UNI-T", "UT71C (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut71d-ser", ut71x,
 		"UNI-T", "UT71D (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut71e-ser", ut71x,
 		"UNI-T", "UT71E (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"uni-t-ut804-ser", ut71x,
 		"UNI-T", "UT804", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc920-ser", ut71x,
 		"Voltcraft", "VC-920 (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc940-ser", ut71x,
 		"Voltcraft", "VC-940 (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc960-ser", ut71x,
 		"Voltcraft", "VC-960 (UT-D02 cable)", "2400/7o1/rts=0/dtr=1",
 		UT71X_PACKET_SIZE, 0, 0, NULL,
-		sr_ut71x_packet_valid, sr_ut71x_parse, NULL
+		sr_ut71x_packet_valid, sr_ut71x_parse, NULL,
+		&sr_ut71x_packet_sync
 	),
 	/* }}} */
 	/* vc870 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc870-ser", vc870,
 		"Voltcraft", "VC-870 (UT-D02 cable)", "9600/8n1/rts=0/dtr=1",
 		VC870_PACKET_SIZE, 0, 0, NULL,
-		sr_vc870_packet_valid, sr_vc870_parse, NULL
+		sr_vc870_packet_valid, sr_vc870_parse, NULL,
+		&sr_vc870_packet_sync
 	),
 	/* }}} */
 	/* vc96 based meters {{{ */
-	DMM(
+	DMM_SYNC(
 		"voltcraft-vc96", vc96,
 		"Voltcraft", "VC-96", "1200/8n2",
 		VC96_PACKET_SIZE, 0, 0, NULL,
 		sr_vc96_packet_valid, sr_vc96_parse,
-		NULL
+		NULL,
+		&sr_vc96_packet_sync
 	),
 	/* }}} */
 	/*
@@ -40,13 +40,12 @@ static void log_dmm_packet(const uint8_t *buf, size_t len)
 }
 
 static void handle_packet(struct sr_dev_inst *sdi,
-	const uint8_t *buf, size_t len, void *info)
+	const uint8_t *buf, size_t len, void *info, int64_t rx_time)
 {
 	struct dmm_info *dmm;
 	struct dev_context *devc;
 	float floatval;
 	double doubleval;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -76,7 +75,7 @@ static void handle_packet(struct sr_dev_inst *sdi,
 			analog.data = &floatval;
 			analog.encoding->unitsize = sizeof(floatval);
 		} else if (dmm->packet_parse_len) {
-			dmm->packet_parse_len(dmm->dmm_state, buf, len,
+			dmm->packet_parse_len(devc->dmm_state, buf, len,
 				&doubleval, &analog, info);
 			analog.data = &doubleval;
 			analog.encoding->unitsize = sizeof(doubleval);
@@ -88,11 +87,10 @@ static void handle_packet(struct sr_dev_inst *sdi,
 
 		if (analog.meaning->mq != 0 && channel->enabled) {
 			/* Got a measurement. */
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			sr_session_send(sdi, &packet);
+			sr_analog_batch_add(&devc->batch, sdi, &analog, rx_time);
 			sent_sample = TRUE;
 		}
+		g_slist_free(analog.meaning->channels);
 	}
 
 	if (sent_sample) {
@@ -163,6 +161,7 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 		return;
 	}
 	devc->buflen += ret;
+	sr_analog_batch_rx_chunk(&devc->batch, ret);
 
 	/*
 	 * Process packets when their reception has completed, or keep
@@ -170,6 +169,11 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	 */
 	check_pos = 0;
 	while (check_pos < devc->buflen) {
+		/* Skip data which cannot start a packet. */
+		if (dmm->packet_sync)
+			check_pos += sr_packet_sync_find(dmm->packet_sync,
+				&devc->buf[check_pos], devc->buflen - check_pos);
+
 		/* Got the (minimum) amount of receive data for a packet? */
 		check_len = devc->buflen - check_pos;
 		if (check_len < dmm->packet_size)
@@ -179,7 +183,7 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 		/* Is it a valid packet? */
 		check_ptr = &devc->buf[check_pos];
 		if (dmm->packet_valid_len) {
-			ret = dmm->packet_valid_len(dmm->dmm_state,
+			ret = dmm->packet_valid_len(devc->dmm_state,
 				check_ptr, check_len, &pkt_size);
 			if (ret == SR_PACKET_NEED_RX) {
 				sr_dbg("Need more RX data.");
@@ -201,7 +205,8 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 
 		/* Process the package. */
 		sr_dbg("Valid packet, size %zu, processing", pkt_size);
-		handle_packet(sdi, check_ptr, pkt_size, info);
+		handle_packet(sdi, check_ptr, pkt_size, info,
+			sr_analog_batch_rx_time(&devc->batch, check_pos));
 		check_pos += pkt_size;
 
 		/* Arrange for the next packet request if needed. */
@@ -222,6 +227,7 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 		memmove(&devc->buf[0], &devc->buf[check_pos], copy_len);
 	}
 	devc->buflen -= check_pos;
+	sr_analog_batch_rx_consume(&devc->batch, check_pos);
 
 	/*
 	 * If the complete buffer filled up and none of it got processed,
@@ -230,6 +236,7 @@ static void handle_new_data(struct sr_dev_inst *sdi, void *info)
 	 */
 	if (devc->buflen == sizeof(devc->buf)) {
 		sr_info("Drop unprocessed RX data, try to re-sync to stream.");
+		sr_analog_batch_rx_consume(&devc->batch, devc->buflen);
 		devc->buflen = 0;
 	}
 }
@@ -261,6 +268,7 @@ int receive_data(int fd, int revents, void *cb_data)
 		if (dmm->packet_request && (req_packet(sdi) < 0))
 			return FALSE;
 	}
+	sr_analog_batch_check(&devc->batch, sdi);
 
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
@@ -61,7 +61,6 @@ struct dmm_info {
 	/** Size of chipset info struct. */
 	gsize info_size;
 	/* Serial-dmm items "with state" and variable length packets. */
-	void *dmm_state;
 	void *(*dmm_state_init)(void);
 	void (*dmm_state_free)(void *state);
 	int (*after_open)(struct sr_serial_dev_inst *serial);
@@ -78,12 +77,17 @@ struct dmm_info {
 	/** Hook at acquisition start. Can re-route the receive routine. */
 	int (*acquire_start)(void *state, const struct sr_dev_inst *sdi,
 		sr_receive_data_callback *cb, void **cb_data);
+	/** (Optional) Signature to re-sync to the packet stream. */
+	const struct sr_packet_sync *packet_sync;
 };
 
 #define DMM_BUFSIZE 256
 
 struct dev_context {
 	struct sr_sw_limits limits;
+	struct sr_analog_batch batch;
+	/** Chipset specific state of this device, see dmm_state_init(). */
+	void *dmm_state;
 
 	uint8_t buf[DMM_BUFSIZE];
 	size_t buflen;
@@ -40,6 +40,7 @@ static const uint32_t devopts[] = {
 	SR_CONF_CONTINUOUS,
 	SR_CONF_LIMIT_FRAMES | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_LIMIT_MSEC | SR_CONF_SET,
+	SR_CONF_BATCH_INTERVAL | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_OUTPUT_FREQUENCY | SR_CONF_GET | SR_CONF_LIST,
 	SR_CONF_EQUIV_CIRCUIT_MODEL | SR_CONF_GET | SR_CONF_LIST,
 };
@@ -85,17 +86,15 @@ static gboolean scan_packet_check_func(const uint8_t *buf)
 	return TRUE;
 }
 
-static int scan_lcr_port(const struct lcr_info *lcr,
-	const char *conn, struct sr_serial_dev_inst *serial)
+static int probe_port(struct sr_serial_dev_inst *serial, void *cb_data)
 {
+	const struct lcr_info *lcr;
 	size_t len;
 	uint8_t buf[128];
 	int ret;
 	size_t dropped;
 
-	if (serial_open(serial, SERIAL_RDWR) != SR_OK)
-		return SR_ERR_IO;
-	sr_info("Probing serial port %s.", conn);
+	lcr = cb_data;
 
 	/*
 	 * See if we can detect a device of specified type.
@@ -109,14 +108,14 @@ static int scan_lcr_port(const struct lcr_info *lcr,
 		ret = lcr->packet_request(serial);
 		if (ret < 0) {
 			sr_err("Failed to request packet: %d.", ret);
-			goto scan_port_cleanup;
+			return ret;
 		}
 	}
 	len = sizeof(buf);
 	ret = serial_stream_detect(serial, buf, &len,
 		lcr->packet_size, lcr->packet_valid, NULL, NULL, 3000);
 	if (ret != SR_OK)
-		goto scan_port_cleanup;
+		return ret;
 
 	/*
 	 * If the packets were found to match after more than two packets
@@ -128,15 +127,10 @@ static int scan_lcr_port(const struct lcr_info *lcr,
 	if (dropped > 2 * lcr->packet_size)
 		sr_warn("Had to drop unexpected amounts of data.");
 
-	/* Create a device instance for the found device. */
-	sr_info("Found %s %s device on port %s.", lcr->vendor, lcr->model, conn);
-
-scan_port_cleanup:
-	/* Keep serial port open if probe succeeded. */
-	if (ret != SR_OK)
-		serial_close(serial);
+	sr_info("Found %s %s device on port %s.", lcr->vendor, lcr->model,
+		serial->port);
 
-	return ret;
+	return SR_OK;
 }
 
 static struct sr_dev_inst *create_lcr_sdi(struct lcr_info *lcr,
@@ -159,6 +153,7 @@ static struct sr_dev_inst *create_lcr_sdi(struct lcr_info *lcr,
 	sdi->priv = devc;
 	devc->lcr_info = lcr;
 	sr_sw_limits_init(&devc->limits);
+	sr_analog_batch_init(&devc->batch);
 	ch_fmts = lcr->channel_formats;
 	for (ch_idx = 0; ch_idx < lcr->channel_count; ch_idx++) {
 		fmt = (ch_fmts && ch_fmts[ch_idx]) ? ch_fmts[ch_idx] : "P%zu";
@@ -208,10 +203,9 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 {
 	struct lcr_info *lcr;
 	struct sr_config *src;
-	GSList *l, *devices;
+	GSList *l, *ports, *devices;
 	const char *conn, *serialcomm;
 	struct sr_serial_dev_inst *serial;
-	int ret;
 	struct sr_dev_inst *sdi;
 
 	lcr = (struct lcr_info *)di;
@@ -233,22 +227,23 @@ static GSList *scan(struct sr_dev_driver *di, GSList *options)
 	if (!conn)
 		return NULL;
 
+	/*
+	 * Probe all given ports. Then set up the devices in the scan's
+	 * thread, the parameter retrieval's packet checker is not safe
+	 * to run concurrently.
+	 */
+	ports = serial_scan_ports(conn, serialcomm, probe_port, lcr);
 	devices = NULL;
-	/* TODO Handle ambiguous conn= specs, see serial-dmm. */
-
-	/* Open the serial port, check data packets. */
-	serial = sr_serial_dev_inst_new(conn, serialcomm);
-	ret = scan_lcr_port(lcr, conn, serial);
-	if (ret != SR_OK) {
-		/* Probe failed, release 'serial'. */
-		sr_serial_dev_inst_free(serial);
-	} else {
-		/* Create and return device instance, keep 'serial' alive. */
+	for (l = ports; l; l = l->next) {
+		serial = l->data;
 		sdi = create_lcr_sdi(lcr, serial);
 		devices = g_slist_append(devices, sdi);
+		if (serial_open(serial, SERIAL_RDWR) != SR_OK)
+			continue;
 		(void)read_lcr_port(sdi, lcr, serial);
 		serial_close(serial);
 	}
+	g_slist_free(ports);
 
 	return std_scan_complete(di, devices);
 }
@@ -267,6 +262,8 @@ static int config_get(uint32_t key, GVariant **data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_get(&devc->limits, key, data);
+	case SR_CONF_BATCH_INTERVAL:
+		return sr_analog_batch_config_get(&devc->batch, key, data);
 	case SR_CONF_OUTPUT_FREQUENCY:
 		*data = g_variant_new_double(devc->output_freq);
 		return SR_OK;
@@ -300,6 +297,8 @@ static int config_set(uint32_t key, GVariant *data,
 	case SR_CONF_LIMIT_FRAMES:
 	case SR_CONF_LIMIT_MSEC:
 		return sr_sw_limits_config_set(&devc->limits, key, data);
+	case SR_CONF_BATCH_INTERVAL:
+		return sr_analog_batch_config_set(&devc->batch, key, data);
 	default:
 		lcr = devc->lcr_info;
 		if (!lcr)
@@ -365,6 +364,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+static int dev_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+
+	devc = sdi->priv;
+	sr_analog_batch_flush(&devc->batch, sdi);
+
+	return std_serial_dev_acquisition_stop(sdi);
+}
+
 #define LCR_ES51919(id, vendor, model) \
 	&((struct lcr_info) { \
 		{ \
@@ -382,7 +391,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		vendor, model, ES51919_CHANNEL_COUNT, NULL, \
@@ -390,6 +399,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		0, NULL, \
 		es51919_packet_valid, es51919_packet_parse, \
 		NULL, NULL, es51919_config_list, \
+		&es51919_packet_sync, \
 	}).di
 
 SR_REGISTER_DEV_DRIVER_LIST(lcr_es51919_drivers,
@@ -416,7 +426,7 @@ SR_REGISTER_DEV_DRIVER_LIST(lcr_es51919_drivers,
 			.dev_open = std_serial_dev_open, \
 			.dev_close = std_serial_dev_close, \
 			.dev_acquisition_start = dev_acquisition_start, \
-			.dev_acquisition_stop = std_serial_dev_acquisition_stop, \
+			.dev_acquisition_stop = dev_acquisition_stop, \
 			.context = NULL, \
 		}, \
 		vendor, model, \
@@ -425,6 +435,7 @@ SR_REGISTER_DEV_DRIVER_LIST(lcr_es51919_drivers,
 		500, vc4080_packet_request, \
 		vc4080_packet_valid, vc4080_packet_parse, \
 		NULL, NULL, vc4080_config_list, \
+		&vc4080_packet_sync, \
 	}).di
 
 SR_REGISTER_DEV_DRIVER_LIST(lcr_vc4080_drivers,
@@ -35,25 +35,33 @@ static void send_frame_start(struct sr_dev_inst *sdi)
 	devc = sdi->priv;
 	info = &devc->parse_info;
 
-	/* Communicate changes of frequency or model before data values. */
+	/*
+	 * Communicate changes of frequency or model before data values.
+	 * Send batched values first, which were taken with the previous
+	 * parameters.
+	 */
 	freq = info->output_freq;
 	if (freq != devc->output_freq) {
+		sr_analog_batch_flush(&devc->batch, sdi);
 		devc->output_freq = freq;
 		sr_session_send_meta(sdi, SR_CONF_OUTPUT_FREQUENCY,
 			g_variant_new_double(freq));
 	}
 	model = info->circuit_model;
 	if (model && model != devc->circuit_model) {
+		sr_analog_batch_flush(&devc->batch, sdi);
 		devc->circuit_model = model;
 		sr_session_send_meta(sdi, SR_CONF_EQUIV_CIRCUIT_MODEL,
 			g_variant_new_string(model));
 	}
 
-	/* Data is about to get sent. Start a new frame. */
-	std_session_send_df_frame_begin(sdi);
+	/* Data is about to get sent. Start a new frame when not batching. */
+	if (!devc->batch.cfg_interval_ms)
+		std_session_send_df_frame_begin(sdi);
 }
 
-static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
+static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt,
+	int64_t rx_time)
 {
 	struct dev_context *devc;
 	struct lcr_parse_info *info;
@@ -61,7 +69,6 @@ static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
 	size_t ch_idx;
 	int rc;
 	float value;
-	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
@@ -89,14 +96,13 @@ static int handle_packet(struct sr_dev_inst *sdi, const uint8_t *pkt)
 				send_frame_start(sdi);
 				frame = TRUE;
 			}
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			sr_session_send(sdi, &packet);
+			sr_analog_batch_add(&devc->batch, sdi, &analog, rx_time);
 		}
 		g_slist_free(analog.meaning->channels);
 	}
 	if (frame) {
-		std_session_send_df_frame_end(sdi);
+		if (!devc->batch.cfg_interval_ms)
+			std_session_send_df_frame_end(sdi);
 		sr_sw_limits_update_frames_read(&devc->limits, 1);
 	}
 
@@ -110,7 +116,7 @@ static int handle_new_data(struct sr_dev_inst *sdi)
 	ssize_t rdsize;
 	const struct lcr_info *lcr;
 	uint8_t *pkt;
-	size_t copy_len;
+	size_t check_pos, copy_len;
 
 	devc = sdi->priv;
 	serial = sdi->conn;
@@ -121,26 +127,36 @@ static int handle_new_data(struct sr_dev_inst *sdi)
 	if (rdsize < 0)
 		return SR_ERR_IO;
 	devc->buf_rxpos += rdsize;
+	sr_analog_batch_rx_chunk(&devc->batch, rdsize);
 
 	/*
 	 * Process as many packets as the buffer might contain. Assume
 	 * that the stream is synchronized in the typical case. Re-sync
-	 * in case of mismatch (skip individual bytes until data matches
-	 * the expected packet layout again).
+	 * in case of mismatch (skip data until it matches the expected
+	 * packet layout again). Move remaining data to the start of the
+	 * buffer when done.
 	 */
 	lcr = devc->lcr_info;
-	while (devc->buf_rxpos >= lcr->packet_size) {
-		pkt = &devc->buf[0];
+	check_pos = 0;
+	while (devc->buf_rxpos - check_pos >= lcr->packet_size) {
+		check_pos += sr_packet_sync_find(lcr->packet_sync,
+			&devc->buf[check_pos], devc->buf_rxpos - check_pos);
+		if (devc->buf_rxpos - check_pos < lcr->packet_size)
+			break;
+		pkt = &devc->buf[check_pos];
 		if (!lcr->packet_valid(pkt)) {
-			copy_len = devc->buf_rxpos - 1;
-			memmove(&devc->buf[0], &devc->buf[1], copy_len);
-			devc->buf_rxpos--;
+			check_pos++;
 			continue;
 		}
-		(void)handle_packet(sdi, pkt);
-		copy_len = devc->buf_rxpos - lcr->packet_size;
-		memmove(&devc->buf[0], &devc->buf[lcr->packet_size], copy_len);
-		devc->buf_rxpos -= lcr->packet_size;
+		(void)handle_packet(sdi, pkt,
+			sr_analog_batch_rx_time(&devc->batch, check_pos));
+		check_pos += lcr->packet_size;
+	}
+	if (check_pos) {
+		copy_len = devc->buf_rxpos - check_pos;
+		memmove(&devc->buf[0], &devc->buf[check_pos], copy_len);
+		devc->buf_rxpos -= check_pos;
+		sr_analog_batch_rx_consume(&devc->batch, check_pos);
 	}
 
 	return SR_OK;
@@ -194,6 +210,7 @@ SR_PRIV int lcr_receive_data(int fd, int revents, void *cb_data)
 		ret = handle_new_data(sdi);
 	else
 		ret = handle_timeout(sdi);
+	sr_analog_batch_check(&devc->batch, sdi);
 	if (sr_sw_limits_check(&devc->limits))
 		sr_dev_acquisition_stop(sdi);
 	if (ret != SR_OK)
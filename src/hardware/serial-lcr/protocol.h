@@ -50,6 +50,7 @@ struct lcr_info {
 	int (*config_list)(uint32_t key, GVariant **data,
 		const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg);
+	const struct sr_packet_sync *packet_sync;
 };
 
 #define LCR_BUFSIZE	128
@@ -57,6 +58,7 @@ struct lcr_info {
 struct dev_context {
 	const struct lcr_info *lcr_info;
 	struct sr_sw_limits limits;
+	struct sr_analog_batch batch;
 	uint8_t buf[LCR_BUFSIZE];
 	size_t buf_rxpos, buf_rdpos;
 	struct lcr_parse_info parse_info;
@@ -211,6 +211,14 @@ static struct sr_key_info sr_key_info_config[] = {
 		"Power Target", NULL},
 	{SR_CONF_RESISTANCE_TARGET, SR_T_FLOAT, "resistance_target",
 		"Resistance Target", NULL},
+	{SR_CONF_USB_TRANSFER_SIZE, SR_T_UINT64, "usb_transfer_size",
+		"USB transfer size", NULL},
+	{SR_CONF_USB_TRANSFER_COUNT, SR_T_UINT64, "usb_transfer_count",
+		"USB transfer count", NULL},
+	{SR_CONF_BATCH_INTERVAL, SR_T_UINT64, "batch_interval",
+		"Batch interval", NULL},
+	{SR_CONF_SAMPLE_TIMESTAMPS, SR_T_UINT64_ARRAY, "sample_timestamps",
+		"Sample timestamps", NULL},
 
 	/* Special stuff */
 	{SR_CONF_SESSIONFILE, SR_T_STRING, "sessionfile",
@@ -345,6 +353,8 @@ SR_PRIV const GVariantType *sr_variant_type_get(int datatype)
 		return G_VARIANT_TYPE_DICTIONARY;
 	case SR_T_MQ:
 		return G_VARIANT_TYPE_TUPLE;
+	case SR_T_UINT64_ARRAY:
+		return G_VARIANT_TYPE("at");
 	default:
 		return NULL;
 	}
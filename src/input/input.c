@@ -72,6 +72,7 @@ extern SR_PRIV struct sr_input_module input_wav;
 extern SR_PRIV struct sr_input_module input_raw_analog;
 extern SR_PRIV struct sr_input_module input_logicport;
 extern SR_PRIV struct sr_input_module input_saleae;
+extern SR_PRIV struct sr_input_module input_transitions;
 extern SR_PRIV struct sr_input_module input_null;
 /** @endcond */
 
@@ -85,6 +86,7 @@ static const struct sr_input_module *input_module_list[] = {
 	&input_raw_analog,
 	&input_logicport,
 	&input_saleae,
+	&input_transitions,
 	&input_null,
 	NULL,
 };
@@ -0,0 +1,395 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Reader for the compact binary transition list of logic captures.
+ * See src/output/transitions.c for a description of the file layout.
+ *
+ * The input is processed in a streaming manner. Records get decoded
+ * as they arrive, runs of unchanged samples are expanded into a large
+ * conversion buffer by means of block copies. The block index at the
+ * end of the file is not needed for sequential import, and is skipped.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "input/transitions"
+
+#define FILE_MAGIC		"SRTRANS"
+#define MAGIC_SIZE		8
+#define FILE_VERSION		1
+#define FIXED_HDR_SIZE		(MAGIC_SIZE + 4 * sizeof(uint16_t) + sizeof(uint64_t))
+#define CHUNK_SIZE		(4 * 1024 * 1024)
+
+enum parse_state {
+	PARSE_HEADER,
+	PARSE_RECORDS,
+	PARSE_DONE,
+};
+
+struct context {
+	gboolean create_channels;
+	gboolean started;
+	enum parse_state state;
+	uint64_t samplerate;
+	size_t unitsize;
+	size_t num_channels;
+	uint8_t *value;
+	uint64_t samplenum;
+	uint8_t *conv_buf;
+	size_t conv_size;
+	size_t conv_fill;
+};
+
+static int format_match(GHashTable *metadata, unsigned int *confidence)
+{
+	GString *buf;
+
+	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
+	if (!buf || buf->len < FIXED_HDR_SIZE)
+		return SR_ERR;
+	if (memcmp(buf->str, FILE_MAGIC, MAGIC_SIZE) != 0)
+		return SR_ERR;
+	if (read_u16le((const uint8_t *)buf->str + MAGIC_SIZE) != FILE_VERSION)
+		return SR_ERR_DATA;
+
+	*confidence = 1;
+
+	return SR_OK;
+}
+
+static int init(struct sr_input *in, GHashTable *options)
+{
+	struct context *inc;
+
+	(void)options;
+
+	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
+	in->priv = inc = g_malloc0(sizeof(struct context));
+	inc->create_channels = TRUE;
+
+	return SR_OK;
+}
+
+/*
+ * Parse the file header. Returns the number of bytes consumed, zero
+ * when more input data is needed, or a negative error code.
+ */
+static int parse_header(struct sr_input *in)
+{
+	struct context *inc;
+	const uint8_t *rdptr, *endptr, *p;
+	size_t unitsize, count, idx, len;
+	char name[UINT8_MAX + 1];
+
+	inc = in->priv;
+	if (in->buf->len < FIXED_HDR_SIZE)
+		return 0;
+
+	rdptr = (const uint8_t *)in->buf->str;
+	endptr = rdptr + in->buf->len;
+	if (memcmp(rdptr, FILE_MAGIC, MAGIC_SIZE) != 0) {
+		sr_err("Missing file magic, not a transition list.");
+		return SR_ERR_DATA;
+	}
+	rdptr += MAGIC_SIZE;
+	if (read_u16le_inc(&rdptr) != FILE_VERSION) {
+		sr_err("Unsupported file format version.");
+		return SR_ERR_DATA;
+	}
+	unitsize = read_u16le_inc(&rdptr);
+	count = read_u16le_inc(&rdptr);
+	(void)read_u16le_inc(&rdptr);
+	inc->samplerate = read_u64le_inc(&rdptr);
+	if (!unitsize || !count || count > 8 * unitsize) {
+		sr_err("Invalid unit size %zu for %zu channels.", unitsize, count);
+		return SR_ERR_DATA;
+	}
+
+	/* Check for completeness before creating any channels. */
+	p = rdptr;
+	for (idx = 0; idx < count; idx++) {
+		if (p >= endptr)
+			return 0;
+		p += 1 + *p;
+	}
+	if (p + unitsize > endptr)
+		return 0;
+
+	for (idx = 0; idx < count; idx++) {
+		len = read_u8_inc(&rdptr);
+		memcpy(name, rdptr, len);
+		name[len] = '\0';
+		rdptr += len;
+		if (inc->create_channels)
+			sr_channel_new(in->sdi, idx, SR_CHANNEL_LOGIC, TRUE, name);
+	}
+	inc->create_channels = FALSE;
+
+	inc->unitsize = unitsize;
+	inc->num_channels = count;
+	g_free(inc->value);
+	inc->value = g_malloc(unitsize);
+	memcpy(inc->value, rdptr, unitsize);
+	rdptr += unitsize;
+
+	return rdptr - (const uint8_t *)in->buf->str;
+}
+
+static int flush_samples(struct sr_input *in)
+{
+	struct context *inc;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	int ret;
+
+	inc = in->priv;
+	if (!inc->conv_fill)
+		return SR_OK;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = inc->unitsize;
+	logic.length = inc->conv_fill;
+	logic.data = inc->conv_buf;
+	ret = sr_session_send(in->sdi, &packet);
+	inc->conv_fill = 0;
+
+	return ret;
+}
+
+/*
+ * Append a run of identical samples to the conversion buffer. Store
+ * the value once, then double the filled area with block copies.
+ */
+static int add_samples(struct sr_input *in, uint64_t count)
+{
+	struct context *inc;
+	uint8_t *start;
+	size_t chunk, total, filled, len;
+	int ret;
+
+	inc = in->priv;
+	while (count) {
+		chunk = (inc->conv_size - inc->conv_fill) / inc->unitsize;
+		if (!chunk) {
+			ret = flush_samples(in);
+			if (ret != SR_OK)
+				return ret;
+			continue;
+		}
+		chunk = MIN(chunk, count);
+		start = &inc->conv_buf[inc->conv_fill];
+		total = chunk * inc->unitsize;
+		memcpy(start, inc->value, inc->unitsize);
+		filled = inc->unitsize;
+		while (filled < total) {
+			len = MIN(filled, total - filled);
+			memcpy(&start[filled], start, len);
+			filled += len;
+		}
+		inc->conv_fill += total;
+		count -= chunk;
+	}
+
+	return SR_OK;
+}
+
+static int process_records(struct sr_input *in)
+{
+	struct context *inc;
+	const uint8_t *rdptr, *endptr;
+	uint64_t delta, total;
+	size_t len, tlen, b;
+	int ret;
+
+	inc = in->priv;
+	rdptr = (const uint8_t *)in->buf->str;
+	endptr = rdptr + in->buf->len;
+	ret = SR_OK;
+
+	while (inc->state == PARSE_RECORDS && rdptr < endptr) {
+		len = read_u64_varint(rdptr, endptr - rdptr, &delta);
+		if (!len) {
+			if (endptr - rdptr >= VARINT_U64_MAXLEN)
+				ret = SR_ERR_DATA;
+			break;
+		}
+		if (!delta) {
+			/* End of records, total sample count follows. */
+			tlen = read_u64_varint(rdptr + len,
+				endptr - rdptr - len, &total);
+			if (!tlen)
+				break;
+			rdptr += len + tlen;
+			if (total < inc->samplenum) {
+				ret = SR_ERR_DATA;
+				break;
+			}
+			ret = add_samples(in, total - inc->samplenum);
+			inc->samplenum = total;
+			inc->state = PARSE_DONE;
+			break;
+		}
+		if (rdptr + len + inc->unitsize > endptr)
+			break;
+		rdptr += len;
+		ret = add_samples(in, delta);
+		if (ret != SR_OK)
+			break;
+		inc->samplenum += delta;
+		for (b = 0; b < inc->unitsize; b++)
+			inc->value[b] ^= *rdptr++;
+	}
+	if (ret == SR_ERR_DATA)
+		sr_err("Malformed record at sample %" PRIu64 ".", inc->samplenum);
+	g_string_erase(in->buf, 0, rdptr - (const uint8_t *)in->buf->str);
+
+	if (inc->state == PARSE_DONE) {
+		/* The block index and footer are of no interest here. */
+		g_string_truncate(in->buf, 0);
+	}
+
+	return ret;
+}
+
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	struct context *inc;
+	int ret;
+
+	inc = in->priv;
+	if (!inc->started) {
+		std_session_send_df_header(in->sdi);
+		if (inc->samplerate) {
+			(void)sr_session_send_meta(in->sdi, SR_CONF_SAMPLERATE,
+				g_variant_new_uint64(inc->samplerate));
+		}
+		inc->conv_size = CHUNK_SIZE / inc->unitsize * inc->unitsize;
+		inc->conv_buf = g_malloc(inc->conv_size);
+		inc->conv_fill = 0;
+		inc->started = TRUE;
+	}
+
+	ret = process_records(in);
+	if (ret != SR_OK)
+		return ret;
+
+	if (is_eof && inc->state != PARSE_DONE) {
+		/* Keep at least the sample of the last seen change. */
+		sr_warn("Truncated input, end of records not seen.");
+		inc->state = PARSE_DONE;
+		ret = add_samples(in, 1);
+		if (ret != SR_OK)
+			return ret;
+	}
+
+	/* Only send partially filled buffers at the end, keep packets large. */
+	if (is_eof || inc->state == PARSE_DONE)
+		return flush_samples(in);
+
+	return SR_OK;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
+	struct context *inc;
+	int ret;
+
+	g_string_append_len(in->buf, buf->str, buf->len);
+
+	inc = in->priv;
+	if (inc->state == PARSE_HEADER) {
+		ret = parse_header(in);
+		if (ret <= 0)
+			return ret;
+		g_string_erase(in->buf, 0, ret);
+		inc->state = PARSE_RECORDS;
+	}
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	return process_buffer(in, FALSE);
+}
+
+static int end(struct sr_input *in)
+{
+	struct context *inc;
+	int ret;
+
+	if (in->sdi_ready)
+		ret = process_buffer(in, TRUE);
+	else
+		ret = SR_OK;
+
+	inc = in->priv;
+	if (inc->started)
+		std_session_send_df_end(in->sdi);
+
+	return ret;
+}
+
+static void cleanup(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	g_free(inc->value);
+	inc->value = NULL;
+	g_free(inc->conv_buf);
+	inc->conv_buf = NULL;
+}
+
+static int reset(struct sr_input *in)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	cleanup(in);
+	inc->started = FALSE;
+	inc->state = PARSE_HEADER;
+	inc->samplenum = 0;
+	inc->conv_fill = 0;
+	g_string_truncate(in->buf, 0);
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_input_module input_transitions = {
+	.id = "transitions",
+	.name = "Transitions",
+	.desc = "Compact binary list of logic transitions",
+	.exts = (const char*[]){"srtr", NULL},
+	.metadata = { SR_INPUT_META_HEADER | SR_INPUT_META_REQUIRED },
+	.format_match = format_match,
+	.init = init,
+	.receive = receive,
+	.end = end,
+	.cleanup = cleanup,
+	.reset = reset,
+};
@@ -43,6 +43,20 @@
 #define WAVE_FORMAT_IEEE_FLOAT_  0x0003
 #define WAVE_FORMAT_EXTENSIBLE_  0xfffe
 
+/*
+ * Size of an optional "JUNK" or RF64 "ds64" chunk right after the RIFF
+ * header. Writers use the former to reserve room for the latter.
+ */
+static size_t leading_junk_size(const GString *buf)
+{
+	if (buf->len < 20)
+		return 0;
+	if (memcmp(buf->str + 12, "JUNK", 4) && memcmp(buf->str + 12, "ds64", 4))
+		return 0;
+
+	return 8 + ((RL32(buf->str + 16) + 1) & ~1U);
+}
+
 struct context {
 	gboolean started;
 	int fmt_code;
@@ -58,20 +72,25 @@ static int parse_wav_header(GString *buf, struct context *inc)
 {
 	uint64_t samplerate;
 	unsigned int fmt_code, samplesize, num_channels, unitsize;
+	size_t skip;
+	const char *hdr;
 
-	if (buf->len < MIN_DATA_CHUNK_OFFSET)
+	skip = leading_junk_size(buf);
+	if (buf->len < MIN_DATA_CHUNK_OFFSET + skip)
 		return SR_ERR_NA;
+	/* Offsets below are relative to a "fmt " chunk at offset 12. */
+	hdr = buf->str + skip;
 
-	fmt_code = RL16(buf->str + 20);
-	samplerate = RL32(buf->str + 24);
+	fmt_code = RL16(hdr + 20);
+	samplerate = RL32(hdr + 24);
 
-	samplesize = RL16(buf->str + 32);
-	num_channels = RL16(buf->str + 22);
+	samplesize = RL16(hdr + 32);
+	num_channels = RL16(hdr + 22);
 	if (num_channels == 0)
 		return SR_ERR;
 	unitsize = samplesize / num_channels;
-	if (unitsize != 1 && unitsize != 2 && unitsize != 4) {
-		sr_err("Only 8, 16 or 32 bits per sample supported.");
+	if (unitsize != 1 && unitsize != 2 && unitsize != 3 && unitsize != 4) {
+		sr_err("Only 8, 16, 24 or 32 bits per sample supported.");
 		return SR_ERR_DATA;
 	}
 
@@ -82,24 +101,24 @@ static int parse_wav_header(GString *buf, struct context *inc)
 			return SR_ERR_DATA;
 		}
 	} else if (fmt_code == WAVE_FORMAT_EXTENSIBLE_) {
-		if (buf->len < 70)
+		if (buf->len < 70 + skip)
 			/* Not enough for extensible header and next chunk. */
 			return SR_ERR_NA;
 
-		if (RL16(buf->str + 16) != 40) {
+		if (RL16(hdr + 16) != 40) {
 			sr_err("WAV extensible format chunk must be 40 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 36) != 22) {
+		if (RL16(hdr + 36) != 22) {
 			sr_err("WAV extension must be 22 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 34) != RL16(buf->str + 38)) {
+		if (RL16(hdr + 34) != RL16(hdr + 38)) {
 			sr_err("Reduced valid bits per sample not supported.");
 			return SR_ERR_DATA;
 		}
 		/* Real format code is the first two bytes of the GUID. */
-		fmt_code = RL16(buf->str + 44);
+		fmt_code = RL16(hdr + 44);
 		if (fmt_code != WAVE_FORMAT_PCM_ && fmt_code != WAVE_FORMAT_IEEE_FLOAT_) {
 			sr_err("Only PCM and floating point samples are supported.");
 			return SR_ERR_DATA;
@@ -131,11 +150,11 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	int ret;
 
 	buf = g_hash_table_lookup(metadata, GINT_TO_POINTER(SR_INPUT_META_HEADER));
-	if (strncmp(buf->str, "RIFF", 4))
+	if (strncmp(buf->str, "RIFF", 4) && strncmp(buf->str, "RF64", 4))
 		return SR_ERR;
 	if (strncmp(buf->str + 8, "WAVE", 4))
 		return SR_ERR;
-	if (strncmp(buf->str + 12, "fmt ", 4))
+	if (strncmp(buf->str + 12 + leading_junk_size(buf), "fmt ", 4))
 		return SR_ERR;
 	/*
 	 * Only gets called when we already know this is a WAV file, so
@@ -218,6 +237,10 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 			case 2:
 				fdata[samplenum] = RL16S(s) / (float)INT16_MAX;
 				break;
+			case 3:
+				fdata[samplenum] = ((int32_t)(read_u24le((const uint8_t *)s) << 8) >> 8)
+					/ (float)0x7fffff;
+				break;
 			case 4:
 				fdata[samplenum] = RL32S(s) / (float)INT32_MAX;
 				break;
@@ -266,7 +289,8 @@ static int process_buffer(struct sr_input *in)
 
 	if (!inc->found_data) {
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
+		i = leading_junk_size(in->buf);
+		i += 20 + RL32(in->buf->str + i + 16);
 		offset = find_data_chunk(in->buf, i);
 		if (offset < 0) {
 			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
@@ -309,6 +309,9 @@ static const char *parse_model(const uint8_t *pkt)
 	return get_equiv_model(code);
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync es51919_packet_sync = { 16, 0xff, 0x0a };
+
 SR_PRIV gboolean es51919_packet_valid(const uint8_t *pkt)
 {
 
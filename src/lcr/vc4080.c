@@ -641,6 +641,9 @@ SR_PRIV int vc4080_packet_request(struct sr_serial_dev_inst *serial)
 	return SR_OK;
 }
 
+/* Packets end in CR/LF. */
+SR_PRIV const struct sr_packet_sync vc4080_packet_sync = { 38, 0xff, '\n' };
+
 SR_PRIV gboolean vc4080_packet_valid(const uint8_t *pkt)
 {
 	/* Workaround for funny serial cables. */
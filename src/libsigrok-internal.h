@@ -447,6 +447,19 @@ static inline void write_u16le(uint8_t *p, uint16_t x)
 }
 #define WL16(p, x) write_u16le((uint8_t *)(p), (uint16_t)(x))
 
+/**
+ * Write a 24 bits unsigned integer to memory stored as little endian.
+ * @param p a pointer to the output memory
+ * @param x the input unsigned integer
+ */
+static inline void write_u24le(uint8_t *p, uint32_t x)
+{
+	p[0] = x & 0xff; x >>= 8;
+	p[1] = x & 0xff; x >>= 8;
+	p[2] = x & 0xff; x >>= 8;
+}
+#define WL24(p, x) write_u24le((uint8_t *)(p), (uint32_t)(x))
+
 /**
  * Write a 32 bits unsigned integer to memory stored as big endian.
  * @param p a pointer to the output memory
@@ -944,6 +957,56 @@ static inline void write_dblle_inc(uint8_t **p, double x)
 	*p += sizeof(x);
 }
 
+/** Maximum number of bytes which a 64bit varint can occupy. */
+#define VARINT_U64_MAXLEN	10
+
+/**
+ * Write unsigned 64bit integer in varint (LEB128) format, increment
+ * write position. Each byte carries seven bits of payload, least
+ * significant group first. The MSB flags that more bytes follow.
+ * @param[in, out] p Pointer into byte stream.
+ * @param[in] x Value to write.
+ */
+static inline void write_u64_varint_inc(uint8_t **p, uint64_t x)
+{
+	if (!p || !*p)
+		return;
+	while (x >= 0x80) {
+		*(*p)++ = (uint8_t)(x | 0x80);
+		x >>= 7;
+	}
+	*(*p)++ = (uint8_t)x;
+}
+
+/**
+ * Read unsigned 64bit varint (LEB128) from memory of limited length.
+ * @param[in] p Pointer to the input memory.
+ * @param[in] len Number of bytes available at the input position.
+ * @param[out] x The decoded value.
+ * @return Number of bytes consumed, or 0 when the input is incomplete
+ *   (the terminating byte is not within @p len bytes) or malformed
+ *   (longer than VARINT_U64_MAXLEN bytes, or exceeding 64 bits).
+ */
+static inline size_t read_u64_varint(const uint8_t *p, size_t len, uint64_t *x)
+{
+	uint64_t v;
+	size_t i;
+
+	v = 0;
+	for (i = 0; i < len && i < VARINT_U64_MAXLEN; i++) {
+		/* The last byte only holds the most significant bit. */
+		if (i == VARINT_U64_MAXLEN - 1 && p[i] > 0x01)
+			return 0;
+		v |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+		if (!(p[i] & 0x80)) {
+			*x = v;
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
 /* Portability fixes for FreeBSD. */
 #ifdef __FreeBSD__
 #define LIBUSB_CLASS_APPLICATION 0xfe
@@ -1042,6 +1105,9 @@ struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
+	/** Handle libusb events on a dedicated thread when supported. */
+	gboolean usb_thread_wanted;
+	struct usb_event_thread *usb_thread;
 #endif
 	sr_resource_open_callback resource_open_cb;
 	sr_resource_close_callback resource_close_cb;
@@ -1312,6 +1378,19 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * This function is called after all output was written to the
+	 * file named in <code>o->filename</code>, and the file was closed.
+	 * It can be used to update the file in place, e.g. to fill in
+	 * header fields which depend on the amount of data. Can be NULL.
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*finalize) (const struct sr_output *o);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -1429,6 +1508,18 @@ struct ser_hid_chip_functions;
 struct sr_bt_desc;
 typedef void (*serial_rx_chunk_callback)(struct sr_serial_dev_inst *serial,
 	void *cb_data, const void *buf, size_t count);
+/** Receive data queue of a serial transport, a power-of-two ring buffer. */
+struct sr_ser_rx_queue {
+	uint8_t *data;
+	/** Capacity in bytes, a power of two. */
+	size_t size;
+	/** Free running read and write positions. */
+	size_t head, tail;
+	/** Number of bytes which were dropped since the queue was full. */
+	uint64_t dropped;
+	/** Number of times that data was dropped. */
+	uint64_t overflows;
+};
 struct sr_serial_dev_inst {
 	/** Port name, e.g. '/dev/tty42'. */
 	char *port;
@@ -1441,7 +1532,9 @@ struct sr_serial_dev_inst {
 		int parity_bits;
 		int stop_bits;
 	} comm_params;
-	GString *rcv_buffer;
+	struct sr_ser_rx_queue *rcv_buffer;
+	/** Bytes which serial_readline() has read past a line end. */
+	GString *rx_unread;
 	serial_rx_chunk_callback rx_chunk_cb_func;
 	void *rx_chunk_cb_data;
 #ifdef HAVE_LIBSERIALPORT
@@ -1691,6 +1784,8 @@ SR_PRIV int sr_session_send_meta(const struct sr_dev_inst *sdi,
 		uint32_t key, GVariant *var);
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_loaned(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, uint8_t *buffer);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
@@ -1706,6 +1801,28 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/** Decoded content of an analog chunk in "packed" session files. */
+struct sr_sessionfile_analog_chunk {
+	/** Sample data are float values (else raw int32_t values). */
+	gboolean is_float;
+	/** Number of samples. */
+	size_t count;
+	/** Sample data, allocated by the decoder. */
+	void *data;
+	/** Scale factor which applies to raw integer values. */
+	struct sr_rational scale;
+	/** Offset which applies to scaled integer values. */
+	struct sr_rational offset;
+};
+
+SR_PRIV void sr_sessionfile_analog_pack_float(GString *out,
+	const float *values, size_t count);
+SR_PRIV void sr_sessionfile_analog_pack_int(GString *out,
+	const int32_t *values, size_t count,
+	const struct sr_rational *scale, const struct sr_rational *offset);
+SR_PRIV int sr_sessionfile_analog_unpack(const uint8_t *buf, size_t len,
+	struct sr_sessionfile_analog_chunk *chunk);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -1833,6 +1950,10 @@ struct soft_trigger_logic {
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* Single stage conditions on up to 64 channels, word-parallel. */
+	gboolean fast;
+	uint64_t mask_zero, mask_one;
+	uint64_t mask_rising, mask_falling, mask_edge;
 };
 
 SR_PRIV int logic_channel_unitsize(GSList *channels);
@@ -1845,6 +1966,20 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf
 
 /*--- serial.c --------------------------------------------------------------*/
 
+/**
+ * Synchronization signature of a serial packet protocol. A byte at a
+ * fixed position within each packet which has some known bits, e.g. a
+ * start byte, or the LF of a CR/LF terminated packet.
+ */
+struct sr_packet_sync {
+	/** Position of the signature byte within a packet. */
+	size_t offset;
+	/** Bits of the signature byte to check, zero for "no signature". */
+	uint8_t mask;
+	/** Expected value of these bits. */
+	uint8_t value;
+};
+
 #ifdef HAVE_SERIAL_COMM
 enum {
 	SERIAL_RDWR = 1,
@@ -1854,6 +1989,8 @@ enum {
 typedef gboolean (*packet_valid_callback)(const uint8_t *buf);
 typedef int (*packet_valid_len_callback)(void *st,
 	const uint8_t *p, size_t l, size_t *pl);
+typedef int (*serial_probe_callback)(struct sr_serial_dev_inst *serial,
+	void *cb_data);
 
 typedef GSList *(*sr_ser_list_append_t)(GSList *devs, const char *name,
 		const char *desc);
@@ -1887,6 +2024,10 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 		size_t packet_size, packet_valid_callback is_valid,
 		packet_valid_len_callback is_valid_len, size_t *return_size,
 		uint64_t timeout_ms);
+SR_PRIV size_t sr_packet_sync_find(const struct sr_packet_sync *sync,
+		const uint8_t *buf, size_t len);
+SR_PRIV GSList *serial_scan_ports(const char *conn, const char *serialcomm,
+		serial_probe_callback probe, void *cb_data);
 SR_PRIV int sr_serial_extract_options(GSList *options, const char **serial_device,
 				      const char **serial_options);
 SR_PRIV int serial_source_add(struct sr_session *session,
@@ -1897,12 +2038,18 @@ SR_PRIV int serial_source_remove(struct sr_session *session,
 SR_PRIV GSList *sr_serial_find_usb(uint16_t vendor_id, uint16_t product_id);
 SR_PRIV int serial_timeout(struct sr_serial_dev_inst *port, int num_bytes);
 
+SR_PRIV void sr_ser_setup_rx_queue(struct sr_serial_dev_inst *serial,
+		size_t min_size);
 SR_PRIV void sr_ser_discard_queued_data(struct sr_serial_dev_inst *serial);
 SR_PRIV size_t sr_ser_has_queued_data(struct sr_serial_dev_inst *serial);
 SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 		const uint8_t *data, size_t len);
 SR_PRIV size_t sr_ser_unqueue_rx_data(struct sr_serial_dev_inst *serial,
 		uint8_t *data, size_t len);
+SR_PRIV size_t sr_ser_peek_rx_data(struct sr_serial_dev_inst *serial,
+		const uint8_t **data);
+SR_PRIV void sr_ser_consume_rx_data(struct sr_serial_dev_inst *serial,
+		size_t len);
 
 struct ser_lib_functions {
 	int (*open)(struct sr_serial_dev_inst *serial, int flags);
@@ -2028,6 +2175,75 @@ SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len);
 SR_PRIV gboolean usb_match_manuf_prod(libusb_device *dev,
 		const char *manufacturer, const char *product);
+
+SR_PRIV int usb_event_thread_start(struct sr_context *ctx);
+SR_PRIV void usb_event_thread_stop(struct sr_context *ctx);
+
+/** A completed USB transfer (or its data), passed between threads. */
+struct sr_usb_completion {
+	/** Transfer which needs processing by the session, or NULL. */
+	struct libusb_transfer *transfer;
+	/** Received data which was detached from its transfer, or NULL. */
+	uint8_t *buffer;
+	/** Number of valid bytes in the detached buffer. */
+	size_t length;
+};
+
+struct sr_usb_completion_queue;
+
+SR_PRIV struct sr_usb_completion_queue *usb_completion_queue_new(
+		size_t capacity);
+SR_PRIV void usb_completion_queue_free(struct sr_usb_completion_queue *queue);
+SR_PRIV gboolean usb_completion_queue_push(struct sr_usb_completion_queue *queue,
+		const struct sr_usb_completion *item);
+SR_PRIV gboolean usb_completion_queue_pop(struct sr_usb_completion_queue *queue,
+		struct sr_usb_completion *item);
+SR_PRIV int usb_completion_source_add(struct sr_session *session,
+		struct sr_usb_completion_queue *queue, int timeout,
+		sr_receive_data_callback cb, void *cb_data);
+SR_PRIV int usb_completion_source_remove(struct sr_session *session,
+		struct sr_usb_completion_queue *queue);
+#endif
+
+/*--- usb_stream.c ----------------------------------------------------------*/
+
+#ifdef HAVE_LIBUSB_1_0
+/** Number of completion interval histogram bins (<1ms, <2ms, ... >=512ms). */
+#define SR_USB_STREAM_HIST_BINS 11
+
+/** Transfer sizing state of a USB bulk streaming acquisition. */
+struct sr_usb_stream {
+	/* User configuration, 0 selects automatic sizing. */
+	uint64_t cfg_size;
+	uint64_t cfg_count;
+	/* Derived per acquisition by sr_usb_stream_setup(). */
+	size_t size;
+	size_t max_size;
+	size_t granule;
+	size_t bytes_per_ms;
+	unsigned int count;
+	unsigned int timeout;
+	gboolean adaptive;
+	/* Completion statistics. */
+	int64_t last_us;
+	int64_t interval_us;
+	uint64_t completions;
+	uint64_t resizes;
+	uint64_t stalls;
+	uint64_t histogram[SR_USB_STREAM_HIST_BINS];
+};
+
+SR_PRIV void sr_usb_stream_init(struct sr_usb_stream *stream);
+SR_PRIV int sr_usb_stream_config_get(const struct sr_usb_stream *stream,
+	uint32_t key, GVariant **data);
+SR_PRIV int sr_usb_stream_config_set(struct sr_usb_stream *stream,
+	uint32_t key, GVariant *data);
+SR_PRIV void sr_usb_stream_setup(struct sr_usb_stream *stream,
+	size_t bytes_per_ms, size_t granule, unsigned int total_ms,
+	unsigned int max_count);
+SR_PRIV void sr_usb_stream_completed(struct sr_usb_stream *stream,
+	struct libusb_transfer *transfer);
+SR_PRIV void sr_usb_stream_report(const struct sr_usb_stream *stream);
 #endif
 
 /*--- binary_helpers.c ------------------------------------------------------*/
@@ -2116,6 +2332,8 @@ SR_PRIV uint16_t sr_crc16(uint16_t crc, const uint8_t *buffer, int len);
 
 /*--- modbus/modbus.c -------------------------------------------------------*/
 
+struct sr_modbus_poll;
+
 struct sr_modbus_dev_inst {
 	const char *name;
 	const char *prefix;
@@ -2135,6 +2353,8 @@ struct sr_modbus_dev_inst {
 	void (*free)(void *priv);
 	unsigned int read_timeout_ms;
 	void *priv;
+	/* Registers which get read periodically, see sr_modbus_poll_read(). */
+	struct sr_modbus_poll *poll;
 };
 
 SR_PRIV GSList *sr_modbus_scan(struct drv_context *drvc, GSList *options,
@@ -2164,6 +2384,16 @@ SR_PRIV int sr_modbus_write_coil(struct sr_modbus_dev_inst *modbus,
 SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
                                                int address, int nb_registers,
                                                uint16_t *registers);
+SR_PRIV int sr_modbus_poll_set_max_gap(struct sr_modbus_dev_inst *modbus,
+                                       int max_gap);
+SR_PRIV int sr_modbus_poll_add(struct sr_modbus_dev_inst *modbus,
+                               int address, int nb_registers);
+SR_PRIV int sr_modbus_poll_read(struct sr_modbus_dev_inst *modbus);
+SR_PRIV int sr_modbus_poll_get(struct sr_modbus_dev_inst *modbus,
+                               int address, int nb_registers,
+                               uint16_t *registers, unsigned int max_age_ms);
+SR_PRIV void sr_modbus_poll_invalidate(struct sr_modbus_dev_inst *modbus,
+                                       int address, int nb_registers);
 SR_PRIV int sr_modbus_close(struct sr_modbus_dev_inst *modbus);
 SR_PRIV void sr_modbus_free(struct sr_modbus_dev_inst *modbus);
 
@@ -2226,6 +2456,7 @@ struct fs9922_info {
 	int bargraph_sign, bargraph_value;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_fs9922_packet_sync;
 SR_PRIV gboolean sr_fs9922_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_fs9922_parse(const uint8_t *buf, float *floatval,
 			    struct sr_datafeed_analog *analog, void *info);
@@ -2242,6 +2473,7 @@ struct fs9721_info {
 	gboolean is_c2c1_11, is_c2c1_10, is_c2c1_01, is_c2c1_00, is_sign;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_fs9721_packet_sync;
 SR_PRIV gboolean sr_fs9721_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_fs9721_parse(const uint8_t *buf, float *floatval,
 			    struct sr_datafeed_analog *analog, void *info);
@@ -2312,6 +2544,7 @@ struct dtm0660_info {
 	gboolean is_minmax, is_max, is_sign;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_dtm0660_packet_sync;
 SR_PRIV gboolean sr_dtm0660_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_dtm0660_parse(const uint8_t *buf, float *floatval,
 			struct sr_datafeed_analog *analog, void *info);
@@ -2344,6 +2577,7 @@ struct metex14_info {
 #ifdef HAVE_SERIAL_COMM
 SR_PRIV int sr_metex14_packet_request(struct sr_serial_dev_inst *serial);
 #endif
+SR_PRIV extern const struct sr_packet_sync sr_metex14_packet_sync;
 SR_PRIV gboolean sr_metex14_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_metex14_parse(const uint8_t *buf, float *floatval,
 			     struct sr_datafeed_analog *analog, void *info);
@@ -2384,7 +2618,9 @@ struct brymen_bm52x_info { size_t ch_idx; };
 SR_PRIV int sr_brymen_bm52x_packet_request(struct sr_serial_dev_inst *serial);
 SR_PRIV int sr_brymen_bm82x_packet_request(struct sr_serial_dev_inst *serial);
 #endif
+SR_PRIV extern const struct sr_packet_sync sr_brymen_bm52x_packet_sync;
 SR_PRIV gboolean sr_brymen_bm52x_packet_valid(const uint8_t *buf);
+SR_PRIV extern const struct sr_packet_sync sr_brymen_bm82x_packet_sync;
 SR_PRIV gboolean sr_brymen_bm82x_packet_valid(const uint8_t *buf);
 /* BM520s and BM820s protocols are similar, the parse routine is shared. */
 SR_PRIV int sr_brymen_bm52x_parse(const uint8_t *buf, float *floatval,
@@ -2444,6 +2680,7 @@ struct ut71x_info {
 	gboolean is_auto, is_manual, is_sign, is_power, is_loop_current;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_ut71x_packet_sync;
 SR_PRIV gboolean sr_ut71x_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_ut71x_parse(const uint8_t *buf, float *floatval,
 		struct sr_datafeed_analog *analog, void *info);
@@ -2465,6 +2702,7 @@ struct vc870_info {
 	gboolean is_frequency, is_dual_display, is_auto;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_vc870_packet_sync;
 SR_PRIV gboolean sr_vc870_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_vc870_parse(const uint8_t *buf, float *floatval,
 		struct sr_datafeed_analog *analog, void *info);
@@ -2480,6 +2718,7 @@ struct vc96_info {
 	gboolean is_unitless;
 };
 
+SR_PRIV extern const struct sr_packet_sync sr_vc96_packet_sync;
 SR_PRIV gboolean sr_vc96_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_vc96_parse(const uint8_t *buf, float *floatval,
 		struct sr_datafeed_analog *analog, void *info);
@@ -2503,6 +2742,7 @@ SR_PRIV int es51919_config_set(uint32_t key, GVariant *data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg);
 SR_PRIV int es51919_config_list(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg);
+SR_PRIV extern const struct sr_packet_sync es51919_packet_sync;
 SR_PRIV gboolean es51919_packet_valid(const uint8_t *pkt);
 SR_PRIV int es51919_packet_parse(const uint8_t *pkt, float *floatval,
 	struct sr_datafeed_analog *analog, void *info);
@@ -2530,6 +2770,7 @@ extern SR_PRIV const char *vc4080_channel_formats[VC4080_CHANNEL_COUNT];
 SR_PRIV int vc4080_config_list(uint32_t key, GVariant **data,
 	const struct sr_dev_inst *sdi, const struct sr_channel_group *cg);
 SR_PRIV int vc4080_packet_request(struct sr_serial_dev_inst *serial);
+SR_PRIV extern const struct sr_packet_sync vc4080_packet_sync;
 SR_PRIV gboolean vc4080_packet_valid(const uint8_t *pkt);
 SR_PRIV int vc4080_packet_parse(const uint8_t *pkt, float *floatval,
 	struct sr_datafeed_analog *analog, void *info);
@@ -2567,6 +2808,7 @@ struct asycii_info {
 #ifdef HAVE_SERIAL_COMM
 SR_PRIV int sr_asycii_packet_request(struct sr_serial_dev_inst *serial);
 #endif
+SR_PRIV extern const struct sr_packet_sync sr_asycii_packet_sync;
 SR_PRIV gboolean sr_asycii_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_asycii_parse(const uint8_t *buf, float *floatval,
 			    struct sr_datafeed_analog *analog, void *info);
@@ -2608,6 +2850,7 @@ struct eev121gw_info {
 };
 
 extern SR_PRIV const char *eev121gw_channel_formats[];
+SR_PRIV extern const struct sr_packet_sync sr_eev121gw_packet_sync;
 SR_PRIV gboolean sr_eev121gw_packet_valid(const uint8_t *buf);
 SR_PRIV int sr_eev121gw_3displays_parse(const uint8_t *buf, float *floatval,
 		struct sr_datafeed_analog *analog, void *info);
@@ -2648,6 +2891,85 @@ SR_PRIV void sr_sw_limits_update_frames_read(struct sr_sw_limits *limits,
 	uint64_t frames_read);
 SR_PRIV void sr_sw_limits_init(struct sr_sw_limits *limits);
 
+/*--- analog_batch.c --------------------------------------------------------*/
+
+#define ANALOG_BATCH_RX_CHUNKS	16
+
+struct sr_analog_batch {
+	/* User configuration, 0 sends every reading right away. */
+	uint64_t cfg_interval_ms;
+	/* Pending readings, one entry per channel. */
+	GPtrArray *chans;
+	/* Host time of reception of the driver's buffered RX data. */
+	struct {
+		size_t end;
+		int64_t time_us;
+	} rx_chunks[ANALOG_BATCH_RX_CHUNKS];
+	size_t rx_chunk_count;
+};
+
+SR_PRIV void sr_analog_batch_init(struct sr_analog_batch *batch);
+SR_PRIV int sr_analog_batch_config_get(const struct sr_analog_batch *batch,
+	uint32_t key, GVariant **data);
+SR_PRIV int sr_analog_batch_config_set(struct sr_analog_batch *batch,
+	uint32_t key, GVariant *data);
+SR_PRIV void sr_analog_batch_rx_chunk(struct sr_analog_batch *batch,
+	size_t len);
+SR_PRIV int64_t sr_analog_batch_rx_time(const struct sr_analog_batch *batch,
+	size_t pos);
+SR_PRIV void sr_analog_batch_rx_consume(struct sr_analog_batch *batch,
+	size_t len);
+SR_PRIV int sr_analog_batch_add(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi, const struct sr_datafeed_analog *analog,
+	int64_t timestamp_us);
+SR_PRIV int sr_analog_batch_check(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi);
+SR_PRIV int sr_analog_batch_flush(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi);
+
+/*--- task_runner.c ---------------------------------------------------------*/
+
+struct sr_task_runner;
+
+/** Task callback, gets the task index and the batch's opaque data. */
+typedef int (*sr_task_func)(size_t idx, void *cb_data);
+
+SR_PRIV struct sr_task_runner *sr_task_runner_new(unsigned int max_workers);
+SR_PRIV void sr_task_runner_free(struct sr_task_runner *runner);
+SR_PRIV unsigned int sr_task_runner_width(const struct sr_task_runner *runner);
+SR_PRIV int sr_task_runner_run(struct sr_task_runner *runner, size_t count,
+	sr_task_func func, void *cb_data);
+
+/*--- transpose.c -----------------------------------------------------------*/
+
+struct sr_bit_transpose;
+
+SR_PRIV struct sr_bit_transpose *sr_bit_transpose_new(size_t row_bits,
+	size_t row_count, const uint16_t *row_masks, gboolean msb_first);
+SR_PRIV void sr_bit_transpose_free(struct sr_bit_transpose *t);
+SR_PRIV int sr_bit_transpose_set_kernel(struct sr_bit_transpose *t,
+	const char *name);
+SR_PRIV const char *sr_bit_transpose_kernel_name(const struct sr_bit_transpose *t);
+SR_PRIV size_t sr_bit_transpose_run(const struct sr_bit_transpose *t,
+	const uint8_t *src, size_t block_count, uint16_t *dst);
+SR_PRIV size_t sr_bit_transpose_feed(struct sr_bit_transpose *t,
+	const uint8_t *src, size_t length, uint16_t *dst);
+
+/*--- buffer_pool.c ---------------------------------------------------------*/
+
+struct sr_buffer_pool;
+
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t size,
+	unsigned int count, unsigned int max_count);
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool);
+SR_PRIV uint8_t *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_PRIV void sr_buffer_pool_put(uint8_t *data);
+SR_PRIV void sr_buffer_pool_loan_begin(uint8_t *data);
+SR_PRIV void sr_buffer_pool_loan_end(void);
+SR_PRIV gboolean sr_buffer_pool_loan_retain(const void *key,
+	const void *data, size_t length);
+SR_PRIV gboolean sr_buffer_pool_loan_release(const void *key);
+
 /*--- feed_queue.h ----------------------------------------------------------*/
 
 struct feed_queue_logic;
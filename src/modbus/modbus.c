@@ -25,6 +25,30 @@
 
 #define LOG_PREFIX "modbus"
 
+/* Maximum number of registers in a read holding registers request. */
+#define MAX_READ_REGISTERS 125
+
+struct poll_range {
+	int address;
+	int count;
+};
+
+struct poll_block {
+	int address;
+	int count;
+	uint16_t *registers;
+	gint64 *timestamps;
+};
+
+struct sr_modbus_poll {
+	/* Register ranges as declared by the driver. */
+	GArray *ranges;
+	/* Coalesced requests, NULL when ranges were added since. */
+	GArray *blocks;
+	/* Largest gap of undeclared registers which gets read along. */
+	int max_gap;
+};
+
 SR_PRIV extern const struct sr_modbus_dev_inst modbus_serial_rtu_dev;
 
 static const struct sr_modbus_dev_inst *modbus_devs[] = {
@@ -549,9 +573,274 @@ SR_PRIV int sr_modbus_write_multiple_registers(struct sr_modbus_dev_inst*modbus,
 	if (memcmp(request, reply, sizeof(reply)))
 		return SR_ERR_DATA;
 
+	sr_modbus_poll_invalidate(modbus, address, nb_registers);
+
 	return SR_OK;
 }
 
+static void poll_free_blocks(struct sr_modbus_poll *poll)
+{
+	struct poll_block *block;
+	guint i;
+
+	if (!poll->blocks)
+		return;
+	for (i = 0; i < poll->blocks->len; i++) {
+		block = &g_array_index(poll->blocks, struct poll_block, i);
+		g_free(block->registers);
+		g_free(block->timestamps);
+	}
+	g_array_free(poll->blocks, TRUE);
+	poll->blocks = NULL;
+}
+
+static gint poll_range_compare(gconstpointer a, gconstpointer b)
+{
+	const struct poll_range *ra = a, *rb = b;
+
+	return ra->address - rb->address;
+}
+
+/*
+ * Coalesce the declared ranges into as few requests as possible. On
+ * slow serial links, the overhead of a request/reply transaction far
+ * exceeds the transfer of a few unused registers in between. Those
+ * only get read when the driver allowed it, since devices may reply
+ * with an exception for registers which they don't implement.
+ */
+static void poll_plan(struct sr_modbus_poll *poll)
+{
+	GArray *ranges;
+	struct poll_range *range;
+	struct poll_block block, *last, *blk;
+	int end;
+	guint i;
+
+	/* Ranges in address order, merged with their predecessor if close. */
+	ranges = g_array_sized_new(FALSE, FALSE, sizeof(*range),
+		poll->ranges->len);
+	g_array_append_vals(ranges, poll->ranges->data, poll->ranges->len);
+	g_array_sort(ranges, poll_range_compare);
+
+	poll->blocks = g_array_new(FALSE, FALSE, sizeof(block));
+	for (i = 0; i < ranges->len; i++) {
+		range = &g_array_index(ranges, struct poll_range, i);
+		last = NULL;
+		if (poll->blocks->len)
+			last = &g_array_index(poll->blocks, struct poll_block,
+				poll->blocks->len - 1);
+		if (last) {
+			end = MAX(last->address + last->count,
+				range->address + range->count);
+			if (range->address <= last->address + last->count + poll->max_gap
+					&& end - last->address <= MAX_READ_REGISTERS) {
+				last->count = end - last->address;
+				continue;
+			}
+		}
+		block.address = range->address;
+		block.count = range->count;
+		g_array_append_val(poll->blocks, block);
+	}
+	g_array_free(ranges, TRUE);
+
+	for (i = 0; i < poll->blocks->len; i++) {
+		blk = &g_array_index(poll->blocks, struct poll_block, i);
+		blk->registers = g_malloc0_n(blk->count, sizeof(uint16_t));
+		blk->timestamps = g_malloc0_n(blk->count, sizeof(gint64));
+	}
+
+	sr_dbg("Polling %u register ranges in %u requests.",
+		poll->ranges->len, poll->blocks->len);
+}
+
+/**
+ * Mark registers of the device's poll set as outdated.
+ *
+ * Writes through sr_modbus_write_multiple_registers() do this for the
+ * written registers. Drivers call this for registers which change as
+ * a side effect of other writes, like mirrors of the written ones.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param address The Modbus address of the first register.
+ * @param nb_registers The number of registers.
+ */
+SR_PRIV void sr_modbus_poll_invalidate(struct sr_modbus_dev_inst *modbus,
+		int address, int nb_registers)
+{
+	struct poll_block *block;
+	int first, last;
+	guint i;
+
+	if (!modbus->poll || !modbus->poll->blocks)
+		return;
+
+	for (i = 0; i < modbus->poll->blocks->len; i++) {
+		block = &g_array_index(modbus->poll->blocks, struct poll_block, i);
+		first = MAX(address, block->address);
+		last = MIN(address + nb_registers, block->address + block->count);
+		if (first < last)
+			memset(block->timestamps + first - block->address, 0,
+				(last - first) * sizeof(gint64));
+	}
+}
+
+static struct sr_modbus_poll *poll_get(struct sr_modbus_dev_inst *modbus)
+{
+	if (!modbus->poll) {
+		modbus->poll = g_malloc0(sizeof(*modbus->poll));
+		modbus->poll->ranges = g_array_new(FALSE, FALSE,
+			sizeof(struct poll_range));
+	}
+
+	return modbus->poll;
+}
+
+/**
+ * Allow the poll set's requests to include undeclared registers.
+ *
+ * By default, only overlapping and adjacent ranges get read in one
+ * request. Devices which implement all registers in between can save
+ * requests by reading up to @p max_gap registers which nobody needs.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param max_gap The largest number of undeclared registers in between.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ */
+SR_PRIV int sr_modbus_poll_set_max_gap(struct sr_modbus_dev_inst *modbus,
+		int max_gap)
+{
+	struct sr_modbus_poll *poll;
+
+	if (max_gap < 0 || max_gap > MAX_READ_REGISTERS)
+		return SR_ERR_ARG;
+
+	poll = poll_get(modbus);
+	poll_free_blocks(poll);
+	poll->max_gap = max_gap;
+
+	return SR_OK;
+}
+
+/**
+ * Add a range of holding registers to the device's poll set.
+ *
+ * Drivers declare the registers which they need periodically once, and
+ * sr_modbus_poll_read() then reads them in as few requests as possible.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param address The Modbus address of the first register.
+ * @param nb_registers The number of registers.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ */
+SR_PRIV int sr_modbus_poll_add(struct sr_modbus_dev_inst *modbus,
+		int address, int nb_registers)
+{
+	struct sr_modbus_poll *poll;
+	struct poll_range range;
+
+	if (address < 0 || address > 0xFFFF || nb_registers < 1
+	    || nb_registers > MAX_READ_REGISTERS
+	    || address + nb_registers > 0x10000)
+		return SR_ERR_ARG;
+
+	poll = poll_get(modbus);
+	poll_free_blocks(poll);
+
+	range.address = address;
+	range.count = nb_registers;
+	g_array_append_val(poll->ranges, range);
+
+	return SR_OK;
+}
+
+/**
+ * Read all registers of the device's poll set.
+ *
+ * The values are kept, and can be retrieved by sr_modbus_poll_get().
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ *
+ * @return SR_OK upon success, SR_ERR_NA when no poll set was declared,
+ *         or the error of the first failed request.
+ */
+SR_PRIV int sr_modbus_poll_read(struct sr_modbus_dev_inst *modbus)
+{
+	struct poll_block *block;
+	gint64 now;
+	guint i;
+	int j, ret;
+
+	if (!modbus->poll)
+		return SR_ERR_NA;
+	if (!modbus->poll->blocks)
+		poll_plan(modbus->poll);
+
+	for (i = 0; i < modbus->poll->blocks->len; i++) {
+		block = &g_array_index(modbus->poll->blocks, struct poll_block, i);
+		ret = sr_modbus_read_holding_registers(modbus, block->address,
+			block->count, block->registers);
+		if (ret != SR_OK)
+			return ret;
+		now = g_get_monotonic_time();
+		for (j = 0; j < block->count; j++)
+			block->timestamps[j] = now;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Get holding register values from the device's poll set.
+ *
+ * Does not communicate with the device. Registers which were written
+ * since the last sr_modbus_poll_read() are not available.
+ *
+ * @param modbus Previously initialized Modbus device structure.
+ * @param address The Modbus address of the first register.
+ * @param nb_registers The number of registers.
+ * @param registers Buffer to store the registers values.
+ * @param max_age_ms The maximum age of the values.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments, SR_ERR_NA
+ *         when the registers are not part of the poll set, or their values
+ *         are outdated.
+ */
+SR_PRIV int sr_modbus_poll_get(struct sr_modbus_dev_inst *modbus,
+		int address, int nb_registers, uint16_t *registers,
+		unsigned int max_age_ms)
+{
+	struct poll_block *block;
+	gint64 oldest;
+	guint i;
+	int j, offset;
+
+	if (nb_registers < 1 || !registers)
+		return SR_ERR_ARG;
+	if (!modbus->poll || !modbus->poll->blocks)
+		return SR_ERR_NA;
+
+	oldest = g_get_monotonic_time() - (gint64)max_age_ms * 1000;
+	for (i = 0; i < modbus->poll->blocks->len; i++) {
+		block = &g_array_index(modbus->poll->blocks, struct poll_block, i);
+		if (address < block->address || address + nb_registers >
+				block->address + block->count)
+			continue;
+		offset = address - block->address;
+		for (j = offset; j < offset + nb_registers; j++) {
+			if (!block->timestamps[j] || block->timestamps[j] < oldest)
+				return SR_ERR_NA;
+		}
+		memcpy(registers, block->registers + offset,
+			nb_registers * sizeof(uint16_t));
+		return SR_OK;
+	}
+
+	return SR_ERR_NA;
+}
+
 /**
  * Close Modbus device.
  *
@@ -573,6 +862,11 @@ SR_PRIV int sr_modbus_close(struct sr_modbus_dev_inst *modbus)
  */
 SR_PRIV void sr_modbus_free(struct sr_modbus_dev_inst *modbus)
 {
+	if (modbus->poll) {
+		poll_free_blocks(modbus->poll);
+		g_array_free(modbus->poll->ranges, TRUE);
+		g_free(modbus->poll);
+	}
 	modbus->free(modbus->priv);
 	g_free(modbus->priv);
 	g_free(modbus);
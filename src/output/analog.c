@@ -29,11 +29,27 @@
 
 #define BIN_TO_DEC_DIGITS (log(2) / log(10))
 
+/* Format on worker threads when a packet has at least this many values. */
+#define PARALLEL_MIN_VALUES 4096
+
 struct context {
 	int num_enabled_channels;
 	GPtrArray *channellist;
 	int digits;
 	float *fdata;
+	struct sr_task_runner *runner;
+};
+
+/* A packet's values, split into sample ranges which get formatted separately. */
+struct format_batch {
+	const struct sr_datafeed_analog *analog;
+	const float *fdata;
+	int num_channels;
+	int digits;
+	gboolean si_friendly;
+	const char *suffix;
+	size_t slice_samples;
+	GString **slices;
 };
 
 enum {
@@ -68,6 +84,46 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->num_enabled_channels++;
 	}
 	ctx->fdata = NULL;
+	ctx->runner = sr_task_runner_new(0);
+
+	return SR_OK;
+}
+
+static int format_slice(size_t idx, void *cb_data)
+{
+	struct format_batch *batch;
+	const struct sr_datafeed_analog *analog;
+	struct sr_channel *ch;
+	GString *out;
+	GSList *l;
+	size_t i, first, last;
+	int c, actual_digits;
+	char *number;
+
+	batch = cb_data;
+	analog = batch->analog;
+	first = idx * batch->slice_samples;
+	last = MIN(first + batch->slice_samples, analog->num_samples);
+	out = g_string_sized_new(64 * (last - first) * batch->num_channels);
+	for (i = first; i < last; i++) {
+		for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
+			float value = batch->fdata[i * batch->num_channels + c];
+			const char *prefix = "";
+			actual_digits = batch->digits;
+			if (batch->si_friendly)
+				prefix = sr_analog_si_prefix(&value, &actual_digits);
+			ch = l->data;
+			g_string_append_printf(out, "%s: ", ch->name);
+			number = g_strdup_printf("%.*f", MAX(actual_digits, 0), value);
+			g_string_append(out, number);
+			g_free(number);
+			g_string_append(out, " ");
+			g_string_append(out, prefix);
+			g_string_append(out, batch->suffix);
+			g_string_append(out, "\n");
+		}
+	}
+	batch->slices[idx] = out;
 
 	return SR_OK;
 }
@@ -80,12 +136,13 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_meta *meta;
 	const struct sr_config *src;
 	const struct sr_key_info *srci;
-	struct sr_channel *ch;
+	struct sr_task_runner *runner;
+	struct format_batch batch;
 	GSList *l;
 	float *fdata;
-	unsigned int i;
-	int num_channels, c, ret, digits, actual_digits;
-	char *number, *suffix;
+	size_t num_slices, i;
+	int num_channels, ret, digits;
+	char *suffix;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -143,25 +200,39 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			digits = copysign(ceil(abs(digits) * BIN_TO_DEC_DIGITS), digits);
 		gboolean si_friendly = sr_analog_si_prefix_friendly(analog->meaning->unit);
 		sr_analog_unit_to_string(analog, &suffix);
-		for (i = 0; i < analog->num_samples; i++) {
-			for (l = analog->meaning->channels, c = 0; l; l = l->next, c++) {
-				float value = fdata[i * num_channels + c];
-				const char *prefix = "";
-				actual_digits = digits;
-				if (si_friendly)
-					prefix = sr_analog_si_prefix(&value, &actual_digits);
-				ch = l->data;
-				g_string_append_printf(*out, "%s: ", ch->name);
-				number = g_strdup_printf("%.*f", MAX(actual_digits, 0), value);
-				g_string_append(*out, number);
-				g_free(number);
-				g_string_append(*out, " ");
-				g_string_append(*out, prefix);
-				g_string_append(*out, suffix);
-				g_string_append(*out, "\n");
-			}
+
+		/*
+		 * Values are independent of each other. Large packets get
+		 * split into sample ranges which are formatted in parallel,
+		 * the text is concatenated in order afterwards.
+		 */
+		runner = NULL;
+		num_slices = 1;
+		if (analog->num_samples * num_channels >= PARALLEL_MIN_VALUES) {
+			runner = ctx->runner;
+			num_slices = sr_task_runner_width(runner);
 		}
+		num_slices = MAX(MIN(num_slices, analog->num_samples), 1);
+		batch.analog = analog;
+		batch.fdata = fdata;
+		batch.num_channels = num_channels;
+		batch.digits = digits;
+		batch.si_friendly = si_friendly;
+		batch.suffix = suffix;
+		batch.slice_samples = (analog->num_samples + num_slices - 1) / num_slices;
+		batch.slices = g_malloc0(num_slices * sizeof(batch.slices[0]));
+		ret = sr_task_runner_run(runner, num_slices, format_slice, &batch);
+		for (i = 0; i < num_slices; i++) {
+			if (!batch.slices[i])
+				continue;
+			g_string_append_len(*out, batch.slices[i]->str,
+				batch.slices[i]->len);
+			g_string_free(batch.slices[i], TRUE);
+		}
+		g_free(batch.slices);
 		g_free(suffix);
+		if (ret != SR_OK)
+			return ret;
 		break;
 	}
 
@@ -195,6 +266,7 @@ static int cleanup(struct sr_output *o)
 	ctx = o->priv;
 
 	g_ptr_array_free(ctx->channellist, 1);
+	sr_task_runner_free(ctx->runner);
 	if (options[0].def) {
 		g_variant_unref(options[0].def);
 		options[0].def = NULL;
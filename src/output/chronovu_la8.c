@@ -34,6 +34,7 @@ struct context {
 	uint64_t samplecount;
 	int *channel_index;
 	GString *pretrig_buf;
+	gboolean warned_unitsize;
 };
 
 /**
@@ -76,6 +77,39 @@ static uint8_t samplerate_to_divcount(uint64_t samplerate)
 	return (SR_MHZ(100) / samplerate) - 1;
 }
 
+/*
+ * Append a logic packet's samples. The LA8 stores one byte per sample,
+ * wider units get reduced to their first byte (channels 0-7) in a single
+ * pass, the user gets warned once about the dropped channels.
+ */
+static void append_samples(struct context *ctx, GString *dst,
+	const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *rdptr;
+	uint8_t *wrptr;
+	size_t count, offset, i;
+
+	if (logic->unitsize == 1) {
+		g_string_append_len(dst, logic->data, logic->length);
+		return;
+	}
+
+	if (!ctx->warned_unitsize) {
+		sr_warn("The LA8 format holds 8 channels, dropping data of "
+			"channels beyond the first 8 (unit size %u).",
+			logic->unitsize);
+		ctx->warned_unitsize = TRUE;
+	}
+
+	count = logic->length / logic->unitsize;
+	offset = dst->len;
+	g_string_set_size(dst, offset + count);
+	rdptr = logic->data;
+	wrptr = (uint8_t *)dst->str + offset;
+	for (i = 0; i < count; i++, rdptr += logic->unitsize)
+		wrptr[i] = *rdptr;
+}
+
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
@@ -138,27 +172,30 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		c[1] = (ctx->samplecount >> 8) & 0xff;
 		c[2] = (ctx->samplecount >> 16) & 0xff;
 		c[3] = (ctx->samplecount >> 24) & 0xff;
-		*out = g_string_new_len(c, 4);
-		/* Flush the pre-trigger buffer. */
-		if (ctx->pretrig_buf->len)
-			g_string_append_len(*out, ctx->pretrig_buf->str,
-					ctx->pretrig_buf->len);
+		/*
+		 * Hand over the pre-trigger buffer with the trigger point
+		 * prepended in place (which moves the buffered data).
+		 */
+		*out = g_string_prepend_len(ctx->pretrig_buf, c, 4);
+		ctx->pretrig_buf = g_string_sized_new(1024);
 		ctx->triggered = TRUE;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		if (!ctx->triggered)
-			g_string_append_len(ctx->pretrig_buf, logic->data, logic->length);
-		else
-			*out = g_string_new_len(logic->data, logic->length);
+		if (!ctx->triggered) {
+			append_samples(ctx, ctx->pretrig_buf, logic);
+		} else {
+			*out = g_string_sized_new(logic->length / logic->unitsize);
+			append_samples(ctx, *out, logic);
+		}
 		ctx->samplecount += logic->length / logic->unitsize;
 		break;
 	case SR_DF_END:
 		if (!ctx->triggered && ctx->pretrig_buf->len) {
 			/* We never got a trigger, submit an empty one. */
-			*out = g_string_sized_new(ctx->pretrig_buf->len + 4);
-			g_string_append_len(*out, "\x00\x00\x00\x00", 4);
-			g_string_append_len(*out, ctx->pretrig_buf->str, ctx->pretrig_buf->len);
+			*out = g_string_prepend_len(ctx->pretrig_buf,
+					"\x00\x00\x00\x00", 4);
+			ctx->pretrig_buf = g_string_sized_new(1024);
 		}
 		break;
 	}
@@ -33,25 +33,151 @@
 
 #define LOG_PREFIX "output/ols"
 
+/* Longest decimal representation of a 64-bit sample index. */
+#define INDEX_DIGITS_MAX	20
+
 struct context {
 	uint64_t samplerate;
 	uint64_t num_samples;
+	gboolean changes_only;
+	/* Decimal text of num_samples, updated incrementally. */
+	char index[INDEX_DIGITS_MAX];
+	size_t index_len;
+	size_t unitsize;
+	uint8_t *prev_sample;
+	gboolean prev_written;
+};
+
+/* Two lower case hex digits for every byte value. */
+#define HEX_ROW(h) \
+	h "0", h "1", h "2", h "3", h "4", h "5", h "6", h "7", \
+	h "8", h "9", h "a", h "b", h "c", h "d", h "e", h "f"
+static const char hex_lut[256][2] = {
+	HEX_ROW("0"), HEX_ROW("1"), HEX_ROW("2"), HEX_ROW("3"),
+	HEX_ROW("4"), HEX_ROW("5"), HEX_ROW("6"), HEX_ROW("7"),
+	HEX_ROW("8"), HEX_ROW("9"), HEX_ROW("a"), HEX_ROW("b"),
+	HEX_ROW("c"), HEX_ROW("d"), HEX_ROW("e"), HEX_ROW("f"),
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct context *ctx;
 
-	(void)options;
-
 	ctx = g_malloc0(sizeof(struct context));
 	o->priv = ctx;
 	ctx->samplerate = 0;
 	ctx->num_samples = 0;
+	ctx->changes_only = g_variant_get_boolean(
+		g_hash_table_lookup(options, "changes_only"));
+	ctx->index[0] = '0';
+	ctx->index_len = 1;
 
 	return SR_OK;
 }
 
+/* Advance the decimal sample index text by one. */
+static void index_inc(struct context *ctx)
+{
+	size_t pos;
+
+	pos = ctx->index_len;
+	while (pos--) {
+		if (ctx->index[pos] != '9') {
+			ctx->index[pos]++;
+			return;
+		}
+		ctx->index[pos] = '0';
+	}
+	/* All digits wrapped, grow by one leading digit. */
+	memmove(&ctx->index[1], &ctx->index[0], ctx->index_len);
+	ctx->index[0] = '1';
+	ctx->index_len++;
+}
+
+/* Format one "<hex>@<index>" line at the write position, return its end. */
+static char *format_line(const struct context *ctx, char *wrptr,
+	const uint8_t *sample)
+{
+	size_t j;
+
+	/* The OLS format wants the samples presented MSB first. */
+	j = ctx->unitsize;
+	while (j--) {
+		memcpy(wrptr, hex_lut[sample[j]], 2);
+		wrptr += 2;
+	}
+	*wrptr++ = '@';
+	memcpy(wrptr, ctx->index, ctx->index_len);
+	wrptr += ctx->index_len;
+	*wrptr++ = '\n';
+
+	return wrptr;
+}
+
+/*
+ * Format a whole logic packet. The output string is grown once for the
+ * worst case, lines get written in place, and the excess is cut off.
+ */
+static void format_block(struct context *ctx, GString *out,
+	const struct sr_datafeed_logic *logic)
+{
+	const uint8_t *sample;
+	size_t count, i, line_max, offset;
+	char *wrptr;
+
+	count = logic->length / logic->unitsize;
+	if (!count)
+		return;
+	if (!ctx->prev_sample || ctx->unitsize != logic->unitsize) {
+		g_free(ctx->prev_sample);
+		ctx->unitsize = logic->unitsize;
+		ctx->prev_sample = g_malloc0(ctx->unitsize);
+		ctx->prev_written = FALSE;
+	}
+
+	line_max = 2 * ctx->unitsize + 1 + INDEX_DIGITS_MAX + 1;
+	offset = out->len;
+	g_string_set_size(out, offset + count * line_max);
+	wrptr = out->str + offset;
+
+	sample = logic->data;
+	for (i = 0; i < count; i++, sample += ctx->unitsize) {
+		if (!ctx->changes_only || !ctx->num_samples ||
+				memcmp(sample, ctx->prev_sample, ctx->unitsize) != 0) {
+			wrptr = format_line(ctx, wrptr, sample);
+			ctx->prev_written = TRUE;
+		} else {
+			ctx->prev_written = FALSE;
+		}
+		memcpy(ctx->prev_sample, sample, ctx->unitsize);
+		ctx->num_samples++;
+		index_inc(ctx);
+	}
+
+	g_string_truncate(out, wrptr - out->str);
+}
+
+/*
+ * When only changes get written, terminate the capture with its last
+ * sample so that readers see the complete length.
+ */
+static void format_last(struct context *ctx, GString *out)
+{
+	char digits[INDEX_DIGITS_MAX + 1];
+	size_t offset;
+	char *wrptr;
+	int len;
+
+	len = g_snprintf(digits, sizeof(digits), "%" PRIu64, ctx->num_samples - 1);
+	memcpy(ctx->index, digits, len);
+	ctx->index_len = len;
+
+	offset = out->len;
+	g_string_set_size(out, offset + 2 * ctx->unitsize + 1 + len + 1);
+	wrptr = format_line(ctx, out->str + offset, ctx->prev_sample);
+	g_string_truncate(out, wrptr - out->str);
+}
+
 static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
 {
 	struct sr_channel *ch;
@@ -94,8 +220,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
-	unsigned int i, j;
-	uint8_t c;
 
 	*out = NULL;
 	if (!o || !o->sdi)
@@ -118,13 +242,12 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			*out = gen_header(o->sdi, ctx);
 		} else
 			*out = g_string_sized_new(512);
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* The OLS format wants the samples presented MSB first. */
-				c = *((uint8_t *)logic->data + i + logic->unitsize - 1 - j);
-				g_string_append_printf(*out, "%02x", c);
-			}
-			g_string_append_printf(*out, "@%"PRIu64"\n", ctx->num_samples++);
+		format_block(ctx, *out, logic);
+		break;
+	case SR_DF_END:
+		if (ctx->changes_only && ctx->num_samples && !ctx->prev_written) {
+			*out = g_string_sized_new(128);
+			format_last(ctx, *out);
 		}
 		break;
 	}
@@ -132,6 +255,19 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	return SR_OK;
 }
 
+static struct sr_option options[] = {
+	{ "changes_only", "Changes only", "Only write samples which differ from their predecessor", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+
+	return options;
+}
+
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
@@ -140,6 +276,7 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
+	g_free(ctx->prev_sample);
 	g_free(ctx);
 	o->priv = NULL;
 
@@ -152,7 +289,7 @@ SR_PRIV struct sr_output_module output_ols = {
 	.desc = "OpenBench Logic Sniffer data",
 	.exts = (const char*[]){"ols", NULL},
 	.flags = 0,
-	.options = NULL,
+	.options = get_options,
 	.init = init,
 	.receive = receive,
 	.cleanup = cleanup
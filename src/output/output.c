@@ -65,6 +65,7 @@ extern SR_PRIV struct sr_output_module output_analog;
 extern SR_PRIV struct sr_output_module output_srzip;
 extern SR_PRIV struct sr_output_module output_wav;
 extern SR_PRIV struct sr_output_module output_wavedrom;
+extern SR_PRIV struct sr_output_module output_transitions;
 extern SR_PRIV struct sr_output_module output_null;
 /** @endcond */
 
@@ -81,6 +82,7 @@ static const struct sr_output_module *output_module_list[] = {
 	&output_srzip,
 	&output_wav,
 	&output_wavedrom,
+	&output_transitions,
 	&output_null,
 	NULL,
 };
@@ -339,6 +341,32 @@ SR_API int sr_output_send(const struct sr_output *o,
 	return o->module->receive(o, packet, out);
 }
 
+/**
+ * Finalize the output of the specified output instance.
+ *
+ * Some formats hold information in their header which is only known
+ * after all data was seen, e.g. the size of the data. When the output
+ * went to a regular file, frontends should call this after the file
+ * received all output and was closed, and before sr_output_free(), to
+ * let the output module update the file in place. Does nothing for
+ * modules which need no such update.
+ *
+ * @retval SR_OK Success, or nothing to do.
+ * @retval other Negative error code.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_finalize(const struct sr_output *o)
+{
+	if (!o)
+		return SR_ERR_ARG;
+
+	if (!o->module->finalize)
+		return SR_OK;
+
+	return o->module->finalize(o);
+}
+
 /**
  * Free the specified output instance and all associated resources.
  *
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <zip.h>
@@ -40,21 +41,25 @@ struct out_context {
 	struct logic_buff {
 		size_t unit_size;
 		size_t alloc_size;
-		uint8_t *samples;
+		GPtrArray *packets;
 		size_t fill_size;
 	} logic_buff;
+	gboolean analog_packed;
 	struct analog_buff {
 		size_t alloc_size;
 		float *samples;
+		int32_t *native;
+		gboolean is_native;
+		struct sr_rational scale, offset;
 		size_t fill_size;
 	} *analog_buff;
+	struct sr_task_runner *runner;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
-
-	(void)options;
+	const char *encoding;
 
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
@@ -63,6 +68,18 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(*outc));
 	outc->filename = g_strdup(o->filename);
+	encoding = g_variant_get_string(g_hash_table_lookup(options,
+		"analog_encoding"), NULL);
+	if (g_ascii_strcasecmp(encoding, "packed") == 0) {
+		outc->analog_packed = TRUE;
+	} else if (g_ascii_strcasecmp(encoding, "float") != 0) {
+		sr_err("Unsupported analog encoding '%s'.", encoding);
+		g_free(outc->filename);
+		g_free(outc);
+		return SR_ERR_ARG;
+	}
+	if (outc->analog_packed)
+		outc->runner = sr_task_runner_new(0);
 	o->priv = outc;
 
 	return SR_OK;
@@ -100,8 +117,9 @@ static int zip_create(const struct sr_output *o)
 	if (!zipfile)
 		return SR_ERR;
 
-	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
+	/* "version", packed analog data requires a newer reader. */
+	versrc = zip_source_buffer(zipfile,
+		outc->analog_packed ? "3" : "2", 1, FALSE);
 	if (zip_add(zipfile, "version", versrc) < 0) {
 		sr_err("Error saving version into zipfile: %s",
 			zip_strerror(zipfile));
@@ -156,6 +174,8 @@ static int zip_create(const struct sr_output *o)
 	g_free(s);
 
 	g_key_file_set_integer(meta, devgroup, "total analog", enabled_analog_channels);
+	if (outc->analog_packed)
+		g_key_file_set_string(meta, devgroup, "analog encoding", "packed");
 
 	outc->analog_ch_count = enabled_analog_channels;
 	alloc_size = sizeof(gint) * outc->analog_ch_count + 1;
@@ -187,13 +207,14 @@ static int zip_create(const struct sr_output *o)
 	}
 
 	/*
-	 * Allocate one samples buffer for all logic channels, and
-	 * several samples buffers for the analog channels. Allocate
-	 * buffers of CHUNK_SIZE size (in bytes), and determine the
-	 * sample counts from the respective channel counts and data
-	 * type widths.
+	 * Queue about CHUNK_SIZE bytes of logic data, as copies of the
+	 * received packets. These share the data with drivers which
+	 * loan their transfer buffers to the session, instead of
+	 * copying it. Allocate several samples buffers of CHUNK_SIZE
+	 * size (in bytes) for the analog channels. Determine the sample
+	 * counts from the respective channel counts and data type widths.
 	 *
-	 * These buffers are intended to reduce the number of ZIP
+	 * These queues are intended to reduce the number of ZIP
 	 * archive update calls, and decouple the srzip output module
 	 * from implementation details in other acquisition device
 	 * drivers and input modules.
@@ -207,9 +228,8 @@ static int zip_create(const struct sr_output *o)
 	outc->logic_buff.unit_size = logic_channels;
 	outc->logic_buff.unit_size += 8 - 1;
 	outc->logic_buff.unit_size /= 8;
-	outc->logic_buff.samples = g_try_malloc0(alloc_size);
-	if (!outc->logic_buff.samples)
-		return SR_ERR_MALLOC;
+	outc->logic_buff.packets = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)sr_packet_free);
 	if (outc->logic_buff.unit_size)
 		alloc_size /= outc->logic_buff.unit_size;
 	outc->logic_buff.alloc_size = alloc_size;
@@ -225,6 +245,12 @@ static int zip_create(const struct sr_output *o)
 		alloc_size /= sizeof(outc->analog_buff[0].samples[0]);
 		outc->analog_buff[index].alloc_size = alloc_size;
 		outc->analog_buff[index].fill_size = 0;
+		if (!outc->analog_packed)
+			continue;
+		outc->analog_buff[index].native = g_try_malloc0(alloc_size *
+			sizeof(outc->analog_buff[0].native[0]));
+		if (!outc->analog_buff[index].native)
+			return SR_ERR_MALLOC;
 	}
 
 	metabuf = g_key_file_to_data(meta, &metalen, NULL);
@@ -251,19 +277,88 @@ static int zip_create(const struct sr_output *o)
 	return SR_OK;
 }
 
+/* Reads a logic chunk's data from the queued packets. */
+struct logic_source {
+	const GPtrArray *packets;
+	uint64_t length;
+	size_t index, offset;
+};
+
+static zip_int64_t logic_source_read(void *state, void *data,
+	zip_uint64_t len, enum zip_source_cmd cmd)
+{
+	struct logic_source *src;
+	const struct sr_datafeed_packet *packet;
+	const struct sr_datafeed_logic *logic;
+	struct zip_stat *st;
+	uint8_t *wrptr;
+	size_t copy_size;
+	int *err;
+
+	src = state;
+	switch (cmd) {
+	case ZIP_SOURCE_OPEN:
+		src->index = 0;
+		src->offset = 0;
+		return 0;
+	case ZIP_SOURCE_READ:
+		wrptr = data;
+		while (len && src->index < src->packets->len) {
+			packet = g_ptr_array_index(src->packets, src->index);
+			logic = packet->payload;
+			copy_size = MIN(len, logic->length - src->offset);
+			memcpy(wrptr, (const uint8_t *)logic->data + src->offset,
+				copy_size);
+			wrptr += copy_size;
+			len -= copy_size;
+			src->offset += copy_size;
+			if (src->offset == logic->length) {
+				src->index++;
+				src->offset = 0;
+			}
+		}
+		return wrptr - (uint8_t *)data;
+	case ZIP_SOURCE_CLOSE:
+		return 0;
+	case ZIP_SOURCE_STAT:
+		if (len < sizeof(*st))
+			return -1;
+		st = data;
+		zip_stat_init(st);
+		st->size = src->length;
+		st->mtime = time(NULL);
+		st->valid |= ZIP_STAT_SIZE | ZIP_STAT_MTIME;
+		return sizeof(*st);
+	case ZIP_SOURCE_ERROR:
+		if (len < 2 * sizeof(int))
+			return -1;
+		err = data;
+		err[0] = ZIP_ER_INTERNAL;
+		err[1] = 0;
+		return 2 * sizeof(int);
+	case ZIP_SOURCE_FREE:
+		return 0;
+	default:
+		return -1;
+	}
+}
+
 /**
  * Append a block of logic data to an srzip archive.
  *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
+ * @param[in] packets Logic packets, whose data forms the block.
  * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Byte sequence length (in bytes, not samples).
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length)
+	const GPtrArray *packets, size_t unitsize)
 {
+	struct logic_source source;
+	const struct sr_datafeed_packet *packet;
+	const struct sr_datafeed_logic *logic;
+	size_t length, idx;
 	struct out_context *outc;
 	struct zip *archive;
 	struct zip_source *logicsrc;
@@ -279,6 +374,12 @@ static int zip_append(const struct sr_output *o,
 	char *chunkname;
 	unsigned int next_chunk_num;
 
+	length = 0;
+	for (idx = 0; idx < packets->len; idx++) {
+		packet = g_ptr_array_index(packets, idx);
+		logic = packet->payload;
+		length += logic->length;
+	}
 	if (!length)
 		return SR_OK;
 
@@ -361,7 +462,10 @@ static int zip_append(const struct sr_output *o,
 		sr_warn("Chunk size %zu not a multiple of the"
 			" unit size %zu.", length, unitsize);
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
+	/* The packets stay until the archive got written. */
+	source.packets = packets;
+	source.length = length;
+	logicsrc = zip_source_function(archive, logic_source_read, &source);
 	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
 	i = zip_add(archive, chunkname, logicsrc);
 	g_free(chunkname);
@@ -384,68 +488,76 @@ static int zip_append(const struct sr_output *o,
 	return SR_OK;
 }
 
+/* Write the queued logic data to the srzip archive. */
+static int zip_append_flush(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct logic_buff *buff;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->logic_buff;
+	if (!buff->fill_size)
+		return SR_OK;
+
+	ret = zip_append(o, buff->packets, buff->unit_size);
+	g_ptr_array_set_size(buff->packets, 0);
+	buff->fill_size = 0;
+
+	return ret;
+}
+
 /**
- * Queue a block of logic data for srzip archive writes.
+ * Queue a logic packet for srzip archive writes.
  *
  * @param[in] o Output module instance.
- * @param[in] buf Logic data samples as byte sequence.
- * @param[in] unitsize Logic data unit size (bytes per sample).
- * @param[in] length Number of bytes of sample data.
+ * @param[in] packet The logic packet, or NULL.
  * @param[in] flush Force ZIP archive update (queue by default).
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_queue(const struct sr_output *o,
-	uint8_t *buf, size_t unitsize, size_t length, gboolean flush)
+	const struct sr_datafeed_packet *packet, gboolean flush)
 {
 	struct out_context *outc;
 	struct logic_buff *buff;
-	size_t send_size, remain, copy_size;
-	uint8_t *wrptr, *rdptr;
+	const struct sr_datafeed_logic *logic;
+	struct sr_datafeed_packet *copy;
+	size_t count;
 	int ret;
 
 	outc = o->priv;
 	buff = &outc->logic_buff;
-	if (length && unitsize != buff->unit_size) {
-		sr_warn("Unexpected unit size, discarding logic data.");
-		return SR_ERR_ARG;
+	logic = packet ? packet->payload : NULL;
+	count = 0;
+	if (logic && logic->length) {
+		if (logic->unitsize != buff->unit_size) {
+			sr_warn("Unexpected unit size, discarding logic data.");
+			return SR_ERR_ARG;
+		}
+		count = logic->length / buff->unit_size;
 	}
 
 	/*
-	 * Queue most recently received samples to the local buffer.
-	 * Flush to the ZIP archive when the buffer space is exhausted.
+	 * Queue most recently received samples, shared with the driver
+	 * where possible. Flush to the ZIP archive before the queue would
+	 * exceed its size, and when it is full.
 	 */
-	rdptr = buf;
-	send_size = buff->unit_size ? length / buff->unit_size : 0;
-	while (send_size) {
-		remain = buff->alloc_size - buff->fill_size;
-		if (remain) {
-			wrptr = &buff->samples[buff->fill_size * buff->unit_size];
-			copy_size = MIN(send_size, remain);
-			send_size -= copy_size;
-			buff->fill_size += copy_size;
-			memcpy(wrptr, rdptr, copy_size * buff->unit_size);
-			rdptr += copy_size * buff->unit_size;
-			remain -= copy_size;
-		}
-		if (send_size && !remain) {
-			ret = zip_append(o, buff->samples, buff->unit_size,
-				buff->fill_size * buff->unit_size);
+	if (count) {
+		if (buff->fill_size + count > buff->alloc_size) {
+			ret = zip_append_flush(o);
 			if (ret != SR_OK)
 				return ret;
-			buff->fill_size = 0;
-			remain = buff->alloc_size - buff->fill_size;
 		}
+		if (sr_packet_copy_shared(packet, &copy) != SR_OK)
+			return SR_ERR_MALLOC;
+		g_ptr_array_add(buff->packets, copy);
+		buff->fill_size += count;
 	}
 
-	/* Flush to the ZIP archive if the caller wants us to. */
-	if (flush && buff->fill_size) {
-		ret = zip_append(o, buff->samples, buff->unit_size,
-			buff->fill_size * buff->unit_size);
-		if (ret != SR_OK)
-			return ret;
-		buff->fill_size = 0;
-	}
+	/* Flush to the ZIP archive if full, or if the caller wants us to. */
+	if (flush || buff->fill_size >= buff->alloc_size)
+		return zip_append_flush(o);
 
 	return SR_OK;
 }
@@ -454,20 +566,20 @@ static int zip_append_queue(const struct sr_output *o,
  * Append analog data of a channel to an srzip archive.
  *
  * @param[in] o Output module instance.
- * @param[in] values Sample data as array of floating point values.
- * @param[in] count Number of samples (float items, not bytes).
+ * @param[in] data Sample data as array of floating point values, or
+ *   an analog chunk container for "packed" analog encoding.
+ * @param[in] size Size of the sample data (in bytes).
  * @param[in] ch_nr 1-based channel number.
  *
  * @returns SR_OK et al error codes.
  */
 static int zip_append_analog(const struct sr_output *o,
-	const float *values, size_t count, size_t ch_nr)
+	const void *data, size_t size, size_t ch_nr)
 {
 	struct out_context *outc;
 	struct zip *archive;
 	struct zip_source *analogsrc;
 	int64_t i, num_files;
-	size_t size;
 	struct zip_stat zs;
 	uint64_t chunk_num;
 	const char *entry_name;
@@ -502,8 +614,7 @@ static int zip_append_analog(const struct sr_output *o,
 		}
 	}
 
-	size = sizeof(values[0]) * count;
-	analogsrc = zip_source_buffer(archive, values, size, FALSE);
+	analogsrc = zip_source_buffer(archive, data, size, FALSE);
 	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
 	i = zip_add(archive, chunkname, analogsrc);
 	if (i < 0) {
@@ -527,6 +638,193 @@ static int zip_append_analog(const struct sr_output *o,
 	return SR_OK;
 }
 
+/* Encode the queued analog data of a channel into a chunk container. */
+static GString *analog_buff_pack(const struct analog_buff *buff)
+{
+	GString *chunk;
+
+	chunk = g_string_sized_new(buff->fill_size * sizeof(buff->samples[0]));
+	if (buff->is_native) {
+		sr_sessionfile_analog_pack_int(chunk, buff->native,
+			buff->fill_size, &buff->scale, &buff->offset);
+	} else {
+		sr_sessionfile_analog_pack_float(chunk,
+			buff->samples, buff->fill_size);
+	}
+
+	return chunk;
+}
+
+/**
+ * Flush the queued analog data of a channel to the srzip archive.
+ *
+ * @param[in] o Output module instance.
+ * @param[in] idx 0-based index of the enabled analog channel.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog_flush(const struct sr_output *o, size_t idx)
+{
+	struct out_context *outc;
+	struct analog_buff *buff;
+	GString *chunk;
+	size_t nr;
+	int ret;
+
+	outc = o->priv;
+	buff = &outc->analog_buff[idx];
+	if (!buff->fill_size)
+		return SR_OK;
+	nr = outc->first_analog_index + idx;
+
+	if (!outc->analog_packed) {
+		ret = zip_append_analog(o, buff->samples,
+			buff->fill_size * sizeof(buff->samples[0]), nr);
+		buff->fill_size = 0;
+		return ret;
+	}
+
+	chunk = analog_buff_pack(buff);
+	ret = zip_append_analog(o, chunk->str, chunk->len, nr);
+	g_string_free(chunk, TRUE);
+	buff->fill_size = 0;
+
+	return ret;
+}
+
+struct analog_pack_batch {
+	struct out_context *outc;
+	GString **chunks;
+};
+
+static int analog_pack_task(size_t idx, void *cb_data)
+{
+	struct analog_pack_batch *batch;
+	struct analog_buff *buff;
+
+	batch = cb_data;
+	buff = &batch->outc->analog_buff[idx];
+	if (buff->fill_size)
+		batch->chunks[idx] = analog_buff_pack(buff);
+
+	return SR_OK;
+}
+
+/**
+ * Flush the queued analog data of all channels to the srzip archive.
+ *
+ * Channels are independent of each other, so the "packed" encoding
+ * runs on worker threads. Archive updates remain in channel order.
+ * Used at the end of the acquisition, and when a channel's buffer
+ * runs full.
+ *
+ * @param[in] o Output module instance.
+ *
+ * @returns SR_OK et al error codes.
+ */
+static int zip_append_analog_flush_all(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct analog_pack_batch batch;
+	size_t idx;
+	int ret;
+
+	outc = o->priv;
+	if (!outc->analog_packed) {
+		for (idx = 0; idx < outc->analog_ch_count; idx++) {
+			ret = zip_append_analog_flush(o, idx);
+			if (ret != SR_OK)
+				return ret;
+		}
+		return SR_OK;
+	}
+
+	batch.outc = outc;
+	batch.chunks = g_malloc0(outc->analog_ch_count * sizeof(batch.chunks[0]));
+	ret = sr_task_runner_run(outc->runner, outc->analog_ch_count,
+		analog_pack_task, &batch);
+	for (idx = 0; idx < outc->analog_ch_count; idx++) {
+		if (!batch.chunks[idx])
+			continue;
+		if (ret == SR_OK) {
+			ret = zip_append_analog(o, batch.chunks[idx]->str,
+				batch.chunks[idx]->len,
+				outc->first_analog_index + idx);
+		}
+		g_string_free(batch.chunks[idx], TRUE);
+		outc->analog_buff[idx].fill_size = 0;
+	}
+	g_free(batch.chunks);
+
+	return ret;
+}
+
+/**
+ * Check whether analog data can be kept in its native integer format.
+ *
+ * Only integer formats which losslessly fit into 32bit signed values
+ * are supported. Other formats get converted to float.
+ */
+static gboolean analog_is_native_int(const struct sr_analog_encoding *enc)
+{
+	if (enc->is_float)
+		return FALSE;
+	if (enc->unitsize == 1 || enc->unitsize == 2)
+		return TRUE;
+	if (enc->unitsize == 4 && enc->is_signed)
+		return TRUE;
+
+	return FALSE;
+}
+
+static void analog_read_native(const struct sr_datafeed_analog *analog,
+	int32_t *values)
+{
+	const struct sr_analog_encoding *enc;
+	const uint8_t *rdptr;
+	size_t count;
+
+	enc = analog->encoding;
+	rdptr = analog->data;
+	count = analog->num_samples;
+	while (count--) {
+		switch (enc->unitsize) {
+		case 1:
+			*values = enc->is_signed ? read_i8_inc(&rdptr)
+				: read_u8_inc(&rdptr);
+			break;
+		case 2:
+			if (enc->is_bigendian)
+				*values = enc->is_signed ? read_i16be_inc(&rdptr)
+					: read_u16be_inc(&rdptr);
+			else
+				*values = enc->is_signed ? read_i16le_inc(&rdptr)
+					: read_u16le_inc(&rdptr);
+			break;
+		default:
+			*values = enc->is_bigendian ? read_i32be_inc(&rdptr)
+				: read_i32le_inc(&rdptr);
+			break;
+		}
+		values++;
+	}
+}
+
+static gboolean analog_buff_matches(const struct analog_buff *buff,
+	gboolean is_native, const struct sr_analog_encoding *enc)
+{
+	if (buff->is_native != is_native)
+		return FALSE;
+	if (!is_native)
+		return TRUE;
+	if (buff->scale.p != enc->scale.p || buff->scale.q != enc->scale.q)
+		return FALSE;
+	if (buff->offset.p != enc->offset.p || buff->offset.q != enc->offset.q)
+		return FALSE;
+
+	return TRUE;
+}
+
 /**
  * Queue analog data of a channel for srzip archive writes.
  *
@@ -541,29 +839,19 @@ static int zip_append_analog_queue(const struct sr_output *o,
 {
 	struct out_context *outc;
 	const struct sr_channel *ch;
-	size_t idx, nr;
+	size_t idx;
 	struct analog_buff *buff;
-	float *values, *wrptr, *rdptr;
-	size_t send_size, remain, copy_size;
+	gboolean is_native;
+	void *values;
+	uint8_t *wrptr, *rdptr;
+	size_t item_size, send_size, remain, copy_size;
 	int ret;
 
 	outc = o->priv;
 
 	/* Is this the DF_END flush call without samples submission? */
-	if (!analog && flush) {
-		for (idx = 0; idx < outc->analog_ch_count; idx++) {
-			nr = outc->first_analog_index + idx;
-			buff = &outc->analog_buff[idx];
-			if (!buff->fill_size)
-				continue;
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
-			if (ret != SR_OK)
-				return ret;
-			buff->fill_size = 0;
-		}
-		return SR_OK;
-	}
+	if (!analog && flush)
+		return zip_append_analog_flush_all(o);
 
 	/* Lookup index and number of the analog channel. */
 	/* TODO: support packets covering multiple channels */
@@ -578,17 +866,39 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	}
 	if (idx == outc->analog_ch_count)
 		return SR_ERR_ARG;
-	nr = outc->first_analog_index + idx;
 	buff = &outc->analog_buff[idx];
 
-	/* Convert the analog data to an array of float values. */
-	values = g_try_malloc0(analog->num_samples * sizeof(values[0]));
+	/*
+	 * Keep the device's native integer values when the "packed"
+	 * encoding is used. A chunk covers values of one representation
+	 * and one set of scale/offset factors. Flush queued data when
+	 * the representation changes.
+	 */
+	is_native = outc->analog_packed && analog_is_native_int(analog->encoding);
+	if (buff->fill_size && !analog_buff_matches(buff, is_native, analog->encoding)) {
+		ret = zip_append_analog_flush(o, idx);
+		if (ret != SR_OK)
+			return ret;
+	}
+	buff->is_native = is_native;
+	if (is_native) {
+		buff->scale = analog->encoding->scale;
+		buff->offset = analog->encoding->offset;
+	}
+
+	/* Convert the analog data to an array of float or integer values. */
+	item_size = is_native ? sizeof(buff->native[0]) : sizeof(buff->samples[0]);
+	values = g_try_malloc0(analog->num_samples * item_size);
 	if (!values)
 		return SR_ERR_MALLOC;
-	ret = sr_analog_to_float(analog, values);
-	if (ret != SR_OK) {
-		g_free(values);
-		return ret;
+	if (is_native) {
+		analog_read_native(analog, values);
+	} else {
+		ret = sr_analog_to_float(analog, values);
+		if (ret != SR_OK) {
+			g_free(values);
+			return ret;
+		}
 	}
 
 	/*
@@ -600,33 +910,41 @@ static int zip_append_analog_queue(const struct sr_output *o,
 	while (send_size) {
 		remain = buff->alloc_size - buff->fill_size;
 		if (remain) {
-			wrptr = &buff->samples[buff->fill_size];
+			if (is_native)
+				wrptr = (uint8_t *)&buff->native[buff->fill_size];
+			else
+				wrptr = (uint8_t *)&buff->samples[buff->fill_size];
 			copy_size = MIN(send_size, remain);
 			send_size -= copy_size;
 			buff->fill_size += copy_size;
-			memcpy(wrptr, rdptr, copy_size * sizeof(values[0]));
-			rdptr += copy_size;
+			memcpy(wrptr, rdptr, copy_size * item_size);
+			rdptr += copy_size * item_size;
 			remain -= copy_size;
 		}
 		if (send_size && !remain) {
-			ret = zip_append_analog(o,
-				buff->samples, buff->fill_size, nr);
+			/*
+			 * Channels arrive interleaved and fill up at about the
+			 * same rate. Have their "packed" encoding run in
+			 * parallel, instead of one channel at a time.
+			 */
+			if (outc->analog_packed)
+				ret = zip_append_analog_flush_all(o);
+			else
+				ret = zip_append_analog_flush(o, idx);
 			if (ret != SR_OK) {
 				g_free(values);
 				return ret;
 			}
-			buff->fill_size = 0;
 			remain = buff->alloc_size - buff->fill_size;
 		}
 	}
 	g_free(values);
 
 	/* Flush to the ZIP archive if the caller wants us to. */
-	if (flush && buff->fill_size) {
-		ret = zip_append_analog(o, buff->samples, buff->fill_size, nr);
+	if (flush) {
+		ret = zip_append_analog_flush(o, idx);
 		if (ret != SR_OK)
 			return ret;
-		buff->fill_size = 0;
 	}
 
 	return SR_OK;
@@ -637,7 +955,6 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 {
 	struct out_context *outc;
 	const struct sr_datafeed_meta *meta;
-	const struct sr_datafeed_logic *logic;
 	const struct sr_datafeed_analog *analog;
 	const struct sr_config *src;
 	GSList *l;
@@ -663,9 +980,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 				return ret;
 			outc->zip_created = TRUE;
 		}
-		logic = packet->payload;
-		ret = zip_append_queue(o, logic->data,
-			logic->unitsize, logic->length, FALSE);
+		ret = zip_append_queue(o, packet, FALSE);
 		if (ret != SR_OK)
 			return ret;
 		break;
@@ -682,7 +997,7 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_END:
 		if (outc->zip_created) {
-			ret = zip_append_queue(o, NULL, 0, 0, TRUE);
+			ret = zip_append_queue(o, NULL, TRUE);
 			if (ret != SR_OK)
 				return ret;
 			ret = zip_append_analog_queue(o, NULL, TRUE);
@@ -696,11 +1011,21 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
+	{"analog_encoding", "Analog encoding", "Storage format of analog data: float, or packed (lossless, native integer values)", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	GSList *l = NULL;
+
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_string("float"));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("float")));
+		l = g_slist_append(l, g_variant_ref_sink(g_variant_new_string("packed")));
+		options[0].values = l;
+	}
+
 	return options;
 }
 
@@ -713,10 +1038,14 @@ static int cleanup(struct sr_output *o)
 
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
-	g_free(outc->logic_buff.samples);
-	for (idx = 0; idx < outc->analog_ch_count; idx++)
+	if (outc->logic_buff.packets)
+		g_ptr_array_free(outc->logic_buff.packets, TRUE);
+	for (idx = 0; idx < outc->analog_ch_count; idx++) {
 		g_free(outc->analog_buff[idx].samples);
+		g_free(outc->analog_buff[idx].native);
+	}
 	g_free(outc->analog_buff);
+	sr_task_runner_free(outc->runner);
 
 	g_free(outc);
 	o->priv = NULL;
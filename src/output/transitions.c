@@ -0,0 +1,374 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compact binary transition list for (sparse) logic captures.
+ *
+ * Instead of dense samples, the file holds one record per sample where
+ * any of the logic channels changed. All multi-byte integers are little
+ * endian, "varint" refers to unsigned LEB128 numbers.
+ *
+ * - Header:
+ *   - 8 bytes magic "SRTRANS\0".
+ *   - u16 format version (1), u16 unitsize, u16 channel count,
+ *     u16 flags (reserved, zero), u64 samplerate (0 when unknown).
+ *   - Per channel: u8 name length, name text (not NUL terminated).
+ *   - unitsize bytes: the value of the very first sample.
+ * - Records, one per change:
+ *   - varint distance in samples since the previous change (or the
+ *     first sample), is never zero.
+ *   - unitsize bytes XOR mask of the channels which changed.
+ * - End of records:
+ *   - varint zero (an otherwise invalid distance).
+ *   - varint total number of samples in the capture.
+ * - Block index for seeking (can be empty):
+ *   - varint number of entries.
+ *   - Per entry: varint sample number of the last change before the
+ *     referenced record, varint byte offset of the record relative to
+ *     the start of the records section, unitsize bytes channel state
+ *     at that sample number.
+ * - Footer:
+ *   - u64 file offset of the block index section.
+ *   - 8 bytes magic "SRTRIDX\0".
+ *
+ * Readers which want to seek can locate the index from the fixed size
+ * footer at the end of the file, pick the last entry at or before the
+ * sample of interest, and start decoding records at its byte offset,
+ * with the entry's channel state and sample number.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "output/transitions"
+
+#define FILE_MAGIC		"SRTRANS"
+#define INDEX_MAGIC		"SRTRIDX"
+#define MAGIC_SIZE		8
+#define FILE_VERSION		1
+#define DEFAULT_INDEX_INTERVAL	4096
+#define RECORD_BUFSIZE		4096
+
+struct context {
+	uint64_t samplerate;
+	gboolean header_done;
+	size_t unitsize;
+	uint8_t *state;
+	uint64_t samplenum;
+	uint64_t last_change;
+	uint64_t file_offset;
+	uint64_t records_offset;
+	uint64_t record_count;
+	uint32_t index_interval;
+	GString *index;
+	uint64_t index_count;
+	uint8_t recbuf[RECORD_BUFSIZE];
+	size_t recbuf_fill;
+};
+
+static int init(struct sr_output *o, GHashTable *options)
+{
+	struct context *ctx;
+
+	ctx = g_malloc0(sizeof(*ctx));
+	o->priv = ctx;
+	ctx->index_interval = g_variant_get_uint32(
+		g_hash_table_lookup(options, "index_interval"));
+	ctx->index = g_string_sized_new(1024);
+
+	return SR_OK;
+}
+
+static void append_out(struct context *ctx, GString *out,
+	const void *data, size_t len)
+{
+	g_string_append_len(out, data, len);
+	ctx->file_offset += len;
+}
+
+static GString *gen_header(const struct sr_output *o, struct context *ctx)
+{
+	struct sr_channel *ch;
+	GSList *l;
+	GString *s;
+	GVariant *gvar;
+	uint8_t buf[4 * sizeof(uint16_t) + sizeof(uint64_t)], *wp;
+	size_t count, len;
+
+	if (!ctx->samplerate && sr_config_get(o->sdi->driver, o->sdi, NULL,
+			SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+		ctx->samplerate = g_variant_get_uint64(gvar);
+		g_variant_unref(gvar);
+	}
+
+	count = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC && ch->enabled)
+			count++;
+	}
+
+	s = g_string_sized_new(512);
+	append_out(ctx, s, FILE_MAGIC, MAGIC_SIZE);
+	wp = &buf[0];
+	write_u16le_inc(&wp, FILE_VERSION);
+	write_u16le_inc(&wp, ctx->unitsize);
+	write_u16le_inc(&wp, count);
+	write_u16le_inc(&wp, 0);
+	write_u64le_inc(&wp, ctx->samplerate);
+	append_out(ctx, s, buf, wp - &buf[0]);
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->type != SR_CHANNEL_LOGIC || !ch->enabled)
+			continue;
+		len = MIN(strlen(ch->name), UINT8_MAX);
+		buf[0] = len;
+		append_out(ctx, s, buf, 1);
+		append_out(ctx, s, ch->name, len);
+	}
+
+	append_out(ctx, s, ctx->state, ctx->unitsize);
+	ctx->records_offset = ctx->file_offset;
+
+	return s;
+}
+
+static void flush_records(struct context *ctx, GString *out)
+{
+	if (!ctx->recbuf_fill)
+		return;
+	append_out(ctx, out, ctx->recbuf, ctx->recbuf_fill);
+	ctx->recbuf_fill = 0;
+}
+
+static void add_index_entry(struct context *ctx)
+{
+	uint8_t buf[2 * VARINT_U64_MAXLEN], *wp;
+	uint64_t offset;
+
+	offset = ctx->file_offset + ctx->recbuf_fill - ctx->records_offset;
+	wp = &buf[0];
+	write_u64_varint_inc(&wp, ctx->last_change);
+	write_u64_varint_inc(&wp, offset);
+	g_string_append_len(ctx->index, (const char *)buf, wp - &buf[0]);
+	g_string_append_len(ctx->index, (const char *)ctx->state, ctx->unitsize);
+	ctx->index_count++;
+}
+
+/*
+ * Determine how many leading samples match the current channel state.
+ * Unit sizes which evenly divide a 64bit word get compared in words of
+ * replicated state, so that idle periods get skipped at memory speed.
+ */
+static size_t skip_unchanged(struct context *ctx,
+	const uint8_t *data, size_t count)
+{
+	const uint8_t *p, *end;
+	uint64_t pattern, word;
+	size_t unitsize, i;
+
+	unitsize = ctx->unitsize;
+	p = data;
+	end = data + count * unitsize;
+
+	if (sizeof(pattern) % unitsize == 0) {
+		for (i = 0; i < sizeof(pattern); i += unitsize)
+			memcpy((uint8_t *)&pattern + i, ctx->state, unitsize);
+		while (p + sizeof(word) <= end) {
+			memcpy(&word, p, sizeof(word));
+			if (word != pattern)
+				break;
+			p += sizeof(word);
+		}
+	}
+	while (p < end && memcmp(p, ctx->state, unitsize) == 0)
+		p += unitsize;
+
+	return (p - data) / unitsize;
+}
+
+static void encode_logic(struct context *ctx, GString *out,
+	const uint8_t *data, size_t count)
+{
+	size_t i, skip, unitsize, b;
+	uint8_t *wp;
+	const uint8_t *sample;
+
+	unitsize = ctx->unitsize;
+	i = 0;
+	while (i < count) {
+		skip = skip_unchanged(ctx, &data[i * unitsize], count - i);
+		i += skip;
+		ctx->samplenum += skip;
+		if (i == count)
+			break;
+
+		if (ctx->recbuf_fill + VARINT_U64_MAXLEN + unitsize > RECORD_BUFSIZE)
+			flush_records(ctx, out);
+		if (ctx->index_interval && ctx->record_count % ctx->index_interval == 0)
+			add_index_entry(ctx);
+
+		sample = &data[i * unitsize];
+		wp = &ctx->recbuf[ctx->recbuf_fill];
+		write_u64_varint_inc(&wp, ctx->samplenum - ctx->last_change);
+		for (b = 0; b < unitsize; b++) {
+			*wp++ = sample[b] ^ ctx->state[b];
+			ctx->state[b] = sample[b];
+		}
+		ctx->recbuf_fill = wp - &ctx->recbuf[0];
+		ctx->record_count++;
+		ctx->last_change = ctx->samplenum;
+		ctx->samplenum++;
+		i++;
+	}
+	flush_records(ctx, out);
+}
+
+static GString *gen_trailer(struct context *ctx)
+{
+	GString *s;
+	uint8_t buf[2 * VARINT_U64_MAXLEN + sizeof(uint64_t)], *wp;
+	uint64_t index_offset;
+
+	s = g_string_sized_new(ctx->index->len + 64);
+	wp = &buf[0];
+	write_u64_varint_inc(&wp, 0);
+	write_u64_varint_inc(&wp, ctx->samplenum);
+	append_out(ctx, s, buf, wp - &buf[0]);
+
+	index_offset = ctx->file_offset;
+	wp = &buf[0];
+	write_u64_varint_inc(&wp, ctx->index_count);
+	append_out(ctx, s, buf, wp - &buf[0]);
+	append_out(ctx, s, ctx->index->str, ctx->index->len);
+
+	wp = &buf[0];
+	write_u64le_inc(&wp, index_offset);
+	append_out(ctx, s, buf, wp - &buf[0]);
+	append_out(ctx, s, INDEX_MAGIC, MAGIC_SIZE);
+
+	sr_dbg("Wrote %" PRIu64 " records for %" PRIu64 " samples, "
+		"%" PRIu64 " index entries.", ctx->record_count,
+		ctx->samplenum, ctx->index_count);
+
+	return s;
+}
+
+static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
+		GString **out)
+{
+	struct context *ctx;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	const uint8_t *data;
+	size_t count;
+	GSList *l;
+
+	*out = NULL;
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+	ctx = o->priv;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				ctx->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (!logic->unitsize)
+			return SR_ERR_DATA;
+		count = logic->length / logic->unitsize;
+		if (!count)
+			break;
+		data = logic->data;
+		if (!ctx->header_done) {
+			ctx->unitsize = logic->unitsize;
+			ctx->state = g_malloc(ctx->unitsize);
+			memcpy(ctx->state, data, ctx->unitsize);
+			*out = gen_header(o, ctx);
+			ctx->header_done = TRUE;
+		} else if (logic->unitsize != ctx->unitsize) {
+			sr_err("Unit size changed from %zu to %u.",
+				ctx->unitsize, logic->unitsize);
+			return SR_ERR_DATA;
+		}
+		if (!*out)
+			*out = g_string_sized_new(RECORD_BUFSIZE);
+		encode_logic(ctx, *out, data, count);
+		break;
+	case SR_DF_END:
+		if (ctx->header_done)
+			*out = gen_trailer(ctx);
+		break;
+	}
+
+	return SR_OK;
+}
+
+static struct sr_option options[] = {
+	{ "index_interval", "Index interval", "Number of transitions between block index entries (0 disables the index)", NULL, NULL },
+	ALL_ZERO
+};
+
+static const struct sr_option *get_options(void)
+{
+	if (!options[0].def)
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_INDEX_INTERVAL));
+
+	return options;
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o || !o->sdi)
+		return SR_ERR_ARG;
+
+	ctx = o->priv;
+	g_free(ctx->state);
+	g_string_free(ctx->index, TRUE);
+	g_free(ctx);
+	o->priv = NULL;
+
+	return SR_OK;
+}
+
+SR_PRIV struct sr_output_module output_transitions = {
+	.id = "transitions",
+	.name = "Transitions",
+	.desc = "Compact binary list of logic transitions",
+	.exts = (const char*[]){"srtr", NULL},
+	.flags = 0,
+	.options = get_options,
+	.init = init,
+	.receive = receive,
+	.cleanup = cleanup,
+};
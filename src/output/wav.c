@@ -17,8 +17,27 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * The WAV output interleaves directly from per-channel float buffers
+ * into the output string, converting to the requested sample format
+ * in the same pass. Samples can be written as 32-bit IEEE floats, or
+ * as 16-bit or 24-bit integer PCM, in which case the "scale" option
+ * determines the value which maps to full scale.
+ *
+ * When the output is a stream, the RIFF and data chunk sizes can not
+ * be known in advance, and are maxed out. When the output goes to a
+ * regular file, a placeholder chunk is reserved after the RIFF header
+ * and the sizes get patched when the frontend finalizes the output after
+ * closing the file, see sr_output_finalize(). Captures which
+ * exceed the 4GiB limit of RIFF then get turned into RF64, with the
+ * placeholder becoming the "ds64" chunk (EBU Tech 3306).
+ */
+
 #include <config.h>
+#include <math.h>
+#include <stdio.h>
 #include <string.h>
+#include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -27,63 +46,179 @@
 /* Minimum/maximum number of samples per channel to put in a data chunk */
 #define MIN_DATA_CHUNK_SAMPLES 10
 
+/* Interleave on worker threads when there are at least this many values. */
+#define PARALLEL_MIN_VALUES (64 * 1024)
+
+#define WAVE_FORMAT_PCM		0x0001
+#define WAVE_FORMAT_IEEE_FLOAT	0x0003
+
+/* Payload size of the placeholder chunk, which later becomes "ds64". */
+#define DS64_CHUNK_SIZE		28
+#define RIFF_SIZE_MAX		0xffffffffULL
+
+enum sample_format {
+	SAMPLE_FLOAT32,
+	SAMPLE_PCM16,
+	SAMPLE_PCM24,
+};
+
 struct out_context {
 	double scale;
+	enum sample_format format;
+	size_t bytes_per_sample;
 	gboolean header_done;
+	gboolean reserve_ds64;
 	uint64_t samplerate;
 	int num_channels;
 	GSList *channels;
-	int chanbuf_size;
-	int *chanbuf_used;
-	uint8_t **chanbuf;
+	size_t chanbuf_size;
+	size_t *chanbuf_used;
+	float **chanbuf;
 	float *fdata;
+	size_t header_size;
+	size_t data_size_offset;
+	uint64_t data_bytes;
+	struct sr_task_runner *runner;
 };
 
-static int realloc_chanbufs(const struct sr_output *o, int size)
+struct interleave_batch {
+	const struct out_context *outc;
+	uint8_t *dst;
+	size_t num_samples;
+	size_t slice_samples;
+};
+
+static const char *format_names[] = {
+	[SAMPLE_FLOAT32] = "float32",
+	[SAMPLE_PCM16] = "pcm16",
+	[SAMPLE_PCM24] = "pcm24",
+};
+
+/* Grow all channel buffers to hold at least the given number of samples. */
+static int grow_chanbufs(const struct sr_output *o, size_t size)
 {
 	struct out_context *outc;
+	float *buf;
 	int i;
 
 	outc = o->priv;
+	if (size <= outc->chanbuf_size)
+		return SR_OK;
+	size = MAX(size, 2 * outc->chanbuf_size);
 	for (i = 0; i < outc->num_channels; i++) {
-		if (!(outc->chanbuf[i] = g_try_realloc(outc->chanbuf[i], sizeof(float) * size))) {
+		buf = g_try_realloc(outc->chanbuf[i], sizeof(float) * size);
+		if (!buf) {
 			sr_err("Unable to allocate enough output buffer memory.");
-			return SR_ERR;
+			return SR_ERR_MALLOC;
 		}
-		outc->chanbuf_used[i] = 0;
+		outc->chanbuf[i] = buf;
 	}
 	outc->chanbuf_size = size;
 
 	return SR_OK;
 }
 
+/*
+ * Convert one channel's samples to the output format, and store them
+ * at their interleaved position. The format dispatch is kept out of
+ * the per-sample loops, which the compiler can unroll and vectorize.
+ */
+static void interleave_channel(const struct out_context *outc,
+	uint8_t *dst, const float *src, size_t count)
+{
+	size_t stride, i;
+	float factor, v;
+
+	stride = outc->num_channels * outc->bytes_per_sample;
+	factor = 1.0 / outc->scale;
+	switch (outc->format) {
+	case SAMPLE_FLOAT32:
+		if (outc->scale == 1.0) {
+			for (i = 0; i < count; i++, dst += stride)
+				write_fltle(dst, src[i]);
+		} else {
+			for (i = 0; i < count; i++, dst += stride)
+				write_fltle(dst, src[i] * factor);
+		}
+		break;
+	case SAMPLE_PCM16:
+		factor *= INT16_MAX;
+		for (i = 0; i < count; i++, dst += stride) {
+			v = src[i] * factor;
+			v = CLAMP(v, -INT16_MAX, INT16_MAX);
+			write_u16le(dst, (uint16_t)(int16_t)lrintf(v));
+		}
+		break;
+	case SAMPLE_PCM24:
+		factor *= 0x7fffff;
+		for (i = 0; i < count; i++, dst += stride) {
+			v = src[i] * factor;
+			v = CLAMP(v, -0x7fffff, 0x7fffff);
+			write_u24le(dst, (uint32_t)(int32_t)lrintf(v));
+		}
+		break;
+	}
+}
+
+/*
+ * Interleave all channels of one sample range. Tasks write contiguous
+ * and disjoint parts of the output, so they don't share cache lines
+ * except at the range boundaries.
+ */
+static int interleave_task(size_t idx, void *cb_data)
+{
+	const struct interleave_batch *batch;
+	const struct out_context *outc;
+	size_t first, last, stride;
+	uint8_t *dst;
+	int i;
+
+	batch = cb_data;
+	outc = batch->outc;
+	first = idx * batch->slice_samples;
+	last = MIN(first + batch->slice_samples, batch->num_samples);
+	if (first >= last)
+		return SR_OK;
+	stride = outc->num_channels * outc->bytes_per_sample;
+	dst = batch->dst + first * stride;
+	for (i = 0; i < outc->num_channels; i++) {
+		interleave_channel(outc, dst + i * outc->bytes_per_sample,
+			&outc->chanbuf[i][first], last - first);
+	}
+
+	return SR_OK;
+}
+
 static int flush_chanbufs(const struct sr_output *o, GString *out)
 {
 	struct out_context *outc;
-	int num_samples, i, j;
-	char *buf, *bufp;
+	struct interleave_batch batch;
+	struct sr_task_runner *runner;
+	size_t offset, len, num_slices;
+	int i;
 
 	outc = o->priv;
 
 	/* Any one of them will do. */
-	num_samples = outc->chanbuf_used[0];
-	if (!(buf = g_try_malloc(4 * num_samples * outc->num_channels))) {
-		sr_err("Unable to allocate enough interleaved output buffer memory.");
-		return SR_ERR;
-	}
-
-	bufp = buf;
-	for (i = 0; i < num_samples; i++) {
-		for (j = 0; j < outc->num_channels; j++) {
-			memcpy(bufp, outc->chanbuf[j] + i * 4, 4);
-			bufp += 4;
-		}
+	batch.outc = outc;
+	batch.num_samples = outc->chanbuf_used[0];
+	len = batch.num_samples * outc->num_channels * outc->bytes_per_sample;
+	offset = out->len;
+	g_string_set_size(out, offset + len);
+	batch.dst = (uint8_t *)out->str + offset;
+
+	/* Sample ranges write disjoint output, and can run in parallel. */
+	runner = NULL;
+	num_slices = 1;
+	if (batch.num_samples * outc->num_channels >= PARALLEL_MIN_VALUES) {
+		runner = outc->runner;
+		num_slices = sr_task_runner_width(runner);
 	}
-	g_string_append_len(out, buf, 4 * num_samples * outc->num_channels);
-	g_free(buf);
-
+	batch.slice_samples = (batch.num_samples + num_slices - 1) / num_slices;
+	sr_task_runner_run(runner, num_slices, interleave_task, &batch);
 	for (i = 0; i < outc->num_channels; i++)
 		outc->chanbuf_used[i] = 0;
+	outc->data_bytes += len;
 
 	return SR_OK;
 }
@@ -92,11 +227,37 @@ static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 	struct sr_channel *ch;
+	const char *fmt;
 	GSList *l;
+	size_t i;
 
 	outc = g_malloc0(sizeof(struct out_context));
 	o->priv = outc;
 	outc->scale = g_variant_get_double(g_hash_table_lookup(options, "scale"));
+	if (outc->scale == 0.0) {
+		sr_err("Scale factor must not be zero.");
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
+	fmt = g_variant_get_string(g_hash_table_lookup(options, "format"), NULL);
+	for (i = 0; i < ARRAY_SIZE(format_names); i++) {
+		if (g_ascii_strcasecmp(fmt, format_names[i]) == 0)
+			break;
+	}
+	if (i == ARRAY_SIZE(format_names)) {
+		sr_err("Unsupported sample format '%s'.", fmt);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+	outc->format = i;
+	outc->bytes_per_sample = (outc->format == SAMPLE_PCM16) ? 2 :
+		(outc->format == SAMPLE_PCM24) ? 3 : 4;
+
+	/* Only regular files can get their header patched later. */
+	outc->reserve_ds64 = o->filename && *o->filename;
 
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -109,10 +270,12 @@ static int init(struct sr_output *o, GHashTable *options)
 	}
 
 	outc->chanbuf = g_malloc0(sizeof(float *) * outc->num_channels);
-	outc->chanbuf_used = g_malloc0(sizeof(int) * outc->num_channels);
+	outc->chanbuf_used = g_malloc0(sizeof(size_t) * outc->num_channels);
 
-	/* Start off the interleaved buffer with 100 samples/channel. */
-	realloc_chanbufs(o, 100);
+	/* Start off the channel buffers with 100 samples/channel. */
+	grow_chanbufs(o, 100);
+
+	outc->runner = sr_task_runner_new(0);
 
 	return SR_OK;
 }
@@ -120,15 +283,20 @@ static int init(struct sr_output *o, GHashTable *options)
 static void add_data_chunk(const struct sr_output *o, GString *gs)
 {
 	struct out_context *outc;
+	size_t block_align;
 	char tmp[4];
 
 	outc = o->priv;
+	block_align = outc->num_channels * outc->bytes_per_sample;
 	g_string_append(gs, "fmt ");
 	/* Remaining chunk size */
 	WL32(tmp, 0x12);
 	g_string_append_len(gs, tmp, 4);
-	/* Format code 3 = IEEE float */
-	WL16(tmp, 0x0003);
+	/* Format code, 1 = integer PCM, 3 = IEEE float */
+	if (outc->format == SAMPLE_FLOAT32)
+		WL16(tmp, WAVE_FORMAT_IEEE_FLOAT);
+	else
+		WL16(tmp, WAVE_FORMAT_PCM);
 	g_string_append_len(gs, tmp, 2);
 	/* Number of channels */
 	WL16(tmp, outc->num_channels);
@@ -136,20 +304,21 @@ static void add_data_chunk(const struct sr_output *o, GString *gs)
 	/* Samplerate */
 	WL32(tmp, outc->samplerate);
 	g_string_append_len(gs, tmp, 4);
-	/* Byterate, using 32-bit floats. */
-	WL32(tmp, outc->samplerate * outc->num_channels * 4);
+	/* Byterate */
+	WL32(tmp, outc->samplerate * block_align);
 	g_string_append_len(gs, tmp, 4);
 	/* Blockalign */
-	WL16(tmp, outc->num_channels * 4);
+	WL16(tmp, block_align);
 	g_string_append_len(gs, tmp, 2);
 	/* Bits per sample */
-	WL16(tmp, 32);
+	WL16(tmp, 8 * outc->bytes_per_sample);
 	g_string_append_len(gs, tmp, 2);
 	WL16(tmp, 0);
 	g_string_append_len(gs, tmp, 2);
 
 	g_string_append(gs, "data");
-	/* Data chunk size, max it out. */
+	/* Data chunk size, max it out. Gets patched later when possible. */
+	outc->data_size_offset = gs->len;
 	WL32(tmp, 0xffffffff);
 	g_string_append_len(gs, tmp, 4);
 }
@@ -176,30 +345,93 @@ static GString *gen_header(const struct sr_output *o)
 	WL32(tmp, 0xffffffff);
 	g_string_append_len(header, tmp, 4);
 	g_string_append(header, "WAVE");
+	if (outc->reserve_ds64) {
+		/* Readers skip this, it becomes "ds64" for RF64 output. */
+		g_string_append(header, "JUNK");
+		WL32(tmp, DS64_CHUNK_SIZE);
+		g_string_append_len(header, tmp, 4);
+		g_string_set_size(header, header->len + DS64_CHUNK_SIZE);
+		memset(header->str + header->len - DS64_CHUNK_SIZE, 0,
+			DS64_CHUNK_SIZE);
+	}
 	add_data_chunk(o, header);
+	outc->header_size = header->len;
 
 	return header;
 }
 
 /*
- * Stores the float in little-endian BINARY32 IEEE-754 2008 format.
+ * Fill in the RIFF and data chunk sizes of a completely written file.
+ * Switches to RF64 when either size exceeds the 32-bit RIFF fields.
  */
-static void float_to_le(uint8_t *buf, float value)
+static int finalize(const struct sr_output *o)
 {
-	uint8_t *old;
-
-	old = (uint8_t *)&value;
-#ifdef WORDS_BIGENDIAN
-	buf[0] = old[3];
-	buf[1] = old[2];
-	buf[2] = old[1];
-	buf[3] = old[0];
-#else
-	buf[0] = old[0];
-	buf[1] = old[1];
-	buf[2] = old[2];
-	buf[3] = old[3];
-#endif
+	struct out_context *outc;
+	GStatBuf st;
+	FILE *f;
+	uint64_t riff_size, file_size;
+	uint8_t hdr[12 + 8 + DS64_CHUNK_SIZE], tmp[4];
+	gboolean is_rf64;
+	int ret;
+
+	outc = o->priv;
+	if (!outc || !outc->header_done || !outc->reserve_ds64)
+		return SR_OK;
+	file_size = outc->header_size + outc->data_bytes + (outc->data_bytes & 1);
+	riff_size = file_size - 8;
+	if (g_stat(o->filename, &st) != 0 || !S_ISREG(st.st_mode)) {
+		sr_dbg("Output is not a regular file, sizes remain unset.");
+		return SR_OK;
+	}
+	if ((uint64_t)st.st_size < file_size) {
+		/* Not all output made it to the file, don't touch it. */
+		sr_dbg("Output file incomplete, sizes remain unset.");
+		return SR_OK;
+	}
+
+	f = g_fopen(o->filename, "r+b");
+	if (!f) {
+		sr_err("Cannot reopen '%s' to update the header.", o->filename);
+		return SR_ERR_IO;
+	}
+	ret = SR_ERR_IO;
+	if (fread(hdr, sizeof(hdr), 1, f) != 1)
+		goto out;
+	if (memcmp(hdr, "RIFF", 4) != 0 || memcmp(&hdr[12], "JUNK", 4) != 0) {
+		sr_err("Unexpected header in '%s', not updated.", o->filename);
+		goto out;
+	}
+
+	is_rf64 = riff_size > RIFF_SIZE_MAX || outc->data_bytes > RIFF_SIZE_MAX;
+	if (is_rf64) {
+		memcpy(&hdr[0], "RF64", 4);
+		WL32(&hdr[4], 0xffffffff);
+		memcpy(&hdr[12], "ds64", 4);
+		WL64(&hdr[20], riff_size);
+		WL64(&hdr[28], outc->data_bytes);
+		WL64(&hdr[36], outc->data_bytes /
+			(outc->num_channels * outc->bytes_per_sample));
+		WL32(&hdr[44], 0);
+	} else {
+		WL32(&hdr[4], riff_size);
+	}
+	if (fseek(f, 0, SEEK_SET) != 0 || fwrite(hdr, sizeof(hdr), 1, f) != 1)
+		goto out;
+
+	WL32(tmp, is_rf64 ? 0xffffffff : outc->data_bytes);
+	if (fseek(f, outc->data_size_offset, SEEK_SET) != 0)
+		goto out;
+	if (fwrite(tmp, sizeof(tmp), 1, f) != 1)
+		goto out;
+	ret = SR_OK;
+
+out:
+	if (fclose(f) != 0)
+		ret = SR_ERR_IO;
+	if (ret != SR_OK)
+		sr_err("Failed to update the header of '%s'.", o->filename);
+
+	return ret;
 }
 
 /*
@@ -223,7 +455,7 @@ static int check_chanbuf_size(const struct sr_output *o)
 				/* New high water mark. */
 				size = outc->chanbuf_used[i];
 			}
-		} else if (outc->chanbuf_used[i] != size) {
+		} else if (outc->chanbuf_used[i] != (size_t)size) {
 			/* All channel buffers are not equally full yet. */
 			size = -1;
 			break;
@@ -243,10 +475,8 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	struct sr_channel *ch;
 	GSList *l;
 	const GSList *channels;
-	float f;
-	int num_channels, num_samples, size, *chan_idx, idx, i, j, ret;
-	float *data;
-	uint8_t *buf;
+	int num_channels, num_samples, size, idx, i, j, ret;
+	float *data, *dst;
 
 	*out = NULL;
 	if (!o || !o->sdi || !(outc = o->priv))
@@ -290,29 +520,24 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 			return SR_ERR;
 		}
 
-		if (num_samples > outc->chanbuf_size) {
-			if (realloc_chanbufs(o, analog->num_samples) != SR_OK)
-				return SR_ERR_MALLOC;
-		}
-
-		/* Index the channels in this packet, so we can interleave quicker. */
-		chan_idx = g_malloc(sizeof(int) * outc->num_channels);
-		for (i = 0; i < num_channels; i++) {
-			ch = g_slist_nth_data((GSList *) channels, i);
-			chan_idx[i] = g_slist_index(outc->channels, ch);
-		}
-
-		for (i = 0; i < num_samples; i++) {
-			for (j = 0; j < num_channels; j++) {
-				idx = chan_idx[j];
-				buf = outc->chanbuf[idx] + outc->chanbuf_used[idx]++ * 4;
-				f = data[i * num_channels + j];
-				if (outc->scale != 1.0)
-					f /= outc->scale;
-				float_to_le(buf, f);
+		/* Append each channel's samples to its own buffer. */
+		for (j = 0, l = (GSList *)channels; l; l = l->next, j++) {
+			ch = l->data;
+			idx = g_slist_index(outc->channels, ch);
+			if (idx < 0)
+				continue;
+			ret = grow_chanbufs(o, outc->chanbuf_used[idx] + num_samples);
+			if (ret != SR_OK)
+				return ret;
+			dst = &outc->chanbuf[idx][outc->chanbuf_used[idx]];
+			if (num_channels == 1) {
+				memcpy(dst, data, sizeof(float) * num_samples);
+			} else {
+				for (i = 0; i < num_samples; i++)
+					dst[i] = data[i * num_channels + j];
 			}
+			outc->chanbuf_used[idx] += num_samples;
 		}
-		g_free(chan_idx);
 
 		size = check_chanbuf_size(o);
 		if (size > MIN_DATA_CHUNK_SAMPLES)
@@ -322,10 +547,17 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 	case SR_DF_END:
 		size = check_chanbuf_size(o);
 		if (size > 0) {
-			*out = g_string_sized_new(4 * size * outc->num_channels);
+			*out = g_string_sized_new(size * outc->num_channels *
+				outc->bytes_per_sample + 1);
 			if (flush_chanbufs(o, *out) != SR_OK)
 				return SR_ERR;
 		}
+		if (outc->header_done && (outc->data_bytes & 1)) {
+			/* RIFF chunks are padded to an even size. */
+			if (!*out)
+				*out = g_string_sized_new(1);
+			g_string_append_c(*out, '\0');
+		}
 		break;
 	}
 
@@ -333,14 +565,27 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 }
 
 static struct sr_option options[] = {
-	{ "scale", "Scale", "Scale values by factor", NULL, NULL },
+	{ "scale", "Scale", "Scale values by factor, full scale for PCM formats", NULL, NULL },
+	{ "format", "Format", "Sample format (float32, pcm16, pcm24)", NULL, NULL },
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
-	if (!options[0].def)
+	GSList *l;
+	size_t i;
+
+	if (!options[0].def) {
 		options[0].def = g_variant_ref_sink(g_variant_new_double(1.0));
+		options[1].def = g_variant_ref_sink(g_variant_new_string(
+			format_names[SAMPLE_FLOAT32]));
+		l = NULL;
+		for (i = 0; i < ARRAY_SIZE(format_names); i++) {
+			l = g_slist_append(l, g_variant_ref_sink(
+				g_variant_new_string(format_names[i])));
+		}
+		options[1].values = l;
+	}
 
 	return options;
 }
@@ -352,12 +597,12 @@ static int cleanup(struct sr_output *o)
 
 	outc = o->priv;
 	g_slist_free(outc->channels);
-	g_variant_unref(options[0].def);
 	for (i = 0; i < outc->num_channels; i++)
 		g_free(outc->chanbuf[i]);
 	g_free(outc->chanbuf_used);
 	g_free(outc->chanbuf);
 	g_free(outc->fdata);
+	sr_task_runner_free(outc->runner);
 	g_free(outc);
 	o->priv = NULL;
 
@@ -373,5 +618,6 @@ SR_PRIV struct sr_output_module output_wav = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.finalize = finalize,
 	.cleanup = cleanup,
 };
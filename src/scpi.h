@@ -113,6 +113,19 @@ struct sr_scpi_dev_inst {
 	uint64_t firmware_version;
 	GMutex scpi_mutex;
 	char *actual_channel_name;
+	/* Set when compound queries failed, see sr_scpi_batch_run(). */
+	gboolean no_compound_queries;
+};
+
+struct sr_scpi_batch;
+
+/** Sample format of a binary waveform transfer. */
+struct sr_scpi_sample_format {
+	/** Size of a sample in bytes. */
+	uint8_t unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	gboolean is_bigendian;
 };
 
 SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
@@ -159,6 +172,16 @@ SR_PRIV int sr_scpi_get_data(struct sr_scpi_dev_inst *scpi,
 			const char *command, GString **scpi_response);
 SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 			const char *command, GByteArray **scpi_response);
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+			const char *command, uint8_t *buf, size_t bufsize,
+			size_t *length);
+SR_PRIV int sr_scpi_get_samples(struct sr_scpi_dev_inst *scpi,
+			const char *command,
+			const struct sr_scpi_sample_format *format,
+			GByteArray **scpi_response, size_t *num_samples);
+SR_PRIV void sr_scpi_sample_encoding(const struct sr_scpi_sample_format *format,
+			double scale, double offset,
+			struct sr_analog_encoding *encoding);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
@@ -177,6 +200,24 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 		int channel_command, const char *channel_name,
 		GVariant **gvar, const GVariantType *gvtype, int command, ...);
 
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(struct sr_scpi_dev_inst *scpi);
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch);
+SR_PRIV int sr_scpi_batch_add(struct sr_scpi_batch *batch,
+		int *response_idx, const char *format, ...);
+SR_PRIV int sr_scpi_batch_add_cmd(struct sr_scpi_batch *batch,
+		const struct scpi_command *cmdtable,
+		int channel_command, const char *channel_name,
+		int *response_idx, int command, ...);
+SR_PRIV int sr_scpi_batch_run(struct sr_scpi_batch *batch);
+SR_PRIV const char *sr_scpi_batch_get_string(struct sr_scpi_batch *batch,
+		int idx);
+SR_PRIV int sr_scpi_batch_get_bool(struct sr_scpi_batch *batch,
+		int idx, gboolean *scpi_response);
+SR_PRIV int sr_scpi_batch_get_double(struct sr_scpi_batch *batch,
+		int idx, double *scpi_response);
+SR_PRIV int sr_scpi_batch_get_variant(struct sr_scpi_batch *batch,
+		int idx, GVariant **gvar, const GVariantType *gvtype);
+
 /*--- GPIB only functions ---------------------------------------------------*/
 
 #ifdef HAVE_LIBGPIB
@@ -20,6 +20,7 @@
 
 #include <config.h>
 #include <glib.h>
+#include <math.h>
 #include <string.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
@@ -77,6 +78,39 @@ static int parse_strict_bool(const char *str, gboolean *ret)
 	return SR_ERR;
 }
 
+/**
+ * Convert a SCPI response to a GVariant of the requested type.
+ *
+ * @param str The response text.
+ * @param gvtype The desired type: boolean, double or string.
+ * @param gvar Pointer where to store the new GVariant.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+static int parse_variant(const char *str, const GVariantType *gvtype,
+	GVariant **gvar)
+{
+	gboolean b;
+	double d;
+	int ret;
+
+	ret = SR_OK;
+	if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_BOOLEAN)) {
+		if ((ret = parse_strict_bool(str, &b)) == SR_OK)
+			*gvar = g_variant_new_boolean(b);
+	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_DOUBLE)) {
+		if ((ret = sr_atod_ascii(str, &d)) == SR_OK)
+			*gvar = g_variant_new_double(d);
+	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_STRING)) {
+		*gvar = g_variant_new_string(str);
+	} else {
+		sr_err("Unable to convert to desired GVariant type.");
+		ret = SR_ERR_NA;
+	}
+
+	return ret;
+}
+
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_serial_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_tcp_raw_dev;
 SR_PRIV extern const struct sr_scpi_dev_inst scpi_tcp_rigol_dev;
@@ -105,32 +139,275 @@ static const struct sr_scpi_dev_inst *scpi_devs[] = {
 #endif
 };
 
-static struct sr_dev_inst *sr_scpi_scan_resource(struct drv_context *drvc,
-		const char *resource, const char *serialcomm,
+/* Number of resources which get probed concurrently. */
+#define SCAN_THREADS		8
+
+/*
+ * Connections which a scan kept open, such that opening the device
+ * does not need to connect again. Unused connections get closed after
+ * some time, upon the next scan or open.
+ */
+#define SCPI_CONN_CACHE_SIZE	8
+#define SCPI_CONN_CACHE_TTL_US	(10 * 1000 * 1000)
+
+struct scpi_conn {
+	char *resource;
+	struct sr_scpi_dev_inst *scpi;
+	struct sr_scpi_hw_info *hw_info;
+	/* Time when the probe was done, 0 while the scan probes. */
+	gint64 time_us;
+};
+
+static GMutex conn_cache_mutex;
+/* Most recently added connections first. */
+static GSList *conn_cache;
+
+struct scan_job {
+	struct drv_context *drvc;
+	char *resource;
+	char *serialcomm;
+	char *connection_id;
+	gboolean concurrent;
+	struct sr_scpi_dev_inst *scpi;
+	struct sr_scpi_hw_info *hw_info;
+	struct sr_dev_inst *sdi;
+};
+
+/* Find the transport for a resource. */
+static const struct sr_scpi_dev_inst *scpi_dev_get(const char *resource)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(scpi_devs); i++) {
+		if (!strncmp(resource, scpi_devs[i]->prefix,
+				strlen(scpi_devs[i]->prefix)))
+			return scpi_devs[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Transports whose open, communication and close were checked to not
+ * share state between instances, such that their resources can get
+ * probed concurrently. Others get probed one after another.
+ */
+static gboolean scpi_scan_concurrent(const struct sr_scpi_dev_inst *dev)
+{
+	switch (dev->transport) {
+	case SCPI_TRANSPORT_RAW_TCP:
+	case SCPI_TRANSPORT_RIGOL_TCP:
+	case SCPI_TRANSPORT_USBTMC:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+ * Network transports, whose connections can be kept open after the
+ * scan. Serial and USB connections may hold exclusive access to the
+ * port, they are closed after the probe.
+ */
+static gboolean scpi_scan_keep_open(const struct sr_scpi_dev_inst *scpi)
+{
+	switch (scpi->transport) {
+	case SCPI_TRANSPORT_RAW_TCP:
+	case SCPI_TRANSPORT_RIGOL_TCP:
+	case SCPI_TRANSPORT_VXI:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static int scpi_close(struct sr_scpi_dev_inst *scpi)
+{
+	int ret;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi->close(scpi);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
+static struct sr_scpi_hw_info *hw_info_copy(const struct sr_scpi_hw_info *src)
+{
+	struct sr_scpi_hw_info *hw_info;
+
+	hw_info = g_malloc0(sizeof(*hw_info));
+	hw_info->manufacturer = g_strdup(src->manufacturer);
+	hw_info->model = g_strdup(src->model);
+	hw_info->serial_number = g_strdup(src->serial_number);
+	hw_info->firmware_version = g_strdup(src->firmware_version);
+
+	return hw_info;
+}
+
+static void scpi_conn_free(struct scpi_conn *conn)
+{
+	if (!conn)
+		return;
+
+	g_free(conn->resource);
+	sr_scpi_hw_info_free(conn->hw_info);
+	g_free(conn);
+}
+
+/* Find a cached connection, by instance or by resource. */
+static struct scpi_conn *conn_cache_find(const struct sr_scpi_dev_inst *scpi,
+		const char *resource)
+{
+	struct scpi_conn *conn;
+	GSList *l;
+
+	for (l = conn_cache; l; l = l->next) {
+		conn = l->data;
+		if (scpi && conn->scpi == scpi)
+			return conn;
+		if (resource && !strcmp(conn->resource, resource))
+			return conn;
+	}
+
+	return NULL;
+}
+
+/* Remove a connection from the cache, optionally close it. */
+static void conn_cache_drop(struct scpi_conn *conn, gboolean close)
+{
+	conn_cache = g_slist_remove(conn_cache, conn);
+	if (close) {
+		sr_dbg("Closing unused connection to %s.", conn->resource);
+		scpi_close(conn->scpi);
+	}
+	scpi_conn_free(conn);
+}
+
+/*
+ * Close connections which were not used in time, and the oldest ones
+ * when there are too many. Connections which get probed are kept.
+ * Called with the cache locked.
+ */
+static void conn_cache_expire(void)
+{
+	struct scpi_conn *conn;
+	GSList *l, *next;
+	gint64 now;
+	guint count;
+
+	now = g_get_monotonic_time();
+	count = 0;
+	for (l = conn_cache; l; l = next) {
+		next = l->next;
+		conn = l->data;
+		if (!conn->time_us)
+			continue;
+		if (++count > SCPI_CONN_CACHE_SIZE ||
+				now - conn->time_us >= SCPI_CONN_CACHE_TTL_US)
+			conn_cache_drop(conn, TRUE);
+	}
+}
+
+static void scan_job_run_probe(struct scan_job *job,
 		struct sr_dev_inst *(*probe_device)(struct sr_scpi_dev_inst *scpi))
 {
 	struct sr_scpi_dev_inst *scpi;
-	struct sr_dev_inst *sdi;
+	struct scpi_conn *conn;
+	gboolean keep;
 
-	if (!(scpi = scpi_dev_inst_new(drvc, resource, serialcomm)))
-		return NULL;
+	/*
+	 * Have the connection and the identification in the cache, the
+	 * probe's sr_scpi_get_hw_id() and sr_dev_open() take them there.
+	 */
+	scpi = job->scpi;
+	conn = g_malloc0(sizeof(*conn));
+	conn->resource = g_strdup(job->resource);
+	conn->scpi = scpi;
+	conn->hw_info = job->hw_info;
+	job->hw_info = NULL;
+	g_mutex_lock(&conn_cache_mutex);
+	conn_cache = g_slist_prepend(conn_cache, conn);
+	g_mutex_unlock(&conn_cache_mutex);
+
+	job->sdi = probe_device(scpi);
+
+	/* The probe may have closed the connection, which drops it. */
+	g_mutex_lock(&conn_cache_mutex);
+	conn = conn_cache_find(scpi, NULL);
+	keep = job->sdi && scpi_scan_keep_open(scpi);
+	if (conn && keep) {
+		conn->time_us = g_get_monotonic_time();
+		conn_cache_expire();
+	} else if (conn) {
+		conn_cache_drop(conn, TRUE);
+	}
+	g_mutex_unlock(&conn_cache_mutex);
 
-	if (sr_scpi_open(scpi) != SR_OK) {
-		sr_info("Couldn't open SCPI device.");
+	if (job->sdi) {
+		job->sdi->status = SR_ST_INACTIVE;
+		if (job->connection_id)
+			job->sdi->connection_id = g_strdup(job->connection_id);
+	} else {
 		sr_scpi_free(scpi);
-		return NULL;
-	};
+	}
+	job->scpi = NULL;
+}
 
-	sdi = probe_device(scpi);
+/*
+ * Open a resource and get its identification. Drivers' probe routines
+ * run in the scan's thread afterwards, this part may run concurrently.
+ */
+static int scan_job_run(size_t idx, void *cb_data)
+{
+	GPtrArray *jobs;
+	struct scan_job *job;
 
-	sr_scpi_close(scpi);
+	jobs = cb_data;
+	job = jobs->pdata[idx];
+	job->scpi = scpi_dev_inst_new(job->drvc, job->resource, job->serialcomm);
+	if (!job->scpi)
+		return SR_OK;
 
-	if (sdi)
-		sdi->status = SR_ST_INACTIVE;
-	else
-		sr_scpi_free(scpi);
+	if (sr_scpi_open(job->scpi) != SR_OK) {
+		sr_info("Couldn't open SCPI device.");
+		sr_scpi_free(job->scpi);
+		job->scpi = NULL;
+		return SR_OK;
+	}
+	/* Not all devices answer *IDN?, leave the decision to the probe. */
+	if (sr_scpi_get_hw_id(job->scpi, &job->hw_info) != SR_OK)
+		job->hw_info = NULL;
+
+	return SR_OK;
+}
+
+static void scan_job_free(gpointer data)
+{
+	struct scan_job *job;
 
-	return sdi;
+	job = data;
+	g_free(job->resource);
+	g_free(job->serialcomm);
+	g_free(job->connection_id);
+	g_free(job);
+}
+
+static void scan_job_add(GPtrArray *jobs, struct drv_context *drvc,
+		const char *resource, const char *serialcomm,
+		const char *connection_id)
+{
+	const struct sr_scpi_dev_inst *dev;
+	struct scan_job *job;
+
+	dev = scpi_dev_get(resource);
+	job = g_malloc0(sizeof(*job));
+	job->drvc = drvc;
+	job->resource = g_strdup(resource);
+	job->serialcomm = g_strdup(serialcomm);
+	job->connection_id = g_strdup(connection_id);
+	job->concurrent = dev && scpi_scan_concurrent(dev);
+	g_ptr_array_add(jobs, job);
 }
 
 /**
@@ -290,11 +567,15 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 	response = *scpi_response;
 
 	while (!sr_scpi_read_complete(scpi)) {
-		/* Resize the buffer when free space drops below a threshold. */
+		/*
+		 * Resize the buffer when free space drops below a threshold.
+		 * Grow geometrically, to limit the number of reallocations
+		 * for large responses.
+		 */
 		space = response->allocated_len - response->len;
 		if (space < 128) {
 			int oldlen = response->len;
-			g_string_set_size(response, oldlen + 1024);
+			g_string_set_size(response, oldlen + MAX(oldlen, 1024));
 			g_string_set_size(response, oldlen);
 		}
 
@@ -310,15 +591,39 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 	return SR_OK;
 }
 
+/**
+ * Scan for SCPI devices.
+ *
+ * The SR_CONF_CONN option can list several resources, separated by
+ * commas (e.g. "tcp-raw/192.168.1.10/5025,tcp-raw/192.168.1.11/5025").
+ * A transport's prefix without parameters (e.g. "usbtmc") lists the
+ * transport's resources. Without the option, the resources of all
+ * transports are listed.
+ *
+ * The resources of suitable transports get opened and identified
+ * concurrently, such that unresponsive ones don't add up their
+ * timeouts. The probe_device callback runs in the caller's thread.
+ * Network connections of found devices are kept open for a while, to
+ * save a reconnect in sr_scpi_open().
+ *
+ * @param drvc The driver's context.
+ * @param options The scan options.
+ * @param probe_device Callback which checks for a supported device.
+ *
+ * @return The list of found devices, in the order of their resources.
+ */
 SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 		struct sr_dev_inst *(*probe_device)(struct sr_scpi_dev_inst *scpi))
 {
 	GSList *resources, *l, *devices;
-	struct sr_dev_inst *sdi;
 	const char *resource = NULL;
 	const char *serialcomm = NULL;
-	gchar **res;
-	unsigned i;
+	GPtrArray *jobs, *concurrent;
+	struct scan_job *job;
+	struct scpi_conn *conn;
+	struct sr_task_runner *runner;
+	gchar **conns, **res, *name;
+	unsigned i, j;
 
 	for (l = options; l; l = l->next) {
 		struct sr_config *src = l->data;
@@ -332,29 +637,85 @@ SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 		}
 	}
 
-	devices = NULL;
+	jobs = g_ptr_array_new_with_free_func(scan_job_free);
+	conns = g_strsplit(resource ? resource : "", ",", 0);
 	for (i = 0; i < ARRAY_SIZE(scpi_devs); i++) {
-		if ((resource && strcmp(resource, scpi_devs[i]->prefix))
-		    || !scpi_devs[i]->scan)
+		if (!scpi_devs[i]->scan)
+			continue;
+		for (j = 0; resource && conns[j]; j++) {
+			name = g_strstrip(conns[j]);
+			if (*name && !strcmp(name, scpi_devs[i]->prefix))
+				break;
+		}
+		if (resource && !conns[j])
 			continue;
 		resources = scpi_devs[i]->scan(drvc);
 		for (l = resources; l; l = l->next) {
 			res = g_strsplit(l->data, ":", 2);
-			if (res[0] && (sdi = sr_scpi_scan_resource(drvc, res[0],
-			               serialcomm ? serialcomm : res[1], probe_device))) {
-				devices = g_slist_append(devices, sdi);
-				sdi->connection_id = g_strdup(l->data);
+			if (res[0]) {
+				scan_job_add(jobs, drvc, res[0],
+					serialcomm ? serialcomm : res[1], l->data);
 			}
 			g_strfreev(res);
 		}
 		g_slist_free_full(resources, g_free);
 	}
+	for (j = 0; resource && conns[j]; j++) {
+		name = g_strstrip(conns[j]);
+		if (!*name)
+			continue;
+		for (i = 0; i < ARRAY_SIZE(scpi_devs); i++) {
+			if (scpi_devs[i]->scan && !strcmp(name, scpi_devs[i]->prefix))
+				break;
+		}
+		if (i == ARRAY_SIZE(scpi_devs))
+			scan_job_add(jobs, drvc, name, serialcomm, NULL);
+	}
+	g_strfreev(conns);
+
+	/*
+	 * Connections which previous scans kept open get closed, devices
+	 * may accept only one connection at a time.
+	 */
+	g_mutex_lock(&conn_cache_mutex);
+	for (i = 0; i < jobs->len; i++) {
+		job = jobs->pdata[i];
+		conn = conn_cache_find(NULL, job->resource);
+		if (conn && conn->time_us)
+			conn_cache_drop(conn, TRUE);
+	}
+	conn_cache_expire();
+	g_mutex_unlock(&conn_cache_mutex);
 
-	if (!devices && resource) {
-		sdi = sr_scpi_scan_resource(drvc, resource, serialcomm, probe_device);
-		if (sdi)
-			devices = g_slist_append(NULL, sdi);
+	/*
+	 * Open the resources of suitable transports concurrently, then
+	 * the remaining ones. Keep the order of the results.
+	 */
+	concurrent = g_ptr_array_new();
+	for (i = 0; i < jobs->len; i++) {
+		job = jobs->pdata[i];
+		if (job->concurrent)
+			g_ptr_array_add(concurrent, job);
+	}
+	runner = NULL;
+	if (concurrent->len > 1)
+		runner = sr_task_runner_new(MIN(concurrent->len, SCAN_THREADS));
+	sr_task_runner_run(runner, concurrent->len, scan_job_run, concurrent);
+	sr_task_runner_free(runner);
+	g_ptr_array_free(concurrent, TRUE);
+
+	devices = NULL;
+	for (i = 0; i < jobs->len; i++) {
+		job = jobs->pdata[i];
+		if (!job->concurrent)
+			scan_job_run(i, jobs);
+		if (job->scpi)
+			scan_job_run_probe(job, probe_device);
+		sr_scpi_hw_info_free(job->hw_info);
+		if (job->sdi)
+			devices = g_slist_append(devices, job->sdi);
 	}
+	g_ptr_array_free(jobs, TRUE);
 
 	/* Tack a copy of the newly found devices onto the driver list. */
 	if (devices)
@@ -366,29 +727,26 @@ SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 SR_PRIV struct sr_scpi_dev_inst *scpi_dev_inst_new(struct drv_context *drvc,
 		const char *resource, const char *serialcomm)
 {
-	struct sr_scpi_dev_inst *scpi = NULL;
+	struct sr_scpi_dev_inst *scpi;
 	const struct sr_scpi_dev_inst *scpi_dev;
 	gchar **params;
-	unsigned i;
 
-	for (i = 0; i < ARRAY_SIZE(scpi_devs); i++) {
-		scpi_dev = scpi_devs[i];
-		if (!strncmp(resource, scpi_dev->prefix, strlen(scpi_dev->prefix))) {
-			sr_dbg("Opening %s device %s.", scpi_dev->name, resource);
-			scpi = g_malloc(sizeof(*scpi));
-			*scpi = *scpi_dev;
-			scpi->priv = g_malloc0(scpi->priv_size);
-			scpi->read_timeout_us = 1000 * 1000;
-			params = g_strsplit(resource, "/", 0);
-			if (scpi->dev_inst_new(scpi->priv, drvc, resource,
-			                       params, serialcomm) != SR_OK) {
-				sr_scpi_free(scpi);
-				scpi = NULL;
-			}
-			g_strfreev(params);
-			break;
-		}
+	if (!(scpi_dev = scpi_dev_get(resource)))
+		return NULL;
+
+	sr_dbg("Opening %s device %s.", scpi_dev->name, resource);
+	scpi = g_malloc(sizeof(*scpi));
+	*scpi = *scpi_dev;
+	g_mutex_init(&scpi->scpi_mutex);
+	scpi->priv = g_malloc0(scpi->priv_size);
+	scpi->read_timeout_us = 1000 * 1000;
+	params = g_strsplit(resource, "/", 0);
+	if (scpi->dev_inst_new(scpi->priv, drvc, resource,
+	                       params, serialcomm) != SR_OK) {
+		sr_scpi_free(scpi);
+		scpi = NULL;
 	}
+	g_strfreev(params);
 
 	return scpi;
 }
@@ -402,7 +760,21 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_dev_inst_new(struct drv_context *drvc,
  */
 SR_PRIV int sr_scpi_open(struct sr_scpi_dev_inst *scpi)
 {
-	g_mutex_init(&scpi->scpi_mutex);
+	struct scpi_conn *conn;
+	gboolean reuse;
+
+	/* Take the connection which the scan kept open, if any. */
+	g_mutex_lock(&conn_cache_mutex);
+	conn_cache_expire();
+	conn = conn_cache_find(scpi, NULL);
+	reuse = conn != NULL;
+	if (conn) {
+		sr_dbg("Reusing the scan's connection to %s.", conn->resource);
+		conn_cache_drop(conn, FALSE);
+	}
+	g_mutex_unlock(&conn_cache_mutex);
+	if (reuse)
+		return SR_OK;
 
 	return scpi->open(scpi);
 }
@@ -580,14 +952,14 @@ SR_PRIV int sr_scpi_read_complete(struct sr_scpi_dev_inst *scpi)
  */
 SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi)
 {
-	int ret;
+	struct scpi_conn *conn;
 
-	g_mutex_lock(&scpi->scpi_mutex);
-	ret = scpi->close(scpi);
-	g_mutex_unlock(&scpi->scpi_mutex);
-	g_mutex_clear(&scpi->scpi_mutex);
+	g_mutex_lock(&conn_cache_mutex);
+	if ((conn = conn_cache_find(scpi, NULL)))
+		conn_cache_drop(conn, FALSE);
+	g_mutex_unlock(&conn_cache_mutex);
 
-	return ret;
+	return scpi_close(scpi);
 }
 
 /**
@@ -598,12 +970,21 @@ SR_PRIV int sr_scpi_close(struct sr_scpi_dev_inst *scpi)
  */
 SR_PRIV void sr_scpi_free(struct sr_scpi_dev_inst *scpi)
 {
+	struct scpi_conn *conn;
+
 	if (!scpi)
 		return;
 
+	/* Close a connection which the scan kept open. */
+	g_mutex_lock(&conn_cache_mutex);
+	if ((conn = conn_cache_find(scpi, NULL)))
+		conn_cache_drop(conn, TRUE);
+	g_mutex_unlock(&conn_cache_mutex);
+
 	scpi->free(scpi->priv);
 	g_free(scpi->priv);
 	g_free(scpi->actual_channel_name);
+	g_mutex_clear(&scpi->scpi_mutex);
 	g_free(scpi);
 }
 
@@ -853,32 +1234,29 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 {
 	int ret;
 	float tmp;
-	char *response;
-	gchar **ptr, **tokens;
+	char *response, *token, *sep;
 	GArray *response_array;
 
 	response = NULL;
-	tokens = NULL;
 
 	ret = sr_scpi_get_string(scpi, command, &response);
 	if (ret != SR_OK && !response)
 		return ret;
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
-
+	/* Split the (potentially long) list in place. */
 	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), 256);
-
-	while (*ptr) {
-		if (sr_atof_ascii(*ptr, &tmp) == SR_OK)
+	token = *response ? response : NULL;
+	while (token) {
+		sep = strchr(token, ',');
+		if (sep)
+			*sep++ = '\0';
+		if (sr_atof_ascii(token, &tmp) == SR_OK)
 			response_array = g_array_append_val(response_array,
 							    tmp);
 		else
 			ret = SR_ERR_DATA;
-
-		ptr++;
+		token = sep;
 	}
-	g_strfreev(tokens);
 	g_free(response);
 
 	if (ret != SR_OK && response_array->len == 0) {
@@ -948,62 +1326,59 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 	return ret;
 }
 
-/**
- * Send a SCPI command, read the reply, parse it as binary data with a
- * "definite length block" header and store the as an result in scpi_response.
- *
- * @param scpi Previously initialised SCPI device structure.
- * @param command The SCPI command to send to the device (can be NULL).
- * @param scpi_response Pointer where to store the parsed result.
- *
- * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
- *         error or upon no response. The allocated response must be freed by
- *         the caller in the case of an SR_OK as well as in the case of
- *         parsing error.
+/*
+ * Consume the response message's terminator after a data block, such
+ * that it does not precede the next response. Devices may send none.
  */
-SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
-			       const char *command, GByteArray **scpi_response)
+static void scpi_read_block_end(struct sr_scpi_dev_inst *scpi)
+{
+	char buf[2];
+	int len;
+
+	while (!sr_scpi_read_complete(scpi)) {
+		len = scpi_read_data(scpi, buf, sizeof(buf));
+		if (len <= 0 || buf[len - 1] == '\n')
+			break;
+	}
+}
+
+/*
+ * Read a "definite length block" response, without mutex. The data
+ * goes to a newly allocated byte array, or to a caller provided buffer.
+ */
+static int scpi_read_block(struct sr_scpi_dev_inst *scpi,
+	const char *command, GByteArray **array,
+	uint8_t *dest, size_t dest_size, size_t *length)
 {
 	int ret;
-	GString* response;
-	gsize oldlen;
+	GString *header;
 	char buf[10];
 	long llen;
 	long datalen;
-	gint64 timeout;
-
-	g_mutex_lock(&scpi->scpi_mutex);
+	size_t got, capacity, remaining, chunk;
+	uint8_t scratch[4096];
+	uint8_t *data;
+	gint64 start, timeout, elapsed;
 
 	if (command)
-		if (scpi_send(scpi, command) != SR_OK) {
-			g_mutex_unlock(&scpi->scpi_mutex);
+		if (scpi_send(scpi, command) != SR_OK)
 			return SR_ERR;
-		}
 
-	if (sr_scpi_read_begin(scpi) != SR_OK) {
-		g_mutex_unlock(&scpi->scpi_mutex);
+	if (sr_scpi_read_begin(scpi) != SR_OK)
 		return SR_ERR;
-	}
-
-	/*
-	 * Assume an initial maximum length, optionally gets adjusted below.
-	 * Prepare a NULL return value for when error paths will be taken.
-	 */
-	response = g_string_sized_new(1024);
-
-	timeout = g_get_monotonic_time() + scpi->read_timeout_us;
 
-	*scpi_response = NULL;
+	start = g_get_monotonic_time();
+	timeout = start + scpi->read_timeout_us;
 
 	/* Get (the first chunk of) the response. */
+	header = g_string_sized_new(1024);
 	do {
-		ret = scpi_read_response(scpi, response, timeout);
+		ret = scpi_read_response(scpi, header, timeout);
 		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
+			g_string_free(header, TRUE);
 			return ret;
 		}
-	} while (response->len < 2);
+	} while (header->len < 2);
 
 	/*
 	 * SCPI protocol data blocks are preceeded with a length spec.
@@ -1012,85 +1387,266 @@ SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
 	 * respective number of characters which specify the data block's
 	 * length. Raw data bytes follow (thus one must no longer assume
 	 * that the received input stream would be an ASCIIZ string).
-	 *
-	 * Get the data block length, and strip off the length spec from
-	 * the input buffer, leaving just the data bytes.
 	 */
-	if (response->str[0] != '#') {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+	if (header->str[0] != '#') {
+		g_string_free(header, TRUE);
 		return SR_ERR_DATA;
 	}
-	buf[0] = response->str[1];
+	buf[0] = header->str[1];
 	buf[1] = '\0';
 	ret = sr_atol(buf, &llen);
 	if ((ret != SR_OK) || (llen == 0)) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+		g_string_free(header, TRUE);
 		return ret;
 	}
 
-	while (response->len < (unsigned long)(2 + llen)) {
-		ret = scpi_read_response(scpi, response, timeout);
+	while (header->len < (unsigned long)(2 + llen)) {
+		ret = scpi_read_response(scpi, header, timeout);
 		if (ret < 0) {
-			g_mutex_unlock(&scpi->scpi_mutex);
-			g_string_free(response, TRUE);
+			g_string_free(header, TRUE);
 			return ret;
 		}
 	}
 
-	memcpy(buf, &response->str[2], llen);
+	memcpy(buf, &header->str[2], llen);
 	buf[llen] = '\0';
 	ret = sr_atol(buf, &datalen);
-	if ((ret != SR_OK) || (datalen == 0)) {
-		g_mutex_unlock(&scpi->scpi_mutex);
-		g_string_free(response, TRUE);
+	if ((ret != SR_OK) || (datalen <= 0)) {
+		g_string_free(header, TRUE);
 		return ret;
 	}
-	g_string_erase(response, 0, 2 + llen);
 
 	/*
-	 * Re-allocate the buffer size to the now known length
-	 * and keep reading more chunks of response data.
+	 * Now that the length is known, allocate the final buffer once,
+	 * and have the transport read directly into it. Data which does
+	 * not fit into a caller provided buffer gets discarded. Reads
+	 * never extend past the block's end.
 	 */
-	oldlen = response->len;
-	g_string_set_size(response, datalen);
-	g_string_set_size(response, oldlen);
-
-	if (oldlen < (unsigned long)(datalen)) {
-		do {
-			oldlen = response->len;
-			ret = scpi_read_response(scpi, response, timeout);
-
-			/* On timeout truncate the buffer and send the partial response
-			 * instead of getting stuck on timeouts...
-			 */
-			if (ret == SR_ERR_TIMEOUT) {
-				datalen = oldlen;
-				break;
-			}
-			if (ret < 0) {
-				g_mutex_unlock(&scpi->scpi_mutex);
-				g_string_free(response, TRUE);
-				return ret;
-			}
-			if (ret > 0)
-				timeout = g_get_monotonic_time() + scpi->read_timeout_us;
-		} while (response->len < (unsigned long)(datalen));
+	if (array) {
+		*array = g_byte_array_sized_new(datalen);
+		g_byte_array_set_size(*array, datalen);
+		data = (*array)->data;
+		capacity = datalen;
+	} else {
+		data = dest;
+		capacity = dest_size;
+	}
+	got = header->len - 2 - llen;
+	got = MIN(got, (size_t)datalen);
+	memcpy(data, &header->str[2 + llen], MIN(got, capacity));
+	g_string_free(header, TRUE);
+
+	while (got < (size_t)datalen) {
+		remaining = (size_t)datalen - got;
+		if (got < capacity) {
+			chunk = MIN(capacity - got, remaining);
+			chunk = MIN(chunk, (size_t)G_MAXINT);
+			ret = scpi_read_data(scpi, (char *)&data[got], chunk);
+		} else {
+			chunk = MIN(sizeof(scratch), remaining);
+			ret = scpi_read_data(scpi, (char *)scratch, chunk);
+		}
+		if (ret < 0) {
+			sr_err("Incompletely read SCPI response.");
+			break;
+		}
+		if (ret > 0) {
+			got += ret;
+			timeout = g_get_monotonic_time() + scpi->read_timeout_us;
+			continue;
+		}
+		/*
+		 * On timeout truncate the buffer and send the partial
+		 * response instead of getting stuck on timeouts...
+		 */
+		if (g_get_monotonic_time() > timeout) {
+			sr_err("Timed out waiting for SCPI response.");
+			ret = SR_ERR_TIMEOUT;
+			break;
+		}
 	}
+	if (ret < 0 && ret != SR_ERR_TIMEOUT) {
+		if (array) {
+			g_byte_array_free(*array, TRUE);
+			*array = NULL;
+		}
+		return ret;
+	}
+	if (got == (size_t)datalen)
+		scpi_read_block_end(scpi);
 
-	g_mutex_unlock(&scpi->scpi_mutex);
+	if (array)
+		g_byte_array_set_size(*array, got);
+	if (length)
+		*length = MIN(got, capacity);
 
-	/* Convert received data to byte array. */
-	*scpi_response = g_byte_array_new_take(
-		(guint8*)g_string_free(response, FALSE), datalen);
+	elapsed = MAX(g_get_monotonic_time() - start, 1);
+	sr_dbg("Read %zu/%ld bytes of block data in %" PRIi64 " ms, %.1f MB/s.",
+		got, datalen, elapsed / 1000, (double)got / elapsed);
 
 	return SR_OK;
 }
 
 /**
- * Send the *IDN? SCPI command, receive the reply, parse it and store the
- * reply as a sr_scpi_hw_info structure in the supplied scpi_response pointer.
+ * Send a SCPI command, read the reply, parse it as binary data with a
+ * "definite length block" header and store the as an result in scpi_response.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param scpi_response Pointer where to store the parsed result.
+ *
+ * @return SR_OK upon successfully parsing all values, SR_ERR* upon a parsing
+ *         error or upon no response. The allocated response must be freed by
+ *         the caller in the case of an SR_OK as well as in the case of
+ *         parsing error.
+ */
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			       const char *command, GByteArray **scpi_response)
+{
+	int ret;
+
+	*scpi_response = NULL;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_read_block(scpi, command, scpi_response, NULL, 0, NULL);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
+/**
+ * Send a SCPI command, read the reply, parse it as binary data with a
+ * "definite length block" header and store the data in a caller provided
+ * buffer.
+ *
+ * Data which exceeds the buffer's size is read and discarded.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param buf Buffer where to store the data.
+ * @param bufsize Size of the buffer.
+ * @param length Pointer where to store the number of bytes stored.
+ *
+ * @return SR_OK upon success, SR_ERR* upon a parsing error or upon no
+ *         response.
+ */
+SR_PRIV int sr_scpi_get_block_into(struct sr_scpi_dev_inst *scpi,
+	const char *command, uint8_t *buf, size_t bufsize, size_t *length)
+{
+	int ret;
+
+	if (!buf || !length)
+		return SR_ERR_ARG;
+
+	*length = 0;
+
+	g_mutex_lock(&scpi->scpi_mutex);
+	ret = scpi_read_block(scpi, command, NULL, buf, bufsize, length);
+	g_mutex_unlock(&scpi->scpi_mutex);
+
+	return ret;
+}
+
+/**
+ * Send a SCPI command, and read a binary sample block in the given format.
+ *
+ * Selecting the transfer format (like ":WAV:FORM BYTE" or "FORM REAL,32")
+ * is up to the caller, since devices differ in their syntax. The samples
+ * are kept in their wire format, see sr_scpi_sample_encoding() for how to
+ * pass them to the session without a conversion to float.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param format The sample format of the transfer.
+ * @param scpi_response Pointer where to store the sample data.
+ * @param num_samples Pointer where to store the number of samples.
+ *
+ * @return SR_OK upon success, SR_ERR* upon a parsing error or upon no
+ *         response. The allocated response must be freed by the caller
+ *         in the case of an SR_OK as well as in the case of an error.
+ */
+SR_PRIV int sr_scpi_get_samples(struct sr_scpi_dev_inst *scpi,
+	const char *command, const struct sr_scpi_sample_format *format,
+	GByteArray **scpi_response, size_t *num_samples)
+{
+	int ret;
+	size_t len;
+
+	*num_samples = 0;
+	if (!format || !format->unitsize)
+		return SR_ERR_ARG;
+
+	ret = sr_scpi_get_block(scpi, command, scpi_response);
+	if (ret != SR_OK || !*scpi_response)
+		return ret;
+
+	/* Drop a trailing partial sample of a truncated block. */
+	len = (*scpi_response)->len;
+	if (len % format->unitsize) {
+		sr_dbg("Ignoring %zu trailing bytes of sample block.",
+			len % format->unitsize);
+		g_byte_array_set_size(*scpi_response, len - len % format->unitsize);
+	}
+	*num_samples = (*scpi_response)->len / format->unitsize;
+
+	return SR_OK;
+}
+
+/*
+ * Represent a value as p / 2^n. This is exact for all of the double's
+ * 53 significant bits, as long as 2^n fits into 'q'. Smaller values keep
+ * fewer bits, still the precision of a float down to about 1e-11.
+ */
+static void scpi_rational_from_double(struct sr_rational *r, double value)
+{
+	int exp, shift;
+	int64_t p;
+	uint64_t q;
+
+	if (value == 0 || !isfinite(value)) {
+		sr_rational_set(r, 0, 1);
+		return;
+	}
+
+	/* Saturate values which don't fit into 'p'. */
+	value = CLAMP(value, -0x1p62, 0x1p62);
+	frexp(value, &exp);
+	shift = CLAMP(53 - exp, 0, 63);
+	p = llround(ldexp(value, shift));
+	q = UINT64_C(1) << shift;
+	while (q > 1 && !(p & 1)) {
+		p /= 2;
+		q /= 2;
+	}
+	sr_rational_set(r, p, q);
+}
+
+/**
+ * Describe sample data in a SCPI transfer format for the session.
+ *
+ * Sets up an analog payload's encoding such that raw samples of @p format
+ * translate to physical values by means of: value = raw * scale + offset.
+ * Should be called after sr_analog_init(), which assumes float data.
+ *
+ * @param format The sample format of the transfer.
+ * @param scale The factor which gets applied to raw sample values.
+ * @param offset The offset which gets added after scaling.
+ * @param encoding The analog encoding to set up.
+ */
+SR_PRIV void sr_scpi_sample_encoding(const struct sr_scpi_sample_format *format,
+	double scale, double offset, struct sr_analog_encoding *encoding)
+{
+	encoding->unitsize = format->unitsize;
+	encoding->is_signed = format->is_signed || format->is_float;
+	encoding->is_float = format->is_float;
+	encoding->is_bigendian = format->is_bigendian;
+	scpi_rational_from_double(&encoding->scale, scale);
+	scpi_rational_from_double(&encoding->offset, offset);
+}
+
+/**
+ * Send the *IDN? SCPI command, receive the reply, parse it and store the
+ * reply as a sr_scpi_hw_info structure in the supplied scpi_response pointer.
  *
  * The hw_info structure must be freed by the caller via sr_scpi_hw_info_free().
  *
@@ -1106,8 +1662,19 @@ SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 	char *response;
 	gchar **tokens;
 	struct sr_scpi_hw_info *hw_info;
+	struct scpi_conn *conn;
 	gchar *idn_substr;
 
+	/* Identification which the scan got before the probe. */
+	g_mutex_lock(&conn_cache_mutex);
+	conn = conn_cache_find(scpi, NULL);
+	hw_info = conn && conn->hw_info ? hw_info_copy(conn->hw_info) : NULL;
+	g_mutex_unlock(&conn_cache_mutex);
+	if (hw_info) {
+		*scpi_response = hw_info;
+		return SR_OK;
+	}
+
 	response = NULL;
 	tokens = NULL;
 
@@ -1307,8 +1874,6 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 	const char *cmd;
 	GString *response;
 	char *s;
-	gboolean b;
-	double d;
 	int ret;
 
 	scpi = sdi->conn;
@@ -1361,21 +1926,537 @@ SR_PRIV int sr_scpi_cmd_resp(const struct sr_dev_inst *sdi,
 
 	s = g_string_free(response, FALSE);
 
+	ret = parse_variant(s, gvtype, gvar);
+
+	g_free(s);
+
+	return ret;
+}
+
+/* Upper limit for the length of a compound program message. */
+#define SCPI_BATCH_MAX_LEN 256
+
+struct scpi_batch_item {
+	char *command;
+	/* Index of the first response unit, or -1 for commands. */
+	int response;
+	/* Number of response units which the command produces. */
+	int count;
+};
+
+struct sr_scpi_batch {
+	struct sr_scpi_dev_inst *scpi;
+	GPtrArray *items;
+	GPtrArray *responses;
+	/* Channel which is selected after the batch was run. */
+	char *channel_name;
+};
+
+static void batch_item_free(void *data)
+{
+	struct scpi_batch_item *item;
+
+	item = data;
+	g_free(item->command);
+	g_free(item);
+}
+
+/*
+ * Find the next ';' separator of program or response message units,
+ * skipping quoted strings. Returns the end of the string when there
+ * are no more separators.
+ */
+static const char *next_unit(const char *s)
+{
+	char quote;
+
+	quote = '\0';
+	for (; *s; s++) {
+		if (quote) {
+			if (*s == quote)
+				quote = '\0';
+		} else if (*s == '"' || *s == '\'') {
+			quote = *s;
+		} else if (*s == ';') {
+			break;
+		}
+	}
+
+	return s;
+}
+
+/* Count the queries among a command's message units. */
+static int count_queries(const char *command)
+{
+	const char *unit, *end;
+	size_t hdr_len;
+	int count;
+
+	count = 0;
+	for (unit = command; *unit; unit = end + 1) {
+		end = next_unit(unit);
+		hdr_len = strcspn(unit, " \t");
+		if (memchr(unit, '?', MIN(hdr_len, (size_t)(end - unit))))
+			count++;
+		if (!*end)
+			break;
+	}
+
+	return count;
+}
+
+/**
+ * Create a batch of SCPI commands and queries.
+ *
+ * Batches are run by sending all their commands in compound program
+ * messages, and parsing the responses to all queries in one pass. This
+ * saves a round trip per query, which matters for network connected
+ * instruments. Devices which do not support compound queries are
+ * detected, batches then are run command by command.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ *
+ * @return The new batch.
+ */
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(struct sr_scpi_dev_inst *scpi)
+{
+	struct sr_scpi_batch *batch;
+
+	batch = g_malloc0(sizeof(*batch));
+	batch->scpi = scpi;
+	batch->items = g_ptr_array_new_with_free_func(batch_item_free);
+	batch->responses = g_ptr_array_new_with_free_func(g_free);
+	batch->channel_name = g_strdup(scpi->actual_channel_name);
+
+	return batch;
+}
+
+/**
+ * Release a batch and the responses which it holds.
+ *
+ * @param batch The batch, may be NULL.
+ */
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch)
+{
+	if (!batch)
+		return;
+
+	g_ptr_array_free(batch->items, TRUE);
+	g_ptr_array_free(batch->responses, TRUE);
+	g_free(batch->channel_name);
+	g_free(batch);
+}
+
+static char *batch_format(const char *format, va_list args)
+{
+	va_list args_copy;
+	char *buf;
+	int len;
+
+	va_copy(args_copy, args);
+	len = sr_vsnprintf_ascii(NULL, 0, format, args_copy);
+	va_end(args_copy);
+
+	buf = g_malloc0(len + 1);
+	sr_vsprintf_ascii(buf, format, args);
+
+	return buf;
+}
+
+static void batch_add_command(struct sr_scpi_batch *batch,
+	char *command, int *response_idx)
+{
+	struct scpi_batch_item *item;
+
+	item = g_malloc0(sizeof(*item));
+	item->command = command;
+	item->count = count_queries(command);
+	item->response = item->count ? (int)batch->responses->len : -1;
+	g_ptr_array_set_size(batch->responses,
+		batch->responses->len + item->count);
+	g_ptr_array_add(batch->items, item);
+
+	if (response_idx)
+		*response_idx = item->response;
+}
+
+/**
+ * Add a command or query to a batch.
+ *
+ * @param batch The batch.
+ * @param response_idx Pointer where to store the index of the query's
+ *                     response, or -1 for commands. Can be NULL.
+ * @param format Format string, to be followed by any necessary arguments.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_batch_add(struct sr_scpi_batch *batch,
+	int *response_idx, const char *format, ...)
+{
+	va_list args;
+	char *command;
+
+	if (!batch || !format)
+		return SR_ERR_ARG;
+
+	va_start(args, format);
+	command = batch_format(format, args);
+	va_end(args);
+	batch_add_command(batch, command, response_idx);
+
+	return SR_OK;
+}
+
+/**
+ * Add a command table entry to a batch, see sr_scpi_cmd_resp().
+ *
+ * @param batch The batch.
+ * @param cmdtable The device's command table.
+ * @param channel_command Command which selects a channel, or 0.
+ * @param channel_name Name of the channel to select, or NULL.
+ * @param response_idx Pointer where to store the index of the query's
+ *                     response, or -1 for commands. Can be NULL.
+ * @param command The command table entry, to be followed by any necessary
+ *                arguments.
+ *
+ * @return SR_OK on success, SR_ERR_NA when the device does not implement
+ *         the command.
+ */
+SR_PRIV int sr_scpi_batch_add_cmd(struct sr_scpi_batch *batch,
+	const struct scpi_command *cmdtable,
+	int channel_command, const char *channel_name,
+	int *response_idx, int command, ...)
+{
+	va_list args;
+	const char *channel_cmd, *cmd;
+
+	if (!batch)
+		return SR_ERR_ARG;
+
+	if (!(cmd = sr_scpi_cmd_get(cmdtable, command)))
+		return SR_ERR_NA;
+
+	/* Select channel. */
+	channel_cmd = sr_scpi_cmd_get(cmdtable, channel_command);
+	if (channel_cmd && channel_name &&
+			g_strcmp0(channel_name, batch->channel_name)) {
+		g_free(batch->channel_name);
+		batch->channel_name = g_strdup(channel_name);
+		sr_scpi_batch_add(batch, NULL, channel_cmd, channel_name);
+	}
+
+	va_start(args, command);
+	batch_add_command(batch, batch_format(cmd, args),
+		response_idx);
+	va_end(args);
+
+	return SR_OK;
+}
+
+/* Run a batch's items from the given one on, one at a time. */
+static int batch_run_single(struct sr_scpi_batch *batch, guint first)
+{
+	struct sr_scpi_dev_inst *scpi;
+	struct scpi_batch_item *item;
+	GString *response;
+	guint i;
+	int ret;
+
+	scpi = batch->scpi;
+	for (i = first; i < batch->items->len; i++) {
+		item = g_ptr_array_index(batch->items, i);
+		if (!item->count) {
+			ret = scpi_send(scpi, "%s", item->command);
+			if (ret != SR_OK)
+				return ret;
+			continue;
+		}
+		response = g_string_sized_new(1024);
+		ret = scpi_get_data(scpi, item->command, &response);
+		if (ret != SR_OK) {
+			g_string_free(response, TRUE);
+			return ret;
+		}
+		g_strchomp(response->str);
+		g_free(batch->responses->pdata[item->response]);
+		batch->responses->pdata[item->response] =
+			g_string_free(response, FALSE);
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Read the responses to a compound program message. Devices may send
+ * all response units in one message, or one message per query. Returns
+ * the number of response units which were received in @p got, also
+ * upon failure.
+ *
+ * Returns SR_ERR_DATA when the number of response units does not match
+ * the number of queries: more units than queries, or a timeout after
+ * part of the queries got answered. Other errors, and timeouts before
+ * any response arrived, are passed on.
+ */
+static int batch_read_units(struct sr_scpi_batch *batch,
+	guint first, guint count, guint *got_count)
+{
+	GString *response;
+	const char *unit, *end;
+	guint got;
+	int ret;
+
+	got = 0;
+	*got_count = 0;
+	while (got < count) {
+		response = g_string_sized_new(1024);
+		ret = scpi_get_data(batch->scpi, NULL, &response);
+		if (ret != SR_OK) {
+			g_string_free(response, TRUE);
+			if (ret == SR_ERR_TIMEOUT && got)
+				return SR_ERR_DATA;
+			return ret;
+		}
+		g_strchomp(response->str);
+		for (unit = response->str; ; unit = end + 1) {
+			end = next_unit(unit);
+			if (got == count) {
+				g_string_free(response, TRUE);
+				return SR_ERR_DATA;
+			}
+			g_free(batch->responses->pdata[first + got]);
+			batch->responses->pdata[first + got++] =
+				g_strstrip(g_strndup(unit, end - unit));
+			*got_count = got;
+			if (!*end)
+				break;
+		}
+		g_string_free(response, TRUE);
+	}
+
+	return SR_OK;
+}
+
+/* Upper limit for the responses which get discarded when resyncing. */
+#define SCPI_BATCH_RESYNC_READS 8
+
+/*
+ * Discard responses which arrive late, after a compound program message
+ * was not answered as expected. Reads up to the response of an *OPC?
+ * query, which is answered after all previous ones.
+ */
+static int batch_resync(struct sr_scpi_dev_inst *scpi)
+{
+	GString *response;
+	const char *command;
+	gboolean done;
+	int i, ret;
+
+	command = SCPI_CMD_OPC;
+	for (i = 0; i < SCPI_BATCH_RESYNC_READS; i++) {
+		response = g_string_sized_new(64);
+		ret = scpi_get_data(scpi, command, &response);
+		command = NULL;
+		done = FALSE;
+		if (ret == SR_OK) {
+			g_strstrip(response->str);
+			done = !strcmp(response->str, "1") ||
+				!strcmp(response->str, "+1");
+			if (!done)
+				sr_dbg("Discarding late response '%s'.",
+					response->str);
+		}
+		g_string_free(response, TRUE);
+		if (ret != SR_OK)
+			break;
+		if (done)
+			return SR_OK;
+	}
+	sr_err("Failed to resynchronize to the device's responses.");
+
+	return SR_ERR_IO;
+}
+
+/**
+ * Run a batch of SCPI commands and queries.
+ *
+ * Responses are available by means of the sr_scpi_batch_get_*()
+ * routines afterwards.
+ *
+ * When the device turns out to not support compound queries, the items
+ * after the last answered query are run again one at a time. Commands
+ * without a query among them may get executed twice, batches should
+ * only hold commands which can be repeated, like settings.
+ *
+ * @param batch The batch.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_batch_run(struct sr_scpi_batch *batch)
+{
+	struct sr_scpi_dev_inst *scpi;
+	struct scpi_batch_item *item;
+	GString *msg;
+	guint first, last, i, queries, response, got;
+	int ret;
+
+	if (!batch)
+		return SR_ERR_ARG;
+
+	scpi = batch->scpi;
+	g_mutex_lock(&scpi->scpi_mutex);
+
 	ret = SR_OK;
-	if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_BOOLEAN)) {
-		if ((ret = parse_strict_bool(s, &b)) == SR_OK)
-			*gvar = g_variant_new_boolean(b);
-	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_DOUBLE)) {
-		if ((ret = sr_atod_ascii(s, &d)) == SR_OK)
-			*gvar = g_variant_new_double(d);
-	} else if (g_variant_type_equal(gvtype, G_VARIANT_TYPE_STRING)) {
-		*gvar = g_variant_new_string(s);
-	} else {
-		sr_err("Unable to convert to desired GVariant type.");
-		ret = SR_ERR_NA;
+	first = 0;
+	msg = g_string_sized_new(SCPI_BATCH_MAX_LEN);
+	while (!scpi->no_compound_queries && first < batch->items->len) {
+		/* Join as many items as fit into a program message. */
+		g_string_truncate(msg, 0);
+		queries = 0;
+		for (last = first; last < batch->items->len; last++) {
+			item = g_ptr_array_index(batch->items, last);
+			if (msg->len && msg->len + strlen(item->command) + 2 >
+					SCPI_BATCH_MAX_LEN)
+				break;
+			if (msg->len) {
+				g_string_append_c(msg, ';');
+				if (item->command[0] != ':' && item->command[0] != '*')
+					g_string_append_c(msg, ':');
+			}
+			g_string_append(msg, item->command);
+			queries += item->count;
+		}
+		ret = scpi_send(scpi, "%s", msg->str);
+		if (ret != SR_OK)
+			break;
+		if (queries) {
+			i = first;
+			while (((struct scpi_batch_item *)
+					g_ptr_array_index(batch->items, i))->response < 0)
+				i++;
+			item = g_ptr_array_index(batch->items, i);
+			response = item->response;
+			ret = batch_read_units(batch, response, queries, &got);
+			if (ret == SR_ERR_DATA) {
+				/*
+				 * The device executed the items up to the last
+				 * query which got answered. Retry the others
+				 * one at a time, after stale responses are gone.
+				 * It's unknown whether the device executed the
+				 * commands after the last answered query, they
+				 * get sent again.
+				 */
+				sr_info("Device does not support compound queries.");
+				scpi->no_compound_queries = TRUE;
+				for (i = first; i < last; i++) {
+					item = g_ptr_array_index(batch->items, i);
+					if (item->count && (guint)item->response +
+							item->count <= response + got)
+						first = i + 1;
+				}
+				ret = batch_resync(scpi);
+				break;
+			}
+			if (ret != SR_OK)
+				break;
+		}
+		first = last;
 	}
+	g_string_free(msg, TRUE);
+	if (ret == SR_OK && scpi->no_compound_queries &&
+			first < batch->items->len)
+		ret = batch_run_single(batch, first);
 
-	g_free(s);
+	if (ret == SR_OK && g_strcmp0(batch->channel_name,
+			scpi->actual_channel_name)) {
+		g_free(scpi->actual_channel_name);
+		scpi->actual_channel_name = g_strdup(batch->channel_name);
+	}
+
+	g_mutex_unlock(&scpi->scpi_mutex);
 
 	return ret;
 }
+
+/**
+ * Get a response of a batch which was run before.
+ *
+ * @param batch The batch.
+ * @param idx The query's response index, see sr_scpi_batch_add().
+ *
+ * @return The response text, or NULL if not available.
+ */
+SR_PRIV const char *sr_scpi_batch_get_string(struct sr_scpi_batch *batch,
+	int idx)
+{
+	if (!batch || idx < 0 || (guint)idx >= batch->responses->len)
+		return NULL;
+
+	return g_ptr_array_index(batch->responses, idx);
+}
+
+/**
+ * Get a response of a batch which was run before, as a bool value.
+ *
+ * @param batch The batch.
+ * @param idx The query's response index.
+ * @param scpi_response Pointer where to store the parsed result.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_batch_get_bool(struct sr_scpi_batch *batch,
+	int idx, gboolean *scpi_response)
+{
+	const char *response;
+
+	if (!(response = sr_scpi_batch_get_string(batch, idx)))
+		return SR_ERR_DATA;
+
+	if (parse_strict_bool(response, scpi_response) != SR_OK)
+		return SR_ERR_DATA;
+
+	return SR_OK;
+}
+
+/**
+ * Get a response of a batch which was run before, as a double value.
+ *
+ * @param batch The batch.
+ * @param idx The query's response index.
+ * @param scpi_response Pointer where to store the parsed result.
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_batch_get_double(struct sr_scpi_batch *batch,
+	int idx, double *scpi_response)
+{
+	const char *response;
+
+	if (!(response = sr_scpi_batch_get_string(batch, idx)))
+		return SR_ERR_DATA;
+
+	if (sr_atod_ascii(response, scpi_response) != SR_OK)
+		return SR_ERR_DATA;
+
+	return SR_OK;
+}
+
+/**
+ * Get a response of a batch which was run before, as a GVariant.
+ *
+ * @param batch The batch.
+ * @param idx The query's response index.
+ * @param gvar Pointer where to store the new GVariant.
+ * @param gvtype The desired type, see sr_scpi_cmd_resp().
+ *
+ * @return SR_OK on success, SR_ERR* on failure.
+ */
+SR_PRIV int sr_scpi_batch_get_variant(struct sr_scpi_batch *batch,
+	int idx, GVariant **gvar, const GVariantType *gvtype)
+{
+	const char *response;
+
+	if (!(response = sr_scpi_batch_get_string(batch, idx)))
+		return SR_ERR_DATA;
+
+	return parse_variant(response, gvtype, gvar);
+}
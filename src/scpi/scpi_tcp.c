@@ -19,7 +19,7 @@
 
 #include <config.h>
 #ifdef _WIN32
-#define _WIN32_WINNT 0x0501
+#define _WIN32_WINNT 0x0600
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #endif
@@ -31,6 +31,8 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
 #endif
 #include <errno.h>
 #include <libsigrok/libsigrok.h>
@@ -41,6 +43,14 @@
 
 #define LENGTH_BYTES 4
 
+/* Per address timeout for connection setup. */
+#define CONNECT_TIMEOUT_MS 2000
+/*
+ * Period for which a raw read waits for data, before it returns to the
+ * caller, which applies the device's read timeout.
+ */
+#define READ_POLL_MS 10
+
 struct scpi_tcp {
 	char *address;
 	char *port;
@@ -72,6 +82,105 @@ static int scpi_tcp_dev_inst_new(void *priv, struct drv_context *drvc,
 	return SR_OK;
 }
 
+static int set_nonblocking(int fd, gboolean nonblocking)
+{
+#ifdef _WIN32
+	u_long mode;
+
+	mode = nonblocking ? 1 : 0;
+	if (ioctlsocket(fd, FIONBIO, &mode) != 0)
+		return SR_ERR;
+#else
+	int flags;
+
+	flags = fcntl(fd, F_GETFL);
+	if (flags < 0)
+		return SR_ERR;
+	if (nonblocking)
+		flags |= O_NONBLOCK;
+	else
+		flags &= ~O_NONBLOCK;
+	if (fcntl(fd, F_SETFL, flags) < 0)
+		return SR_ERR;
+#endif
+
+	return SR_OK;
+}
+
+/*
+ * Wait until a socket becomes ready for the given events. Returns a
+ * positive value when ready, 0 upon timeout, negative upon error.
+ */
+static int socket_wait(int fd, short events, int timeout_ms)
+{
+#ifdef _WIN32
+	WSAPOLLFD pfd;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+
+	return WSAPoll(&pfd, 1, timeout_ms);
+#else
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	do {
+		ret = poll(&pfd, 1, timeout_ms);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+#endif
+}
+
+/*
+ * Connect with a timeout, instead of waiting for the operating system's
+ * (typically minutes long) timeout when the peer does not respond. The
+ * socket is in blocking mode again when the connection was established.
+ */
+static int connect_timeout(int fd, const struct sockaddr *addr,
+	socklen_t addrlen, int timeout_ms)
+{
+	int ret, soerror;
+	socklen_t solen;
+
+	if (set_nonblocking(fd, TRUE) != SR_OK)
+		return -1;
+
+	ret = connect(fd, addr, addrlen);
+#ifdef _WIN32
+	if (ret != 0 && WSAGetLastError() != WSAEWOULDBLOCK)
+		return -1;
+#else
+	if (ret != 0 && errno != EINPROGRESS)
+		return -1;
+#endif
+	if (ret != 0) {
+		ret = socket_wait(fd, POLLOUT, timeout_ms);
+		if (ret == 0)
+			errno = ETIMEDOUT;
+		if (ret <= 0)
+			return -1;
+		soerror = 0;
+		solen = sizeof(soerror);
+		if (getsockopt(fd, SOL_SOCKET, SO_ERROR,
+				(void *)&soerror, &solen) != 0)
+			return -1;
+		if (soerror) {
+			errno = soerror;
+			return -1;
+		}
+	}
+
+	if (set_nonblocking(fd, FALSE) != SR_OK)
+		return -1;
+
+	return 0;
+}
+
 static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_tcp *tcp = scpi->priv;
@@ -96,7 +205,8 @@ static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 		if ((tcp->socket = socket(res->ai_family, res->ai_socktype,
 						res->ai_protocol)) < 0)
 			continue;
-		if (connect(tcp->socket, res->ai_addr, res->ai_addrlen) != 0) {
+		if (connect_timeout(tcp->socket, res->ai_addr, res->ai_addrlen,
+				CONNECT_TIMEOUT_MS) != 0) {
 			close(tcp->socket);
 			tcp->socket = -1;
 			continue;
@@ -180,6 +290,15 @@ static int scpi_tcp_raw_read_data(void *priv, char *buf, int maxlen)
 	struct scpi_tcp *tcp = priv;
 	int len;
 
+	/* Don't block, such that the caller's read timeout applies. */
+	len = socket_wait(tcp->socket, POLLIN, READ_POLL_MS);
+	if (len < 0) {
+		sr_err("Poll error: %s", g_strerror(errno));
+		return SR_ERR;
+	}
+	if (len == 0)
+		return 0;
+
 	len = recv(tcp->socket, buf, maxlen, 0);
 
 	if (len < 0) {
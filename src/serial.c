@@ -39,6 +39,9 @@
 #define LOG_PREFIX "serial"
 /** @endcond */
 
+/* Default capacity of the RX data queue, must be a power of two. */
+#define SER_RX_QUEUE_SIZE	(64 * 1024)
+
 /**
  * @file
  *
@@ -168,9 +171,19 @@ SR_PRIV int serial_close(struct sr_serial_dev_inst *serial)
 
 	rc = serial->lib_funcs->close(serial);
 	if (rc == SR_OK && serial->rcv_buffer) {
-		g_string_free(serial->rcv_buffer, TRUE);
+		if (serial->rcv_buffer->overflows)
+			sr_dbg("RX queue overflowed %" PRIu64 " times, "
+				"dropped %" PRIu64 " bytes.",
+				serial->rcv_buffer->overflows,
+				serial->rcv_buffer->dropped);
+		g_free(serial->rcv_buffer->data);
+		g_free(serial->rcv_buffer);
 		serial->rcv_buffer = NULL;
 	}
+	if (rc == SR_OK && serial->rx_unread) {
+		g_string_free(serial->rx_unread, TRUE);
+		serial->rx_unread = NULL;
+	}
 
 	return rc;
 }
@@ -195,6 +208,8 @@ SR_PRIV int serial_flush(struct sr_serial_dev_inst *serial)
 	sr_spew("Flushing serial port %s.", serial->port);
 
 	sr_ser_discard_queued_data(serial);
+	if (serial->rx_unread)
+		g_string_truncate(serial->rx_unread, 0);
 
 	if (!serial->lib_funcs || !serial->lib_funcs->flush)
 		return SR_ERR_NA;
@@ -274,6 +289,38 @@ SR_PRIV int serial_set_read_chunk_cb(struct sr_serial_dev_inst *serial,
 	return SR_OK;
 }
 
+/**
+ * Allocate the RX data queue. Internal to the serial subsystem,
+ * coordination between common and transport specific support code.
+ *
+ * The queue has a fixed capacity. Data which does not fit is dropped
+ * and accounted for in the queue's statistics.
+ *
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] min_size Minimum capacity in bytes, e.g. a transport's
+ *                     chunk size.
+ *
+ * @private
+ */
+SR_PRIV void sr_ser_setup_rx_queue(struct sr_serial_dev_inst *serial,
+	size_t min_size)
+{
+	struct sr_ser_rx_queue *q;
+	size_t size;
+
+	if (!serial || serial->rcv_buffer)
+		return;
+
+	size = SER_RX_QUEUE_SIZE;
+	while (size < min_size)
+		size <<= 1;
+
+	q = g_malloc0(sizeof(*q));
+	q->data = g_malloc(size);
+	q->size = size;
+	serial->rcv_buffer = q;
+}
+
 /**
  * Discard previously queued RX data. Internal to the serial subsystem,
  * coordination between common and transport specific support code.
@@ -287,7 +334,7 @@ SR_PRIV void sr_ser_discard_queued_data(struct sr_serial_dev_inst *serial)
 	if (!serial || !serial->rcv_buffer)
 		return;
 
-	g_string_truncate(serial->rcv_buffer, 0);
+	serial->rcv_buffer->head = serial->rcv_buffer->tail;
 }
 
 /**
@@ -303,7 +350,7 @@ SR_PRIV size_t sr_ser_has_queued_data(struct sr_serial_dev_inst *serial)
 	if (!serial || !serial->rcv_buffer)
 		return 0;
 
-	return serial->rcv_buffer->len;
+	return serial->rcv_buffer->tail - serial->rcv_buffer->head;
 }
 
 /**
@@ -319,13 +366,32 @@ SR_PRIV size_t sr_ser_has_queued_data(struct sr_serial_dev_inst *serial)
 SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 	const uint8_t *data, size_t len)
 {
+	struct sr_ser_rx_queue *q;
+	size_t space, pos, run;
+
 	if (!serial || !data || !len)
 		return;
 
-	if (serial->rx_chunk_cb_func)
+	if (serial->rx_chunk_cb_func) {
 		serial->rx_chunk_cb_func(serial, serial->rx_chunk_cb_data, data, len);
-	else if (serial->rcv_buffer)
-		g_string_append_len(serial->rcv_buffer, (const gchar *)data, len);
+		return;
+	}
+	q = serial->rcv_buffer;
+	if (!q)
+		return;
+
+	space = q->size - (q->tail - q->head);
+	if (len > space) {
+		sr_warn("RX queue full, dropping %zu bytes.", len - space);
+		q->overflows++;
+		q->dropped += len - space;
+		len = space;
+	}
+	pos = q->tail & (q->size - 1);
+	run = MIN(len, q->size - pos);
+	memcpy(&q->data[pos], data, run);
+	memcpy(q->data, data + run, len - run);
+	q->tail += len;
 }
 
 /**
@@ -341,25 +407,77 @@ SR_PRIV void sr_ser_queue_rx_data(struct sr_serial_dev_inst *serial,
 SR_PRIV size_t sr_ser_unqueue_rx_data(struct sr_serial_dev_inst *serial,
 	uint8_t *data, size_t len)
 {
-	size_t qlen;
-	GString *buf;
+	const uint8_t *chunk;
+	size_t got, run;
 
 	if (!serial || !data || !len)
 		return 0;
 
-	qlen = sr_ser_has_queued_data(serial);
-	if (!qlen)
+	/* Two runs at most, before and after the wrap around. */
+	got = 0;
+	while (got < len) {
+		run = sr_ser_peek_rx_data(serial, &chunk);
+		if (!run)
+			break;
+		run = MIN(run, len - got);
+		memcpy(&data[got], chunk, run);
+		sr_ser_consume_rx_data(serial, run);
+		got += run;
+	}
+
+	return got;
+}
+
+/**
+ * Access queued RX data without copying. Internal to the serial
+ * subsystem, for parsers which search the received data in place.
+ *
+ * Returns the contiguous part of the queued data which starts at the
+ * oldest byte. When the data wraps around the end of the queue, another
+ * call after sr_ser_consume_rx_data() returns the remainder.
+ *
+ * @param[in] serial Previously opened serial port instance.
+ * @param[out] data Pointer to store the start of the data into.
+ *
+ * @return The number of bytes available at @p data.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_ser_peek_rx_data(struct sr_serial_dev_inst *serial,
+	const uint8_t **data)
+{
+	struct sr_ser_rx_queue *q;
+	size_t pos;
+
+	if (!serial || !serial->rcv_buffer || !data)
 		return 0;
 
-	buf = serial->rcv_buffer;
-	if (len > buf->len)
-		len = buf->len;
-	if (len) {
-		memcpy(data, buf->str, len);
-		g_string_erase(buf, 0, len);
-	}
+	q = serial->rcv_buffer;
+	pos = q->head & (q->size - 1);
+	*data = &q->data[pos];
 
-	return len;
+	return MIN(q->tail - q->head, q->size - pos);
+}
+
+/**
+ * Remove data from the RX queue, after sr_ser_peek_rx_data(). Internal
+ * to the serial subsystem.
+ *
+ * @param[in] serial Previously opened serial port instance.
+ * @param[in] len Number of data bytes to remove.
+ *
+ * @private
+ */
+SR_PRIV void sr_ser_consume_rx_data(struct sr_serial_dev_inst *serial,
+	size_t len)
+{
+	struct sr_ser_rx_queue *q;
+
+	if (!serial || !serial->rcv_buffer)
+		return;
+
+	q = serial->rcv_buffer;
+	q->head += MIN(len, q->tail - q->head);
 }
 
 /**
@@ -386,6 +504,8 @@ SR_PRIV size_t serial_has_receive_data(struct sr_serial_dev_inst *serial)
 		lib_count = serial->lib_funcs->get_rx_avail(serial);
 
 	buf_count = sr_ser_has_queued_data(serial);
+	if (serial->rx_unread)
+		buf_count += serial->rx_unread->len;
 
 	return lib_count + buf_count;
 }
@@ -454,6 +574,7 @@ static int _serial_read(struct sr_serial_dev_inst *serial,
 	void *buf, size_t count, int nonblocking, unsigned int timeout_ms)
 {
 	ssize_t ret;
+	size_t got;
 
 	if (!serial) {
 		sr_dbg("Invalid serial port.");
@@ -462,10 +583,25 @@ static int _serial_read(struct sr_serial_dev_inst *serial,
 
 	if (!serial->lib_funcs || !serial->lib_funcs->read)
 		return SR_ERR_NA;
+
+	/* Hand out data which serial_readline() has read ahead first. */
+	got = 0;
+	if (serial->rx_unread && serial->rx_unread->len) {
+		got = MIN(count, serial->rx_unread->len);
+		memcpy(buf, serial->rx_unread->str, got);
+		g_string_erase(serial->rx_unread, 0, got);
+		if (got == count)
+			return got;
+		buf = (uint8_t *)buf + got;
+		count -= got;
+	}
+
 	ret = serial->lib_funcs->read(serial, buf, count,
 		nonblocking, timeout_ms);
 	if (ret > 0)
 		sr_spew("Read %zd/%zu bytes.", ret, count);
+	if (got)
+		return (ret < 0) ? (int)got : (int)(got + ret);
 
 	return ret;
 }
@@ -719,6 +855,36 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
 			flow, rts, dtr);
 }
 
+/*
+ * Take queued RX data of HID and BT transports up to and including the
+ * next line end. The line end gets searched for in place, data after it
+ * stays in the queue for subsequent reads.
+ */
+static int readline_queued(struct sr_serial_dev_inst *serial,
+	char *dst, size_t len)
+{
+	const uint8_t *data, *cr, *lf;
+	size_t take;
+
+	/* Previously returned bytes are older than the queued data. */
+	if (serial->rx_unread && serial->rx_unread->len)
+		return 0;
+
+	take = MIN(sr_ser_peek_rx_data(serial, &data), len);
+	if (!take)
+		return 0;
+	cr = memchr(data, '\r', take);
+	lf = memchr(data, '\n', take);
+	if (cr && (!lf || cr < lf))
+		take = cr - data + 1;
+	else if (lf)
+		take = lf - data + 1;
+	memcpy(dst, data, take);
+	sr_ser_consume_rx_data(serial, take);
+
+	return take;
+}
+
 /**
  * Read a line from the specified serial port.
  *
@@ -728,6 +894,9 @@ SR_PRIV int serial_set_paramstr(struct sr_serial_dev_inst *serial,
  * @param[in] timeout_ms How long to wait for a line to come in.
  *
  * Reading stops when CR or LF is found, which is stripped from the buffer.
+ * All available data is read in one go. Bytes after the line end are kept,
+ * subsequent read calls return them before data from the port. Data in
+ * the RX queue of HID and BT transports is taken up to the line end only.
  *
  * @retval SR_OK Success.
  * @retval SR_ERR Failure.
@@ -738,7 +907,9 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
 	char **buf, int *buflen, gint64 timeout_ms)
 {
 	gint64 start, remaining;
-	int maxlen, len;
+	int maxlen, len, got;
+	char *dst, *cr, *lf, *eol;
+	size_t tail;
 
 	if (!serial) {
 		sr_dbg("Invalid serial port.");
@@ -754,29 +925,51 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
 	remaining = timeout_ms;
 
 	maxlen = *buflen;
-	*buflen = len = 0;
+	*buflen = 0;
+	if (maxlen > 0)
+		**buf = '\0';
 	while (1) {
 		len = maxlen - *buflen - 1;
 		if (len < 1)
 			break;
-		len = serial_read_blocking(serial, *buf + *buflen, 1, remaining);
+		dst = *buf + *buflen;
+		/*
+		 * Take what is available. Otherwise have the transport wait
+		 * for the next byte, which wakes up as soon as it arrives.
+		 */
+		got = readline_queued(serial, dst, len);
+		if (got == 0)
+			got = serial_read_nonblocking(serial, dst, len);
+		if (got == 0)
+			got = serial_read_blocking(serial, dst, 1, remaining);
+		len = got;
+		if (len < 0)
+			break;
 		if (len > 0) {
-			*buflen += len;
-			*(*buf + *buflen) = '\0';
-			if (*buflen > 0 && (*(*buf + *buflen - 1) == '\r'
-					|| *(*buf + *buflen - 1) == '\n')) {
-				/* Strip CR/LF and terminate. */
-				*(*buf + --*buflen) = '\0';
+			cr = memchr(dst, '\r', len);
+			lf = memchr(dst, '\n', len);
+			eol = (cr && (!lf || cr < lf)) ? cr : lf;
+			if (eol) {
+				/* Keep bytes after the line end, strip CR/LF. */
+				tail = dst + len - eol - 1;
+				if (tail) {
+					if (!serial->rx_unread)
+						serial->rx_unread = g_string_sized_new(tail);
+					g_string_prepend_len(serial->rx_unread,
+						eol + 1, tail);
+				}
+				*buflen += eol - dst;
+				*(*buf + *buflen) = '\0';
 				break;
 			}
+			*buflen += len;
+			*(*buf + *buflen) = '\0';
 		}
 		/* Reduce timeout by time elapsed. */
 		remaining = timeout_ms - ((g_get_monotonic_time() - start) / 1000);
 		if (remaining <= 0)
 			/* Timeout */
 			break;
-		if (len < 1)
-			g_usleep(2000);
 	}
 	if (*buflen)
 		sr_dbg("Received %d: '%s'.", *buflen, *buf);
@@ -784,6 +977,48 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial,
 	return SR_OK;
 }
 
+/**
+ * Find the next position in a data stream where a packet might start.
+ *
+ * @param[in] sync The protocol's synchronization signature.
+ * @param[in] buf Buffer containing received data.
+ * @param[in] len Number of bytes in the buffer.
+ *
+ * Skips data which cannot be the start of a packet, because the packet's
+ * signature byte does not match, without invoking the protocol's more
+ * expensive validity check at every offset. Signatures which cover all
+ * bits of a byte are searched for with memchr().
+ *
+ * @return The offset of the first candidate position. Or the offset of
+ *         the first position which cannot get checked yet, because the
+ *         signature byte was not received.
+ *
+ * @private
+ */
+SR_PRIV size_t sr_packet_sync_find(const struct sr_packet_sync *sync,
+	const uint8_t *buf, size_t len)
+{
+	const uint8_t *p, *end;
+
+	if (!sync || !sync->mask || !buf)
+		return 0;
+	if (len <= sync->offset)
+		return 0;
+
+	p = &buf[sync->offset];
+	end = &buf[len];
+	if (sync->mask == 0xff) {
+		p = memchr(p, sync->value, end - p);
+		if (!p)
+			p = end;
+	} else {
+		while (p < end && (*p & sync->mask) != sync->value)
+			p++;
+	}
+
+	return p - buf - sync->offset;
+}
+
 /**
  * Try to find a valid packet in a serial data stream.
  *
@@ -817,7 +1052,7 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 	uint64_t timeout_ms)
 {
 	uint64_t start_us, elapsed_ms, byte_delay_us;
-	size_t fill_idx, check_idx, max_fill_idx;
+	size_t fill_idx, check_idx, max_fill_idx, want;
 	ssize_t recv_len;
 	const uint8_t *check_ptr;
 	size_t check_len, pkt_len;
@@ -844,35 +1079,48 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 	check_idx = fill_idx = 0;
 	while (fill_idx < max_fill_idx) {
 		/*
-		 * Read bytes individually. Lets callers continue to
+		 * Read just enough bytes to complete the next candidate
+		 * packet, never beyond it. Lets callers continue to
 		 * successfully process next RX data after first match.
 		 * Run full loop bodies for empty or failed reception
 		 * in an iteration, to have timeouts checked.
 		 */
-		recv_len = serial_read_nonblocking(serial, &buf[fill_idx], 1);
+		want = 1;
+		if (fill_idx - check_idx < packet_size)
+			want = packet_size - (fill_idx - check_idx);
+		want = MIN(want, max_fill_idx - fill_idx);
+		recv_len = serial_read_nonblocking(serial, &buf[fill_idx], want);
 		if (recv_len > 0)
 			fill_idx += recv_len;
 
 		/* Dump receive data when (a minimum) size is reached. */
-		check_ptr = &buf[check_idx];
 		check_len = fill_idx - check_idx;
-		do_dump = check_len >= packet_size;
+		do_dump = recv_len > 0 && check_len >= packet_size;
 		do_dump &= sr_log_loglevel_get() >= SR_LOG_SPEW;
 		if (do_dump) {
 			GString *text;
 
-			text = sr_hexdump_new(check_ptr, check_len);
+			text = sr_hexdump_new(&buf[check_idx], check_len);
 			sr_spew("Trying packet: len %zu, bytes %s",
 				check_len, text->str);
 			sr_hexdump_free(text);
 		}
 
-		/* A packet's (minimum) length was received, check its data. */
+		/*
+		 * Check all candidate positions for which a packet's
+		 * (minimum) length was received.
+		 */
 		elapsed_ms = g_get_monotonic_time() - start_us;
 		elapsed_ms /= 1000;
-		if (is_valid_len && check_len >= packet_size) {
+		while (check_len >= packet_size) {
+			check_ptr = &buf[check_idx];
 			pkt_len = packet_size;
-			ret = is_valid_len(NULL, check_ptr, check_len, &pkt_len);
+			if (is_valid_len)
+				ret = is_valid_len(NULL, check_ptr, check_len, &pkt_len);
+			else if (is_valid && is_valid(check_ptr))
+				ret = SR_PACKET_VALID;
+			else
+				ret = SR_PACKET_INVALID;
 			if (ret == SR_PACKET_VALID) {
 				/* Exact match. Terminate with success. */
 				sr_spew("Valid packet after %" PRIu64 "ms.",
@@ -887,27 +1135,11 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 			if (ret == SR_PACKET_NEED_RX) {
 				/* Incomplete, keep accumulating RX data. */
 				sr_spew("Checker needs more RX data.");
-			} else {
-				/* Not a valid packet. Continue searching. */
-				sr_spew("Invalid packet, advancing read pos.");
-				check_idx++;
-			}
-		}
-		if (is_valid && check_len >= packet_size) {
-			if (is_valid(check_ptr)) {
-				/* Exact match. Terminate with success. */
-				sr_spew("Valid packet after %" PRIu64 "ms.",
-					elapsed_ms);
-				sr_spew("RX count %zu, packet len %zu.",
-					fill_idx, packet_size);
-				*buflen = fill_idx;
-				if (return_size)
-					*return_size = packet_size;
-				return SR_OK;
+				break;
 			}
 			/* Not a valid packet. Continue searching. */
-			sr_spew("Invalid packet, advancing read pointer.");
 			check_idx++;
+			check_len--;
 		}
 
 		/* Check for packet search timeout. */
@@ -925,6 +1157,122 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 	return SR_ERR;
 }
 
+/* Maximum number of ports which serial_scan_ports() probes concurrently. */
+#define SCAN_THREADS	8
+
+struct scan_port {
+	struct sr_serial_dev_inst *serial;
+	serial_probe_callback probe;
+	void *cb_data;
+	gboolean found;
+};
+
+static int scan_port_run(size_t idx, void *cb_data)
+{
+	GPtrArray *ports;
+	struct scan_port *port;
+	int ret;
+
+	ports = cb_data;
+	port = ports->pdata[idx];
+
+	/* A port which can't be opened must not keep others from probing. */
+	ret = serial_open(port->serial, SERIAL_RDWR);
+	if (ret != SR_OK) {
+		sr_info("Cannot open serial port %s: %s.", port->serial->port,
+			sr_strerror(ret));
+		return SR_OK;
+	}
+	sr_info("Probing serial port %s.", port->serial->port);
+	port->found = port->probe(port->serial, port->cb_data) == SR_OK;
+	serial_close(port->serial);
+
+	return SR_OK;
+}
+
+static void scan_port_free(void *data)
+{
+	struct scan_port *port;
+
+	port = data;
+	sr_serial_dev_inst_free(port->serial);
+	g_free(port);
+}
+
+/**
+ * Probe a list of serial ports for a device.
+ *
+ * The @p conn specification can list several ports, separated by commas
+ * (e.g. "/dev/ttyUSB0,/dev/ttyUSB1"). Each port gets opened, passed to
+ * the probe callback, and closed again. Ports are probed concurrently,
+ * which reduces the time to scan many ports to the time of the slowest
+ * probe. HID and Bluetooth ports are probed one after another.
+ *
+ * The probe callback may run in a different thread, and must not access
+ * state which is shared between ports without synchronization.
+ *
+ * @param[in] conn The port(s) to probe.
+ * @param[in] serialcomm Serial communication parameters, can be NULL.
+ * @param[in] probe Callback which returns SR_OK when it detected a device.
+ * @param[in] cb_data Opaque data which gets passed to the callback.
+ *
+ * @return A list of (closed) serial port structures of the ports which
+ *         had a device, in the order of @p conn. The caller takes
+ *         ownership of the list and its items.
+ *
+ * @private
+ */
+SR_PRIV GSList *serial_scan_ports(const char *conn, const char *serialcomm,
+	serial_probe_callback probe, void *cb_data)
+{
+	gchar **names, *name;
+	GPtrArray *ports;
+	struct scan_port *port;
+	struct sr_task_runner *runner;
+	gboolean concurrent;
+	GSList *found;
+	size_t i;
+
+	if (!conn || !probe)
+		return NULL;
+
+	ports = g_ptr_array_new_with_free_func(scan_port_free);
+	concurrent = TRUE;
+	names = g_strsplit(conn, ",", 0);
+	for (i = 0; names[i]; i++) {
+		name = g_strstrip(names[i]);
+		if (!*name)
+			continue;
+		port = g_malloc0(sizeof(*port));
+		port->serial = sr_serial_dev_inst_new(name, serialcomm);
+		port->probe = probe;
+		port->cb_data = cb_data;
+		g_ptr_array_add(ports, port);
+		/* Not all of these transports are known to be thread safe. */
+		if (ser_name_is_hid(port->serial) || ser_name_is_bt(port->serial))
+			concurrent = FALSE;
+	}
+	g_strfreev(names);
+
+	runner = NULL;
+	if (concurrent && ports->len > 1)
+		runner = sr_task_runner_new(MIN(ports->len, SCAN_THREADS));
+	sr_task_runner_run(runner, ports->len, scan_port_run, ports);
+	sr_task_runner_free(runner);
+
+	found = NULL;
+	for (i = 0; i < ports->len; i++) {
+		port = ports->pdata[i];
+		if (!port->found)
+			continue;
+		found = g_slist_append(found, port->serial);
+		port->serial = NULL;
+	}
+	g_ptr_array_free(ports, TRUE);
+
+	return found;
+}
+
 /**
  * Extract the serial device and options from the options linked list.
  *
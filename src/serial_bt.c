@@ -366,8 +366,7 @@ static int ser_bt_open(struct sr_serial_dev_inst *serial, int flags)
 	serial->bt_conn_type = conn_type;
 
 	/* Make sure the receive buffer can accept input data. */
-	if (!serial->rcv_buffer)
-		serial->rcv_buffer = g_string_sized_new(SER_BT_CHUNK_SIZE);
+	sr_ser_setup_rx_queue(serial, SER_BT_CHUNK_SIZE);
 	rc = sr_bt_config_cb_data(desc, ser_bt_data_cb, serial);
 	if (rc < 0)
 		return SR_ERR;
@@ -1113,8 +1113,7 @@ static int ser_hid_open(struct sr_serial_dev_inst *serial, int flags)
 		return SR_ERR_IO;
 	}
 
-	if (!serial->rcv_buffer)
-		serial->rcv_buffer = g_string_sized_new(SER_HID_CHUNK_SIZE);
+	sr_ser_setup_rx_queue(serial, SER_HID_CHUNK_SIZE);
 
 	return SR_OK;
 }
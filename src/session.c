@@ -1190,6 +1190,35 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
+/**
+ * Send a packet whose payload is located in a pool buffer.
+ *
+ * Works like sr_session_send(), but consumers can retain the payload
+ * by taking a reference on the buffer instead of copying the data
+ * (see sr_packet_copy_shared()). The caller keeps its own reference,
+ * and returns it to the pool when done.
+ *
+ * @param sdi The device instance to send the packet from.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buffer The pool buffer which holds the packet's payload.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_loaned(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, uint8_t *buffer)
+{
+	int ret;
+
+	sr_buffer_pool_loan_begin(buffer);
+	ret = sr_session_send(sdi, packet);
+	sr_buffer_pool_loan_end();
+
+	return ret;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -1487,8 +1516,8 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	                                   g_memdup(src, sizeof(struct sr_config)));
 }
 
-SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
-		struct sr_datafeed_packet **copy)
+static int packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy, gboolean share)
 {
 	const struct sr_datafeed_meta *meta;
 	struct sr_datafeed_meta *meta_copy;
@@ -1524,12 +1553,19 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 			return SR_ERR;
 		logic_copy->length = logic->length;
 		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
+		/* Reference loaned pool buffers instead of copying them. */
+		if (share && sr_buffer_pool_loan_retain(logic_copy,
+				logic->data, logic->length)) {
+			logic_copy->data = logic->data;
+			(*copy)->payload = logic_copy;
+			break;
+		}
+		logic_copy->data = g_malloc(logic->length);
 		if (!logic_copy->data) {
 			g_free(logic_copy);
 			return SR_ERR;
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
+		memcpy(logic_copy->data, logic->data, logic->length);
 		(*copy)->payload = logic_copy;
 		break;
 	case SR_DF_ANALOG:
@@ -1558,6 +1594,37 @@ SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
 	return SR_OK;
 }
 
+SR_API int sr_packet_copy(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy)
+{
+	return packet_copy(packet, copy, FALSE);
+}
+
+/**
+ * Copy a packet, sharing logic data with the sender where possible.
+ *
+ * Works like sr_packet_copy(), except for logic data which the sender
+ * passes in a pool buffer (see sr_session_send_loaned()). The copy
+ * then references the sender's buffer instead of holding a private
+ * copy of the data, and the buffer is not reused before the copy gets
+ * released. Must be called from within the datafeed callback which
+ * received the packet. The copy's data must not be modified.
+ *
+ * @param packet The packet to copy.
+ * @param copy Receives the copy, which must be released with
+ *             sr_packet_free().
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unknown packet type, or allocation failure.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_copy_shared(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **copy)
+{
+	return packet_copy(packet, copy, TRUE);
+}
+
 SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_meta *meta;
@@ -1587,7 +1654,8 @@ SR_API void sr_packet_free(struct sr_datafeed_packet *packet)
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
+		if (!sr_buffer_pool_loan_release(logic))
+			g_free(logic->data);
 		g_free((void *)packet->payload);
 		break;
 	case SR_DF_ANALOG:
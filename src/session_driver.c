@@ -18,6 +18,7 @@
  */
 
 #include <config.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -41,6 +42,7 @@ struct session_vdev {
 	char *capturefile;
 	struct zip *archive;
 	struct zip_file *capfile;
+	uint64_t capfile_size;
 	int bytes_read;
 	uint64_t samplerate;
 	int unitsize;
@@ -49,6 +51,7 @@ struct session_vdev {
 	int cur_analog_channel;
 	GArray *analog_channels;
 	int cur_chunk;
+	gboolean analog_packed;
 	gboolean finished;
 };
 
@@ -71,9 +74,12 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 	struct zip_stat zs;
+	struct sr_sessionfile_analog_chunk chunk;
 	int ret, got_data;
 	char capturefile[128];
 	void *buf;
+	size_t bufsize;
+	gboolean read_whole;
 
 	got_data = FALSE;
 	vdev = sdi->priv;
@@ -89,6 +95,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 				if (!(vdev->capfile = zip_fopen(vdev->archive,
 						vdev->capturefile, 0)))
 					return FALSE;
+				vdev->capfile_size = zs.size;
 				sr_dbg("Opened %s.", vdev->capturefile);
 			} else {
 				/* Try as first chunk filename. */
@@ -98,6 +105,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 					if (!(vdev->capfile = zip_fopen(vdev->archive,
 							capturefile, 0)))
 						return FALSE;
+					vdev->capfile_size = zs.size;
 					sr_dbg("Opened %s.", capturefile);
 				} else {
 					sr_err("No capture file '%s' in " "session file '%s'.",
@@ -114,6 +122,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 				if (!(vdev->capfile = zip_fopen(vdev->archive,
 						capturefile, 0)))
 					return FALSE;
+				vdev->capfile_size = zs.size;
 				sr_dbg("Opened %s.", capturefile);
 			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
 				vdev->capturefile = g_strdup_printf("analog-1-%d",
@@ -140,15 +149,24 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 		}
 	}
 
-	buf = g_malloc(CHUNKSIZE);
+	/*
+	 * Packed analog chunks are containers which need to get decoded
+	 * as a whole. Read them in one go, the next read sees their end.
+	 */
+	read_whole = vdev->cur_analog_channel != 0 && vdev->analog_packed;
+	bufsize = read_whole ? MAX(vdev->capfile_size, 1) : CHUNKSIZE;
+	buf = g_try_malloc(bufsize);
+	if (!buf)
+		return FALSE;
 
 	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
+	if (vdev->unitsize && !read_whole)
 		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
+				bufsize / vdev->unitsize * vdev->unitsize);
 	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
+		ret = zip_fread(vdev->capfile, buf, bufsize);
 
+	memset(&chunk, 0, sizeof(chunk));
 	if (ret > 0) {
 		if (vdev->cur_analog_channel != 0) {
 			got_data = TRUE;
@@ -164,6 +182,30 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			analog.meaning->unit = SR_UNIT_VOLT;
 			analog.meaning->mqflags = SR_MQFLAG_DC;
 			analog.data = (float *) buf;
+			if (vdev->analog_packed) {
+				if (sr_sessionfile_analog_unpack(buf, ret, &chunk) != SR_OK) {
+					sr_err("Malformed analog data in '%s'.",
+						vdev->sessionfile);
+					g_slist_free(analog.meaning->channels);
+					g_free(buf);
+					return FALSE;
+				}
+				analog.num_samples = chunk.count;
+				analog.data = chunk.data;
+				if (!chunk.is_float) {
+					/* Raw device values, host endianess. */
+					encoding.unitsize = sizeof(int32_t);
+					encoding.is_signed = TRUE;
+					encoding.is_float = FALSE;
+#ifdef WORDS_BIGENDIAN
+					encoding.is_bigendian = TRUE;
+#else
+					encoding.is_bigendian = FALSE;
+#endif
+					encoding.scale = chunk.scale;
+					encoding.offset = chunk.offset;
+				}
+			}
 		} else if (vdev->unitsize) {
 			got_data = TRUE;
 			if (ret % vdev->unitsize != 0)
@@ -195,6 +237,7 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 			got_data = TRUE;
 		}
 	}
+	g_free(chunk.data);
 	g_free(buf);
 
 	return got_data;
@@ -334,6 +377,9 @@ static int config_list(uint32_t key, GVariant **data,
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct session_vdev *vdev;
+	struct zip_stat zs;
+	GKeyFile *kf;
+	char *encoding;
 	int ret;
 	GSList *l;
 	struct sr_channel *ch;
@@ -360,6 +406,17 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		return SR_ERR;
 	}
 
+	vdev->analog_packed = FALSE;
+	if (zip_stat(vdev->archive, "metadata", 0, &zs) != -1 &&
+			(kf = sr_sessionfile_read_metadata(vdev->archive, &zs))) {
+		encoding = g_key_file_get_string(kf, "device 1",
+			"analog encoding", NULL);
+		if (encoding && strcmp(encoding, "packed") == 0)
+			vdev->analog_packed = TRUE;
+		g_free(encoding);
+		g_key_file_free(kf);
+	}
+
 	std_session_send_df_header(sdi);
 
 	/* freewheeling source */
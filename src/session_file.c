@@ -111,6 +111,225 @@ SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 	return keyfile;
 }
 
+/*
+ * Analog chunk containers, used when the "analog encoding" of a session
+ * file is "packed" (session file version 3). Each analog-1-N-M archive
+ * member holds one container. Integers are little endian.
+ *
+ * - 4 bytes magic "SRA1", u8 codec, u8 and u16 reserved, u32 count.
+ * - Codec 0: count float32 values.
+ * - Codec 1: native integer values of the acquisition device. Scale
+ *   and offset (i64 p, u64 q each) follow the header. Sample data is
+ *   kept in blocks of up to ANALOG_PACK_BLOCK values: one byte bit
+ *   width, then the zigzag encoded differences to the respective
+ *   previous value, packed LSB first into the minimum number of bytes.
+ */
+#define ANALOG_PACK_MAGIC	"SRA1"
+#define ANALOG_PACK_HDRSIZE	12
+#define ANALOG_PACK_RATSIZE	(4 * sizeof(uint64_t))
+#define ANALOG_PACK_BLOCK	128
+#define ANALOG_PACK_MAXBITS	33
+
+static void analog_pack_header(GString *out, uint8_t codec, size_t count)
+{
+	uint8_t hdr[ANALOG_PACK_HDRSIZE], *wp;
+
+	wp = &hdr[0];
+	memcpy(wp, ANALOG_PACK_MAGIC, 4);
+	wp += 4;
+	write_u8_inc(&wp, codec);
+	write_u8_inc(&wp, 0);
+	write_u16le_inc(&wp, 0);
+	write_u32le_inc(&wp, count);
+	g_string_append_len(out, (const char *)hdr, sizeof(hdr));
+}
+
+/**
+ * Append a container of float values to an output buffer.
+ *
+ * @param[out] out The buffer which receives the container.
+ * @param[in] values The sample values.
+ * @param[in] count The number of sample values.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_analog_pack_float(GString *out,
+	const float *values, size_t count)
+{
+	uint8_t *wp;
+	size_t pos;
+
+	analog_pack_header(out, 0, count);
+	pos = out->len;
+	g_string_set_size(out, pos + count * sizeof(float));
+	wp = (uint8_t *)&out->str[pos];
+	while (count--)
+		write_fltle_inc(&wp, *values++);
+}
+
+/**
+ * Append a container of delta encoded and bit packed native integer
+ * sample values to an output buffer.
+ *
+ * @param[out] out The buffer which receives the container.
+ * @param[in] values The raw sample values (before scale and offset).
+ * @param[in] count The number of sample values.
+ * @param[in] scale The scale factor which applies to raw values.
+ * @param[in] offset The offset which applies to scaled values.
+ *
+ * @private
+ */
+SR_PRIV void sr_sessionfile_analog_pack_int(GString *out,
+	const int32_t *values, size_t count,
+	const struct sr_rational *scale, const struct sr_rational *offset)
+{
+	uint8_t rat[ANALOG_PACK_RATSIZE], *wp;
+	uint64_t zz[ANALOG_PACK_BLOCK], bits, acc;
+	int64_t prev, delta;
+	size_t block, idx, width, nacc, pos;
+
+	analog_pack_header(out, 1, count);
+	wp = &rat[0];
+	write_u64le_inc(&wp, (uint64_t)scale->p);
+	write_u64le_inc(&wp, scale->q);
+	write_u64le_inc(&wp, (uint64_t)offset->p);
+	write_u64le_inc(&wp, offset->q);
+	g_string_append_len(out, (const char *)rat, sizeof(rat));
+
+	prev = 0;
+	while (count) {
+		block = MIN(count, ANALOG_PACK_BLOCK);
+		bits = 0;
+		for (idx = 0; idx < block; idx++) {
+			delta = (int64_t)values[idx] - prev;
+			prev = values[idx];
+			zz[idx] = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+			bits |= zz[idx];
+		}
+		width = 0;
+		while (bits) {
+			width++;
+			bits >>= 1;
+		}
+
+		pos = out->len;
+		g_string_set_size(out, pos + 1 + (block * width + 7) / 8);
+		wp = (uint8_t *)&out->str[pos];
+		*wp++ = width;
+		acc = 0;
+		nacc = 0;
+		for (idx = 0; width && idx < block; idx++) {
+			acc |= zz[idx] << nacc;
+			nacc += width;
+			while (nacc >= 8) {
+				*wp++ = acc & 0xff;
+				acc >>= 8;
+				nacc -= 8;
+			}
+		}
+		if (nacc)
+			*wp++ = acc & 0xff;
+
+		values += block;
+		count -= block;
+	}
+}
+
+/**
+ * Decode an analog chunk container.
+ *
+ * @param[in] buf The container's content.
+ * @param[in] len The container's size in bytes.
+ * @param[out] chunk Receives the decoded sample data. The caller
+ *   must g_free() the chunk's data when done.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_DATA Malformed input data.
+ *
+ * @private
+ */
+SR_PRIV int sr_sessionfile_analog_unpack(const uint8_t *buf, size_t len,
+	struct sr_sessionfile_analog_chunk *chunk)
+{
+	const uint8_t *rdptr, *endptr;
+	uint8_t codec;
+	size_t count, idx, block, width, nacc;
+	uint64_t acc, zz, mask;
+	int64_t value;
+	int32_t *ints;
+	float *floats;
+
+	memset(chunk, 0, sizeof(*chunk));
+	if (len < ANALOG_PACK_HDRSIZE || memcmp(buf, ANALOG_PACK_MAGIC, 4) != 0)
+		return SR_ERR_DATA;
+	rdptr = buf + 4;
+	endptr = buf + len;
+	codec = read_u8_inc(&rdptr);
+	rdptr += 3;
+	count = read_u32le_inc(&rdptr);
+
+	if (codec == 0) {
+		if ((size_t)(endptr - rdptr) < count * sizeof(float))
+			return SR_ERR_DATA;
+		floats = g_try_malloc(count * sizeof(float) + 1);
+		if (!floats)
+			return SR_ERR_MALLOC;
+		for (idx = 0; idx < count; idx++)
+			floats[idx] = read_fltle_inc(&rdptr);
+		chunk->is_float = TRUE;
+		chunk->count = count;
+		chunk->data = floats;
+		return SR_OK;
+	}
+	if (codec != 1 || (size_t)(endptr - rdptr) < ANALOG_PACK_RATSIZE)
+		return SR_ERR_DATA;
+
+	chunk->scale.p = (int64_t)read_u64le_inc(&rdptr);
+	chunk->scale.q = read_u64le_inc(&rdptr);
+	chunk->offset.p = (int64_t)read_u64le_inc(&rdptr);
+	chunk->offset.q = read_u64le_inc(&rdptr);
+	ints = g_try_malloc(count * sizeof(int32_t) + 1);
+	if (!ints)
+		return SR_ERR_MALLOC;
+
+	value = 0;
+	idx = 0;
+	while (idx < count) {
+		if (rdptr >= endptr)
+			break;
+		width = read_u8_inc(&rdptr);
+		if (width > ANALOG_PACK_MAXBITS)
+			break;
+		block = MIN(count - idx, ANALOG_PACK_BLOCK);
+		if ((size_t)(endptr - rdptr) < (block * width + 7) / 8)
+			break;
+		mask = (width < 64) ? (1ULL << width) - 1 : ~0ULL;
+		acc = 0;
+		nacc = 0;
+		while (block--) {
+			while (nacc < width) {
+				acc |= (uint64_t)*rdptr++ << nacc;
+				nacc += 8;
+			}
+			zz = acc & mask;
+			acc >>= width;
+			nacc -= width;
+			value += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+			ints[idx++] = value;
+		}
+	}
+	if (idx < count) {
+		g_free(ints);
+		return SR_ERR_DATA;
+	}
+
+	chunk->is_float = FALSE;
+	chunk->count = count;
+	chunk->data = ints;
+
+	return SR_OK;
+}
+
 /** @private */
 SR_PRIV int sr_sessionfile_check(const char *filename)
 {
@@ -151,7 +370,7 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	zip_fclose(zf);
 	s[ret] = '\0';
 	version = g_ascii_strtoull(s, NULL, 10);
-	if (version == 0 || version > 2) {
+	if (version == 0 || version > 3) {
 		sr_dbg("Cannot handle sigrok session file version %" PRIu64 ".",
 			version);
 		zip_discard(archive);
@@ -41,6 +41,57 @@ SR_PRIV int logic_channel_unitsize(GSList *channels)
 	return (number + 7) / 8;
 }
 
+/*
+ * Prepare word-parallel checks for the common case of a single stage
+ * trigger. Conditions of all channels get evaluated at once, by means
+ * of masks, instead of iterating the list of matches for each sample.
+ */
+static void setup_fast_check(struct soft_trigger_logic *stl)
+{
+	const struct sr_trigger_stage *stage;
+	const struct sr_trigger_match *match;
+	const GSList *l;
+	uint64_t bit;
+
+	stl->fast = FALSE;
+	if (!stl->trigger || g_slist_length(stl->trigger->stages) != 1)
+		return;
+	if (stl->unitsize > (int)sizeof(uint64_t))
+		return;
+	stage = stl->trigger->stages->data;
+	if (!stage->matches)
+		return;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			continue;
+		if (match->channel->index >= stl->unitsize * 8)
+			return;
+		bit = UINT64_C(1) << match->channel->index;
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+			stl->mask_zero |= bit;
+			break;
+		case SR_TRIGGER_ONE:
+			stl->mask_one |= bit;
+			break;
+		case SR_TRIGGER_RISING:
+			stl->mask_rising |= bit;
+			break;
+		case SR_TRIGGER_FALLING:
+			stl->mask_falling |= bit;
+			break;
+		case SR_TRIGGER_EDGE:
+			stl->mask_edge |= bit;
+			break;
+		default:
+			return;
+		}
+	}
+	stl->fast = TRUE;
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
@@ -70,6 +121,8 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	setup_fast_check(stl);
+
 	return stl;
 }
 
@@ -144,7 +197,6 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	int bit, prev_bit;
 	gboolean result;
 
-	stl->count++;
 	result = FALSE;
 	bit = *(sample + match->channel->index / 8)
 			& (1 << (match->channel->index % 8));
@@ -154,7 +206,7 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 		result = bit != 0;
 	else {
 		/* Edge matches. */
-		if (stl->count == 1)
+		if (!stl->count)
 			/* First sample, don't have enough for an edge match yet. */
 			return FALSE;
 		prev_bit = *(stl->prev_sample + match->channel->index / 8)
@@ -170,6 +222,73 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	return result;
 }
 
+static uint64_t read_sample(const uint8_t *p, int unitsize)
+{
+	uint64_t value;
+	int idx;
+
+	switch (unitsize) {
+	case 1:
+		return read_u8(p);
+	case 2:
+		return read_u16le(p);
+	case 4:
+		return read_u32le(p);
+	case 8:
+		return read_u64le(p);
+	}
+	value = 0;
+	for (idx = unitsize - 1; idx >= 0; idx--)
+		value = (value << 8) | p[idx];
+
+	return value;
+}
+
+/*
+ * Word-parallel variant of the trigger check, for single stage
+ * triggers. The very first sample of an acquisition cannot match edge
+ * conditions. Returns the offset of the matching sample, or -1.
+ */
+static int logic_check_fast(struct soft_trigger_logic *stl,
+		uint8_t *buf, int len)
+{
+	uint64_t sample, prev, changed;
+	uint64_t edges;
+	int i;
+
+	edges = stl->mask_rising | stl->mask_falling | stl->mask_edge;
+	if (len < stl->unitsize)
+		return -1;
+
+	i = 0;
+	if (!stl->count) {
+		/* No previous sample yet, edges cannot match. */
+		stl->count = 1;
+		if (edges) {
+			memcpy(stl->prev_sample, buf, stl->unitsize);
+			i += stl->unitsize;
+		}
+	}
+	prev = read_sample(stl->prev_sample, stl->unitsize);
+
+	for (; i + stl->unitsize <= len; i += stl->unitsize) {
+		sample = read_sample(buf + i, stl->unitsize);
+		changed = sample ^ prev;
+		if ((sample & stl->mask_one) == stl->mask_one &&
+				!(sample & stl->mask_zero) &&
+				(changed & sample & stl->mask_rising) == stl->mask_rising &&
+				(changed & prev & stl->mask_falling) == stl->mask_falling &&
+				(changed & stl->mask_edge) == stl->mask_edge) {
+			memcpy(stl->prev_sample, buf + i, stl->unitsize);
+			return i / stl->unitsize;
+		}
+		prev = sample;
+	}
+	memcpy(stl->prev_sample, buf + len - stl->unitsize, stl->unitsize);
+
+	return -1;
+}
+
 /* Returns the offset (in samples) within buf of where the trigger
  * occurred, or -1 if not triggered. */
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
@@ -182,6 +301,18 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 	int i;
 	gboolean match_found;
 
+	if (stl->fast) {
+		offset = logic_check_fast(stl, buf, len);
+		if (offset >= 0) {
+			pre_trigger_append(stl, buf, offset * stl->unitsize);
+			pre_trigger_send(stl, pre_trigger_samples);
+			std_session_send_df_trigger(stl->sdi);
+		} else {
+			pre_trigger_append(stl, buf, len);
+		}
+		return offset;
+	}
+
 	offset = -1;
 	for (i = 0; i < len; i += stl->unitsize) {
 		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
@@ -202,6 +333,7 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 			}
 		}
 		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+		stl->count = 1;
 		if (match_found) {
 			/* Matched on the current stage. */
 			if (l_stage->next) {
@@ -0,0 +1,214 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Task runner helper functions
+ *
+ * A small fork/join helper on top of a GThreadPool. A batch of tasks,
+ * identified by their index, gets distributed to worker threads, and
+ * the caller blocks until all of them have completed. Tasks must only
+ * touch data which is private to their index, results are collected
+ * by the caller in index order afterwards.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "task_runner"
+
+/* Upper limit for worker threads, regardless of the number of cores. */
+#define MAX_WORKERS 32
+
+struct sr_task_runner {
+	GThreadPool *pool;
+	unsigned int num_workers;
+};
+
+struct task_batch {
+	sr_task_func func;
+	void *cb_data;
+	GMutex mutex;
+	GCond done_cond;
+	size_t pending;
+	int *results;
+};
+
+struct task_item {
+	struct task_batch *batch;
+	size_t idx;
+};
+
+static void run_task(gpointer data, gpointer user_data)
+{
+	struct task_item *item;
+	struct task_batch *batch;
+	int ret;
+
+	(void)user_data;
+
+	item = data;
+	batch = item->batch;
+	ret = batch->func(item->idx, batch->cb_data);
+
+	g_mutex_lock(&batch->mutex);
+	batch->results[item->idx] = ret;
+	if (!--batch->pending)
+		g_cond_signal(&batch->done_cond);
+	g_mutex_unlock(&batch->mutex);
+}
+
+/**
+ * Create a task runner.
+ *
+ * @param max_workers Maximum number of worker threads, or 0 to use one
+ *                    per processor.
+ *
+ * @return The new task runner, or NULL when tasks should run inline
+ *         (single processor systems, or thread creation failure).
+ */
+SR_PRIV struct sr_task_runner *sr_task_runner_new(unsigned int max_workers)
+{
+	struct sr_task_runner *runner;
+	GError *error;
+
+	if (!max_workers)
+		max_workers = g_get_num_processors();
+	max_workers = MIN(max_workers, MAX_WORKERS);
+	if (max_workers < 2)
+		return NULL;
+
+	runner = g_malloc0(sizeof(*runner));
+	error = NULL;
+	runner->pool = g_thread_pool_new(run_task, runner, max_workers,
+		FALSE, &error);
+	if (!runner->pool) {
+		sr_warn("Cannot create worker threads: %s.",
+			error ? error->message : "unknown error");
+		g_clear_error(&error);
+		g_free(runner);
+		return NULL;
+	}
+	runner->num_workers = max_workers;
+	sr_dbg("Created task runner with %u workers.", max_workers);
+
+	return runner;
+}
+
+/**
+ * Release a task runner and its worker threads.
+ *
+ * @param runner The task runner, may be NULL.
+ */
+SR_PRIV void sr_task_runner_free(struct sr_task_runner *runner)
+{
+	if (!runner)
+		return;
+
+	g_thread_pool_free(runner->pool, FALSE, TRUE);
+	g_free(runner);
+}
+
+/**
+ * Get the number of tasks which can execute concurrently.
+ *
+ * Callers use this to decide how many slices to split their work into.
+ *
+ * @param runner The task runner, may be NULL.
+ *
+ * @return The number of workers, 1 when tasks run inline.
+ */
+SR_PRIV unsigned int sr_task_runner_width(const struct sr_task_runner *runner)
+{
+	return runner ? runner->num_workers : 1;
+}
+
+/**
+ * Run a batch of tasks, and wait for their completion.
+ *
+ * The callback gets invoked once for every index in the range 0 to
+ * count - 1, potentially from different threads and in any order.
+ * Without a runner, or for a single task, the callback runs inline.
+ *
+ * @param runner The task runner, may be NULL.
+ * @param count The number of tasks.
+ * @param func The callback to run for each task.
+ * @param cb_data Opaque data which gets passed to the callback.
+ *
+ * @return SR_OK when all tasks succeeded, otherwise the error code of
+ *         the failed task with the lowest index.
+ */
+SR_PRIV int sr_task_runner_run(struct sr_task_runner *runner, size_t count,
+	sr_task_func func, void *cb_data)
+{
+	struct task_batch batch;
+	struct task_item *items;
+	size_t idx;
+	int ret;
+
+	if (!func)
+		return SR_ERR_ARG;
+
+	if (!runner || count < 2) {
+		for (idx = 0; idx < count; idx++) {
+			ret = func(idx, cb_data);
+			if (ret != SR_OK)
+				return ret;
+		}
+		return SR_OK;
+	}
+
+	memset(&batch, 0, sizeof(batch));
+	batch.func = func;
+	batch.cb_data = cb_data;
+	g_mutex_init(&batch.mutex);
+	g_cond_init(&batch.done_cond);
+	batch.pending = count;
+	batch.results = g_malloc0(count * sizeof(batch.results[0]));
+	items = g_malloc(count * sizeof(items[0]));
+
+	for (idx = 0; idx < count; idx++) {
+		items[idx].batch = &batch;
+		items[idx].idx = idx;
+		g_thread_pool_push(runner->pool, &items[idx], NULL);
+	}
+
+	g_mutex_lock(&batch.mutex);
+	while (batch.pending)
+		g_cond_wait(&batch.done_cond, &batch.mutex);
+	g_mutex_unlock(&batch.mutex);
+
+	ret = SR_OK;
+	for (idx = 0; idx < count; idx++) {
+		if (batch.results[idx] != SR_OK) {
+			ret = batch.results[idx];
+			break;
+		}
+	}
+
+	g_free(items);
+	g_free(batch.results);
+	g_cond_clear(&batch.done_cond);
+	g_mutex_clear(&batch.mutex);
+
+	return ret;
+}
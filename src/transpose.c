@@ -0,0 +1,523 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * Bit matrix transposition of channel-major logic data
+ *
+ * Several logic analyzers send their samples channel by channel: a
+ * block holds one 32bit or 64bit word per enabled channel, each word
+ * carries consecutive samples of that channel. These helpers convert
+ * such blocks to sigrok's sample-major representation, one 16bit unit
+ * per sample, with the bit positions of each channel configurable.
+ *
+ * The work is done by kernels which transpose a 16 rows by 64 bits
+ * matrix. Portable kernels use per-bit tests and 64bit word tricks.
+ * On x86 an SSE2 and an AVX2 kernel use byte unpacking and movemask
+ * instructions, and get selected at runtime when the CPU supports them.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "transpose"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* Kernel input: up to 16 rows (channels) of 8 bytes each. */
+#define KERNEL_ROWS	16
+#define KERNEL_BYTES	8
+#define KERNEL_SAMPLES	(KERNEL_BYTES * 8)
+
+/*
+ * Transpose a 16 x 64 bit matrix. Row r holds 64 samples of channel r,
+ * sample k is bit (k % 8) of byte (k / 8). Sample k of the output has
+ * bit r set when that bit of row r is set.
+ */
+typedef void (*transpose_kernel)(const uint8_t *rows, uint16_t *samples);
+
+struct sr_bit_transpose {
+	size_t row_bits;
+	size_t row_count;
+	gboolean msb_first;
+	gboolean remap;
+	uint16_t remap_lut[2][256];
+	const char *kernel_name;
+	transpose_kernel kernel;
+	/* Partial block from the previous sr_bit_transpose_feed() call. */
+	uint8_t carry[KERNEL_ROWS * KERNEL_BYTES];
+	size_t carry_len;
+};
+
+static void kernel_scalar(const uint8_t *rows, uint16_t *samples)
+{
+	size_t k, r;
+	uint16_t sample;
+
+	for (k = 0; k < KERNEL_SAMPLES; k++) {
+		sample = 0;
+		for (r = 0; r < KERNEL_ROWS; r++) {
+			if (rows[r * KERNEL_BYTES + k / 8] & (1 << (k % 8)))
+				sample |= 1 << r;
+		}
+		samples[k] = sample;
+	}
+}
+
+/*
+ * Transpose an 8x8 bit matrix held in a 64bit word, byte r being row r
+ * and bit c of it being column c (Hacker's Delight, section 7-3).
+ */
+static inline uint64_t transpose_8x8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & UINT64_C(0x00aa00aa00aa00aa);
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & UINT64_C(0x0000cccc0000cccc);
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & UINT64_C(0x00000000f0f0f0f0);
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+static void kernel_swar(const uint8_t *rows, uint16_t *samples)
+{
+	size_t j, r, i;
+	uint64_t lo, hi;
+
+	for (j = 0; j < KERNEL_BYTES; j++) {
+		/* Gather byte j of all rows, then transpose 8 channels each. */
+		lo = hi = 0;
+		for (r = 0; r < 8; r++) {
+			lo |= (uint64_t)rows[r * KERNEL_BYTES + j] << (8 * r);
+			hi |= (uint64_t)rows[(r + 8) * KERNEL_BYTES + j] << (8 * r);
+		}
+		lo = transpose_8x8(lo);
+		hi = transpose_8x8(hi);
+		for (i = 0; i < 8; i++) {
+			*samples++ = (lo & 0xff) | ((hi & 0xff) << 8);
+			lo >>= 8;
+			hi >>= 8;
+		}
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * Byte transpose 16 rows of 8 bytes, v[j] gets byte j of all rows.
+ * Plain SSE2, shared by both x86 kernels.
+ */
+__attribute__((target("sse2")))
+static inline void gather_columns_sse2(const uint8_t *rows, __m128i *v)
+{
+	__m128i a[16], b[8], c[8], d[8];
+	size_t i;
+
+	for (i = 0; i < 16; i++)
+		a[i] = _mm_loadl_epi64((const __m128i *)&rows[i * KERNEL_BYTES]);
+	/* b[i]: rows 2i, 2i+1 interleaved bytewise. */
+	for (i = 0; i < 8; i++)
+		b[i] = _mm_unpacklo_epi8(a[2 * i], a[2 * i + 1]);
+	/* c[2i], c[2i+1]: rows 4i..4i+3, bytes 0..3 and 4..7. */
+	for (i = 0; i < 4; i++) {
+		c[2 * i] = _mm_unpacklo_epi16(b[2 * i], b[2 * i + 1]);
+		c[2 * i + 1] = _mm_unpackhi_epi16(b[2 * i], b[2 * i + 1]);
+	}
+	/* d: rows 0..7 resp. 8..15, pairs of bytes (0,1) (2,3) (4,5) (6,7). */
+	for (i = 0; i < 2; i++) {
+		d[4 * i + 0] = _mm_unpacklo_epi32(c[4 * i + 0], c[4 * i + 2]);
+		d[4 * i + 1] = _mm_unpackhi_epi32(c[4 * i + 0], c[4 * i + 2]);
+		d[4 * i + 2] = _mm_unpacklo_epi32(c[4 * i + 1], c[4 * i + 3]);
+		d[4 * i + 3] = _mm_unpackhi_epi32(c[4 * i + 1], c[4 * i + 3]);
+	}
+	for (i = 0; i < 4; i++) {
+		v[2 * i] = _mm_unpacklo_epi64(d[i], d[4 + i]);
+		v[2 * i + 1] = _mm_unpackhi_epi64(d[i], d[4 + i]);
+	}
+}
+
+__attribute__((target("sse2")))
+static void kernel_sse2(const uint8_t *rows, uint16_t *samples)
+{
+	__m128i v[KERNEL_BYTES];
+	size_t j;
+
+	gather_columns_sse2(rows, v);
+	for (j = 0; j < KERNEL_BYTES; j++) {
+		/* The MSB of every byte holds the sample of interest. */
+		samples[0] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 7));
+		samples[1] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 6));
+		samples[2] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 5));
+		samples[3] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 4));
+		samples[4] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 3));
+		samples[5] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 2));
+		samples[6] = _mm_movemask_epi8(_mm_slli_epi64(v[j], 1));
+		samples[7] = _mm_movemask_epi8(v[j]);
+		samples += 8;
+	}
+}
+
+static inline void store_pair(uint16_t *samples, uint32_t pair)
+{
+	memcpy(samples, &pair, sizeof(pair));
+}
+
+__attribute__((target("avx2")))
+static void kernel_avx2(const uint8_t *rows, uint16_t *samples)
+{
+	__m128i v[KERNEL_BYTES];
+	__m256i y, s01, s23, s45, s67;
+	size_t j;
+
+	gather_columns_sse2(rows, v);
+	/*
+	 * One column in both lanes, shifted by different amounts. Each
+	 * movemask yields two consecutive samples.
+	 */
+	s01 = _mm256_set_epi64x(6, 6, 7, 7);
+	s23 = _mm256_set_epi64x(4, 4, 5, 5);
+	s45 = _mm256_set_epi64x(2, 2, 3, 3);
+	s67 = _mm256_set_epi64x(0, 0, 1, 1);
+	for (j = 0; j < KERNEL_BYTES; j++) {
+		y = _mm256_broadcastsi128_si256(v[j]);
+		store_pair(&samples[0],
+			_mm256_movemask_epi8(_mm256_sllv_epi64(y, s01)));
+		store_pair(&samples[2],
+			_mm256_movemask_epi8(_mm256_sllv_epi64(y, s23)));
+		store_pair(&samples[4],
+			_mm256_movemask_epi8(_mm256_sllv_epi64(y, s45)));
+		store_pair(&samples[6],
+			_mm256_movemask_epi8(_mm256_sllv_epi64(y, s67)));
+		samples += 8;
+	}
+}
+
+#endif
+
+static const struct {
+	const char *name;
+	transpose_kernel kernel;
+} kernels[] = {
+	/* In order of increasing preference. */
+	{ "scalar", kernel_scalar, },
+	{ "swar", kernel_swar, },
+#ifdef HAVE_X86_KERNELS
+	{ "sse2", kernel_sse2, },
+	{ "avx2", kernel_avx2, },
+#endif
+};
+
+static gboolean kernel_supported(const char *name)
+{
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init();
+	if (strcmp(name, "sse2") == 0)
+		return __builtin_cpu_supports("sse2");
+	if (strcmp(name, "avx2") == 0)
+		return __builtin_cpu_supports("avx2");
+#endif
+	(void)name;
+
+	return TRUE;
+}
+
+static uint64_t reverse_bits_64(uint64_t x)
+{
+	x = ((x >> 1) & UINT64_C(0x5555555555555555)) |
+		((x & UINT64_C(0x5555555555555555)) << 1);
+	x = ((x >> 2) & UINT64_C(0x3333333333333333)) |
+		((x & UINT64_C(0x3333333333333333)) << 2);
+	x = ((x >> 4) & UINT64_C(0x0f0f0f0f0f0f0f0f)) |
+		((x & UINT64_C(0x0f0f0f0f0f0f0f0f)) << 4);
+
+	return GUINT64_SWAP_LE_BE(x);
+}
+
+/*
+ * Copy one block's rows into the kernel's input layout, at byte offset
+ * ofs within each row. Words with the first sample in their MSB get
+ * bit reversed, so that the first sample ends up in bit 0 of byte 0.
+ */
+static void stage_block(const struct sr_bit_transpose *t,
+	const uint8_t *src, uint8_t *rows, size_t ofs)
+{
+	size_t row_bytes, r;
+	uint64_t w;
+
+	row_bytes = t->row_bits / 8;
+	for (r = 0; r < t->row_count; r++) {
+		if (!t->msb_first) {
+			memcpy(&rows[r * KERNEL_BYTES + ofs], src, row_bytes);
+		} else if (row_bytes == 8) {
+			w = reverse_bits_64(read_u64le(src));
+			write_u64le(&rows[r * KERNEL_BYTES + ofs], w);
+		} else {
+			w = reverse_bits_64(read_u32le(src)) >> 32;
+			write_u32le(&rows[r * KERNEL_BYTES + ofs], w);
+		}
+		src += row_bytes;
+	}
+}
+
+/**
+ * Create a bit transposition context.
+ *
+ * Input data is a sequence of blocks, each block holds one word per
+ * row. The rows typically correspond to the enabled channels. Words
+ * are little endian.
+ *
+ * @param row_bits The size of a word, 32 or 64 bits.
+ * @param row_count The number of rows per block, 1 to 16.
+ * @param row_masks The output bits for each row, or NULL to map row r
+ *                  to bit r.
+ * @param msb_first When set, the first sample is in the word's MSB,
+ *                  otherwise in its LSB.
+ *
+ * @return The new context, or NULL on invalid parameters. Must be
+ *         released with sr_bit_transpose_free().
+ */
+SR_PRIV struct sr_bit_transpose *sr_bit_transpose_new(size_t row_bits,
+	size_t row_count, const uint16_t *row_masks, gboolean msb_first)
+{
+	struct sr_bit_transpose *t;
+	size_t r, v;
+	size_t idx;
+
+	if (row_bits != 32 && row_bits != 64)
+		return NULL;
+	if (!row_count || row_count > KERNEL_ROWS)
+		return NULL;
+
+	t = g_malloc0(sizeof(*t));
+	t->row_bits = row_bits;
+	t->row_count = row_count;
+	t->msb_first = msb_first;
+
+	if (row_masks) {
+		for (r = 0; r < row_count; r++) {
+			if (row_masks[r] != (1U << r))
+				t->remap = TRUE;
+		}
+	}
+	if (t->remap) {
+		/* Lookup tables from dense row bits to output bits. */
+		for (v = 0; v < 256; v++) {
+			for (r = 0; r < 8; r++) {
+				if (!(v & (1U << r)))
+					continue;
+				if (r < row_count)
+					t->remap_lut[0][v] |= row_masks[r];
+				if (r + 8 < row_count)
+					t->remap_lut[1][v] |= row_masks[r + 8];
+			}
+		}
+	}
+
+	/* Pick the most preferred kernel which the CPU supports. */
+	for (idx = ARRAY_SIZE(kernels); idx-- > 0; ) {
+		if (kernel_supported(kernels[idx].name))
+			break;
+	}
+	t->kernel_name = kernels[idx].name;
+	t->kernel = kernels[idx].kernel;
+	sr_dbg("Using %s kernel for %zu x %zu bit blocks.",
+		t->kernel_name, row_count, row_bits);
+
+	return t;
+}
+
+/**
+ * Release a bit transposition context.
+ *
+ * @param t The context, may be NULL.
+ */
+SR_PRIV void sr_bit_transpose_free(struct sr_bit_transpose *t)
+{
+	g_free(t);
+}
+
+/**
+ * Select a specific kernel, for tests and benchmarks.
+ *
+ * @param t The context.
+ * @param name The kernel name ("scalar", "swar", "sse2", "avx2").
+ *
+ * @return SR_OK upon success, SR_ERR_NA when the kernel is not
+ *         available on this platform or CPU, SR_ERR_ARG otherwise.
+ */
+SR_PRIV int sr_bit_transpose_set_kernel(struct sr_bit_transpose *t,
+	const char *name)
+{
+	size_t idx;
+
+	if (!t || !name)
+		return SR_ERR_ARG;
+
+	for (idx = 0; idx < ARRAY_SIZE(kernels); idx++) {
+		if (strcmp(kernels[idx].name, name) != 0)
+			continue;
+		if (!kernel_supported(name))
+			return SR_ERR_NA;
+		t->kernel_name = kernels[idx].name;
+		t->kernel = kernels[idx].kernel;
+		return SR_OK;
+	}
+
+	return SR_ERR_NA;
+}
+
+/**
+ * Get the name of the kernel which a context uses.
+ *
+ * @param t The context.
+ *
+ * @return The kernel name.
+ */
+SR_PRIV const char *sr_bit_transpose_kernel_name(const struct sr_bit_transpose *t)
+{
+	return t ? t->kernel_name : NULL;
+}
+
+static void remap_samples(const struct sr_bit_transpose *t,
+	uint16_t *samples, size_t count)
+{
+	while (count--) {
+		*samples = t->remap_lut[0][*samples & 0xff] |
+			t->remap_lut[1][*samples >> 8];
+		samples++;
+	}
+}
+
+/**
+ * Convert channel-major blocks to sample-major 16bit units.
+ *
+ * @param t The context.
+ * @param src Input data, block_count blocks of row_count words.
+ * @param block_count The number of input blocks.
+ * @param dst Output buffer, row_bits units of 16 bits per block.
+ *
+ * @return The number of samples written.
+ */
+SR_PRIV size_t sr_bit_transpose_run(const struct sr_bit_transpose *t,
+	const uint8_t *src, size_t block_count, uint16_t *dst)
+{
+	uint8_t rows[KERNEL_ROWS * KERNEL_BYTES];
+	uint16_t tail[KERNEL_SAMPLES];
+	size_t block_bytes, per_call, count, i;
+	gboolean direct;
+
+	if (!t || !src || !dst)
+		return 0;
+
+	block_bytes = t->row_count * t->row_bits / 8;
+	count = block_count * t->row_bits;
+
+	/* Full 16 channel blocks of LSB first 64bit words need no staging. */
+	direct = t->row_bits == 64 && t->row_count == KERNEL_ROWS && !t->msb_first;
+	/* Two blocks of 32bit words fill the kernel's 64bit rows. */
+	per_call = KERNEL_SAMPLES / t->row_bits;
+
+	memset(rows, 0, sizeof(rows));
+	while (block_count >= per_call) {
+		if (direct) {
+			t->kernel(src, dst);
+		} else {
+			for (i = 0; i < per_call; i++) {
+				stage_block(t, src + i * block_bytes, rows,
+					i * t->row_bits / 8);
+			}
+			t->kernel(rows, dst);
+		}
+		if (t->remap)
+			remap_samples(t, dst, KERNEL_SAMPLES);
+		src += per_call * block_bytes;
+		dst += KERNEL_SAMPLES;
+		block_count -= per_call;
+	}
+	if (block_count) {
+		/* A single trailing block of 32bit words. */
+		memset(rows, 0, sizeof(rows));
+		stage_block(t, src, rows, 0);
+		t->kernel(rows, tail);
+		if (t->remap)
+			remap_samples(t, tail, t->row_bits);
+		memcpy(dst, tail, t->row_bits * sizeof(tail[0]));
+	}
+
+	return count;
+}
+
+/**
+ * Convert a stream of channel-major data to sample-major 16bit units.
+ *
+ * Unlike sr_bit_transpose_run(), input may end in the middle of a
+ * block, e.g. at USB packet boundaries. The incomplete block is kept
+ * and gets completed by the next call.
+ *
+ * @param t The context.
+ * @param src Input data.
+ * @param length The input length in bytes.
+ * @param dst Output buffer, row_bits units of 16 bits per completed
+ *            block. One block more than length covers is sufficient.
+ *
+ * @return The number of samples written.
+ */
+SR_PRIV size_t sr_bit_transpose_feed(struct sr_bit_transpose *t,
+	const uint8_t *src, size_t length, uint16_t *dst)
+{
+	size_t block_bytes, blocks, count, n;
+
+	if (!t || !src || !dst)
+		return 0;
+
+	block_bytes = t->row_count * t->row_bits / 8;
+	count = 0;
+
+	if (t->carry_len) {
+		n = MIN(block_bytes - t->carry_len, length);
+		memcpy(&t->carry[t->carry_len], src, n);
+		t->carry_len += n;
+		src += n;
+		length -= n;
+		if (t->carry_len < block_bytes)
+			return 0;
+		count = sr_bit_transpose_run(t, t->carry, 1, dst);
+		dst += count;
+		t->carry_len = 0;
+	}
+
+	blocks = length / block_bytes;
+	count += sr_bit_transpose_run(t, src, blocks, dst);
+	src += blocks * block_bytes;
+	length -= blocks * block_bytes;
+
+	memcpy(t->carry, src, length);
+	t->carry_len = length;
+
+	return count;
+}
@@ -468,6 +468,387 @@ SR_PRIV int usb_source_remove(struct sr_session *session, struct sr_context *ctx
 	return sr_session_source_remove_internal(session, ctx->libusb_ctx);
 }
 
+/*
+ * Optional libusb event thread. When the user asked for it (see the
+ * SIGROK_USB_EVENT_THREAD environment variable), streaming drivers let
+ * a dedicated thread handle libusb events, instead of the session's
+ * main loop. Transfer callbacks then run on that thread, and can get
+ * resubmitted without waiting for datafeed consumers. Completed data
+ * gets passed to the session by means of a completion queue.
+ *
+ * The thread is shared by all acquisitions within a libsigrok context,
+ * and runs while at least one of them needs it.
+ */
+
+/* Interval at which the event thread checks for its termination. */
+#define USB_EVENT_THREAD_POLL_MS 100
+
+struct usb_event_thread {
+	GThread *thread;
+	struct libusb_context *usb_ctx;
+	int stop;
+	unsigned int refcount;
+};
+
+static gpointer usb_event_thread_run(gpointer data)
+{
+	struct usb_event_thread *evt;
+	struct timeval tv;
+	int ret;
+
+	evt = data;
+	sr_dbg("USB event thread running.");
+	while (!g_atomic_int_get(&evt->stop)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = USB_EVENT_THREAD_POLL_MS * 1000;
+		ret = libusb_handle_events_timeout_completed(evt->usb_ctx,
+			&tv, &evt->stop);
+		if (ret != 0 && ret != LIBUSB_ERROR_INTERRUPTED) {
+			sr_err("USB event handling failed: %s.",
+				libusb_error_name(ret));
+			g_usleep(USB_EVENT_THREAD_POLL_MS * 1000);
+		}
+	}
+	sr_dbg("USB event thread terminated.");
+
+	return NULL;
+}
+
+/**
+ * Start (or share) the USB event thread of a libsigrok context.
+ *
+ * Must be balanced by a call to usb_event_thread_stop().
+ *
+ * @param ctx The libsigrok context.
+ *
+ * @retval SR_OK The thread is running, transfer callbacks run on it.
+ * @retval SR_ERR_NA The thread was not requested. Callers should use the
+ *         main loop based usb_source_add() instead.
+ * @retval SR_ERR The thread could not be created.
+ */
+SR_PRIV int usb_event_thread_start(struct sr_context *ctx)
+{
+	struct usb_event_thread *evt;
+	GError *error;
+
+	if (!ctx->usb_thread_wanted)
+		return SR_ERR_NA;
+
+	evt = ctx->usb_thread;
+	if (evt) {
+		evt->refcount++;
+		return SR_OK;
+	}
+
+	evt = g_malloc0(sizeof(*evt));
+	evt->usb_ctx = ctx->libusb_ctx;
+	evt->refcount = 1;
+	error = NULL;
+	evt->thread = g_thread_try_new("sr-usb-events",
+		usb_event_thread_run, evt, &error);
+	if (!evt->thread) {
+		sr_err("Cannot create USB event thread: %s.",
+			error ? error->message : "unknown error");
+		g_clear_error(&error);
+		g_free(evt);
+		return SR_ERR;
+	}
+	ctx->usb_thread = evt;
+
+	return SR_OK;
+}
+
+/**
+ * Release the USB event thread of a libsigrok context.
+ *
+ * The thread terminates when its last user is gone. Callers must make
+ * sure that none of their transfers is pending any longer.
+ *
+ * @param ctx The libsigrok context.
+ */
+SR_PRIV void usb_event_thread_stop(struct sr_context *ctx)
+{
+	struct usb_event_thread *evt;
+
+	evt = ctx->usb_thread;
+	if (!evt || --evt->refcount)
+		return;
+
+	ctx->usb_thread = NULL;
+	g_atomic_int_set(&evt->stop, 1);
+#if (LIBUSB_API_VERSION >= 0x01000105)
+	libusb_interrupt_event_handler(evt->usb_ctx);
+#endif
+	g_thread_join(evt->thread);
+	g_free(evt);
+}
+
+/*
+ * Completion queue. A lock-free ring buffer with exactly one producer
+ * (the USB event thread) and one consumer (the session's main loop).
+ * Each index is only ever written by one side, the atomic accessors
+ * provide the memory barriers which publish the items.
+ */
+struct sr_usb_completion_queue {
+	struct sr_usb_completion *items;
+	size_t capacity;
+	gint head;
+	gint tail;
+	GMainContext *main_context;
+};
+
+/** GLib event source which dispatches when completions are queued. */
+struct usb_completion_source {
+	GSource base;
+	int64_t timeout_us;
+	int64_t due_us;
+	struct sr_session *session;
+	struct sr_usb_completion_queue *queue;
+};
+
+/**
+ * Create a completion queue.
+ *
+ * @param capacity The maximum number of items in the queue. Callers
+ *                 size this by the number of transfers and buffers in
+ *                 flight, pushing never blocks.
+ *
+ * @return The new queue.
+ */
+SR_PRIV struct sr_usb_completion_queue *usb_completion_queue_new(
+	size_t capacity)
+{
+	struct sr_usb_completion_queue *queue;
+
+	queue = g_malloc0(sizeof(*queue));
+	/* One slot remains unused, to tell "full" from "empty". */
+	queue->capacity = capacity + 1;
+	queue->items = g_malloc0(queue->capacity * sizeof(queue->items[0]));
+
+	return queue;
+}
+
+/**
+ * Free a completion queue. Items which still are queued are not
+ * touched, callers must drain the queue and release them.
+ *
+ * @param queue The queue, may be NULL.
+ */
+SR_PRIV void usb_completion_queue_free(struct sr_usb_completion_queue *queue)
+{
+	if (!queue)
+		return;
+
+	if (queue->main_context)
+		g_main_context_unref(queue->main_context);
+	g_free(queue->items);
+	g_free(queue);
+}
+
+/**
+ * Append an item to a completion queue, and wake up the consumer.
+ *
+ * Must only be called by the single producer of the queue.
+ *
+ * @param queue The queue.
+ * @param item The item to append, gets copied.
+ *
+ * @return TRUE when the item was queued, FALSE when the queue is full.
+ */
+SR_PRIV gboolean usb_completion_queue_push(struct sr_usb_completion_queue *queue,
+	const struct sr_usb_completion *item)
+{
+	size_t tail, next;
+
+	tail = g_atomic_int_get(&queue->tail);
+	next = (tail + 1) % queue->capacity;
+	if (next == (size_t)g_atomic_int_get(&queue->head))
+		return FALSE;
+
+	queue->items[tail] = *item;
+	g_atomic_int_set(&queue->tail, next);
+	if (queue->main_context)
+		g_main_context_wakeup(queue->main_context);
+
+	return TRUE;
+}
+
+/**
+ * Take the oldest item from a completion queue.
+ *
+ * Must only be called by the single consumer of the queue.
+ *
+ * @param queue The queue.
+ * @param item Receives the item.
+ *
+ * @return TRUE when an item was taken, FALSE when the queue is empty.
+ */
+SR_PRIV gboolean usb_completion_queue_pop(struct sr_usb_completion_queue *queue,
+	struct sr_usb_completion *item)
+{
+	size_t head;
+
+	head = g_atomic_int_get(&queue->head);
+	if (head == (size_t)g_atomic_int_get(&queue->tail))
+		return FALSE;
+
+	*item = queue->items[head];
+	g_atomic_int_set(&queue->head, (head + 1) % queue->capacity);
+
+	return TRUE;
+}
+
+static gboolean usb_completion_queue_empty(struct sr_usb_completion_queue *queue)
+{
+	return g_atomic_int_get(&queue->head) == g_atomic_int_get(&queue->tail);
+}
+
+/** Completion source prepare() method.
+ */
+static gboolean usb_completion_source_prepare(GSource *source, int *timeout)
+{
+	struct usb_completion_source *csource;
+	int64_t now_us;
+
+	csource = (struct usb_completion_source *)source;
+	if (!usb_completion_queue_empty(csource->queue)) {
+		*timeout = 0;
+		return TRUE;
+	}
+
+	now_us = g_source_get_time(source);
+	if (csource->due_us == 0)
+		csource->due_us = now_us + csource->timeout_us;
+	if (csource->due_us == INT64_MAX)
+		*timeout = -1;
+	else if (csource->due_us <= now_us)
+		*timeout = 0;
+	else
+		*timeout = MIN((csource->due_us - now_us + 999) / 1000, G_MAXINT);
+
+	return *timeout == 0;
+}
+
+/** Completion source check() method.
+ */
+static gboolean usb_completion_source_check(GSource *source)
+{
+	struct usb_completion_source *csource;
+
+	csource = (struct usb_completion_source *)source;
+
+	return !usb_completion_queue_empty(csource->queue) ||
+		(csource->due_us != INT64_MAX &&
+		csource->due_us <= g_source_get_time(source));
+}
+
+/** Completion source dispatch() method.
+ */
+static gboolean usb_completion_source_dispatch(GSource *source,
+		GSourceFunc callback, void *user_data)
+{
+	struct usb_completion_source *csource;
+	int revents;
+	gboolean keep;
+
+	csource = (struct usb_completion_source *)source;
+	if (!callback) {
+		sr_err("Callback not set, cannot dispatch event.");
+		return G_SOURCE_REMOVE;
+	}
+	revents = usb_completion_queue_empty(csource->queue) ? 0 : G_IO_IN;
+	keep = (*SR_RECEIVE_DATA_CALLBACK(callback))(-1, revents, user_data);
+
+	if (G_LIKELY(keep) && G_LIKELY(!g_source_is_destroyed(source))) {
+		if (csource->timeout_us >= 0)
+			csource->due_us = g_source_get_time(source)
+					+ csource->timeout_us;
+		else
+			csource->due_us = INT64_MAX;
+	}
+	return keep;
+}
+
+/** Completion source finalize() method.
+ */
+static void usb_completion_source_finalize(GSource *source)
+{
+	struct usb_completion_source *csource;
+
+	csource = (struct usb_completion_source *)source;
+	sr_session_source_destroyed(csource->session, csource->queue, source);
+}
+
+/**
+ * Have the session's main loop consume a completion queue.
+ *
+ * The callback gets invoked when items were queued, and when the
+ * timeout expires. It is expected to pop all queued items.
+ *
+ * @param session The session.
+ * @param queue The queue to consume, also serves as the source's key.
+ * @param timeout The timeout interval in ms, or -1 to wait indefinitely.
+ * @param cb The callback.
+ * @param cb_data Opaque data which gets passed to the callback.
+ *
+ * @return SR_OK upon success, an error code otherwise.
+ */
+SR_PRIV int usb_completion_source_add(struct sr_session *session,
+	struct sr_usb_completion_queue *queue, int timeout,
+	sr_receive_data_callback cb, void *cb_data)
+{
+	static GSourceFuncs completion_source_funcs = {
+		.prepare  = &usb_completion_source_prepare,
+		.check    = &usb_completion_source_check,
+		.dispatch = &usb_completion_source_dispatch,
+		.finalize = &usb_completion_source_finalize
+	};
+	GSource *source;
+	struct usb_completion_source *csource;
+	GMainContext *main_context;
+	int ret;
+
+	source = g_source_new(&completion_source_funcs,
+		sizeof(struct usb_completion_source));
+	csource = (struct usb_completion_source *)source;
+	g_source_set_name(source, "usb-completion");
+	if (timeout >= 0) {
+		csource->timeout_us = 1000 * (int64_t)timeout;
+		csource->due_us = 0;
+	} else {
+		csource->timeout_us = -1;
+		csource->due_us = INT64_MAX;
+	}
+	csource->session = session;
+	csource->queue = queue;
+	g_source_set_callback(source, G_SOURCE_FUNC(cb), cb_data, NULL);
+
+	ret = sr_session_source_add_internal(session, queue, source);
+	if (ret == SR_OK) {
+		/* Producers need the context to wake up the main loop. */
+		main_context = g_source_get_context(source);
+		if (main_context && !queue->main_context)
+			queue->main_context = g_main_context_ref(main_context);
+	}
+	g_source_unref(source);
+
+	return ret;
+}
+
+/**
+ * Remove the main loop source of a completion queue.
+ *
+ * @param session The session.
+ * @param queue The queue.
+ *
+ * @return SR_OK upon success, an error code otherwise.
+ */
+SR_PRIV int usb_completion_source_remove(struct sr_session *session,
+	struct sr_usb_completion_queue *queue)
+{
+	return sr_session_source_remove_internal(session, queue);
+}
+
 SR_PRIV int usb_get_port_path(libusb_device *dev, char *path, int path_len)
 {
 	uint8_t port_numbers[8];
@@ -0,0 +1,309 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * USB bulk streaming transfer sizing helper functions
+ *
+ * Streaming drivers keep a number of bulk transfers in flight. Their
+ * size is a trade-off: small transfers cost CPU time per completion at
+ * high data rates, large transfers increase latency at low data rates.
+ * These helpers derive initial values from the expected data rate, and
+ * adjust the transfer length at run time based on observed completion
+ * intervals. Users can override the automatic sizing by means of the
+ * SR_CONF_USB_TRANSFER_SIZE and SR_CONF_USB_TRANSFER_COUNT keys.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libusb.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "usb_stream"
+
+/* Initial completion interval of a transfer. */
+#define TRANSFER_INTERVAL_MS	10
+/* Completion intervals outside this range cause transfer resizing. */
+#define MIN_INTERVAL_US		2000
+#define MAX_INTERVAL_US		50000
+/* Upper limit for the size of an individual transfer. */
+#define MAX_TRANSFER_SIZE	(4 * 1024 * 1024)
+/* Headroom for transfers to grow beyond their initial size. */
+#define GROWTH_FACTOR		4
+/* Minimum depth of the transfer queue. */
+#define MIN_TRANSFERS		4
+/* Range of the transfer timeout. */
+#define MIN_TIMEOUT_MS		100
+#define MAX_TIMEOUT_MS		5000
+
+/**
+ * Initialize a streaming transfer sizing instance.
+ *
+ * Must be called before any other operations are performed on a struct
+ * sr_usb_stream, typically when the device context gets allocated.
+ * Selects automatic sizing.
+ *
+ * @param stream The streaming transfer sizing instance to initialize.
+ */
+SR_PRIV void sr_usb_stream_init(struct sr_usb_stream *stream)
+{
+	memset(stream, 0, sizeof(*stream));
+}
+
+/**
+ * Get streaming transfer configuration.
+ *
+ * Should be called from the driver's config_get() callback.
+ *
+ * @param stream Streaming transfer sizing instance.
+ * @param key Config item key.
+ * @param data Config item data.
+ *
+ * @return SR_ERR_NA if @p key is not supported, SR_OK otherwise.
+ */
+SR_PRIV int sr_usb_stream_config_get(const struct sr_usb_stream *stream,
+	uint32_t key, GVariant **data)
+{
+	switch (key) {
+	case SR_CONF_USB_TRANSFER_SIZE:
+		*data = g_variant_new_uint64(stream->cfg_size);
+		break;
+	case SR_CONF_USB_TRANSFER_COUNT:
+		*data = g_variant_new_uint64(stream->cfg_count);
+		break;
+	default:
+		return SR_ERR_NA;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Set streaming transfer configuration.
+ *
+ * Should be called from the driver's config_set() callback. A value of
+ * zero selects automatic sizing. Takes effect with the next acquisition.
+ *
+ * @param stream Streaming transfer sizing instance.
+ * @param key Config item key.
+ * @param data Config item data.
+ *
+ * @return SR_ERR_NA if @p key is not supported, SR_ERR_ARG for values
+ *         which are out of range, SR_OK otherwise.
+ */
+SR_PRIV int sr_usb_stream_config_set(struct sr_usb_stream *stream,
+	uint32_t key, GVariant *data)
+{
+	uint64_t value;
+
+	value = g_variant_get_uint64(data);
+	switch (key) {
+	case SR_CONF_USB_TRANSFER_SIZE:
+		if (value > MAX_TRANSFER_SIZE)
+			return SR_ERR_ARG;
+		stream->cfg_size = value;
+		break;
+	case SR_CONF_USB_TRANSFER_COUNT:
+		if (value > G_MAXUINT)
+			return SR_ERR_ARG;
+		stream->cfg_count = value;
+		break;
+	default:
+		return SR_ERR_NA;
+	}
+
+	return SR_OK;
+}
+
+static size_t round_up(size_t size, size_t granule)
+{
+	return (size + granule - 1) / granule * granule;
+}
+
+/**
+ * Determine transfer size, count and timeout for an acquisition.
+ *
+ * Fills in the size, max_size, count and timeout fields, and resets the
+ * completion statistics. Transfer buffers must be allocated with the
+ * max_size, transfers get submitted with the size.
+ *
+ * When the previous acquisition saw the transfer queue run dry, the
+ * automatic depth gets doubled (within max_count). This only applies to
+ * the acquisition right after the one which stalled: the stall counter
+ * gets reset here, so the depth returns to normal after a clean run.
+ *
+ * The timeout covers all transfers at their largest size, since they
+ * can grow during acquisition. It is limited to MAX_TIMEOUT_MS, so that
+ * slow data rates or a doubled depth don't delay the detection of
+ * a device which stopped sending. Transfers which time out with partial
+ * data still deliver it.
+ *
+ * @param stream Streaming transfer sizing instance.
+ * @param bytes_per_ms The expected data rate.
+ * @param granule Transfer sizes are a multiple of this (e.g. 512).
+ * @param total_ms The amount of data to keep buffered in transfers.
+ * @param max_count The maximum number of transfers.
+ */
+SR_PRIV void sr_usb_stream_setup(struct sr_usb_stream *stream,
+	size_t bytes_per_ms, size_t granule, unsigned int total_ms,
+	unsigned int max_count)
+{
+	size_t size, total;
+	uint64_t timeout;
+	unsigned int count;
+
+	if (!granule)
+		granule = 512;
+	bytes_per_ms = MAX(bytes_per_ms, 1);
+	total = (size_t)total_ms * bytes_per_ms;
+
+	if (stream->cfg_size) {
+		size = round_up(stream->cfg_size, granule);
+		stream->max_size = size;
+	} else {
+		size = round_up(TRANSFER_INTERVAL_MS * bytes_per_ms, granule);
+		size = MIN(size, round_up(MAX_TRANSFER_SIZE / GROWTH_FACTOR, granule));
+		stream->max_size = MAX(size, MIN(size * GROWTH_FACTOR,
+			MAX_TRANSFER_SIZE / granule * granule));
+	}
+	stream->size = size;
+	stream->adaptive = !stream->cfg_size;
+
+	if (stream->cfg_count) {
+		count = stream->cfg_count;
+	} else {
+		count = (total + size - 1) / size;
+		if (stream->stalls)
+			count *= 2;
+		count = CLAMP(count, MIN_TRANSFERS, max_count);
+	}
+	stream->count = MAX(count, 1);
+
+	/* Cover all transfers at their largest, plus 25% headroom. */
+	timeout = (uint64_t)stream->count * stream->max_size / bytes_per_ms;
+	timeout += timeout / 4;
+	stream->timeout = CLAMP(timeout, MIN_TIMEOUT_MS, MAX_TIMEOUT_MS);
+
+	stream->bytes_per_ms = bytes_per_ms;
+	stream->granule = granule;
+	stream->last_us = 0;
+	stream->interval_us = 0;
+	stream->completions = 0;
+	stream->resizes = 0;
+	stream->stalls = 0;
+	memset(stream->histogram, 0, sizeof(stream->histogram));
+
+	sr_dbg("Using %u transfers of %zu bytes (up to %zu), timeout %u ms.",
+		stream->count, stream->size, stream->max_size, stream->timeout);
+}
+
+/**
+ * Account for a completed transfer, and prepare it for resubmission.
+ *
+ * Updates the completion interval statistics, and sets the length of
+ * the transfer for its next submission. Must only be called for the
+ * completions of one thread, and before the transfer gets resubmitted.
+ *
+ * @param stream Streaming transfer sizing instance.
+ * @param transfer The completed transfer.
+ */
+SR_PRIV void sr_usb_stream_completed(struct sr_usb_stream *stream,
+	struct libusb_transfer *transfer)
+{
+	int64_t now_us, delta_us, queue_us;
+	unsigned int bin;
+	size_t size;
+
+	now_us = g_get_monotonic_time();
+	if (!stream->last_us) {
+		stream->last_us = now_us;
+		return;
+	}
+	delta_us = now_us - stream->last_us;
+	stream->last_us = now_us;
+	stream->completions++;
+
+	/* Logarithmic histogram of completion intervals, in ms. */
+	bin = 0;
+	while (bin < SR_USB_STREAM_HIST_BINS - 1 && (delta_us >> bin) >= 1000)
+		bin++;
+	stream->histogram[bin]++;
+
+	/*
+	 * A completion gap which covers half of the queued data means
+	 * that the queue almost ran dry. Remember it for the next run.
+	 */
+	queue_us = 1000 * (int64_t)(stream->count * stream->size / stream->bytes_per_ms);
+	if (stream->completions > stream->count && delta_us > queue_us / 2)
+		stream->stalls++;
+
+	if (!stream->adaptive)
+		return;
+
+	/* Exponentially weighted moving average over about 8 completions. */
+	if (!stream->interval_us)
+		stream->interval_us = delta_us;
+	else
+		stream->interval_us += (delta_us - stream->interval_us) / 8;
+	if (stream->completions < stream->count)
+		return;
+
+	size = stream->size;
+	if (stream->interval_us < MIN_INTERVAL_US && size < stream->max_size)
+		size = MIN(size * 2, stream->max_size);
+	else if (stream->interval_us > MAX_INTERVAL_US && size > stream->granule)
+		size = MAX(round_up(size / 2, stream->granule), stream->granule);
+	if (size != stream->size) {
+		sr_spew("Transfer interval %" PRIi64 " us, resizing to %zu bytes.",
+			stream->interval_us, size);
+		stream->size = size;
+		stream->interval_us = 0;
+		stream->resizes++;
+	}
+	transfer->length = stream->size;
+}
+
+/**
+ * Log the completion statistics of an acquisition.
+ *
+ * @param stream Streaming transfer sizing instance.
+ */
+SR_PRIV void sr_usb_stream_report(const struct sr_usb_stream *stream)
+{
+	GString *s;
+	unsigned int bin;
+
+	if (!stream->completions)
+		return;
+
+	s = g_string_sized_new(256);
+	for (bin = 0; bin < SR_USB_STREAM_HIST_BINS; bin++) {
+		if (!stream->histogram[bin])
+			continue;
+		g_string_append_printf(s, " %s%ums:%" PRIu64,
+			(bin == SR_USB_STREAM_HIST_BINS - 1) ? ">=" : "<",
+			1U << bin, stream->histogram[bin]);
+	}
+	sr_dbg("%" PRIu64 " completions, %" PRIu64 " resizes, %" PRIu64
+		" stalls, final size %zu, intervals%s.", stream->completions,
+		stream->resizes, stream->stalls, stream->size, s->str);
+	g_string_free(s, TRUE);
+}
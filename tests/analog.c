@@ -153,6 +153,44 @@ START_TEST(test_analog_to_float_null)
 }
 END_TEST
 
+START_TEST(test_analog_to_float_u8_scaled)
+{
+	int ret;
+	size_t i;
+	uint8_t data[1024];
+	float fout[ARRAY_SIZE(data)], want;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	/* Raw 8bit samples, 0-255 mapping to -10V - +10V. */
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 2);
+	encoding.unitsize = sizeof(uint8_t);
+	encoding.is_float = FALSE;
+	encoding.is_signed = FALSE;
+	encoding.scale.p = 10;
+	encoding.scale.q = 128;
+	encoding.offset.p = -10;
+	encoding.offset.q = 1;
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = (i * 7) & 0xff;
+	analog.num_samples = ARRAY_SIZE(data);
+	analog.data = data;
+	meaning.channels = g_slist_append(NULL, &ch);
+
+	ret = sr_analog_to_float(&analog, fout);
+	fail_unless(ret == SR_OK, "sr_analog_to_float() failed: %d.", ret);
+	for (i = 0; i < ARRAY_SIZE(data); i++) {
+		want = (data[i] - 128.0f) / 12.8f;
+		fail_unless(fabs(fout[i] - want) <= 0.0001,
+			"sample %zu: %f != %f", i, fout[i], want);
+	}
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
 START_TEST(test_analog_to_float_conv)
 {
 	static const int with_diag = 0;
@@ -693,6 +731,7 @@ Suite *suite_analog(void)
 	tc = tcase_create("analog_to_float");
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
+	tcase_add_test(tc, test_analog_to_float_u8_scaled);
 	tcase_add_test(tc, test_analog_to_float_conv);
 	suite_add_tcase(s, tc);
 
@@ -0,0 +1,388 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+/* What the datafeed callback received, in order of arrival. */
+static GArray *rx_timestamps;
+static GArray *rx_values;
+static GString *rx_sequence;
+/* Values of double encoded packets, as they were sent. */
+static GArray *rx_doubles;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_config *src;
+	const guint64 *timestamps;
+	gsize count;
+	float values[8];
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		fail_unless(g_slist_length(meta->config) == 1);
+		src = meta->config->data;
+		fail_unless(src->key == SR_CONF_SAMPLE_TIMESTAMPS);
+		fail_unless(g_variant_is_of_type(src->data, G_VARIANT_TYPE("at")));
+		timestamps = g_variant_get_fixed_array(src->data, &count,
+			sizeof(guint64));
+		g_array_append_vals(rx_timestamps, timestamps, count);
+		g_string_append_c(rx_sequence, 'M');
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		fail_unless(analog->num_samples <= ARRAY_SIZE(values));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		g_array_append_vals(rx_values, values, analog->num_samples);
+		if (analog->encoding->is_float &&
+				analog->encoding->unitsize == sizeof(double))
+			g_array_append_vals(rx_doubles, analog->data,
+				analog->num_samples);
+		g_string_append_c(rx_sequence, 'A');
+		break;
+	default:
+		fail("Unexpected packet type %d.", packet->type);
+	}
+}
+
+static void setup(void)
+{
+	srtest_setup();
+	rx_timestamps = g_array_new(FALSE, FALSE, sizeof(guint64));
+	rx_values = g_array_new(FALSE, FALSE, sizeof(float));
+	rx_doubles = g_array_new(FALSE, FALSE, sizeof(double));
+	rx_sequence = g_string_new(NULL);
+}
+
+static void teardown(void)
+{
+	g_array_free(rx_timestamps, TRUE);
+	g_array_free(rx_values, TRUE);
+	g_array_free(rx_doubles, TRUE);
+	g_string_free(rx_sequence, TRUE);
+	srtest_teardown();
+}
+
+static struct sr_session *session_new(struct sr_dev_inst **sdi)
+{
+	struct sr_session *session;
+
+	*sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	fail_unless(sr_dev_inst_channel_add(*sdi, 0, SR_CHANNEL_ANALOG,
+		"P1") == SR_OK);
+	fail_unless(sr_session_new(srtest_ctx, &session) == SR_OK);
+	fail_unless(sr_session_datafeed_callback_add(session,
+		datafeed_in, NULL) == SR_OK);
+	fail_unless(sr_session_dev_add(session, *sdi) == SR_OK);
+
+	return session;
+}
+
+/* Adds a single float or double reading of the device's first channel. */
+static int add_value(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi, const void *value, size_t size,
+	enum sr_unit unit, int64_t timestamp_us)
+{
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int ret;
+
+	memset(&analog, 0, sizeof(analog));
+	memset(&encoding, 0, sizeof(encoding));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	encoding.unitsize = size;
+	encoding.is_float = TRUE;
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = TRUE;
+#endif
+	encoding.is_digits_decimal = TRUE;
+	encoding.scale.p = encoding.scale.q = 1;
+	encoding.offset.q = 1;
+	meaning.mq = SR_MQ_VOLTAGE;
+	meaning.unit = unit;
+	meaning.channels = g_slist_append(NULL,
+		sr_dev_inst_channels_get(sdi)->data);
+	analog.encoding = &encoding;
+	analog.meaning = &meaning;
+	analog.spec = &spec;
+	analog.num_samples = 1;
+	analog.data = (void *)value;
+
+	ret = sr_analog_batch_add(batch, sdi, &analog, timestamp_us);
+	g_slist_free(meaning.channels);
+
+	return ret;
+}
+
+static int add_reading(struct sr_analog_batch *batch,
+	const struct sr_dev_inst *sdi, float value, enum sr_unit unit,
+	int64_t timestamp_us)
+{
+	return add_value(batch, sdi, &value, sizeof(value), unit, timestamp_us);
+}
+
+START_TEST(test_key_info)
+{
+	const struct sr_key_info *info;
+	guint64 timestamps[2] = { 1, 2 };
+	guint32 values[2] = { 1, 2 };
+	GVariant *gvar;
+
+	info = sr_key_info_get(SR_KEY_CONFIG, SR_CONF_BATCH_INTERVAL);
+	fail_unless(info != NULL);
+	fail_unless(info->datatype == SR_T_UINT64);
+	fail_unless(!strcmp(info->id, "batch_interval"));
+
+	info = sr_key_info_get(SR_KEY_CONFIG, SR_CONF_SAMPLE_TIMESTAMPS);
+	fail_unless(info != NULL);
+	fail_unless(info->datatype == SR_T_UINT64_ARRAY);
+	fail_unless(!strcmp(info->id, "sample_timestamps"));
+
+	gvar = g_variant_ref_sink(g_variant_new_fixed_array(G_VARIANT_TYPE_UINT64,
+		timestamps, ARRAY_SIZE(timestamps), sizeof(timestamps[0])));
+	fail_unless(sr_variant_type_check(SR_CONF_SAMPLE_TIMESTAMPS,
+		gvar) == SR_OK);
+	g_variant_unref(gvar);
+
+	gvar = g_variant_ref_sink(g_variant_new_fixed_array(G_VARIANT_TYPE_UINT32,
+		values, ARRAY_SIZE(values), sizeof(values[0])));
+	fail_unless(sr_variant_type_check(SR_CONF_SAMPLE_TIMESTAMPS,
+		gvar) == SR_ERR_ARG);
+	g_variant_unref(gvar);
+
+	gvar = g_variant_ref_sink(g_variant_new_uint64(100));
+	fail_unless(sr_variant_type_check(SR_CONF_BATCH_INTERVAL,
+		gvar) == SR_OK);
+	fail_unless(sr_variant_type_check(SR_CONF_SAMPLE_TIMESTAMPS,
+		gvar) == SR_ERR_ARG);
+	g_variant_unref(gvar);
+}
+END_TEST
+
+START_TEST(test_interval)
+{
+	struct sr_analog_batch batch;
+	GVariant *gvar;
+
+	sr_analog_batch_init(&batch);
+	fail_unless(sr_analog_batch_config_get(&batch,
+		SR_CONF_BATCH_INTERVAL, &gvar) == SR_OK);
+	fail_unless(g_variant_get_uint64(gvar) == 0);
+	g_variant_unref(g_variant_ref_sink(gvar));
+
+	gvar = g_variant_ref_sink(g_variant_new_uint64(250));
+	fail_unless(sr_analog_batch_config_set(&batch,
+		SR_CONF_BATCH_INTERVAL, gvar) == SR_OK);
+	g_variant_unref(gvar);
+	gvar = g_variant_ref_sink(g_variant_new_uint64(60001));
+	fail_unless(sr_analog_batch_config_set(&batch,
+		SR_CONF_BATCH_INTERVAL, gvar) == SR_ERR_ARG);
+	fail_unless(sr_analog_batch_config_set(&batch,
+		SR_CONF_LIMIT_SAMPLES, gvar) == SR_ERR_NA);
+	g_variant_unref(gvar);
+
+	fail_unless(sr_analog_batch_config_get(&batch,
+		SR_CONF_BATCH_INTERVAL, &gvar) == SR_OK);
+	fail_unless(g_variant_get_uint64(gvar) == 250);
+	g_variant_unref(g_variant_ref_sink(gvar));
+	fail_unless(sr_analog_batch_config_get(&batch,
+		SR_CONF_LIMIT_SAMPLES, &gvar) == SR_ERR_NA);
+}
+END_TEST
+
+/* Without an interval, readings get sent right away, without timestamps. */
+START_TEST(test_immediate)
+{
+	struct sr_analog_batch batch;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+
+	session = session_new(&sdi);
+	sr_analog_batch_init(&batch);
+	fail_unless(add_reading(&batch, sdi, 1.5, SR_UNIT_VOLT, 100) == SR_OK);
+	fail_unless(add_reading(&batch, sdi, 2.5, SR_UNIT_VOLT, 200) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "AA"), "%s", rx_sequence->str);
+	fail_unless(g_array_index(rx_values, float, 1) == 2.5);
+	fail_unless(sr_analog_batch_flush(&batch, sdi) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "AA"));
+
+	sr_session_destroy(session);
+}
+END_TEST
+
+/* Batches carry one timestamp per sample, and break at meaning changes. */
+START_TEST(test_timestamps)
+{
+	struct sr_analog_batch batch;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GVariant *gvar;
+
+	session = session_new(&sdi);
+	sr_analog_batch_init(&batch);
+	gvar = g_variant_ref_sink(g_variant_new_uint64(1000));
+	fail_unless(sr_analog_batch_config_set(&batch,
+		SR_CONF_BATCH_INTERVAL, gvar) == SR_OK);
+	g_variant_unref(gvar);
+
+	fail_unless(add_reading(&batch, sdi, 1.0, SR_UNIT_VOLT, 100) == SR_OK);
+	fail_unless(add_reading(&batch, sdi, 2.0, SR_UNIT_VOLT, 200) == SR_OK);
+	fail_unless(add_reading(&batch, sdi, 3.0, SR_UNIT_VOLT, 300) == SR_OK);
+	fail_unless(sr_analog_batch_check(&batch, sdi) == SR_OK);
+	fail_unless(rx_sequence->len == 0, "Sent before the interval elapsed.");
+
+	fail_unless(add_reading(&batch, sdi, 4.0, SR_UNIT_AMPERE, 400) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "MA"), "%s", rx_sequence->str);
+	fail_unless(rx_timestamps->len == 3 && rx_values->len == 3);
+	fail_unless(g_array_index(rx_timestamps, guint64, 0) == 100);
+	fail_unless(g_array_index(rx_timestamps, guint64, 2) == 300);
+	fail_unless(g_array_index(rx_values, float, 2) == 3.0);
+
+	fail_unless(sr_analog_batch_flush(&batch, sdi) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "MAMA"), "%s", rx_sequence->str);
+	fail_unless(rx_timestamps->len == 4 && rx_values->len == 4);
+	fail_unless(g_array_index(rx_timestamps, guint64, 3) == 400);
+	fail_unless(g_array_index(rx_values, float, 3) == 4.0);
+
+	sr_session_destroy(session);
+}
+END_TEST
+
+/* Batches keep the readings' encoding, double values are not rounded. */
+START_TEST(test_double)
+{
+	static const double values[] = { 1.000000123, 2.000000456 };
+	struct sr_analog_batch batch;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GVariant *gvar;
+	size_t i;
+
+	session = session_new(&sdi);
+	sr_analog_batch_init(&batch);
+	gvar = g_variant_ref_sink(g_variant_new_uint64(1000));
+	fail_unless(sr_analog_batch_config_set(&batch,
+		SR_CONF_BATCH_INTERVAL, gvar) == SR_OK);
+	g_variant_unref(gvar);
+
+	for (i = 0; i < ARRAY_SIZE(values); i++) {
+		fail_unless(add_value(&batch, sdi, &values[i], sizeof(values[i]),
+			SR_UNIT_VOLT, 100 * (i + 1)) == SR_OK);
+	}
+	fail_unless(rx_sequence->len == 0);
+
+	/* A float reading breaks the batch. */
+	fail_unless(add_reading(&batch, sdi, 3.0, SR_UNIT_VOLT, 300) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "MA"), "%s", rx_sequence->str);
+	fail_unless(rx_doubles->len == ARRAY_SIZE(values));
+	for (i = 0; i < ARRAY_SIZE(values); i++)
+		fail_unless(g_array_index(rx_doubles, double, i) == values[i]);
+
+	fail_unless(sr_analog_batch_flush(&batch, sdi) == SR_OK);
+	fail_unless(!strcmp(rx_sequence->str, "MAMA"), "%s", rx_sequence->str);
+	fail_unless(rx_doubles->len == ARRAY_SIZE(values));
+	fail_unless(g_array_index(rx_values, float, 2) == 3.0);
+
+	sr_session_destroy(session);
+}
+END_TEST
+
+/* Bytes keep the time of the chunk they were received with. */
+START_TEST(test_rx_chunks)
+{
+	struct sr_analog_batch batch;
+	int64_t first, second, third;
+	size_t i;
+
+	sr_analog_batch_init(&batch);
+	sr_analog_batch_rx_chunk(&batch, 4);
+	g_usleep(2000);
+	sr_analog_batch_rx_chunk(&batch, 4);
+	g_usleep(2000);
+	sr_analog_batch_rx_chunk(&batch, 4);
+	g_usleep(2000);
+	first = sr_analog_batch_rx_time(&batch, 0);
+	second = sr_analog_batch_rx_time(&batch, 4);
+	third = sr_analog_batch_rx_time(&batch, 11);
+	fail_unless(first < second && second < third);
+	fail_unless(sr_analog_batch_rx_time(&batch, 3) == first);
+	fail_unless(sr_analog_batch_rx_time(&batch, 7) == second);
+	fail_unless(sr_analog_batch_rx_time(&batch, 12) > third,
+		"Unrecorded bytes should get the current time.");
+
+	/* The driver moved the remaining 6 bytes to the buffer's start. */
+	sr_analog_batch_rx_consume(&batch, 6);
+	fail_unless(sr_analog_batch_rx_time(&batch, 0) == second);
+	fail_unless(sr_analog_batch_rx_time(&batch, 1) == second);
+	fail_unless(sr_analog_batch_rx_time(&batch, 2) == third);
+	fail_unless(sr_analog_batch_rx_time(&batch, 5) == third);
+
+	/* Excess chunks get merged, the oldest bytes keep their time. */
+	for (i = 0; i < 2 * ANALOG_BATCH_RX_CHUNKS; i++)
+		sr_analog_batch_rx_chunk(&batch, 1);
+	fail_unless(batch.rx_chunk_count == ANALOG_BATCH_RX_CHUNKS);
+	fail_unless(sr_analog_batch_rx_time(&batch, 0) == second);
+	fail_unless(sr_analog_batch_rx_time(&batch, 5) == second);
+	fail_unless(sr_analog_batch_rx_time(&batch,
+		5 + 2 * ANALOG_BATCH_RX_CHUNKS) > third);
+
+	sr_analog_batch_rx_consume(&batch, 6 + 2 * ANALOG_BATCH_RX_CHUNKS);
+	fail_unless(batch.rx_chunk_count == 0);
+}
+END_TEST
+
+Suite *suite_analog_batch(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("analog_batch");
+
+	tc = tcase_create("config");
+	tcase_add_test(tc, test_key_info);
+	tcase_add_test(tc, test_interval);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("send");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_immediate);
+	tcase_add_test(tc, test_timestamps);
+	tcase_add_test(tc, test_double);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("rx");
+	tcase_add_test(tc, test_rx_chunks);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
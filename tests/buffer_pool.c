@@ -0,0 +1,187 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#define BUFSIZE 4096
+
+static void logic_packet(struct sr_datafeed_packet *packet,
+	struct sr_datafeed_logic *logic, uint8_t *data, size_t length)
+{
+	logic->length = length;
+	logic->unitsize = 1;
+	logic->data = data;
+	packet->type = SR_DF_LOGIC;
+	packet->payload = logic;
+}
+
+static const struct sr_datafeed_logic *logic_of(
+	const struct sr_datafeed_packet *packet)
+{
+	return packet->payload;
+}
+
+/* Shared copies of loaned data reference the buffer, others copy. */
+START_TEST(test_loan_copy)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_datafeed_packet packet, *shared, *priv;
+	struct sr_datafeed_logic logic;
+	uint8_t *buf;
+
+	pool = sr_buffer_pool_new(BUFSIZE, 1, 1);
+	fail_unless(pool != NULL);
+	buf = sr_buffer_pool_get(pool);
+	fail_unless(buf != NULL);
+	memset(buf, 0x5a, BUFSIZE);
+	logic_packet(&packet, &logic, buf + 16, 128);
+
+	sr_buffer_pool_loan_begin(buf);
+	fail_unless(sr_packet_copy_shared(&packet, &shared) == SR_OK);
+	fail_unless(sr_packet_copy(&packet, &priv) == SR_OK);
+	sr_buffer_pool_loan_end();
+
+	fail_unless(logic_of(shared)->data == buf + 16,
+		"Shared copy of loaned data was not shared.");
+	fail_unless(logic_of(shared)->length == 128);
+	fail_unless(logic_of(priv)->data != buf + 16,
+		"sr_packet_copy() returned shared data.");
+	fail_unless(logic_of(priv)->length == 128);
+	fail_unless(memcmp(logic_of(priv)->data, buf + 16, 128) == 0);
+
+	sr_packet_free(priv);
+	sr_packet_free(shared);
+	sr_buffer_pool_put(buf);
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* Data outside of a loan, or outside the loaned buffer, gets copied. */
+START_TEST(test_copy_outside_loan)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_datafeed_packet packet, *copy;
+	struct sr_datafeed_logic logic;
+	uint8_t *buf, other[64];
+
+	pool = sr_buffer_pool_new(BUFSIZE, 1, 1);
+	buf = sr_buffer_pool_get(pool);
+	memset(buf, 0xa5, BUFSIZE);
+
+	logic_packet(&packet, &logic, buf, 64);
+	fail_unless(sr_packet_copy_shared(&packet, &copy) == SR_OK);
+	fail_unless(logic_of(copy)->data != buf,
+		"Data was shared without a loan.");
+	sr_packet_free(copy);
+
+	memset(other, 0x11, sizeof(other));
+	logic_packet(&packet, &logic, other, sizeof(other));
+	sr_buffer_pool_loan_begin(buf);
+	fail_unless(sr_packet_copy_shared(&packet, &copy) == SR_OK);
+	sr_buffer_pool_loan_end();
+	fail_unless(logic_of(copy)->data != other,
+		"Data outside the loaned buffer was shared.");
+	fail_unless(memcmp(logic_of(copy)->data, other, sizeof(other)) == 0);
+	sr_packet_free(copy);
+
+	sr_buffer_pool_put(buf);
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* A buffer does not return to the pool while copies reference it. */
+START_TEST(test_loan_release)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_datafeed_packet packet, *copy1, *copy2;
+	struct sr_datafeed_logic logic;
+	uint8_t *buf;
+
+	pool = sr_buffer_pool_new(BUFSIZE, 1, 1);
+	buf = sr_buffer_pool_get(pool);
+	fail_unless(sr_buffer_pool_get(pool) == NULL);
+
+	logic_packet(&packet, &logic, buf, BUFSIZE);
+	sr_buffer_pool_loan_begin(buf);
+	fail_unless(sr_packet_copy_shared(&packet, &copy1) == SR_OK);
+	fail_unless(sr_packet_copy_shared(&packet, &copy2) == SR_OK);
+	sr_buffer_pool_loan_end();
+	sr_buffer_pool_put(buf);
+
+	fail_unless(sr_buffer_pool_get(pool) == NULL,
+		"Referenced buffer was reused.");
+	sr_packet_free(copy1);
+	fail_unless(sr_buffer_pool_get(pool) == NULL,
+		"Referenced buffer was reused.");
+	sr_packet_free(copy2);
+	fail_unless(sr_buffer_pool_get(pool) == buf,
+		"Released buffer did not return to the pool.");
+
+	sr_buffer_pool_put(buf);
+	sr_buffer_pool_free(pool);
+}
+END_TEST
+
+/* The pool may go away while copies still reference its buffers. */
+START_TEST(test_free_pool_with_loans)
+{
+	struct sr_buffer_pool *pool;
+	struct sr_datafeed_packet packet, *copy;
+	struct sr_datafeed_logic logic;
+	uint8_t *buf;
+
+	pool = sr_buffer_pool_new(BUFSIZE, 2, 4);
+	buf = sr_buffer_pool_get(pool);
+	memset(buf, 0x3c, BUFSIZE);
+
+	logic_packet(&packet, &logic, buf, BUFSIZE);
+	sr_buffer_pool_loan_begin(buf);
+	fail_unless(sr_packet_copy_shared(&packet, &copy) == SR_OK);
+	sr_buffer_pool_loan_end();
+	sr_buffer_pool_put(buf);
+	sr_buffer_pool_free(pool);
+
+	/* The data stays valid until the copy gets released. */
+	fail_unless(logic_of(copy)->data == buf);
+	fail_unless(((uint8_t *)logic_of(copy)->data)[BUFSIZE - 1] == 0x3c);
+	sr_packet_free(copy);
+}
+END_TEST
+
+Suite *suite_buffer_pool(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("buffer_pool");
+
+	tc = tcase_create("loan");
+	tcase_add_test(tc, test_loan_copy);
+	tcase_add_test(tc, test_copy_outside_loan);
+	tcase_add_test(tc, test_loan_release);
+	tcase_add_test(tc, test_free_pool_with_loans);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -211,6 +211,225 @@ START_TEST(test_endian_write_inc)
 }
 END_TEST
 
+START_TEST(test_varint)
+{
+	static const uint64_t values[] = {
+		0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0xffffffffULL, UINT64_MAX,
+	};
+	static const size_t lengths[] = { 1, 1, 1, 2, 2, 3, 5, 10, };
+	uint8_t buff[VARINT_U64_MAXLEN], *p;
+	uint64_t v;
+	size_t i, l;
+
+	for (i = 0; i < ARRAY_SIZE(values); i++) {
+		p = &buff[0];
+		write_u64_varint_inc(&p, values[i]);
+		l = p - &buff[0];
+		fail_unless(l == lengths[i]);
+		fail_unless(read_u64_varint(&buff[0], l, &v) == l);
+		fail_unless(v == values[i]);
+		/* Truncated input must not decode. */
+		fail_unless(read_u64_varint(&buff[0], l - 1, &v) == 0);
+	}
+
+	/* Unterminated sequences are rejected. */
+	memset(buff, 0xff, sizeof(buff));
+	fail_unless(read_u64_varint(&buff[0], sizeof(buff), &v) == 0);
+
+	/* A 10th byte which exceeds 64 bits is rejected. */
+	memset(buff, 0xff, sizeof(buff));
+	buff[VARINT_U64_MAXLEN - 1] = 0x02;
+	fail_unless(read_u64_varint(&buff[0], sizeof(buff), &v) == 0);
+	buff[VARINT_U64_MAXLEN - 1] = 0x01;
+	fail_unless(read_u64_varint(&buff[0], sizeof(buff), &v) == sizeof(buff));
+	fail_unless(v == UINT64_MAX);
+}
+END_TEST
+
+static const char *transpose_kernels[] = {
+	"scalar", "swar", "sse2", "avx2",
+};
+
+/* Straight forward implementation of the transposition's definition. */
+static void transpose_reference(const uint8_t *src, size_t block_count,
+	size_t row_bits, size_t row_count, const uint16_t *row_masks,
+	gboolean msb_first, uint16_t *dst)
+{
+	size_t b, r, k, bit;
+	uint64_t w;
+
+	memset(dst, 0, block_count * row_bits * sizeof(dst[0]));
+	for (b = 0; b < block_count; b++) {
+		for (r = 0; r < row_count; r++) {
+			w = (row_bits == 64) ? RL64(src) : RL32(src);
+			src += row_bits / 8;
+			for (k = 0; k < row_bits; k++) {
+				bit = msb_first ? row_bits - 1 - k : k;
+				if (w & (UINT64_C(1) << bit))
+					dst[b * row_bits + k] |= row_masks[r];
+			}
+		}
+	}
+}
+
+START_TEST(test_transpose_kernels)
+{
+	static const size_t block_count = 5;
+	uint8_t src[5 * 16 * 8];
+	uint16_t dense[16], sparse[16], *masks;
+	uint16_t expected[5 * 64], got[5 * 64];
+	struct sr_bit_transpose *t;
+	size_t i, row_bits, row_count, k;
+	int msb_first, use_sparse, ret;
+
+	for (i = 0; i < sizeof(src); i++)
+		src[i] = g_random_int();
+	for (i = 0; i < 16; i++) {
+		dense[i] = 1 << i;
+		sparse[i] = 1 << (15 - i);
+	}
+
+	for (row_bits = 32; row_bits <= 64; row_bits += 32)
+	for (msb_first = 0; msb_first <= 1; msb_first++)
+	for (use_sparse = 0; use_sparse <= 1; use_sparse++)
+	for (row_count = 1; row_count <= 16; row_count++) {
+		masks = use_sparse ? sparse : dense;
+		transpose_reference(src, block_count, row_bits, row_count,
+			masks, msb_first, expected);
+		t = sr_bit_transpose_new(row_bits, row_count,
+			use_sparse ? sparse : NULL, msb_first);
+		fail_unless(t != NULL);
+		for (k = 0; k < ARRAY_SIZE(transpose_kernels); k++) {
+			ret = sr_bit_transpose_set_kernel(t, transpose_kernels[k]);
+			if (ret == SR_ERR_NA)
+				continue;
+			fail_unless(ret == SR_OK);
+			memset(got, 0xa5, sizeof(got));
+			fail_unless(sr_bit_transpose_run(t, src, block_count,
+				got) == block_count * row_bits);
+			fail_unless(memcmp(got, expected,
+				block_count * row_bits * sizeof(got[0])) == 0,
+				"%s kernel mismatch (%zu x %zu bits, msb %d, sparse %d)",
+				transpose_kernels[k], row_count, row_bits,
+				msb_first, use_sparse);
+		}
+		sr_bit_transpose_free(t);
+	}
+
+	fail_unless(sr_bit_transpose_new(16, 8, NULL, FALSE) == NULL);
+	fail_unless(sr_bit_transpose_new(64, 17, NULL, FALSE) == NULL);
+	fail_unless(sr_bit_transpose_new(64, 0, NULL, FALSE) == NULL);
+}
+END_TEST
+
+/* Compare the kernels on a larger 16 channel buffer. */
+START_TEST(test_transpose_large)
+{
+	static const size_t block_count = 8192;
+	struct sr_bit_transpose *t;
+	uint8_t *src;
+	uint16_t *expected, *got;
+	size_t i, k, size;
+
+	size = block_count * 16 * sizeof(uint64_t);
+	src = g_malloc(size);
+	expected = g_malloc(block_count * 64 * sizeof(uint16_t));
+	got = g_malloc(block_count * 64 * sizeof(uint16_t));
+	for (i = 0; i < size; i++)
+		src[i] = g_random_int();
+
+	t = sr_bit_transpose_new(64, 16, NULL, FALSE);
+	fail_unless(t != NULL);
+	fail_unless(sr_bit_transpose_set_kernel(t, "scalar") == SR_OK);
+	sr_bit_transpose_run(t, src, block_count, expected);
+
+	for (k = 0; k < ARRAY_SIZE(transpose_kernels); k++) {
+		if (sr_bit_transpose_set_kernel(t, transpose_kernels[k]) != SR_OK)
+			continue;
+		memset(got, 0, block_count * 64 * sizeof(got[0]));
+		sr_bit_transpose_run(t, src, block_count, got);
+		fail_unless(memcmp(got, expected,
+			block_count * 64 * sizeof(got[0])) == 0,
+			"%s kernel mismatch", transpose_kernels[k]);
+	}
+
+	sr_bit_transpose_free(t);
+	g_free(got);
+	g_free(expected);
+	g_free(src);
+}
+END_TEST
+
+/*
+ * Saleae Logic Pro style USB payload: batches of one 32bit word per
+ * enabled channel, first sample in the MSB, in packets of 16KiB which
+ * don't align with batches. Checks the stream conversion across packet
+ * boundaries.
+ */
+START_TEST(test_transpose_stream)
+{
+	static const size_t packet_size = 16384;
+	static const uint16_t channel_sets[][16] = {
+		{ 0x0001, },
+		{ 0x0001, 0x0020, 0x2000, },
+		{ 0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+		  0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, 0x8000, },
+	};
+	static const size_t channel_counts[] = { 1, 3, 16, };
+	struct sr_bit_transpose *t;
+	uint16_t *samples, *got, enabled;
+	uint8_t *payload, *p;
+	size_t set, count, batches, total, pos, len, out, b, r, k;
+	const uint16_t *masks;
+	uint32_t word;
+
+	batches = 3000;
+	total = batches * 32;
+	samples = g_malloc(total * sizeof(samples[0]));
+	got = g_malloc((total + 32) * sizeof(got[0]));
+	payload = g_malloc(batches * 16 * sizeof(word));
+
+	for (set = 0; set < ARRAY_SIZE(channel_sets); set++) {
+		masks = channel_sets[set];
+		count = channel_counts[set];
+		enabled = 0;
+		for (r = 0; r < count; r++)
+			enabled |= masks[r];
+		for (k = 0; k < total; k++)
+			samples[k] = g_random_int() & enabled;
+
+		p = payload;
+		for (b = 0; b < batches; b++) {
+			for (r = 0; r < count; r++) {
+				word = 0;
+				for (k = 0; k < 32; k++) {
+					if (samples[b * 32 + k] & masks[r])
+						word |= 1UL << (31 - k);
+				}
+				write_u32le_inc(&p, word);
+			}
+		}
+		len = p - payload;
+
+		t = sr_bit_transpose_new(32, count, masks, TRUE);
+		fail_unless(t != NULL);
+		out = 0;
+		for (pos = 0; pos < len; pos += packet_size) {
+			out += sr_bit_transpose_feed(t, &payload[pos],
+				MIN(packet_size, len - pos), &got[out]);
+		}
+		fail_unless(out == total);
+		fail_unless(memcmp(got, samples, total * sizeof(got[0])) == 0,
+			"stream mismatch for %zu channels", count);
+		sr_bit_transpose_free(t);
+	}
+
+	g_free(payload);
+	g_free(got);
+	g_free(samples);
+}
+END_TEST
+
 Suite *suite_conv(void)
 {
 	Suite *s;
@@ -226,5 +445,15 @@ Suite *suite_conv(void)
 	tcase_add_test(tc, test_endian_write_inc);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("varint");
+	tcase_add_test(tc, test_varint);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("transpose");
+	tcase_add_test(tc, test_transpose_kernels);
+	tcase_add_test(tc, test_transpose_large);
+	tcase_add_test(tc, test_transpose_stream);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
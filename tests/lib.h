@@ -53,6 +53,12 @@ Suite *suite_version(void);
 Suite *suite_device(void);
 Suite *suite_trigger(void);
 Suite *suite_analog(void);
+Suite *suite_analog_batch(void);
 Suite *suite_conv(void);
+Suite *suite_transitions(void);
+Suite *suite_buffer_pool(void);
+Suite *suite_serial(void);
+Suite *suite_scpi(void);
+Suite *suite_modbus(void);
 
 #endif
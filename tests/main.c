@@ -45,7 +45,13 @@ int main(void)
 	srunner_add_suite(srunner, suite_device());
 	srunner_add_suite(srunner, suite_trigger());
 	srunner_add_suite(srunner, suite_analog());
+	srunner_add_suite(srunner, suite_analog_batch());
 	srunner_add_suite(srunner, suite_conv());
+	srunner_add_suite(srunner, suite_transitions());
+	srunner_add_suite(srunner, suite_buffer_pool());
+	srunner_add_suite(srunner, suite_serial());
+	srunner_add_suite(srunner, suite_scpi());
+	srunner_add_suite(srunner, suite_modbus());
 
 	srunner_run_all(srunner, CK_VERBOSE);
 	ret = srunner_ntests_failed(srunner);
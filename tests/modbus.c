@@ -0,0 +1,266 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#define NUM_REGISTERS	0x40
+
+/*
+ * A Modbus device stand-in, with a transport which serves requests
+ * right away. Registers which the device doesn't implement yield an
+ * "illegal data address" exception.
+ */
+struct standin {
+	uint16_t registers[NUM_REGISTERS];
+	gboolean implemented[NUM_REGISTERS];
+	uint8_t reply[256];
+	int reply_len, reply_pos;
+	int num_requests, num_exceptions;
+};
+
+static void standin_exception(struct standin *s, uint8_t function)
+{
+	s->reply[0] = function | 0x80;
+	s->reply[1] = 0x02;
+	s->reply_len = 2;
+	s->num_exceptions++;
+}
+
+static gboolean standin_valid(struct standin *s, int address, int count)
+{
+	int i;
+
+	if (address + count > NUM_REGISTERS)
+		return FALSE;
+	for (i = address; i < address + count; i++) {
+		if (!s->implemented[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static int standin_send(void *priv, const uint8_t *buffer, int buffer_size)
+{
+	struct standin *s;
+	int address, count, i;
+
+	s = priv;
+	s->num_requests++;
+	fail_unless(buffer_size >= 5);
+	address = RB16(buffer + 1);
+	count = RB16(buffer + 3);
+	if (!standin_valid(s, address, count)) {
+		standin_exception(s, buffer[0]);
+		return SR_OK;
+	}
+
+	s->reply[0] = buffer[0];
+	switch (buffer[0]) {
+	case 0x03:
+		s->reply[1] = 2 * count;
+		for (i = 0; i < count; i++)
+			WB16(s->reply + 2 + 2 * i, s->registers[address + i]);
+		s->reply_len = 2 + 2 * count;
+		break;
+	case 0x10:
+		for (i = 0; i < count; i++)
+			s->registers[address + i] = RB16(buffer + 6 + 2 * i);
+		memcpy(s->reply, buffer, 5);
+		s->reply_len = 5;
+		break;
+	default:
+		fail("Unexpected function 0x%02x.", buffer[0]);
+	}
+
+	return SR_OK;
+}
+
+static int standin_read_begin(void *priv, uint8_t *function_code)
+{
+	struct standin *s;
+
+	s = priv;
+	*function_code = s->reply[0];
+	s->reply_pos = 1;
+
+	return SR_OK;
+}
+
+static int standin_read_data(void *priv, uint8_t *buf, int maxlen)
+{
+	struct standin *s;
+	int len;
+
+	s = priv;
+	len = MIN(maxlen, s->reply_len - s->reply_pos);
+	memcpy(buf, s->reply + s->reply_pos, len);
+	s->reply_pos += len;
+
+	return len;
+}
+
+static int standin_read_end(void *priv)
+{
+	(void)priv;
+
+	return SR_OK;
+}
+
+static void standin_free(void *priv)
+{
+	(void)priv;
+}
+
+/* Implements registers 0x00-0x0c and 0x20-0x23, like an RDTech DPS. */
+static struct sr_modbus_dev_inst *standin_new(void)
+{
+	struct sr_modbus_dev_inst *modbus;
+	struct standin *s;
+	int i;
+
+	s = g_malloc0(sizeof(*s));
+	for (i = 0; i < NUM_REGISTERS; i++) {
+		s->implemented[i] = i <= 0x0c || (i >= 0x20 && i <= 0x23);
+		s->registers[i] = 0x1000 + i;
+	}
+
+	modbus = g_malloc0(sizeof(*modbus));
+	modbus->name = "Stand-in";
+	modbus->send = standin_send;
+	modbus->read_begin = standin_read_begin;
+	modbus->read_data = standin_read_data;
+	modbus->read_end = standin_read_end;
+	modbus->free = standin_free;
+	modbus->read_timeout_ms = 100;
+	modbus->priv = s;
+
+	return modbus;
+}
+
+static struct standin *standin_of(struct sr_modbus_dev_inst *modbus)
+{
+	return modbus->priv;
+}
+
+/* Only adjacent and overlapping ranges share a request by default. */
+START_TEST(test_poll_coalesce)
+{
+	struct sr_modbus_dev_inst *modbus;
+	uint16_t regs[4];
+
+	modbus = standin_new();
+	sr_modbus_poll_add(modbus, 0x00, 2);
+	sr_modbus_poll_add(modbus, 0x02, 8);
+	sr_modbus_poll_add(modbus, 0x04, 2);
+	sr_modbus_poll_add(modbus, 0x0b, 2);
+	sr_modbus_poll_add(modbus, 0x20, 4);
+	fail_unless(sr_modbus_poll_read(modbus) == SR_OK);
+	fail_unless(standin_of(modbus)->num_requests == 3,
+		"%d requests.", standin_of(modbus)->num_requests);
+	fail_unless(standin_of(modbus)->num_exceptions == 0);
+
+	fail_unless(sr_modbus_poll_get(modbus, 0x08, 4, regs, 1000) == SR_ERR_NA,
+		"Undeclared register 0x0a was read.");
+	fail_unless(sr_modbus_poll_get(modbus, 0x01, 2, regs, 1000) == SR_OK);
+	fail_unless(RB16(regs + 0) == 0x1001 && RB16(regs + 1) == 0x1002);
+	fail_unless(sr_modbus_poll_get(modbus, 0x22, 2, regs, 1000) == SR_OK);
+	fail_unless(RB16(regs + 0) == 0x1022 && RB16(regs + 1) == 0x1023);
+
+	sr_modbus_free(modbus);
+}
+END_TEST
+
+/* Gaps only get read along when the driver allows it. */
+START_TEST(test_poll_gap)
+{
+	struct sr_modbus_dev_inst *modbus;
+	uint16_t regs[2];
+
+	/* The gap 0x0d-0x1f isn't implemented. */
+	modbus = standin_new();
+	sr_modbus_poll_add(modbus, 0x0a, 3);
+	sr_modbus_poll_add(modbus, 0x20, 2);
+	fail_unless(sr_modbus_poll_read(modbus) == SR_OK);
+	fail_unless(standin_of(modbus)->num_requests == 2);
+	fail_unless(standin_of(modbus)->num_exceptions == 0);
+	sr_modbus_free(modbus);
+
+	/* The gap 0x02-0x09 is implemented. */
+	modbus = standin_new();
+	fail_unless(sr_modbus_poll_set_max_gap(modbus, 8) == SR_OK);
+	sr_modbus_poll_add(modbus, 0x00, 2);
+	sr_modbus_poll_add(modbus, 0x0a, 2);
+	fail_unless(sr_modbus_poll_read(modbus) == SR_OK);
+	fail_unless(standin_of(modbus)->num_requests == 1);
+	fail_unless(sr_modbus_poll_get(modbus, 0x0a, 2, regs, 1000) == SR_OK);
+	fail_unless(RB16(regs + 0) == 0x100a);
+	sr_modbus_free(modbus);
+}
+END_TEST
+
+/* Written and invalidated registers are not served from the cache. */
+START_TEST(test_poll_invalidate)
+{
+	struct sr_modbus_dev_inst *modbus;
+	uint16_t regs[2], value;
+
+	modbus = standin_new();
+	sr_modbus_poll_add(modbus, 0x00, 10);
+	fail_unless(sr_modbus_poll_read(modbus) == SR_OK);
+	fail_unless(sr_modbus_poll_get(modbus, 0x00, 2, regs, 1000) == SR_OK);
+
+	WB16(&value, 0x1234);
+	fail_unless(sr_modbus_write_multiple_registers(modbus, 0x01, 1,
+		&value) == SR_OK);
+	fail_unless(sr_modbus_poll_get(modbus, 0x00, 1, regs, 1000) == SR_OK);
+	fail_unless(sr_modbus_poll_get(modbus, 0x01, 1, regs, 1000) == SR_ERR_NA);
+
+	sr_modbus_poll_invalidate(modbus, 0x00, 1);
+	fail_unless(sr_modbus_poll_get(modbus, 0x00, 1, regs, 1000) == SR_ERR_NA);
+	fail_unless(sr_modbus_poll_get(modbus, 0x02, 1, regs, 1000) == SR_OK);
+
+	fail_unless(sr_modbus_poll_read(modbus) == SR_OK);
+	fail_unless(sr_modbus_poll_get(modbus, 0x00, 2, regs, 1000) == SR_OK);
+	fail_unless(RB16(regs + 1) == 0x1234);
+
+	sr_modbus_free(modbus);
+}
+END_TEST
+
+Suite *suite_modbus(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("modbus");
+
+	tc = tcase_create("poll");
+	tcase_add_test(tc, test_poll_coalesce);
+	tcase_add_test(tc, test_poll_gap);
+	tcase_add_test(tc, test_poll_invalidate);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
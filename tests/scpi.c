@@ -0,0 +1,655 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <math.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "scpi.h"
+#include "lib.h"
+
+#ifndef _WIN32
+
+#define STANDIN_MAX_CLIENTS	8
+#define STANDIN_POLL_MS		20
+
+/*
+ * A SCPI device stand-in, which serves raw SCPI on a local TCP port.
+ * Each line is a program message, whose units are separated by ';'.
+ */
+struct standin {
+	int listen_fd;
+	int port;
+	GThread *thread;
+	gint stop;
+	/* Answer all queries of compound program messages. */
+	gboolean compound;
+	/* Do not answer queries at all. */
+	gboolean mute;
+	/* Identification, instead of the stand-in's own. */
+	const char *idn;
+	/* Number of connected clients, and of accepted connections. */
+	gint num_clients;
+	gint num_accepts;
+	/* Number of *IDN? queries. */
+	gint num_idn;
+	GMutex mutex;
+	/* Commands which the device executed. */
+	GPtrArray *executed;
+};
+
+struct standin_client {
+	int fd;
+	GString *rx;
+};
+
+static const char *standin_query(struct standin *s, const char *header)
+{
+	static const struct {
+		const char *header;
+		const char *response;
+	} responses[] = {
+		{ "*IDN?", "Sigrok,Stand-in,1234,1.0" },
+		{ "*OPC?", "1" },
+		{ "MEAS:VOLT?", "1.25" },
+		{ "MEAS:CURR?", "0.5" },
+		{ "OUTP?", "1" },
+		{ "SYST:ERR?", "0,\"No error; all fine\"" },
+		{ "WAV:DATA?", "#2160123456789abcdef" },
+	};
+	size_t i;
+
+	if (!g_ascii_strcasecmp(header, "*IDN?"))
+		g_atomic_int_inc(&s->num_idn);
+	if (s->idn && !g_ascii_strcasecmp(header, "*IDN?"))
+		return s->idn;
+	for (i = 0; i < G_N_ELEMENTS(responses); i++) {
+		if (!g_ascii_strcasecmp(header, responses[i].header))
+			return responses[i].response;
+	}
+
+	return "0";
+}
+
+/* Execute a program message, and return the response message. */
+static void standin_message(struct standin *s, const char *msg, GString *out)
+{
+	gchar **units;
+	char *unit;
+	size_t i;
+
+	units = g_strsplit(msg, ";", 0);
+	for (i = 0; units[i]; i++) {
+		unit = g_strstrip(units[i]);
+		if (*unit == ':')
+			unit++;
+		if (!*unit)
+			continue;
+		if (!strchr(unit, '?')) {
+			g_mutex_lock(&s->mutex);
+			g_ptr_array_add(s->executed, g_strdup(unit));
+			g_mutex_unlock(&s->mutex);
+			continue;
+		}
+		if (out->len)
+			g_string_append_c(out, ';');
+		g_string_append(out, standin_query(s, unit));
+		/* Devices without compound support ignore the remainder. */
+		if (!s->compound)
+			break;
+	}
+	g_strfreev(units);
+	if (out->len)
+		g_string_append_c(out, '\n');
+}
+
+/*
+ * Send a response. Data blocks are sent in two parts, like large
+ * blocks over slow links, such that they get received in several reads.
+ */
+static gboolean standin_send(int fd, const GString *out)
+{
+	size_t part;
+
+	part = out->str[0] == '#' ? 8 : out->len;
+	if (send(fd, out->str, part, 0) < 0)
+		return FALSE;
+	if (part == out->len)
+		return TRUE;
+	g_usleep(STANDIN_POLL_MS * 1000);
+
+	return send(fd, out->str + part, out->len - part, 0) >= 0;
+}
+
+/* Returns FALSE when the client closed the connection. */
+static gboolean standin_receive(struct standin *s, struct standin_client *c)
+{
+	char buf[256], *nl;
+	GString *out;
+	ssize_t len;
+
+	len = recv(c->fd, buf, sizeof(buf), 0);
+	if (len <= 0)
+		return FALSE;
+	g_string_append_len(c->rx, buf, len);
+
+	out = g_string_new(NULL);
+	while ((nl = strchr(c->rx->str, '\n'))) {
+		*nl = '\0';
+		g_string_truncate(out, 0);
+		standin_message(s, c->rx->str, out);
+		g_string_erase(c->rx, 0, nl + 1 - c->rx->str);
+		if (out->len && !s->mute && !standin_send(c->fd, out))
+			break;
+	}
+	g_string_free(out, TRUE);
+
+	return TRUE;
+}
+
+static gpointer standin_thread(gpointer data)
+{
+	struct standin *s;
+	struct standin_client clients[STANDIN_MAX_CLIENTS];
+	struct pollfd fds[1 + STANDIN_MAX_CLIENTS];
+	int num_clients, i, fd;
+
+	s = data;
+	num_clients = 0;
+	while (!g_atomic_int_get(&s->stop)) {
+		fds[0].fd = s->listen_fd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < num_clients; i++) {
+			fds[1 + i].fd = clients[i].fd;
+			fds[1 + i].events = POLLIN;
+		}
+		if (poll(fds, 1 + num_clients, STANDIN_POLL_MS) <= 0)
+			continue;
+		for (i = num_clients - 1; i >= 0; i--) {
+			if (!fds[1 + i].revents)
+				continue;
+			if (standin_receive(s, &clients[i]))
+				continue;
+			close(clients[i].fd);
+			g_string_free(clients[i].rx, TRUE);
+			clients[i] = clients[--num_clients];
+			g_atomic_int_set(&s->num_clients, num_clients);
+		}
+		if (fds[0].revents && num_clients < STANDIN_MAX_CLIENTS) {
+			fd = accept(s->listen_fd, NULL, NULL);
+			if (fd >= 0) {
+				clients[num_clients].fd = fd;
+				clients[num_clients++].rx = g_string_new(NULL);
+				g_atomic_int_set(&s->num_clients, num_clients);
+				g_atomic_int_inc(&s->num_accepts);
+			}
+		}
+	}
+	for (i = 0; i < num_clients; i++) {
+		close(clients[i].fd);
+		g_string_free(clients[i].rx, TRUE);
+	}
+
+	return NULL;
+}
+
+static struct standin *standin_new(gboolean compound)
+{
+	struct standin *s;
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+
+	s = g_malloc0(sizeof(*s));
+	s->compound = compound;
+	g_mutex_init(&s->mutex);
+	s->executed = g_ptr_array_new_with_free_func(g_free);
+
+	s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	fail_unless(s->listen_fd >= 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	fail_unless(bind(s->listen_fd, (struct sockaddr *)&addr,
+		sizeof(addr)) == 0);
+	fail_unless(listen(s->listen_fd, 4) == 0);
+	addrlen = sizeof(addr);
+	getsockname(s->listen_fd, (struct sockaddr *)&addr, &addrlen);
+	s->port = ntohs(addr.sin_port);
+
+	s->thread = g_thread_new("scpi-standin", standin_thread, s);
+
+	return s;
+}
+
+static void standin_free(struct standin *s)
+{
+	g_atomic_int_set(&s->stop, 1);
+	g_thread_join(s->thread);
+	close(s->listen_fd);
+	g_ptr_array_free(s->executed, TRUE);
+	g_mutex_clear(&s->mutex);
+	g_free(s);
+}
+
+/* Check the commands which the stand-in executed, in order. */
+static void standin_check_executed(struct standin *s, const char **expected)
+{
+	guint i;
+
+	g_mutex_lock(&s->mutex);
+	for (i = 0; expected[i]; i++) {
+		fail_unless(i < s->executed->len, "Command '%s' not executed.",
+			expected[i]);
+		fail_unless(!strcmp(g_ptr_array_index(s->executed, i),
+			expected[i]), "Executed '%s', expected '%s'.",
+			(char *)g_ptr_array_index(s->executed, i), expected[i]);
+	}
+	fail_unless(i == s->executed->len, "Executed %u commands, expected %u.",
+		s->executed->len, i);
+	g_mutex_unlock(&s->mutex);
+}
+
+/* Wait for the stand-in to see the given number of clients. */
+static gboolean standin_wait_clients(struct standin *s, int count)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if (g_atomic_int_get(&s->num_clients) == count)
+			return TRUE;
+		g_usleep(STANDIN_POLL_MS * 1000);
+	}
+
+	return FALSE;
+}
+
+static struct sr_scpi_dev_inst *standin_connect(struct standin *s)
+{
+	struct drv_context drvc;
+	struct sr_scpi_dev_inst *scpi;
+	char *resource;
+
+	memset(&drvc, 0, sizeof(drvc));
+	drvc.sr_ctx = srtest_ctx;
+	resource = g_strdup_printf("tcp-raw/127.0.0.1/%d", s->port);
+	scpi = scpi_dev_inst_new(&drvc, resource, NULL);
+	g_free(resource);
+	fail_unless(scpi != NULL);
+	fail_unless(sr_scpi_open(scpi) == SR_OK);
+
+	return scpi;
+}
+
+static void run_batch(struct sr_scpi_dev_inst *scpi)
+{
+	struct sr_scpi_batch *batch;
+	int volt, curr, err, outp;
+
+	batch = sr_scpi_batch_new(scpi);
+	sr_scpi_batch_add(batch, NULL, "VOLT %.1f", 1.5);
+	sr_scpi_batch_add(batch, &volt, "MEAS:VOLT?");
+	sr_scpi_batch_add(batch, NULL, "CURR 0.2");
+	sr_scpi_batch_add(batch, &curr, "MEAS:CURR?");
+	sr_scpi_batch_add(batch, &err, "SYST:ERR?");
+	sr_scpi_batch_add(batch, NULL, "OUTP ON");
+	sr_scpi_batch_add(batch, &outp, "OUTP?");
+	fail_unless(sr_scpi_batch_run(batch) == SR_OK);
+
+	fail_unless(!g_strcmp0(sr_scpi_batch_get_string(batch, volt), "1.25"));
+	fail_unless(!g_strcmp0(sr_scpi_batch_get_string(batch, curr), "0.5"));
+	fail_unless(!g_strcmp0(sr_scpi_batch_get_string(batch, err),
+		"0,\"No error; all fine\""));
+	fail_unless(!g_strcmp0(sr_scpi_batch_get_string(batch, outp), "1"));
+	sr_scpi_batch_free(batch);
+}
+
+/* Batches run as compound program messages, responses get split. */
+START_TEST(test_batch_compound)
+{
+	static const char *executed[] = {
+		"VOLT 1.5", "CURR 0.2", "OUTP ON",
+		"VOLT 1.5", "CURR 0.2", "OUTP ON", NULL,
+	};
+	struct standin *s;
+	struct sr_scpi_dev_inst *scpi;
+
+	s = standin_new(TRUE);
+	scpi = standin_connect(s);
+	run_batch(scpi);
+	run_batch(scpi);
+	fail_unless(!scpi->no_compound_queries);
+	sr_scpi_close(scpi);
+	sr_scpi_free(scpi);
+	standin_check_executed(s, executed);
+	standin_free(s);
+}
+END_TEST
+
+/*
+ * Devices which ignore the remainder of compound messages get single
+ * commands, from the item after the last answered query on.
+ */
+START_TEST(test_batch_fallback)
+{
+	static const char *executed[] = {
+		"VOLT 1.5", "CURR 0.2", "OUTP ON",
+		"VOLT 1.5", "CURR 0.2", "OUTP ON", NULL,
+	};
+	struct standin *s;
+	struct sr_scpi_dev_inst *scpi;
+
+	s = standin_new(FALSE);
+	scpi = standin_connect(s);
+	scpi->read_timeout_us = 200 * 1000;
+	run_batch(scpi);
+	fail_unless(scpi->no_compound_queries);
+	run_batch(scpi);
+	sr_scpi_close(scpi);
+	sr_scpi_free(scpi);
+	standin_check_executed(s, executed);
+	standin_free(s);
+}
+END_TEST
+
+/* Timeouts without any response are errors, not a lack of compound support. */
+START_TEST(test_batch_timeout)
+{
+	struct standin *s;
+	struct sr_scpi_dev_inst *scpi;
+	struct sr_scpi_batch *batch;
+	int volt;
+
+	s = standin_new(TRUE);
+	s->mute = TRUE;
+	scpi = standin_connect(s);
+	scpi->read_timeout_us = 200 * 1000;
+	batch = sr_scpi_batch_new(scpi);
+	sr_scpi_batch_add(batch, NULL, "VOLT 1.5");
+	sr_scpi_batch_add(batch, &volt, "MEAS:VOLT?");
+	fail_unless(sr_scpi_batch_run(batch) == SR_ERR_TIMEOUT);
+	fail_unless(!scpi->no_compound_queries);
+	sr_scpi_batch_free(batch);
+	sr_scpi_close(scpi);
+	sr_scpi_free(scpi);
+	standin_free(s);
+}
+END_TEST
+
+/* Block reads stop at the block's end, also into larger buffers. */
+START_TEST(test_block_into)
+{
+	struct standin *s;
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *block;
+	uint8_t buf[64];
+	size_t length;
+	char *response;
+
+	s = standin_new(TRUE);
+	scpi = standin_connect(s);
+
+	fail_unless(sr_scpi_get_block(scpi, "WAV:DATA?", &block) == SR_OK);
+	fail_unless(block->len == 16);
+	fail_unless(!memcmp(block->data, "0123456789abcdef", 16));
+	g_byte_array_free(block, TRUE);
+
+	memset(buf, 0, sizeof(buf));
+	fail_unless(sr_scpi_get_block_into(scpi, "WAV:DATA?", buf,
+		sizeof(buf), &length) == SR_OK);
+	fail_unless(length == 16);
+	fail_unless(!memcmp(buf, "0123456789abcdef", 16));
+	fail_unless(buf[16] == 0, "Read past the block's end.");
+
+	/* Excess data gets discarded. */
+	memset(buf, 0, sizeof(buf));
+	fail_unless(sr_scpi_get_block_into(scpi, "WAV:DATA?", buf, 4,
+		&length) == SR_OK);
+	fail_unless(length == 4);
+	fail_unless(!memcmp(buf, "0123", 5));
+
+	/* The next response is not affected. */
+	fail_unless(sr_scpi_get_string(scpi, "*OPC?", &response) == SR_OK);
+	fail_unless(!g_strcmp0(response, "1"), "Got '%s'.", response);
+	g_free(response);
+
+	sr_scpi_close(scpi);
+	sr_scpi_free(scpi);
+	standin_free(s);
+}
+END_TEST
+
+/* Trailing partial samples of a block get dropped. */
+START_TEST(test_get_samples)
+{
+	static const struct sr_scpi_sample_format word = { 4, TRUE, FALSE, FALSE };
+	static const struct sr_scpi_sample_format odd = { 3, TRUE, FALSE, FALSE };
+	struct standin *s;
+	struct sr_scpi_dev_inst *scpi;
+	GByteArray *samples;
+	size_t num_samples;
+
+	s = standin_new(TRUE);
+	scpi = standin_connect(s);
+
+	fail_unless(sr_scpi_get_samples(scpi, "WAV:DATA?", &word, &samples,
+		&num_samples) == SR_OK);
+	fail_unless(num_samples == 4 && samples->len == 16);
+	g_byte_array_free(samples, TRUE);
+
+	fail_unless(sr_scpi_get_samples(scpi, "WAV:DATA?", &odd, &samples,
+		&num_samples) == SR_OK);
+	fail_unless(num_samples == 5 && samples->len == 15);
+	fail_unless(!memcmp(samples->data, "0123456789abcde", 15));
+	g_byte_array_free(samples, TRUE);
+
+	sr_scpi_close(scpi);
+	sr_scpi_free(scpi);
+	standin_free(s);
+}
+END_TEST
+
+#ifdef HAVE_HW_SCPI_DMM
+static GSList *scan_conn(struct sr_dev_driver *driver, const char *conn)
+{
+	struct sr_config src;
+	GSList *options, *devices;
+
+	src.key = SR_CONF_CONN;
+	src.data = g_variant_new_string(conn);
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+
+	return devices;
+}
+
+/*
+ * The scan keeps the connection open for the first open of the device.
+ * Another scan of the resource, and clearing the devices, close it.
+ */
+START_TEST(test_scan_open)
+{
+	struct standin *s;
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	GSList *devices;
+	char *conn;
+
+	s = standin_new(TRUE);
+	s->idn = "Agilent Technologies,34405A,MY12345678,1.0";
+	driver = srtest_driver_get("scpi-dmm");
+	srtest_driver_init(srtest_ctx, driver);
+
+	conn = g_strdup_printf("tcp-raw/127.0.0.1/%d", s->port);
+	devices = scan_conn(driver, conn);
+	fail_unless(g_slist_length(devices) == 1, "Device not found.");
+	g_slist_free(devices);
+	fail_unless(standin_wait_clients(s, 1));
+
+	/* Scanning again replaces the connection. */
+	devices = scan_conn(driver, conn);
+	fail_unless(g_slist_length(devices) == 1, "Device not found.");
+	sdi = devices->data;
+	g_slist_free(devices);
+	fail_unless(!g_strcmp0(sr_dev_inst_model_get(sdi), "34405A"));
+	fail_unless(g_atomic_int_get(&s->num_accepts) == 2);
+	fail_unless(standin_wait_clients(s, 1),
+		"Connection of the first scan was kept open.");
+
+	/* The first open takes the scan's connection, the next connects. */
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+	fail_unless(g_atomic_int_get(&s->num_accepts) == 2);
+	fail_unless(sr_dev_close(sdi) == SR_OK);
+	fail_unless(standin_wait_clients(s, 0));
+	fail_unless(sr_dev_open(sdi) == SR_OK);
+	fail_unless(standin_wait_clients(s, 1));
+	fail_unless(g_atomic_int_get(&s->num_accepts) == 3);
+	fail_unless(sr_dev_close(sdi) == SR_OK);
+	fail_unless(standin_wait_clients(s, 0));
+
+	/* Clearing devices closes connections which were not used. */
+	devices = scan_conn(driver, conn);
+	fail_unless(g_slist_length(devices) == 1, "Device not found.");
+	g_slist_free(devices);
+	fail_unless(standin_wait_clients(s, 1));
+	sr_dev_clear(driver);
+	fail_unless(standin_wait_clients(s, 0),
+		"Connection of the scan was not closed.");
+
+	g_free(conn);
+	standin_free(s);
+}
+END_TEST
+
+/* Several TCP resources get scanned, results keep their order. */
+START_TEST(test_scan_list)
+{
+	static const char *models[] = { "34405A", "34465A" };
+	struct standin *s[2];
+	struct sr_dev_driver *driver;
+	GSList *devices, *l;
+	char *conn;
+	int i;
+
+	driver = srtest_driver_get("scpi-dmm");
+	srtest_driver_init(srtest_ctx, driver);
+	s[0] = standin_new(TRUE);
+	s[0]->idn = "Agilent Technologies,34405A,MY12345678,1.0";
+	s[1] = standin_new(TRUE);
+	s[1]->idn = "Keysight Technologies,34465A,MY87654321,2.0";
+
+	conn = g_strdup_printf("tcp-raw/127.0.0.1/%d, tcp-raw/127.0.0.1/%d",
+		s[0]->port, s[1]->port);
+	devices = scan_conn(driver, conn);
+	g_free(conn);
+	fail_unless(g_slist_length(devices) == 2, "Found %u devices.",
+		g_slist_length(devices));
+	for (i = 0, l = devices; l; i++, l = l->next) {
+		fail_unless(!g_strcmp0(sr_dev_inst_model_get(l->data),
+			models[i]));
+		/* The probe took the identification of the scan. */
+		fail_unless(g_atomic_int_get(&s[i]->num_accepts) == 1);
+		fail_unless(g_atomic_int_get(&s[i]->num_idn) == 1);
+	}
+	g_slist_free(devices);
+
+	sr_dev_clear(driver);
+	for (i = 0; i < 2; i++) {
+		fail_unless(standin_wait_clients(s[i], 0));
+		standin_free(s[i]);
+	}
+}
+END_TEST
+#endif
+
+#endif
+
+/* Scale and offset keep their precision, also for small gains. */
+START_TEST(test_sample_encoding)
+{
+	static const struct sr_scpi_sample_format format = { 2, TRUE, FALSE, FALSE };
+	static const double values[][2] = {
+		{ 1.0, 0.0 }, { 0.04, -3.2 }, { 3.0517578125e-5, 0.25 },
+		{ 1.234567e-7, -1.5e-3 }, { 7.62939453125e-12, 1e-11 },
+		{ -2.5e-3, 125.0 }, { 1e6, -4.2e9 },
+	};
+	struct sr_analog_encoding encoding;
+	double scale, offset;
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(values); i++) {
+		sr_scpi_sample_encoding(&format, values[i][0], values[i][1],
+			&encoding);
+		fail_unless(encoding.unitsize == 2 && encoding.is_signed);
+		scale = (double)encoding.scale.p / encoding.scale.q;
+		offset = (double)encoding.offset.p / encoding.offset.q;
+		fail_unless(fabs(scale - values[i][0]) <= fabs(values[i][0]) * 1e-7,
+			"Scale %g became %g.", values[i][0], scale);
+		fail_unless(fabs(offset - values[i][1]) <= fabs(values[i][1]) * 1e-7,
+			"Offset %g became %g.", values[i][1], offset);
+	}
+}
+END_TEST
+
+Suite *suite_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("batch");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#ifndef _WIN32
+	tcase_add_test(tc, test_batch_compound);
+	tcase_add_test(tc, test_batch_fallback);
+	tcase_add_test(tc, test_batch_timeout);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("block");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#ifndef _WIN32
+	tcase_add_test(tc, test_block_into);
+	tcase_add_test(tc, test_get_samples);
+#endif
+	tcase_add_test(tc, test_sample_encoding);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("scan");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+#if !defined(_WIN32) && defined(HAVE_HW_SCPI_DMM)
+	tcase_add_test(tc, test_scan_open);
+	tcase_add_test(tc, test_scan_list);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,435 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "lib.h"
+
+#ifdef HAVE_SERIAL_COMM
+
+/* Receive buffer size of the replay, like a driver's local buffer. */
+#define REPLAY_BUFSIZE	128
+#define REPLAY_PACKETS	500
+
+/* A meter protocol, and packets as the meter sends them. */
+struct replay_proto {
+	const char *name;
+	const struct sr_packet_sync *sync;
+	gboolean (*packet_valid)(const uint8_t *buf);
+	size_t packet_size;
+	const uint8_t (*packets)[32];
+	size_t packet_count;
+	/* Noise bytes must not look like a packet start. */
+	uint8_t noise_mask, noise_value;
+};
+
+/* FS9721: 1.234 V, -0.567 V, 12.34 mA (DC, auto range). */
+static const uint8_t fs9721_packets[][32] = {
+	{ 0x17, 0x20, 0x35, 0x4d, 0x5b, 0x61, 0x7f, 0x82, 0x97,
+	  0xa0, 0xb0, 0xc0, 0xd4, 0xe0 },
+	{ 0x17, 0x2f, 0x3d, 0x4b, 0x5e, 0x67, 0x7e, 0x81, 0x95,
+	  0xa0, 0xb0, 0xc0, 0xd4, 0xe0 },
+	{ 0x17, 0x20, 0x35, 0x45, 0x5b, 0x69, 0x7f, 0x82, 0x97,
+	  0xa0, 0xb8, 0xc0, 0xd8, 0xe0 },
+};
+
+/* Metex 14 byte text packets. */
+static const uint8_t metex14_packets[][32] = {
+	{ "DC  1.234   V\r" },
+	{ "AC 230.1    V\r" },
+	{ "OH  0.998KOhm\r" },
+	{ "DC -12.34  mA\r" },
+};
+
+/* ES51919: primary and secondary readings. */
+static const uint8_t es51919_packets[][32] = {
+	{ 0x00, 0x0d, 0x21, 0x11, 0x03, 0x12, 0x34, 0x00, 0x01,
+	  0x12, 0x00, 0x23, 0x00, 0x00, 0x03, 0x0d, 0x0a },
+	{ 0x00, 0x0d, 0x21, 0x11, 0x03, 0x09, 0x87, 0x00, 0x02,
+	  0x12, 0x00, 0x45, 0x00, 0x00, 0x03, 0x0d, 0x0a },
+};
+
+static const struct replay_proto replay_protos[] = {
+	{ "fs9721", &sr_fs9721_packet_sync, sr_fs9721_packet_valid,
+	  FS9721_PACKET_SIZE, fs9721_packets,
+	  G_N_ELEMENTS(fs9721_packets), 0xf0, 0x10 },
+	{ "metex14", &sr_metex14_packet_sync, sr_metex14_packet_valid,
+	  METEX14_PACKET_SIZE, metex14_packets,
+	  G_N_ELEMENTS(metex14_packets), 0xff, '\r' },
+	{ "es51919", &es51919_packet_sync, es51919_packet_valid,
+	  ES51919_PACKET_SIZE, es51919_packets,
+	  G_N_ELEMENTS(es51919_packets), 0xff, 0x0a },
+};
+
+/*
+ * Build a stream of packets, with noise and truncated packets between
+ * them, as after reconnects or dropped bytes. Returns the packets'
+ * offsets in @p offsets.
+ */
+static GByteArray *replay_stream(const struct replay_proto *proto,
+	GArray *offsets)
+{
+	GByteArray *stream;
+	const uint8_t *packet;
+	uint8_t b;
+	size_t i, n, pos;
+
+	stream = g_byte_array_new();
+	for (i = 0; i < REPLAY_PACKETS; i++) {
+		n = g_random_int_range(0, 40);
+		while (n--) {
+			do {
+				b = g_random_int_range(0, 256);
+			} while ((b & proto->noise_mask) == proto->noise_value);
+			g_byte_array_append(stream, &b, 1);
+		}
+		packet = proto->packets[g_random_int_range(0, proto->packet_count)];
+		if (g_random_int_range(0, 4) == 0) {
+			n = g_random_int_range(1, proto->packet_size - 1);
+			g_byte_array_append(stream, packet, n);
+		}
+		pos = stream->len;
+		g_array_append_val(offsets, pos);
+		g_byte_array_append(stream, packet, proto->packet_size);
+	}
+
+	return stream;
+}
+
+/* Check every offset, as without a synchronization signature. */
+static GArray *replay_scan_plain(const struct replay_proto *proto,
+	const GByteArray *stream)
+{
+	GArray *found;
+	size_t pos;
+
+	found = g_array_new(FALSE, FALSE, sizeof(size_t));
+	pos = 0;
+	while (pos + proto->packet_size <= stream->len) {
+		if (proto->packet_valid(&stream->data[pos])) {
+			g_array_append_val(found, pos);
+			pos += proto->packet_size;
+		} else {
+			pos++;
+		}
+	}
+
+	return found;
+}
+
+/* Receive the stream in random chunks, like the serial-dmm driver. */
+static GArray *replay_receive(const struct replay_proto *proto,
+	const GByteArray *stream)
+{
+	GArray *found;
+	uint8_t buf[REPLAY_BUFSIZE];
+	size_t buflen, base, rdpos, len, check_pos, pos;
+
+	found = g_array_new(FALSE, FALSE, sizeof(size_t));
+	buflen = 0;
+	base = 0;
+	rdpos = 0;
+	while (rdpos < stream->len) {
+		len = g_random_int_range(1, 64);
+		len = MIN(len, REPLAY_BUFSIZE - buflen);
+		len = MIN(len, stream->len - rdpos);
+		memcpy(&buf[buflen], &stream->data[rdpos], len);
+		buflen += len;
+		rdpos += len;
+
+		check_pos = 0;
+		while (check_pos < buflen) {
+			check_pos += sr_packet_sync_find(proto->sync,
+				&buf[check_pos], buflen - check_pos);
+			if (buflen - check_pos < proto->packet_size)
+				break;
+			if (!proto->packet_valid(&buf[check_pos])) {
+				check_pos++;
+				continue;
+			}
+			pos = base + check_pos;
+			g_array_append_val(found, pos);
+			check_pos += proto->packet_size;
+		}
+		memmove(buf, &buf[check_pos], buflen - check_pos);
+		buflen -= check_pos;
+		base += check_pos;
+	}
+
+	return found;
+}
+
+static void check_offsets(const char *name, const char *what,
+	const GArray *found, const GArray *expected)
+{
+	size_t i;
+
+	fail_unless(found->len == expected->len,
+		"%s, %s: found %u packets, expected %u.", name, what,
+		found->len, expected->len);
+	for (i = 0; i < expected->len; i++) {
+		fail_unless(g_array_index(found, size_t, i) ==
+			g_array_index(expected, size_t, i),
+			"%s, %s: packet %zu at %zu, expected %zu.", name, what, i,
+			g_array_index(found, size_t, i),
+			g_array_index(expected, size_t, i));
+	}
+}
+
+/* Replays find the same packets with and without the signature. */
+START_TEST(test_packet_sync_replay)
+{
+	const struct replay_proto *proto;
+	GByteArray *stream;
+	GArray *expected, *plain, *received;
+	size_t i;
+
+	for (i = 0; i < G_N_ELEMENTS(replay_protos); i++) {
+		proto = &replay_protos[i];
+		expected = g_array_new(FALSE, FALSE, sizeof(size_t));
+		stream = replay_stream(proto, expected);
+
+		plain = replay_scan_plain(proto, stream);
+		check_offsets(proto->name, "per-byte scan", plain, expected);
+		received = replay_receive(proto, stream);
+		check_offsets(proto->name, "signature scan", received, expected);
+
+		g_array_free(received, TRUE);
+		g_array_free(plain, TRUE);
+		g_array_free(expected, TRUE);
+		g_byte_array_free(stream, TRUE);
+	}
+}
+END_TEST
+
+/* Signature bytes which were not received yet stop the search. */
+START_TEST(test_packet_sync_find)
+{
+	static const struct sr_packet_sync sync = { 3, 0xff, '\n' };
+	static const struct sr_packet_sync nibble = { 0, 0xf0, 0x10 };
+	static const struct sr_packet_sync none = { 0, 0x00, 0x00 };
+	static const uint8_t data[] = "abcdefg\nhij";
+
+	fail_unless(sr_packet_sync_find(&sync, data, 3) == 0);
+	fail_unless(sr_packet_sync_find(&sync, data, 4) == 1);
+	fail_unless(sr_packet_sync_find(&sync, data, 7) == 4);
+	fail_unless(sr_packet_sync_find(&sync, data, 8) == 4);
+	fail_unless(sr_packet_sync_find(&sync, data, 11) == 4);
+	fail_unless(sr_packet_sync_find(&none, data, 11) == 0);
+	fail_unless(sr_packet_sync_find(NULL, data, 11) == 0);
+	fail_unless(sr_packet_sync_find(&nibble,
+		(const uint8_t *)"\x20\x0f\xf1\x1f", 4) == 3);
+	fail_unless(sr_packet_sync_find(&nibble,
+		(const uint8_t *)"\x20\x0f", 2) == 2);
+}
+END_TEST
+
+/*
+ * A serial port stand-in, which hands out a stream of receive data in
+ * chunks of limited size, and counts the reads.
+ */
+static struct {
+	const uint8_t *data;
+	size_t len, pos, max_chunk;
+	size_t num_reads;
+} standin;
+
+static int standin_read(struct sr_serial_dev_inst *serial,
+	void *buf, size_t count, int nonblocking, unsigned int timeout_ms)
+{
+	(void)serial;
+	(void)nonblocking;
+	(void)timeout_ms;
+
+	standin.num_reads++;
+	count = MIN(count, standin.max_chunk);
+	count = MIN(count, standin.len - standin.pos);
+	memcpy(buf, &standin.data[standin.pos], count);
+	standin.pos += count;
+
+	return count;
+}
+
+static int standin_frame_format(struct sr_serial_dev_inst *serial,
+	int *baud, int *bits)
+{
+	(void)serial;
+
+	*baud = 2400;
+	*bits = 10;
+
+	return SR_OK;
+}
+
+static struct ser_lib_functions standin_funcs = {
+	.read = standin_read,
+	.get_frame_format = standin_frame_format,
+};
+
+static void standin_setup(struct sr_serial_dev_inst *serial,
+	const GByteArray *stream, size_t max_chunk)
+{
+	memset(serial, 0, sizeof(*serial));
+	serial->port = "standin";
+	serial->lib_funcs = &standin_funcs;
+	memset(&standin, 0, sizeof(standin));
+	standin.data = stream->data;
+	standin.len = stream->len;
+	standin.max_chunk = max_chunk;
+}
+
+/*
+ * Detection reads up to the next candidate packet's end in one go, and
+ * never reads past the matching packet.
+ */
+START_TEST(test_stream_detect)
+{
+	static const uint8_t noise[] = { 0x00, 0xff, 0x10 };
+	static const size_t chunks[] = { 64, 5, 1 };
+	struct sr_serial_dev_inst serial;
+	GByteArray *stream;
+	uint8_t buf[REPLAY_BUFSIZE];
+	size_t i, len, pkt_len, max_reads;
+	int ret;
+
+	stream = g_byte_array_new();
+	g_byte_array_append(stream, noise, sizeof(noise));
+	g_byte_array_append(stream, fs9721_packets[0], FS9721_PACKET_SIZE);
+	g_byte_array_append(stream, fs9721_packets[1], FS9721_PACKET_SIZE);
+
+	for (i = 0; i < G_N_ELEMENTS(chunks); i++) {
+		standin_setup(&serial, stream, chunks[i]);
+		len = sizeof(buf);
+		pkt_len = 0;
+		ret = serial_stream_detect(&serial, buf, &len,
+			FS9721_PACKET_SIZE, sr_fs9721_packet_valid, NULL,
+			&pkt_len, 1000);
+		fail_unless(ret == SR_OK, "Chunk size %zu: no packet.", chunks[i]);
+		fail_unless(len == sizeof(noise) + FS9721_PACKET_SIZE,
+			"Chunk size %zu: read %zu bytes.", chunks[i], len);
+		fail_unless(pkt_len == FS9721_PACKET_SIZE);
+		fail_unless(!memcmp(&buf[sizeof(noise)], fs9721_packets[0],
+			FS9721_PACKET_SIZE));
+		fail_unless(standin.pos == len);
+
+		/* One read per candidate position, when the port keeps up. */
+		max_reads = sizeof(noise) + 1;
+		if (chunks[i] < FS9721_PACKET_SIZE)
+			max_reads += FS9721_PACKET_SIZE / chunks[i];
+		fail_unless(standin.num_reads <= max_reads,
+			"Chunk size %zu: %zu reads.", chunks[i], standin.num_reads);
+	}
+
+	/* Without a valid packet, detection ends with the buffer full. */
+	g_byte_array_set_size(stream, 0);
+	for (i = 0; i < 2 * sizeof(buf); i++)
+		g_byte_array_append(stream, &noise[i % sizeof(noise)], 1);
+	standin_setup(&serial, stream, 64);
+	len = sizeof(buf);
+	ret = serial_stream_detect(&serial, buf, &len,
+		FS9721_PACKET_SIZE, sr_fs9721_packet_valid, NULL, NULL, 1000);
+	fail_unless(ret == SR_ERR);
+	fail_unless(len == sizeof(buf));
+	fail_unless(standin.pos == sizeof(buf));
+
+	g_byte_array_free(stream, TRUE);
+}
+END_TEST
+
+/*
+ * Lines get taken from the RX queue of HID and BT transports in place,
+ * also across the queue's wrap around. Data after the line end stays
+ * queued.
+ */
+START_TEST(test_readline_queued)
+{
+	static const char text[] = "abc\r\nde\nf";
+	static const char *lines[] = { "abc", "", "de" };
+	struct sr_serial_dev_inst serial;
+	GByteArray *stream, *filler;
+	char line[16], *p;
+	size_t i, skip;
+	int wrap, len;
+
+	stream = g_byte_array_new();
+	filler = g_byte_array_new();
+	for (wrap = 0; wrap <= 1; wrap++) {
+		standin_setup(&serial, stream, 64);
+		sr_ser_setup_rx_queue(&serial, 0);
+		/* Have the text start 3 bytes before the queue's end. */
+		skip = wrap ? serial.rcv_buffer->size - 3 : 0;
+		g_byte_array_set_size(filler, skip);
+		sr_ser_queue_rx_data(&serial, filler->data, skip);
+		sr_ser_consume_rx_data(&serial, skip);
+		sr_ser_queue_rx_data(&serial, (const uint8_t *)text,
+			strlen(text));
+
+		for (i = 0; i < G_N_ELEMENTS(lines); i++) {
+			p = line;
+			len = sizeof(line);
+			fail_unless(serial_readline(&serial, &p, &len, 10) == SR_OK);
+			fail_unless(!strcmp(line, lines[i]),
+				"Skip %zu: line '%s', expected '%s'.",
+				skip, line, lines[i]);
+		}
+		fail_unless(!serial.rx_unread);
+		fail_unless(sr_ser_has_queued_data(&serial) == 1);
+		fail_unless(standin.num_reads == 0);
+
+		g_free(serial.rcv_buffer->data);
+		g_free(serial.rcv_buffer);
+	}
+	g_byte_array_free(filler, TRUE);
+	g_byte_array_free(stream, TRUE);
+}
+END_TEST
+
+#endif
+
+Suite *suite_serial(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("serial");
+
+	tc = tcase_create("packet_sync");
+#ifdef HAVE_SERIAL_COMM
+	tcase_add_test(tc, test_packet_sync_find);
+	tcase_add_test(tc, test_packet_sync_replay);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stream_detect");
+#ifdef HAVE_SERIAL_COMM
+	tcase_add_test(tc, test_stream_detect);
+#endif
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("rx_queue");
+#ifdef HAVE_SERIAL_COMM
+	tcase_add_test(tc, test_readline_queued);
+#endif
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -19,9 +19,11 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
+#include "libsigrok-internal.h"
 
 /*
  * Check whether sr_session_new() works.
@@ -185,6 +187,104 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+static void check_analog_pack_int(const int32_t *values, size_t count)
+{
+	struct sr_rational scale, offset;
+	struct sr_sessionfile_analog_chunk chunk;
+	GString *buf;
+	int ret;
+
+	sr_rational_set(&scale, 5, 1000000);
+	sr_rational_set(&offset, -25, 10);
+	buf = g_string_new(NULL);
+	sr_sessionfile_analog_pack_int(buf, values, count, &scale, &offset);
+	ret = sr_sessionfile_analog_unpack((const uint8_t *)buf->str,
+		buf->len, &chunk);
+	fail_unless(ret == SR_OK, "Unpack failed: %d.", ret);
+	fail_unless(!chunk.is_float);
+	fail_unless(chunk.count == count, "Count %zu != %zu.",
+		chunk.count, count);
+	fail_unless(sr_rational_eq(&chunk.scale, &scale));
+	fail_unless(sr_rational_eq(&chunk.offset, &offset));
+	fail_unless(!count || memcmp(chunk.data, values,
+		count * sizeof(values[0])) == 0, "Value mismatch.");
+	g_free(chunk.data);
+
+	/* Truncated containers are rejected. */
+	if (count) {
+		ret = sr_sessionfile_analog_unpack((const uint8_t *)buf->str,
+			buf->len - 1, &chunk);
+		fail_unless(ret == SR_ERR_DATA);
+	}
+	g_string_free(buf, TRUE);
+}
+
+/* Packed integer samples survive the round trip, at all bit widths. */
+START_TEST(test_analog_pack_int)
+{
+	static const size_t counts[] = { 0, 1, 127, 128, 129, 1000, };
+	int32_t *values;
+	size_t i, c, bits;
+
+	values = g_malloc(1000 * sizeof(values[0]));
+	for (c = 0; c < G_N_ELEMENTS(counts); c++) {
+		/* Constant values pack into zero width blocks. */
+		for (i = 0; i < counts[c]; i++)
+			values[i] = -42;
+		check_analog_pack_int(values, counts[c]);
+
+		for (bits = 1; bits <= 32; bits++) {
+			for (i = 0; i < counts[c]; i++) {
+				values[i] = g_random_int();
+				if (bits < 32)
+					values[i] >>= 32 - bits;
+			}
+			check_analog_pack_int(values, counts[c]);
+		}
+
+		/* Largest possible differences. */
+		for (i = 0; i < counts[c]; i++)
+			values[i] = (i & 1) ? INT32_MIN : INT32_MAX;
+		check_analog_pack_int(values, counts[c]);
+	}
+	g_free(values);
+}
+END_TEST
+
+/* Float samples survive the round trip. */
+START_TEST(test_analog_pack_float)
+{
+	struct sr_sessionfile_analog_chunk chunk;
+	float values[300];
+	GString *buf;
+	size_t i;
+	int ret;
+
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = g_random_double_range(-1e6, 1e6);
+	buf = g_string_new(NULL);
+	sr_sessionfile_analog_pack_float(buf, values, G_N_ELEMENTS(values));
+	ret = sr_sessionfile_analog_unpack((const uint8_t *)buf->str,
+		buf->len, &chunk);
+	fail_unless(ret == SR_OK, "Unpack failed: %d.", ret);
+	fail_unless(chunk.is_float);
+	fail_unless(chunk.count == G_N_ELEMENTS(values));
+	fail_unless(memcmp(chunk.data, values, sizeof(values)) == 0);
+	g_free(chunk.data);
+
+	ret = sr_sessionfile_analog_unpack((const uint8_t *)buf->str,
+		buf->len - 1, &chunk);
+	fail_unless(ret == SR_ERR_DATA);
+
+	/* Bad magic. */
+	buf->str[0] = 'X';
+	ret = sr_sessionfile_analog_unpack((const uint8_t *)buf->str,
+		buf->len, &chunk);
+	fail_unless(ret == SR_ERR_DATA);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +309,10 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("analog_pack");
+	tcase_add_test(tc, test_analog_pack_int);
+	tcase_add_test(tc, test_analog_pack_float);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
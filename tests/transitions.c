@@ -0,0 +1,257 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2024 The libsigrok project contributors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+#define NUM_CHANNELS	12
+#define UNITSIZE	2
+#define NUM_SAMPLES	200000
+#define SAMPLERATE	SR_MHZ(1)
+
+static uint8_t *expected;
+static uint64_t received_samples, received_samplerate;
+static gboolean seen_end;
+
+/* Sparse changes with long idle periods, and some bursts. */
+static uint8_t *gen_samples(void)
+{
+	uint8_t *data;
+	uint16_t value;
+	size_t i;
+
+	data = g_malloc(NUM_SAMPLES * UNITSIZE);
+	value = 0x0a5;
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		if (g_random_int_range(0, 1000) == 0 || (i > 5000 && i < 5100))
+			value ^= 1 << g_random_int_range(0, NUM_CHANNELS);
+		if (i == 100000)
+			value = 0xfff;
+		data[i * UNITSIZE + 0] = value & 0xff;
+		data[i * UNITSIZE + 1] = value >> 8;
+	}
+
+	return data;
+}
+
+static GString *run_output(const uint8_t *data, uint32_t index_interval)
+{
+	const struct sr_output_module *omod;
+	const struct sr_output *o;
+	struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_datafeed_logic logic;
+	struct sr_config src;
+	GHashTable *options;
+	GString *file, *out;
+	char name[8];
+	size_t i, pos, len;
+	int ret;
+
+	sdi = sr_dev_inst_user_new("Test", "Transitions", NULL);
+	for (i = 0; i < NUM_CHANNELS; i++) {
+		snprintf(name, sizeof(name), "D%zu", i);
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, name);
+	}
+
+	omod = sr_output_find("transitions");
+	fail_unless(omod != NULL, "Couldn't find the 'transitions' output.");
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("index_interval"),
+		g_variant_ref_sink(g_variant_new_uint32(index_interval)));
+	o = sr_output_new(omod, options, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create output instance.");
+	g_hash_table_destroy(options);
+
+	file = g_string_new(NULL);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_new_uint64(SAMPLERATE);
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+
+	/* Logic packets of varying size. */
+	for (pos = 0; pos < NUM_SAMPLES; pos += len) {
+		len = g_random_int_range(1, 20000);
+		len = MIN(len, NUM_SAMPLES - pos);
+		logic.length = len * UNITSIZE;
+		logic.unitsize = UNITSIZE;
+		logic.data = (void *)&data[pos * UNITSIZE];
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		ret = sr_output_send(o, &packet, &out);
+		fail_unless(ret == SR_OK, "Output error: %d.", ret);
+		if (out) {
+			g_string_append_len(file, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	}
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(o, &packet, &out);
+	fail_unless(ret == SR_OK);
+	if (out) {
+		g_string_append_len(file, out->str, out->len);
+		g_string_free(out, TRUE);
+	}
+	sr_output_free(o);
+
+	return file;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_config *src;
+	uint64_t count;
+	GSList *l;
+
+	(void)sdi;
+	(void)cb_data;
+
+	fail_unless(!seen_end, "Packet after SR_DF_END.");
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				received_samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == UNITSIZE);
+		count = logic->length / logic->unitsize;
+		fail_unless(received_samples + count <= NUM_SAMPLES,
+			"Too many samples.");
+		fail_unless(memcmp(logic->data,
+			&expected[received_samples * UNITSIZE],
+			logic->length) == 0, "Sample data mismatch at %" PRIu64 ".",
+			received_samples);
+		received_samples += count;
+		break;
+	case SR_DF_END:
+		seen_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+static void run_input(const GString *file, size_t chunk)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GString *buf;
+	size_t pos, len;
+	int ret;
+
+	received_samples = received_samplerate = 0;
+	seen_end = FALSE;
+
+	imod = sr_input_find("transitions");
+	fail_unless(imod != NULL, "Couldn't find the 'transitions' input.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	sdi = NULL;
+	buf = g_string_new(NULL);
+	for (pos = 0; pos < file->len; pos += len) {
+		len = MIN(chunk, file->len - pos);
+		g_string_assign(buf, "");
+		g_string_append_len(buf, &file->str[pos], len);
+		ret = sr_input_send(in, buf);
+		fail_unless(ret == SR_OK, "Input error: %d.", ret);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in))) {
+			fail_unless(g_slist_length(sr_dev_inst_channels_get(sdi))
+				== NUM_CHANNELS);
+			sr_session_dev_add(session, sdi);
+		}
+	}
+	g_string_free(buf, TRUE);
+	fail_unless(sdi != NULL, "Input did not provide a device.");
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "Input end error: %d.", ret);
+	sr_input_free(in);
+	sr_session_destroy(session);
+
+	fail_unless(seen_end, "No SR_DF_END.");
+	fail_unless(received_samplerate == SAMPLERATE);
+	fail_unless(received_samples == NUM_SAMPLES,
+		"Expected %d samples, got %" PRIu64 ".", NUM_SAMPLES,
+		received_samples);
+}
+
+/* Logic data survives export and import without changes. */
+START_TEST(test_transitions_roundtrip)
+{
+	GString *file;
+
+	expected = gen_samples();
+
+	file = run_output(expected, 0);
+	fail_unless(file->len < NUM_SAMPLES * UNITSIZE / 10,
+		"Sparse data did not compress.");
+	run_input(file, file->len);
+	run_input(file, 7);
+	g_string_free(file, TRUE);
+
+	/* With a dense block index, which the reader skips. */
+	file = run_output(expected, 4);
+	run_input(file, 4096);
+	g_string_free(file, TRUE);
+
+	g_free(expected);
+	expected = NULL;
+}
+END_TEST
+
+Suite *suite_transitions(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("transitions");
+
+	tc = tcase_create("roundtrip");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_transitions_roundtrip);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
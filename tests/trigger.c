@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
 #include "lib.h"
 
 /* Test lots of triggers/stages/matches/channels */
@@ -30,6 +31,10 @@
 #define NUM_MATCHES 70
 #define NUM_CHANNELS NUM_MATCHES
 
+/* Randomized soft trigger setups, and the samples checked per setup. */
+#define NUM_SOFT_SETUPS 2000
+#define NUM_SOFT_SAMPLES 4096
+
 /* Check whether creating/freeing triggers with valid names works. */
 START_TEST(test_trigger_new_free)
 {
@@ -249,6 +254,187 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+/*
+ * Generate mostly stable logic data, so that level conditions on
+ * several channels can match. Starts from random levels, the very
+ * first sample never matches edge conditions.
+ */
+static uint8_t *soft_trigger_samples(int num_channels, int unitsize)
+{
+	uint8_t *data;
+	uint64_t value;
+	int i, b;
+
+	data = g_malloc(NUM_SOFT_SAMPLES * unitsize);
+	value = ((uint64_t)g_random_int() << 32) | g_random_int();
+	for (i = 0; i < NUM_SOFT_SAMPLES; i++) {
+		if (i && g_random_int_range(0, 64) == 0)
+			value = ((uint64_t)g_random_int() << 32) | g_random_int();
+		else if (i && g_random_int_range(0, 4) == 0)
+			value ^= UINT64_C(1) << g_random_int_range(0, num_channels);
+		if (num_channels < 64)
+			value &= (UINT64_C(1) << num_channels) - 1;
+		for (b = 0; b < unitsize; b++)
+			data[i * unitsize + b] = value >> (8 * b);
+	}
+
+	return data;
+}
+
+/* Feed the samples in random chunks, return the trigger's sample index. */
+static int soft_trigger_run(struct soft_trigger_logic *stl,
+		uint8_t *data, guint32 seed, int *pre_trigger_samples)
+{
+	GRand *rand;
+	int pos, len, offset;
+
+	rand = g_rand_new_with_seed(seed);
+	*pre_trigger_samples = 0;
+	offset = -1;
+	for (pos = 0; pos < NUM_SOFT_SAMPLES; pos += len) {
+		len = g_rand_int_range(rand, 1, 300);
+		len = MIN(len, NUM_SOFT_SAMPLES - pos);
+		offset = soft_trigger_logic_check(stl, data + pos * stl->unitsize,
+			len * stl->unitsize, pre_trigger_samples);
+		if (offset >= 0) {
+			offset += pos;
+			break;
+		}
+	}
+	g_rand_free(rand);
+
+	return offset;
+}
+
+/* The word-parallel soft trigger check agrees with the per-match check. */
+START_TEST(test_soft_trigger_fast)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi[64];
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+	struct soft_trigger_logic *fast, *slow;
+	uint8_t *data;
+	char name[8];
+	int setup, num_channels, num_matches, pre_trigger;
+	int i, ret, offset_fast, offset_slow, pre_fast, pre_slow;
+	guint32 seed;
+
+	sr_session_new(srtest_ctx, &session);
+	for (i = 0; i < 64; i++) {
+		sdi[i] = sr_dev_inst_user_new("Test", "Trigger", NULL);
+		for (num_channels = 0; num_channels <= i; num_channels++) {
+			sprintf(name, "D%d", num_channels);
+			sr_dev_inst_channel_add(sdi[i], num_channels,
+				SR_CHANNEL_LOGIC, name);
+		}
+		sr_session_dev_add(session, sdi[i]);
+	}
+
+	for (setup = 0; setup < NUM_SOFT_SETUPS; setup++) {
+		num_channels = g_random_int_range(1, 65);
+		trigger = sr_trigger_new(NULL);
+		stage = sr_trigger_stage_add(trigger);
+		num_matches = g_random_int_range(1, 5);
+		for (i = 0; i < num_matches; i++) {
+			ch = g_slist_nth_data(sdi[num_channels - 1]->channels,
+				g_random_int_range(0, num_channels));
+			ret = sr_trigger_match_add(stage, ch, g_random_int_range(
+				SR_TRIGGER_ZERO, SR_TRIGGER_EDGE + 1), 0);
+			fail_unless(ret == SR_OK);
+			/* Triggers on disabled channels get ignored. */
+			if (g_random_int_range(0, 8) == 0)
+				ch->enabled = FALSE;
+		}
+		pre_trigger = g_random_int_range(0, 100);
+
+		fast = soft_trigger_logic_new(sdi[num_channels - 1], trigger,
+			pre_trigger);
+		fail_unless(fast != NULL);
+		fail_unless(fast->fast, "Fast check not used for %d channels.",
+			num_channels);
+		slow = soft_trigger_logic_new(sdi[num_channels - 1], trigger,
+			pre_trigger);
+		fail_unless(slow != NULL);
+		slow->fast = FALSE;
+
+		data = soft_trigger_samples(num_channels, fast->unitsize);
+		seed = g_random_int();
+		offset_fast = soft_trigger_run(fast, data, seed, &pre_fast);
+		offset_slow = soft_trigger_run(slow, data, seed, &pre_slow);
+		fail_unless(offset_fast == offset_slow,
+			"Setup %d: trigger at %d, expected %d.",
+			setup, offset_fast, offset_slow);
+		fail_unless(pre_fast == pre_slow,
+			"Setup %d: %d pre-trigger samples, expected %d.",
+			setup, pre_fast, pre_slow);
+
+		g_free(data);
+		soft_trigger_logic_free(fast);
+		soft_trigger_logic_free(slow);
+		for (i = 0; i < num_channels; i++) {
+			ch = g_slist_nth_data(sdi[num_channels - 1]->channels, i);
+			ch->enabled = TRUE;
+		}
+		sr_trigger_free(trigger);
+	}
+
+	sr_session_destroy(session);
+}
+END_TEST
+
+/* Edges never match on the first sample, even when the channel starts high. */
+START_TEST(test_soft_trigger_first_sample)
+{
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct soft_trigger_logic *stl;
+	uint8_t data[] = { 0x03, 0x03, 0x02, 0x03, 0x03 };
+	int i, fast, chunk, offset, pre_trigger;
+
+	sr_session_new(srtest_ctx, &session);
+	sdi = sr_dev_inst_user_new("Test", "Trigger", NULL);
+	sr_dev_inst_channel_add(sdi, 0, SR_CHANNEL_LOGIC, "D0");
+	sr_dev_inst_channel_add(sdi, 1, SR_CHANNEL_LOGIC, "D1");
+	sr_session_dev_add(session, sdi);
+
+	/* D1 high and D0 rising: first matches at the fourth sample. */
+	trigger = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(trigger);
+	sr_trigger_match_add(stage, g_slist_nth_data(sdi->channels, 1),
+		SR_TRIGGER_ONE, 0);
+	sr_trigger_match_add(stage, g_slist_nth_data(sdi->channels, 0),
+		SR_TRIGGER_RISING, 0);
+
+	for (fast = 0; fast <= 1; fast++) {
+		/* Whole buffer at once, then one sample at a time. */
+		for (chunk = sizeof(data); chunk >= 1; chunk -= sizeof(data) - 1) {
+			stl = soft_trigger_logic_new(sdi, trigger, 0);
+			fail_unless(stl != NULL);
+			fail_unless(stl->fast);
+			stl->fast = fast;
+			offset = -1;
+			for (i = 0; offset < 0 && i < (int)sizeof(data); i += chunk) {
+				offset = soft_trigger_logic_check(stl, data + i,
+					chunk, &pre_trigger);
+				if (offset >= 0)
+					offset += i;
+			}
+			fail_unless(offset == 3,
+				"%s check in %d byte chunks: trigger at %d, expected 3.",
+				fast ? "Fast" : "Slow", chunk, offset);
+			soft_trigger_logic_free(stl);
+		}
+	}
+
+	sr_trigger_free(trigger);
+	sr_session_destroy(session);
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +462,12 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("soft");
+	tcase_set_timeout(tc, 0);
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_soft_trigger_fast);
+	tcase_add_test(tc, test_soft_trigger_first_sample);
+	suite_add_tcase(s, tc);
+
 	return s;
 }